@@ -544,7 +544,7 @@ void json_reader::skip_object()
         }
         skip_string(); // name.
         consume(':');
-        skip_object();
+        skip_property();
         if (peek() == ',')
         {
             consume(',');
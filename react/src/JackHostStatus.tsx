@@ -19,6 +19,7 @@
 
 import React from 'react';
 import Typography from '@mui/material/Typography';
+import Button from '@mui/material/Button';
 import { isDarkMode } from './DarkMode';
 
 const RED_COLOR = isDarkMode() ? "#F88" : "#C00";
@@ -49,6 +50,15 @@ function fmtCpuFreq(freq: number): string {
     return freq + " KHz";
 }
 
+export interface BufferSizeRecommendation {
+    valid: boolean;
+    bufferSize: number;
+    numberOfBuffers: number;
+    loadP999: number;
+    xruns: number;
+    reason: string;
+}
+
 export default class JackHostStatus {
     deserialize(input: any): JackHostStatus {
         this.active = input.active;
@@ -62,6 +72,8 @@ export default class JackHostStatus {
         this.cpuFreqMin = input.cpuFreqMin;
         this.hasCpuGovernor = input.hasCpuGovernor;
         this.governor = input.governor;
+        this.threadPlacement = input.threadPlacement ?? "";
+        this.bufferSizeRecommendation = input.bufferSizeRecommendation;
         return this;
     }
     hasTemperature(): boolean {
@@ -78,8 +90,10 @@ export default class JackHostStatus {
     cpuFreqMin: number = 0;
     hasCpuGovernor: boolean = false;
     governor: string = "";
+    threadPlacement: string = "";
+    bufferSizeRecommendation?: BufferSizeRecommendation;
 
-    static getCpuInfo(label: string, status?: JackHostStatus): React.ReactNode {
+    static getCpuInfo(label: string, status?: JackHostStatus, onApplyBufferSizeRecommendation?: () => void): React.ReactNode {
         if (!status) {
             return (<div style={{ whiteSpace: "nowrap" }}>
                 <Typography variant="caption" color="inherit">{label}</Typography>
@@ -103,6 +117,25 @@ export default class JackHostStatus {
                         }
                     </Typography>
                 )}
+            {status.threadPlacement !== "" &&
+                (
+                    <Typography display="block" variant="caption" color="inherit">
+                        {status.threadPlacement}
+                    </Typography>
+                )}
+            {status.bufferSizeRecommendation?.valid &&
+                (
+                    <Typography display="block" variant="caption" color="inherit">
+                        Recommended buffers: {status.bufferSizeRecommendation.bufferSize}x{status.bufferSizeRecommendation.numberOfBuffers}
+                        &nbsp;(p99.9 load {(status.bufferSizeRecommendation.loadP999 * 100).toFixed(0)}%)
+                        {onApplyBufferSizeRecommendation &&
+                            (
+                                <Button variant="text" size="small" style={{ minWidth: 0, padding: "0px 8px" }}
+                                    onClick={() => onApplyBufferSizeRecommendation()}
+                                >Apply</Button>
+                            )}
+                    </Typography>
+                )}
         </div>);
 
 
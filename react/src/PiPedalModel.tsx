@@ -89,6 +89,12 @@ export interface FileEntry {
     displayName: string;
     isDirectory: boolean;
     isProtected: boolean;
+    fileSize?: number;
+    lastModified?: number;
+    sampleRate?: number;
+    channels?: number;
+    duration?: number;
+    namArchitecture?: string;
 };
 
 export interface BreadcrumbEntry {
@@ -100,6 +106,7 @@ export class FileRequestResult {
     isProtected: boolean = false;
     breadcrumbs: BreadcrumbEntry[] = [];
     currentDirectory: string = "";
+    totalFiles: number = 0;
 };
 
 export type PluginPresetsChangedHandler = (pluginUri: string) => void;
@@ -215,6 +222,28 @@ class VuSubscriptionHandleImpl implements VuSubscriptionHandle {
 
 export type VuChangedHandler = (vuInfo: VuUpdateInfo) => void;
 
+export interface AudioTapRequest {
+    instanceId: number;
+    output: boolean;
+    channel: number;
+    mode: "waveform" | "spectrum";
+    points: number; // waveform: min/max pairs per frame. spectrum: FFT size.
+    updateRate: number; // frames per second.
+};
+
+export interface AudioTapFrame {
+    mode: "waveform" | "spectrum";
+    subscriptionHandle: number;
+    sampleRate: number;
+    droppedSamples: number;
+    values: Float32Array; // waveform: interleaved min/max pairs. spectrum: dBFS per bin.
+};
+
+export type AudioTapHandler = (frame: AudioTapFrame) => void;
+
+const AUDIO_TAP_FRAME_MAGIC = 0x50415450;
+const AUDIO_TAP_HEADER_SIZE = 32;
+
 
 class VuSubscriptionTarget {
     serverSubscriptionHandle?: number;
@@ -360,15 +389,29 @@ interface PedalboardItemEnableBody {
     instanceId: number,
     enabled: boolean
 }
+interface ControlHandle {
+    handle: number;
+    instanceId: number;
+    symbol: string;
+}
 interface PedalboardChangedBody {
     clientId: number;
     pedalboard: Pedalboard;
+    controlHandles?: ControlHandle[];
 }
 interface ControlChangedBody {
     clientId: number;
     instanceId: number;
     symbol: string;
     value: number;
+    handle?: number;
+};
+interface ControlHandleValueBody {
+    clientId: number;
+    handle: number;
+    instanceId: number; // used by the server if the handle is stale.
+    symbol: string;
+    value: number;
 };
 interface PatchPropertyChangedBody {
     clientId: number;
@@ -476,6 +519,7 @@ export class PiPedalModel //implements PiPedalModel
 
         this.onSocketError = this.onSocketError.bind(this);
         this.onSocketMessage = this.onSocketMessage.bind(this);
+        this.onSocketBinaryMessage = this.onSocketBinaryMessage.bind(this);
         this.onSocketReconnecting = this.onSocketReconnecting.bind(this);
         this.onSocketReconnected = this.onSocketReconnected.bind(this);
         this.onVisibilityChanged = this.onVisibilityChanged.bind(this);
@@ -675,6 +719,7 @@ export class PiPedalModel //implements PiPedalModel
             );
         } else if (message === "onPedalboardChanged") {
             let pedalChangedBody = body as PedalboardChangedBody;
+            this.setControlHandles(pedalChangedBody.controlHandles);
             this.setModelPedalboard(new Pedalboard().deserialize(pedalChangedBody.pedalboard));
 
         } else if (message === "onMidiValueChanged") {
@@ -918,6 +963,7 @@ export class PiPedalModel //implements PiPedalModel
             return; // page unloading. do NOT change the UI.
         }
         this.vuSubscriptions = [];
+        this.audioTapHandlers.clear();
         this.monitorPatchPropertyListeners = [];
 
         if (this.isAndroidHosted()) {
@@ -1004,6 +1050,7 @@ export class PiPedalModel //implements PiPedalModel
             this.socketServerUrl,
             {
                 onMessageReceived: this.onSocketMessage,
+                onBinaryMessageReceived: this.onSocketBinaryMessage,
                 onError: this.onSocketError,
                 onConnectionLost: this.onSocketConnectionLost,
                 onReconnect: this.onSocketReconnected,
@@ -1048,6 +1095,7 @@ export class PiPedalModel //implements PiPedalModel
                     await this.getWebSocket().request<Pedalboard>("currentPedalboard")
                 )
             );
+            this.setControlHandles(await this.getWebSocket().request<ControlHandle[]>("getControlHandles"));
             this.plugin_classes.set(new PluginClass().deserialize(
                 await this.getWebSocket().request<any>("pluginClasses")
             ));
@@ -1571,7 +1619,32 @@ export class PiPedalModel //implements PiPedalModel
         throw new PiPedalArgumentError("Pedalboard item not found.");
 
     }
+    // (instanceId/symbol) -> numeric handle issued by the server, so that control messages don't need symbol lookups.
+    private controlHandles: Map<string, number> = new Map<string, number>();
+
+    private setControlHandles(controlHandles: ControlHandle[] | undefined) {
+        let result = new Map<string, number>();
+        if (controlHandles) {
+            for (let controlHandle of controlHandles) {
+                result.set(controlHandle.instanceId + "/" + controlHandle.symbol, controlHandle.handle);
+            }
+        }
+        this.controlHandles = result;
+    }
+
     private _setServerControl(message: string, instanceId: number, key: string, value: number) {
+        let handle = this.controlHandles.get(instanceId + "/" + key);
+        if (handle !== undefined) {
+            let handleBody: ControlHandleValueBody = {
+                clientId: this.clientId,
+                handle: handle,
+                instanceId: instanceId,
+                symbol: key,
+                value: value
+            };
+            this.webSocket?.send(message + "ByHandle", handleBody);
+            return;
+        }
         let body: ControlChangedBody = {
             clientId: this.clientId,
             instanceId: instanceId,
@@ -1908,6 +1981,17 @@ export class PiPedalModel //implements PiPedalModel
                 { relativePath: relativeDirectoryPath, fileProperty: piPedalFileProperty }
             );
     }
+    requestFileListPage(
+        relativeDirectoryPath: string, piPedalFileProperty: UiFileProperty,
+        filter: string, offset: number, count: number): Promise<FileRequestResult> {
+        return nullCast(this.webSocket)
+            .request<FileRequestResult>('requestFileListPage',
+                {
+                    relativePath: relativeDirectoryPath, fileProperty: piPedalFileProperty,
+                    filter: filter, offset: offset, count: count
+                }
+            );
+    }
 
     deleteUserFile(fileName: string): Promise<boolean> {
         return nullCast(this.webSocket).request<boolean>('deleteUserFile', fileName);
@@ -2045,6 +2129,44 @@ export class PiPedalModel //implements PiPedalModel
 
     vuSubscriptions: (VuSubscriptionTarget | undefined)[] = [];
 
+    private audioTapHandlers: Map<number, AudioTapHandler> = new Map<number, AudioTapHandler>();
+
+    // Stream decimated waveforms or spectra of an effect's input or output. Returns a handle for removeAudioTap().
+    addAudioTap(request: AudioTapRequest, handler: AudioTapHandler): Promise<number> {
+        if (!this.webSocket) {
+            return Promise.reject("Not connected.");
+        }
+        return this.webSocket.request<number>("addAudioTap", request)
+            .then((subscriptionHandle) => {
+                this.audioTapHandlers.set(subscriptionHandle, handler);
+                return subscriptionHandle;
+            });
+    }
+    removeAudioTap(subscriptionHandle: number): void {
+        if (this.audioTapHandlers.delete(subscriptionHandle)) {
+            this.webSocket?.send("removeAudioTap", subscriptionHandle);
+        }
+    }
+
+    onSocketBinaryMessage(data: ArrayBuffer) {
+        // see AudioTapFrameHeader (AudioTap.hpp).
+        let view = new DataView(data);
+        if (data.byteLength < AUDIO_TAP_HEADER_SIZE || view.getUint32(0, true) !== AUDIO_TAP_FRAME_MAGIC) {
+            return;
+        }
+        let frame: AudioTapFrame = {
+            mode: view.getUint32(4, true) === 1 ? "spectrum" : "waveform",
+            subscriptionHandle: view.getUint32(8, true) + view.getInt32(12, true) * 4294967296,
+            sampleRate: view.getUint32(16, true),
+            droppedSamples: view.getUint32(24, true) + view.getUint32(28, true) * 4294967296,
+            values: new Float32Array(data, AUDIO_TAP_HEADER_SIZE, view.getUint32(20, true))
+        };
+        let handler = this.audioTapHandlers.get(frame.subscriptionHandle);
+        if (handler) {
+            handler(frame);
+        }
+    }
+
 
     addVuSubscription(instanceId: number, vuChangedHandler: VuChangedHandler): VuSubscriptionHandle {
 
@@ -2262,6 +2384,12 @@ export class PiPedalModel //implements PiPedalModel
                 this.showAlert(error);
             });
     }
+    applyBufferSizeRecommendation(): void {
+        this.webSocket?.request<boolean>("applyBufferSizeRecommendation")
+            .catch((error) => {
+                this.showAlert(error);
+            });
+    }
 
     updateVst3State(pedalboard: Pedalboard) {
         // let it = pedalboard.itemsGenerator();
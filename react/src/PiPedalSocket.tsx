@@ -38,6 +38,7 @@ type ReplyHandler = (header: PiPedalMessageHeader, body: any | null) => void;
 
 export interface PiPedalSocketListener {
     onMessageReceived: (header: PiPedalMessageHeader, body: any | null) => void;
+    onBinaryMessageReceived?: (data: ArrayBuffer) => void;
     onError: (message: string, exception?: Error) => void;
     onConnectionLost: () => void;
     onReconnect: () => void;
@@ -138,7 +139,11 @@ class PiPedalSocket {
             }
         });
     }
-    handleMessage(event: MessageEvent<string>): any {
+    handleMessage(event: MessageEvent<string | ArrayBuffer>): any {
+        if (event.data instanceof ArrayBuffer) {
+            this.listener.onBinaryMessageReceived?.(event.data);
+            return;
+        }
         try {
             let message: any = JSON.parse(event.data);
             if (!Array.isArray(message)) {
@@ -269,6 +274,7 @@ class PiPedalSocket {
         return new Promise<WebSocket>((resolve, reject) => {
             try {
                 let ws = new WebSocket(this.url);
+                ws.binaryType = "arraybuffer";
 
                 let self = this;
 
@@ -616,7 +616,8 @@ const SettingsDialog = withStyles(styles, { withTheme: true })(
                                         (
                                             <div className={classes.cpuStatusColor} style={{ paddingLeft: 48, position: "relative", top: -12 }}>
                                                 {JackHostStatus.getDisplayView("", this.state.jackStatus)}
-                                                {(!this.props.onboarding) && JackHostStatus.getCpuInfo("Governor:\u00A0", this.state.jackStatus)}
+                                                {(!this.props.onboarding) && JackHostStatus.getCpuInfo("Governor:\u00A0", this.state.jackStatus,
+                                                    () => this.model.applyBufferSizeRecommendation())}
                                             </div>
                                         )
                                     }
@@ -37,8 +37,12 @@
 #include "SchedulerPriority.hpp"
 
 #include "CpuUse.hpp"
+#include "LockFreeQueue.hpp"
 
 #include <alsa/asoundlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "Lv2Log.hpp"
 #include <limits>
@@ -46,6 +50,10 @@
 
 #undef ALSADRIVER_CONFIG_DBG
 
+// Use mmap access to transfer audio directly to and from the DMA buffer when the device supports it.
+// Set to 0 to force read/write access.
+#define ALSADRIVER_USE_MMAP 1
+
 #ifdef ALSADRIVER_CONFIG_DBG
 #include <stdio.h>
 #endif
@@ -54,6 +62,54 @@ using namespace pipedal;
 
 namespace pipedal
 {
+    static int64_t MonotonicNanoseconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    // A MIDI message, as timestamped by the MIDI input thread.
+    struct AlsaMidiMessage
+    {
+        int64_t timeNs; // CLOCK_MONOTONIC
+        uint8_t size;
+        uint8_t data[3];
+    };
+
+    // What the MIDI input thread should do with a device after poll() returns.
+    enum class MidiPollResult
+    {
+        Idle,
+        Readable,
+        Failed
+    };
+
+    static MidiPollResult ClassifyMidiPollRevents(unsigned short revents)
+    {
+        // An unplugged device reports POLLHUP/POLLERR on every poll() until it is closed, so
+        // an error takes precedence over any data that may be pending.
+        if (revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            return MidiPollResult::Failed;
+        }
+        if (revents & POLLIN)
+        {
+            return MidiPollResult::Readable;
+        }
+        return MidiPollResult::Idle;
+    }
+
+    // Removes a device's descriptors from a poll set. poll() ignores entries with a negative fd.
+    static void DisableMidiPollFds(struct pollfd *pfds, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            pfds[i].fd = -1;
+            pfds[i].events = 0;
+            pfds[i].revents = 0;
+        }
+    }
 
     static bool ShouldForceStereoChannels(snd_pcm_t *pcmHandle, snd_pcm_hw_params_t *hwParams, unsigned int channelsMin, unsigned int channelsMax)
     {
@@ -243,6 +299,13 @@ namespace pipedal
         AlsaError(SS("No supported audio formats (" << alsa_device_name << "/" << streamType << ")"));
     }
 
+    // Location of one channel's samples in an ALSA buffer: address of the first sample, and bytes between samples.
+    struct AlsaChannelArea
+    {
+        uint8_t *address = nullptr;
+        size_t step = 0;
+    };
+
     class AlsaDriverImpl : public AudioDriver
     {
     private:
@@ -265,13 +328,18 @@ namespace pipedal
         bool soft_mode = false;
 
         snd_pcm_format_t captureFormat = snd_pcm_format_t::SND_PCM_FORMAT_UNKNOWN;
+        snd_pcm_format_t playbackFormat = snd_pcm_format_t::SND_PCM_FORMAT_UNKNOWN;
+
+        bool captureMmap = false;
+        bool playbackMmap = false;
 
         uint32_t playbackSampleSize = 0;
         uint32_t captureSampleSize = 0;
         uint32_t playbackFrameSize = 0;
         uint32_t captureFrameSize = 0;
 
-        using CopyFunction = void (AlsaDriverImpl::*)(size_t frames);
+        // Converts frames between the channel areas and frames [offset, offset+frames) of the float buffers.
+        using CopyFunction = void (AlsaDriverImpl::*)(size_t offset, size_t frames);
 
         CopyFunction copyInputFn;
         CopyFunction copyOutputFn;
@@ -285,9 +353,13 @@ namespace pipedal
         std::vector<float *> captureBuffers;
         std::vector<float *> playbackBuffers;
 
+        // used only with read/write access.
         std::vector<uint8_t> rawCaptureBuffer;
         std::vector<uint8_t> rawPlaybackBuffer;
 
+        std::vector<AlsaChannelArea> captureAreas;
+        std::vector<AlsaChannelArea> playbackAreas;
+
         AudioDriverHost *driverHost = nullptr;
 
         void validate_capture_handle()
@@ -366,6 +438,7 @@ namespace pipedal
         snd_pcm_sw_params_t *playbackSwParams = nullptr;
 
         bool capture_and_playback_not_synced = false;
+        bool captureTimestampsValid = false;
 
         std::mutex terminateSync;
 
@@ -437,7 +510,8 @@ namespace pipedal
             snd_pcm_hw_params_t *hwParams,
             snd_pcm_sw_params_t *swParams,
             int *channels,
-            unsigned int *periods)
+            unsigned int *periods,
+            bool *mmapAccess)
         {
             int err;
             snd_pcm_uframes_t stop_th;
@@ -447,10 +521,25 @@ namespace pipedal
                 AlsaError(SS("No playback configurations available (" << snd_strerror(err) << ")"));
             }
 
-            err = snd_pcm_hw_params_set_access(handle, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
-            if (err < 0)
+            *mmapAccess = false;
+#if ALSADRIVER_USE_MMAP
+            // Failed attempts leave hwParams unchanged.
+            if (snd_pcm_hw_params_set_access(handle, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0)
+            {
+                *mmapAccess = true;
+            }
+            else if (snd_pcm_hw_params_set_access(handle, hwParams, SND_PCM_ACCESS_MMAP_NONINTERLEAVED) >= 0)
             {
-                AlsaError("snd_pcm_hw_params_set_access failed.");
+                *mmapAccess = true;
+            }
+#endif
+            if (!*mmapAccess)
+            {
+                err = snd_pcm_hw_params_set_access(handle, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
+                if (err < 0)
+                {
+                    AlsaError("snd_pcm_hw_params_set_access failed.");
+                }
             }
 
             SetPreferredAlsaFormat(alsa_device_name, streamType, handle, hwParams);
@@ -544,6 +633,9 @@ namespace pipedal
             {
                 AlsaError(SS("Cannot set hardware parameters for " << alsa_device_name));
             }
+            snd_pcm_access_t access = SND_PCM_ACCESS_RW_INTERLEAVED;
+            snd_pcm_hw_params_get_access(hwParams, &access);
+            Lv2Log::info(SS("ALSA " << streamType << " access: " << snd_pcm_access_name(access)));
 
             snd_pcm_sw_params_current(handle, swParams);
 
@@ -595,21 +687,37 @@ namespace pipedal
                 AlsaError(SS("Cannot set avail min for " << alsa_device_name));
             }
 
-            // err = snd_pcm_sw_params_set_tstamp_mode(handle, swParams, SND_PCM_TSTAMP_ENABLE);
-            // if (err < 0)
-            // {
-            //     Lv2Log::info(SS(
-            //         "Could not enable ALSA time stamp mode for " << alsa_device_name << " (err " << err << ")"));
-            // }
+            bool timestampsEnabled = false;
+            if (handle == this->captureHandle)
+            {
+                // capture timestamps are used to position MIDI events within the audio buffer.
+                err = snd_pcm_sw_params_set_tstamp_mode(handle, swParams, SND_PCM_TSTAMP_ENABLE);
+                if (err < 0)
+                {
+                    Lv2Log::info(SS(
+                        "Could not enable ALSA time stamp mode for " << alsa_device_name << " (err " << err << ")"));
+                }
+                else
+                {
+                    timestampsEnabled = true;
+                }
+            }
 
 #if SND_LIB_MAJOR >= 1 && SND_LIB_MINOR >= 1
             err = snd_pcm_sw_params_set_tstamp_type(handle, swParams, SND_PCM_TSTAMP_TYPE_MONOTONIC);
             if (err < 0)
             {
+                timestampsEnabled = false;
                 Lv2Log::info(SS(
                     "Could not use monotonic ALSA time stamps for " << alsa_device_name << "(err " << err << ")"));
             }
+#else
+            timestampsEnabled = false;
 #endif
+            if (handle == this->captureHandle)
+            {
+                this->captureTimestampsValid = timestampsEnabled;
+            }
 
             if ((err = snd_pcm_sw_params(handle, swParams)) < 0)
             {
@@ -636,7 +744,8 @@ namespace pipedal
                     captureHwParams,
                     captureSwParams,
                     &captureChannels,
-                    &this->periods);
+                    &this->periods,
+                    &captureMmap);
             }
             if (this->playbackHandle)
             {
@@ -647,7 +756,8 @@ namespace pipedal
                     playbackHwParams,
                     playbackSwParams,
                     &playbackChannels,
-                    &this->periods);
+                    &this->periods,
+                    &playbackMmap);
             }
 
 #ifdef ALSADRIVER_CONFIG_DBG
@@ -677,310 +787,341 @@ namespace pipedal
             int32_t v = EndianSwap(*(int32_t *)&v_);
             *(int32_t *)p = v;
         }
-        template <typename T>
-        static T *getCaptureBuffer(std::vector<uint8_t> &buffer) { return (T *)(buffer.data()); }
-
-        void CopyCaptureFloatBe(size_t frames)
+        // Set the channel areas to describe the interleaved raw buffer used for read/write access.
+        static void SetRawAreas(std::vector<AlsaChannelArea> &areas, std::vector<uint8_t> &buffer, int channels, uint32_t sampleSize)
         {
-            int32_t *p = getCaptureBuffer<int32_t>(rawCaptureBuffer);
+            areas.resize(channels);
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                areas[channel].address = buffer.data() + channel * sampleSize;
+                areas[channel].step = channels * sampleSize;
+            }
+        }
+        // Set the channel areas to describe the mmap DMA buffer at the given frame offset.
+        static void SetMmapAreas(std::vector<AlsaChannelArea> &areas, const snd_pcm_channel_area_t *mmapAreas, snd_pcm_uframes_t offset, int channels)
+        {
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                const snd_pcm_channel_area_t &mmapArea = mmapAreas[channel];
+                areas[channel].address = ((uint8_t *)mmapArea.addr) + (mmapArea.first + offset * mmapArea.step) / 8;
+                areas[channel].step = mmapArea.step / 8;
+            }
+        }
 
-            std::vector<float *> &buffers = this->captureBuffers;
+        void CopyCaptureFloatBe(size_t offset, size_t frames)
+        {
             int channels = this->captureChannels;
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int32_t v = EndianSwap(*p);
-                    ++p;
+                    int32_t v = EndianSwap(*(const int32_t *)p);
+                    p += step;
 
-                    *(int32_t *)(buffers[channel] + frame) = v;
+                    *(int32_t *)(output + frame) = v;
                 }
             }
         }
 
-        void CopyCaptureFloatLe(size_t frames)
+        void CopyCaptureFloatLe(size_t offset, size_t frames)
         {
-            float *p = getCaptureBuffer<float>(rawCaptureBuffer);
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = *p++;
-                    buffers[channel][frame] = v;
+                    float v = *(const float *)p;
+                    p += step;
+                    output[frame] = v;
                 }
             }
         }
 
-        void CopyCaptureS16Le(size_t frames)
+        void CopyCaptureS16Le(size_t offset, size_t frames)
         {
-            int16_t *p = getCaptureBuffer<int16_t>(rawCaptureBuffer);
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int16_t>::max() + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int16_t v = *p++;
-                    buffers[channel][frame] = scale * v;
+                    int16_t v = *(const int16_t *)p;
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS16Be(size_t frames)
+        void CopyCaptureS16Be(size_t offset, size_t frames)
         {
-            int16_t *p = getCaptureBuffer<int16_t>(rawCaptureBuffer);
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int16_t>::max() + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int16_t v = EndianSwap(*p++);
-                    buffers[channel][frame] = scale * v;
+                    int16_t v = EndianSwap(*(const int16_t *)p);
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
 
-        void CopyCaptureS32Le(size_t frames)
+        void CopyCaptureS32Le(size_t offset, size_t frames)
         {
-            int32_t *p = getCaptureBuffer<int32_t>(rawCaptureBuffer);
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int32_t>::max() + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int32_t v = *p++;
-                    buffers[channel][frame] = scale * v;
+                    int32_t v = *(const int32_t *)p;
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS24_3Le(size_t frames)
+        void CopyCaptureS24_3Le(size_t offset, size_t frames)
         {
-            uint8_t *p = getCaptureBuffer<uint8_t>(rawCaptureBuffer);
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int32_t>::max() + 1LL);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
                     int32_t v = (p[0] << 8) + (p[1] << 16) | (p[2] << 24);
-                    p += 3;
-                    buffers[channel][frame] = scale * v;
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS24_3Be(size_t frames)
+        void CopyCaptureS24_3Be(size_t offset, size_t frames)
         {
-            uint8_t *p = (uint8_t *)rawCaptureBuffer.data();
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int32_t>::max() + 1LL);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
                     int32_t v = (p[2] << 8) + (p[1] << 16) | (p[0] << 24);
-                    p += 3;
-                    buffers[channel][frame] = scale * v;
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS24Le(size_t frames)
+        void CopyCaptureS24Le(size_t offset, size_t frames)
         {
-            int32_t *p = (int32_t *)rawCaptureBuffer.data();
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (0x00FFFFFFL + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int32_t v = *p++;
-                    buffers[channel][frame] = scale * v;
+                    int32_t v = *(const int32_t *)p;
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS24Be(size_t frames)
+        void CopyCaptureS24Be(size_t offset, size_t frames)
         {
-            int32_t *p = (int32_t *)rawCaptureBuffer.data();
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (0x00FFFFFFL + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int32_t v = EndianSwap(*p++);
-                    buffers[channel][frame] = scale * v;
+                    int32_t v = EndianSwap(*(const int32_t *)p);
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyCaptureS32Be(size_t frames)
+        void CopyCaptureS32Be(size_t offset, size_t frames)
         {
-            int32_t *p = (int32_t *)rawCaptureBuffer.data();
-
-            std::vector<float *> &buffers = this->captureBuffers;
             int channels = this->captureChannels;
             constexpr float scale = 1.0f / (std::numeric_limits<int32_t>::max() + 1L);
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                const uint8_t *p = captureAreas[channel].address;
+                size_t step = captureAreas[channel].step;
+                float *output = captureBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    int32_t v = EndianSwap(*p++);
-                    buffers[channel][frame] = scale * v;
+                    int32_t v = EndianSwap(*(const int32_t *)p);
+                    p += step;
+                    output[frame] = scale * v;
                 }
             }
         }
-        void CopyPlaybackS16Le(size_t frames)
+        void CopyPlaybackS16Le(size_t offset, size_t frames)
         {
-            int16_t *p = (int16_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int16_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = (int16_t)(scale * v);
+                    *(int16_t *)p = (int16_t)(scale * v);
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS16Be(size_t frames)
+        void CopyPlaybackS16Be(size_t offset, size_t frames)
         {
-            int16_t *p = (int16_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int16_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = EndianSwap((int16_t)(scale * v));
+                    *(int16_t *)p = EndianSwap((int16_t)(scale * v));
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS32Le(size_t frames)
+        void CopyPlaybackS32Le(size_t offset, size_t frames)
         {
-            int32_t *p = (int32_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int32_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = (int32_t)(scale * v);
+                    *(int32_t *)p = (int32_t)(scale * v);
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS24Le(size_t frames)
+        void CopyPlaybackS24Le(size_t offset, size_t frames)
         {
             // 24 bits in low bits of an int32_t.
 
-            int32_t *p = (int32_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = 0x00FFFFFF;
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = (int32_t)(scale * v);
+                    *(int32_t *)p = (int32_t)(scale * v);
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS24Be(size_t frames)
+        void CopyPlaybackS24Be(size_t offset, size_t frames)
         {
             // 24 bits in low bits of an int32_t.
 
-            int32_t *p = (int32_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = 0x00FFFFFF;
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = EndianSwap((int32_t)(scale * v));
+                    *(int32_t *)p = EndianSwap((int32_t)(scale * v));
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS32Be(size_t frames)
+        void CopyPlaybackS32Be(size_t offset, size_t frames)
         {
-            int32_t *p = (int32_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int32_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
                         v = -1.0f;
-                    *p++ = EndianSwap((int32_t)(scale * v));
+                    *(int32_t *)p = EndianSwap((int32_t)(scale * v));
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS24_3Be(size_t frames)
+        void CopyPlaybackS24_3Be(size_t offset, size_t frames)
         {
-            uint8_t *p = (uint8_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int32_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
@@ -989,23 +1130,22 @@ namespace pipedal
                     p[0] = (uint8_t)(iValue >> 24);
                     p[1] = (uint8_t)(iValue >> 16);
                     p[2] = (uint8_t)(iValue >> 8);
-
-                    p += 3;
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackS24_3Le(size_t frames)
+        void CopyPlaybackS24_3Le(size_t offset, size_t frames)
         {
-            uint8_t *p = (uint8_t *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
             int channels = this->playbackChannels;
             constexpr float scale = std::numeric_limits<int32_t>::max();
-            for (size_t frame = 0; frame < frames; ++frame)
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
+                    float v = input[frame];
                     if (v > 1.0f)
                         v = 1.0f;
                     else if (v < -1.0f)
@@ -1014,46 +1154,45 @@ namespace pipedal
                     p[0] = (uint8_t)(iValue >> 8);
                     p[1] = (uint8_t)(iValue >> 16);
                     p[2] = (uint8_t)(iValue >> 24);
-
-                    p += 3;
+                    p += step;
                 }
             }
         }
 
-        void CopyPlaybackFloatLe(size_t frames)
+        void CopyPlaybackFloatLe(size_t offset, size_t frames)
         {
-            float *p = (float *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
-            int channels = this->captureChannels;
-            for (size_t frame = 0; frame < frames; ++frame)
+            int channels = this->playbackChannels;
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
-                    *p++ = v;
+                    *(float *)p = input[frame];
+                    p += step;
                 }
             }
         }
-        void CopyPlaybackFloatBe(size_t frames)
+        void CopyPlaybackFloatBe(size_t offset, size_t frames)
         {
-            float *p = (float *)rawPlaybackBuffer.data();
-
-            std::vector<float *> &buffers = this->playbackBuffers;
-            int channels = this->captureChannels;
-            for (size_t frame = 0; frame < frames; ++frame)
+            int channels = this->playbackChannels;
+            for (int channel = 0; channel < channels; ++channel)
             {
-                for (int channel = 0; channel < channels; ++channel)
+                uint8_t *p = playbackAreas[channel].address;
+                size_t step = playbackAreas[channel].step;
+                const float *input = playbackBuffers[channel] + offset;
+                for (size_t frame = 0; frame < frames; ++frame)
                 {
-                    float v = buffers[channel][frame];
-                    EndianSwap(p, v);
-                    p++;
+                    EndianSwap((float *)p, input[frame]);
+                    p += step;
                 }
             }
         }
 
     public:
         void TestFormatEncodeDecode(snd_pcm_format_t captureFormat);
+        void TestCaptureFault();
 
     private:
         void AllocateBuffers(std::vector<float *> &buffers, size_t n)
@@ -1153,8 +1292,18 @@ namespace pipedal
             }
 
             captureFrameSize = captureSampleSize * captureChannels;
-            rawCaptureBuffer.resize(captureFrameSize * bufferSize);
-            memset(rawCaptureBuffer.data(), 0, captureFrameSize * bufferSize);
+            if (captureMmap)
+            {
+                // set per-transfer by ReadMmap.
+                rawCaptureBuffer.resize(0);
+                captureAreas.resize(captureChannels);
+            }
+            else
+            {
+                rawCaptureBuffer.resize(captureFrameSize * bufferSize);
+                memset(rawCaptureBuffer.data(), 0, captureFrameSize * bufferSize);
+                SetRawAreas(captureAreas, rawCaptureBuffer, captureChannels, captureSampleSize);
+            }
 
             AllocateBuffers(captureBuffers, captureChannels);
         }
@@ -1168,11 +1317,13 @@ namespace pipedal
                 << ", " << this->sampleRate
                 << ", " << this->bufferSize << "x" << this->numberOfBuffers
                 << ", in: " << this->InputBufferCount() << "/" << this->captureChannels
-                << ", out: " << this->OutputBufferCount() << "/" << this->playbackChannels);
+                << ", out: " << this->OutputBufferCount() << "/" << this->playbackChannels
+                << ((this->captureMmap && this->playbackMmap) ? ", mmap" : ""));
             return result;
         }
         void PreparePlaybackFunctions(snd_pcm_format_t playbackFormat)
         {
+            this->playbackFormat = playbackFormat;
             copyOutputFn = nullptr;
             switch (playbackFormat)
             {
@@ -1225,8 +1376,18 @@ namespace pipedal
             }
 
             playbackFrameSize = playbackSampleSize * playbackChannels;
-            rawPlaybackBuffer.resize(playbackFrameSize * bufferSize);
-            memset(rawPlaybackBuffer.data(), 0, playbackFrameSize * bufferSize);
+            if (playbackMmap)
+            {
+                // set per-transfer by WriteMmap.
+                rawPlaybackBuffer.resize(0);
+                playbackAreas.resize(playbackChannels);
+            }
+            else
+            {
+                rawPlaybackBuffer.resize(playbackFrameSize * bufferSize);
+                memset(rawPlaybackBuffer.data(), 0, playbackFrameSize * bufferSize);
+                SetRawAreas(playbackAreas, rawPlaybackBuffer, playbackChannels, playbackSampleSize);
+            }
 
             AllocateBuffers(playbackBuffers, playbackChannels);
         }
@@ -1366,7 +1527,10 @@ namespace pipedal
         {
             validate_capture_handle();
 
-            memset(rawPlaybackBuffer.data(), 0, playbackFrameSize * bufferSize);
+            if (!playbackMmap)
+            {
+                memset(rawPlaybackBuffer.data(), 0, playbackFrameSize * bufferSize);
+            }
             int retry = 0;
             while (true)
             {
@@ -1390,7 +1554,15 @@ namespace pipedal
                 if (avail > this->bufferSize)
                     avail = this->bufferSize;
 
-                ssize_t err = WriteBuffer(playbackHandle, rawPlaybackBuffer.data(), avail);
+                ssize_t err;
+                if (playbackMmap)
+                {
+                    err = WriteMmap(avail, true);
+                }
+                else
+                {
+                    err = WriteBuffer(playbackHandle, rawPlaybackBuffer.data(), avail);
+                }
                 if (err < 0)
                 {
                     throw PiPedalStateException(SS("Audio playback failed. " << snd_strerror(err)));
@@ -1532,15 +1704,142 @@ namespace pipedal
             return framesRead;
         }
 
-        void ReadMidiData(uint32_t audioFrame)
+        // Read capture frames with mmap access, converting directly from the DMA buffer.
+        // Returns the number of frames read, or a negative ALSA error.
+        snd_pcm_sframes_t ReadMmap(snd_pcm_uframes_t frames)
         {
-            for (size_t i = 0; i < midiDevices.size(); ++i)
+            snd_pcm_uframes_t framesRead = 0;
+            while (framesRead < frames)
             {
-                size_t nRead = midiDevices[i]->ReadMidiEvents(
-                    this->midiEvents,
-                    midiEventCount,
-                    audioFrame);
-                midiEventCount += nRead;
+                snd_pcm_sframes_t avail = snd_pcm_avail_update(captureHandle);
+                if (avail < 0)
+                {
+                    return avail;
+                }
+                if (avail == 0)
+                {
+                    int err = snd_pcm_wait(captureHandle, 1);
+                    if (err < 0)
+                    {
+                        return err;
+                    }
+                    continue;
+                }
+                const snd_pcm_channel_area_t *areas;
+                snd_pcm_uframes_t offset;
+                snd_pcm_uframes_t thisTime = frames - framesRead;
+                int err = snd_pcm_mmap_begin(captureHandle, &areas, &offset, &thisTime);
+                if (err < 0)
+                {
+                    return err;
+                }
+                SetMmapAreas(captureAreas, areas, offset, captureChannels);
+                (this->*copyInputFn)(framesRead, thisTime);
+
+                snd_pcm_sframes_t committed = snd_pcm_mmap_commit(captureHandle, offset, thisTime);
+                if (committed < 0)
+                {
+                    return committed;
+                }
+                if ((snd_pcm_uframes_t)committed != thisTime)
+                {
+                    return -EPIPE;
+                }
+                framesRead += thisTime;
+            }
+            return (snd_pcm_sframes_t)framesRead;
+        }
+
+        // Read one buffer of capture frames, with mmap access or snd_pcm_readi, but never both.
+        // Returns the number of frames read, or a negative ALSA error.
+        snd_pcm_sframes_t ReadCaptureBuffer()
+        {
+            return ReadCaptureBuffer(
+                [this](snd_pcm_uframes_t frames)
+                { return ReadMmap(frames); },
+                [this](snd_pcm_t *handle, uint8_t *buffer, snd_pcm_uframes_t frames)
+                { return ReadBuffer(handle, buffer, frames); });
+        }
+
+        // (Transfer functions are template parameters so that tests can inject faults without adding
+        // an indirect call to the audio thread.)
+        template <typename READ_MMAP, typename READ_BUFFER>
+        snd_pcm_sframes_t ReadCaptureBuffer(READ_MMAP &&readMmap, READ_BUFFER &&readBuffer)
+        {
+            if (captureMmap)
+            {
+                return readMmap(bufferSize);
+            }
+            snd_pcm_uframes_t framesToRead = bufferSize;
+            snd_pcm_uframes_t framesRead = 0;
+            while (framesToRead != 0)
+            {
+                snd_pcm_sframes_t nFrames = readBuffer(
+                    captureHandle,
+                    this->rawCaptureBuffer.data() + this->captureFrameSize * framesRead,
+                    framesToRead);
+                if (nFrames < 0)
+                {
+                    return nFrames;
+                }
+                framesRead += nFrames;
+                framesToRead -= nFrames;
+            }
+            return (snd_pcm_sframes_t)framesRead;
+        }
+
+        // CLOCK_MONOTONIC time at which the last frame of the most recently read capture buffer was captured.
+        int64_t GetCaptureEndTimeNs()
+        {
+            if (captureTimestampsValid)
+            {
+                snd_pcm_uframes_t avail;
+                snd_htimestamp_t tstamp;
+                if (snd_pcm_htimestamp(captureHandle, &avail, &tstamp) == 0 && (tstamp.tv_sec != 0 || tstamp.tv_nsec != 0))
+                {
+                    int64_t t = tstamp.tv_sec * 1000000000LL + tstamp.tv_nsec;
+                    return t - (int64_t)avail * 1000000000LL / sampleRate;
+                }
+            }
+            return MonotonicNanoseconds();
+        }
+
+        // Transfer MIDI messages received from the MIDI input thread, converting timestamps to frame offsets.
+        // Messages received after the end of the current capture buffer are left for the next cycle, so that
+        // MIDI latency is constant rather than jittering by up to a full period.
+        void ReadMidiData(uint32_t frames)
+        {
+            this->midiEventCount = 0;
+            if (midiDevices.size() == 0)
+            {
+                return;
+            }
+            int64_t periodEndNs = GetCaptureEndTimeNs();
+            int64_t periodStartNs = periodEndNs - (int64_t)frames * 1000000000LL / sampleRate;
+
+            uint32_t lastFrame = 0;
+            AlsaMidiMessage *message;
+            while (midiEventCount < midiEvents.size() && (message = midiInputQueue.peek()) != nullptr)
+            {
+                int64_t frame = (message->timeNs - periodStartNs) * (int64_t)sampleRate / 1000000000LL;
+                if (frame >= (int64_t)frames)
+                {
+                    break;
+                }
+                if (frame < lastFrame)
+                {
+                    frame = lastFrame;
+                }
+                lastFrame = (uint32_t)frame;
+
+                MidiEvent &event = midiEvents[midiEventCount++];
+                event.time = (uint32_t)frame;
+                event.size = message->size;
+                for (size_t i = 0; i < message->size; ++i)
+                {
+                    event.buffer[i] = message->data[i];
+                }
+                midiInputQueue.pop();
             }
         }
 
@@ -1561,6 +1860,57 @@ namespace pipedal
             }
             return 0;
         }
+        // Write playback frames with mmap access, converting directly into the DMA buffer (or writing silence).
+        // Returns 0, or a negative ALSA error.
+        long WriteMmap(size_t frames, bool silence)
+        {
+            snd_pcm_uframes_t framesWritten = 0;
+            while (framesWritten < frames)
+            {
+                snd_pcm_sframes_t avail = snd_pcm_avail_update(playbackHandle);
+                if (avail < 0)
+                {
+                    return avail;
+                }
+                if (avail == 0)
+                {
+                    int err = snd_pcm_wait(playbackHandle, 1);
+                    if (err < 0)
+                    {
+                        return err;
+                    }
+                    continue;
+                }
+                const snd_pcm_channel_area_t *areas;
+                snd_pcm_uframes_t offset;
+                snd_pcm_uframes_t thisTime = frames - framesWritten;
+                int err = snd_pcm_mmap_begin(playbackHandle, &areas, &offset, &thisTime);
+                if (err < 0)
+                {
+                    return err;
+                }
+                if (silence)
+                {
+                    snd_pcm_areas_silence(areas, offset, playbackChannels, thisTime, playbackFormat);
+                }
+                else
+                {
+                    SetMmapAreas(playbackAreas, areas, offset, playbackChannels);
+                    (this->*copyOutputFn)(framesWritten, thisTime);
+                }
+                snd_pcm_sframes_t committed = snd_pcm_mmap_commit(playbackHandle, offset, thisTime);
+                if (committed < 0)
+                {
+                    return committed;
+                }
+                if ((snd_pcm_uframes_t)committed != thisTime)
+                {
+                    return -EPIPE;
+                }
+                framesWritten += thisTime;
+            }
+            return 0;
+        }
         void AudioThread()
         {
             SetThreadName("alsaDriver");
@@ -1593,36 +1943,17 @@ namespace pipedal
                     this->midiEventCount = 0;
 
                     // snd_pcm_wait(captureHandle, 1);
-                    ssize_t framesToRead = bufferSize;
-                    ssize_t framesRead = 0;
-                    bool xrun = false;
                     validate_capture_handle();
 
-                    while (framesToRead != 0)
+                    ssize_t framesRead = ReadCaptureBuffer();
+                    if (framesRead < 0)
                     {
-                        ReadMidiData((uint32_t)framesRead);
-
-                        ssize_t thisTime = framesToRead;
-                        ssize_t nFrames;
-                        if ((nFrames = ReadBuffer(
-                                 captureHandle,
-                                 this->rawCaptureBuffer.data() + this->captureFrameSize * framesRead,
-                                 framesToRead)) < 0)
-                        {
-                            this->driverHost->OnUnderrun();
-                            recover_from_input_underrun(captureHandle, playbackHandle, nFrames);
-                            xrun = true;
-                            break;
-                        }
-                        framesRead += nFrames;
-                        framesToRead -= nFrames;
+                        this->driverHost->OnUnderrun();
+                        recover_from_input_underrun(captureHandle, playbackHandle, framesRead);
+                        continue;
                     }
                     validate_capture_handle();
 
-                    if (xrun)
-                    {
-                        continue;
-                    }
                     cpuUse.AddSample(ProfileCategory::Read);
                     if (framesRead == 0)
                         continue;
@@ -1631,18 +1962,30 @@ namespace pipedal
                         throw PiPedalStateException("Invalid read.");
                     }
 
-                    (this->*copyInputFn)(framesRead);
+                    ReadMidiData((uint32_t)framesRead);
+
+                    if (!captureMmap) // (mmap reads convert in place)
+                    {
+                        (this->*copyInputFn)(0, framesRead);
+                    }
                     cpuUse.AddSample(ProfileCategory::Driver);
 
                     this->driverHost->OnProcess(framesRead);
 
                     cpuUse.AddSample(ProfileCategory::Execute);
 
-                    (this->*copyOutputFn)(framesRead);
-                    cpuUse.AddSample(ProfileCategory::Driver);
-                    // process.
+                    ssize_t err;
+                    if (playbackMmap)
+                    {
+                        err = WriteMmap(framesRead, false);
+                    }
+                    else
+                    {
+                        (this->*copyOutputFn)(0, framesRead);
+                        cpuUse.AddSample(ProfileCategory::Driver);
 
-                    ssize_t err = WriteBuffer(playbackHandle, rawPlaybackBuffer.data(), framesRead);
+                        err = WriteBuffer(playbackHandle, rawPlaybackBuffer.data(), framesRead);
+                    }
 
                     if (err < 0)
                     {
@@ -1671,6 +2014,7 @@ namespace pipedal
                         pBuffer[j] = 0;
                     }
                 }
+                this->midiEventCount = 0;
                 while (!terminateAudio())
                 {
                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -1743,6 +2087,17 @@ namespace pipedal
 
             audioThread = new std::jthread([this]()
                                            { AudioThread(); });
+            if (midiDevices.size() != 0)
+            {
+                // discard MIDI input received while the driver was inactive.
+                for (auto &midiDevice : midiDevices)
+                {
+                    midiDevice->DiscardInput();
+                }
+                terminateMidi = false;
+                midiThread = new std::jthread([this]()
+                                              { MidiThread(); });
+            }
         }
 
         virtual void Deactivate()
@@ -1759,6 +2114,92 @@ namespace pipedal
                 this->audioThread = 0;
             }
             Lv2Log::debug("Audio thread joined.");
+            terminateMidi = true;
+            if (midiThread)
+            {
+                this->midiThread->join();
+                delete this->midiThread;
+                this->midiThread = nullptr;
+            }
+            // Both threads have stopped. Events left in the queue would otherwise be delivered at
+            // the start of the first period after the next Activate().
+            midiInputQueue.clear();
+        }
+
+        std::jthread *midiThread = nullptr;
+        std::atomic<bool> terminateMidi = false;
+        LockFreeQueue<AlsaMidiMessage> midiInputQueue{MAX_MIDI_EVENT};
+
+        void MidiThread()
+        {
+            SetThreadName("alsaMidi");
+            SetThreadPriority(SchedulerPriority::MidiInput);
+            try
+            {
+                std::vector<struct pollfd> pollFds;
+                std::vector<int> deviceFdCounts;
+                for (auto &midiDevice : midiDevices)
+                {
+                    int n = midiDevice->GetPollDescriptorCount();
+                    size_t offset = pollFds.size();
+                    pollFds.resize(offset + n);
+                    deviceFdCounts.push_back(midiDevice->GetPollDescriptors(pollFds.data() + offset, n));
+                }
+                std::vector<bool> deviceFailed(midiDevices.size(), false);
+
+                while (!terminateMidi)
+                {
+                    // time out periodically in order to check for termination.
+                    int rc = poll(pollFds.data(), pollFds.size(), 100);
+                    if (rc < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        throw PiPedalStateException(SS("MIDI poll failed. (" << strerror(errno) << ")"));
+                    }
+                    if (rc == 0)
+                    {
+                        continue;
+                    }
+                    int64_t timeNs = MonotonicNanoseconds();
+
+                    size_t offset = 0;
+                    for (size_t i = 0; i < midiDevices.size(); ++i)
+                    {
+                        struct pollfd *devicePollFds = pollFds.data() + offset;
+                        offset += deviceFdCounts[i];
+                        if (deviceFailed[i])
+                        {
+                            continue;
+                        }
+                        MidiPollResult result = midiDevices[i]->GetPollResult(devicePollFds, deviceFdCounts[i]);
+                        if (result == MidiPollResult::Readable)
+                        {
+                            try
+                            {
+                                midiDevices[i]->FillInputBuffer(midiInputQueue, timeNs);
+                            }
+                            catch (const std::exception &e)
+                            {
+                                Lv2Log::warning(e.what());
+                                result = MidiPollResult::Failed;
+                            }
+                        }
+                        if (result == MidiPollResult::Failed)
+                        {
+                            // Stop polling the device; otherwise poll() returns immediately on every pass.
+                            Lv2Log::warning(SS("MIDI device " << midiDevices[i]->GetDeviceName() << " is no longer available."));
+                            DisableMidiPollFds(devicePollFds, deviceFdCounts[i]);
+                            deviceFailed[i] = true;
+                        }
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                Lv2Log::error(e.what());
+                Lv2Log::error("ALSA MIDI thread terminated abnormally.");
+            }
         }
 
         static constexpr size_t MAX_MIDI_EVENT_SIZE = 3;
@@ -1844,6 +2285,20 @@ namespace pipedal
                 }
             }
 
+            // Discard buffered input, and any partially received message.
+            void DiscardInput()
+            {
+                if (hIn)
+                {
+                    snd_rawmidi_drop(hIn);
+                }
+                runningStatus = 0;
+                inputProcessingSysex = false;
+                inputSysexBufferCount = 0;
+                dataIndex = 0;
+                dataLength = 0;
+            }
+
             int GetDataLength(uint8_t cc)
             {
                 static int sDataLength[] = {0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 1, 1, 1, -1};
@@ -1855,54 +2310,59 @@ namespace pipedal
                 if (cc == 0)
                     return;
 
-                // check for overrun.
-                if (inputEventBufferIndex >= pInputEventBuffer->size())
-                {
-                    return;
-                }
+                AlsaMidiMessage message;
+                message.timeNs = inputTimeNs;
+                message.size = dataLength + 1;
+                assert(dataLength + 1 <= MAX_MIDI_EVENT_SIZE);
+                message.data[0] = cc;
+                message.data[1] = d0;
+                message.data[2] = d1;
 
-                auto &event = (*pInputEventBuffer)[inputEventBufferIndex];
+                // discard on overrun.
+                pInputQueue->push(message);
+            }
 
-                event.time = inputSampleFrame;
-                event.size = dataLength + 1;
-                assert(dataLength + 1 <= MAX_MIDI_EVENT_SIZE);
-                event.buffer[0] = cc;
-                event.buffer[1] = d0;
-                event.buffer[2] = d1;
-                ++inputEventBufferIndex;
+            int GetPollDescriptorCount()
+            {
+                return snd_rawmidi_poll_descriptors_count(hIn);
+            }
+            int GetPollDescriptors(struct pollfd *pfds, int count)
+            {
+                return snd_rawmidi_poll_descriptors(hIn, pfds, count);
             }
+            MidiPollResult GetPollResult(struct pollfd *pfds, int count)
+            {
+                unsigned short revents = 0;
+                int err = snd_rawmidi_poll_descriptors_revents(hIn, pfds, count, &revents);
+                if (err < 0)
+                {
+                    return MidiPollResult::Failed;
+                }
+                return ClassifyMidiPollRevents(revents);
+            }
+            const std::string &GetDeviceName() const { return deviceName; }
 
-            void FillInputBuffer()
+            // Called on the MIDI input thread.
+            void FillInputBuffer(LockFreeQueue<AlsaMidiMessage> &queue, int64_t timeNs)
             {
+                this->pInputQueue = &queue;
+                this->inputTimeNs = timeNs;
                 while (true)
                 {
                     ssize_t nRead = snd_rawmidi_read(hIn, readBuffer, sizeof(readBuffer));
                     if (nRead == -EAGAIN)
-                        return;
+                        break;
                     if (nRead < 0)
                     {
                         checkError(nRead, SS(this->deviceName << "MIDI event read failed. (" << snd_strerror(nRead)).c_str());
                     }
                     ProcessInputBuffer(readBuffer, nRead); // expose write to test code.
                 }
+                this->pInputQueue = nullptr;
             }
 
-            uint32_t inputSampleFrame = -1;
-            size_t inputEventBufferIndex;
-            std::vector<MidiEvent> *pInputEventBuffer = nullptr;
-
-            size_t ReadMidiEvents(
-                std::vector<MidiEvent> &outputBuffer,
-                size_t startIndex,
-                uint32_t sampleFrame)
-            {
-                inputSampleFrame = sampleFrame;
-                inputEventBufferIndex = startIndex;
-                pInputEventBuffer = &outputBuffer;
-                FillInputBuffer();
-                pInputEventBuffer = nullptr;
-                return inputEventBufferIndex - startIndex;
-            }
+            int64_t inputTimeNs = 0;
+            LockFreeQueue<AlsaMidiMessage> *pInputQueue = nullptr;
 
             void FlushSysex()
             {
@@ -2321,12 +2781,36 @@ namespace pipedal
             }
         }
 
-        (this->*copyOutputFn)(bufferSize);
+        (this->*copyOutputFn)(0, bufferSize);
 
         assert(captureFrameSize == playbackFrameSize);
         memcpy(this->rawCaptureBuffer.data(), this->rawPlaybackBuffer.data(), captureFrameSize * bufferSize);
 
-        (this->*copyInputFn)(bufferSize);
+        (this->*copyInputFn)(0, bufferSize);
+
+        // Again, through non-interleaved channel areas (as with mmap access to non-interleaved devices),
+        // transferring the buffer in two pieces, as happens when an mmap transfer wraps.
+        std::vector<uint8_t> nonInterleaved(captureFrameSize * bufferSize);
+        std::vector<snd_pcm_channel_area_t> mmapAreas(captureChannels);
+        for (size_t c = 0; c < captureChannels; ++c)
+        {
+            mmapAreas[c].addr = nonInterleaved.data() + c * captureSampleSize * bufferSize;
+            mmapAreas[c].first = 0;
+            mmapAreas[c].step = captureSampleSize * 8;
+        }
+        std::vector<float> expected(this->captureBuffers[1], this->captureBuffers[1] + bufferSize);
+        size_t split = bufferSize / 2 + 1;
+        SetMmapAreas(playbackAreas, mmapAreas.data(), 0, playbackChannels);
+        (this->*copyOutputFn)(0, split);
+        SetMmapAreas(playbackAreas, mmapAreas.data(), split, playbackChannels);
+        (this->*copyOutputFn)(split, bufferSize - split);
+
+        SetMmapAreas(captureAreas, mmapAreas.data(), 0, captureChannels);
+        (this->*copyInputFn)(0, bufferSize);
+        for (size_t i = 0; i < bufferSize; ++i)
+        {
+            assert(this->captureBuffers[1][i] == expected[i]);
+        }
 
         for (size_t i = 0; i < bufferSize; ++i)
         {
@@ -2340,6 +2824,41 @@ namespace pipedal
         }
     }
 
+    void AlsaDriverImpl::TestCaptureFault()
+    {
+        this->bufferSize = 64;
+        this->captureFrameSize = 8;
+        this->rawCaptureBuffer.resize(this->bufferSize * this->captureFrameSize);
+
+        int readBufferCalls = 0;
+        auto readMmapFault = [](snd_pcm_uframes_t frames) -> snd_pcm_sframes_t
+        {
+            return -EPIPE;
+        };
+        // delivers the buffer in two pieces.
+        auto readBufferCount = [&readBufferCalls](snd_pcm_t *handle, uint8_t *buffer, snd_pcm_uframes_t frames) -> snd_pcm_sframes_t
+        {
+            ++readBufferCalls;
+            return (snd_pcm_sframes_t)std::min(frames, (snd_pcm_uframes_t)40);
+        };
+
+        // A failed mmap read reports the error, without falling back to snd_pcm_readi on the mmap handle.
+        this->captureMmap = true;
+        AlsaAssert(ReadCaptureBuffer(readMmapFault, readBufferCount) == -EPIPE);
+        AlsaAssert(readBufferCalls == 0);
+
+        this->captureMmap = false;
+        AlsaAssert(ReadCaptureBuffer(readMmapFault, readBufferCount) == (snd_pcm_sframes_t)this->bufferSize);
+        AlsaAssert(readBufferCalls == 2);
+    }
+
+    void AlsaCaptureFaultTest(AudioDriverHost *testDriverHost)
+    {
+        std::unique_ptr<AlsaDriverImpl> alsaDriver{
+            new AlsaDriverImpl(testDriverHost)};
+        alsaDriver->TestCaptureFault();
+    }
+
     void AlsaFormatEncodeDecodeTest(AudioDriverHost *testDriverHost)
     {
         static snd_pcm_format_t formats[] = {
@@ -2362,6 +2881,34 @@ namespace pipedal
             alsaDriver->TestFormatEncodeDecode(format);
         }
     }
+    void AlsaMidiPollTest()
+    {
+        AlsaAssert(ClassifyMidiPollRevents(0) == MidiPollResult::Idle);
+        AlsaAssert(ClassifyMidiPollRevents(POLLIN) == MidiPollResult::Readable);
+        AlsaAssert(ClassifyMidiPollRevents(POLLERR) == MidiPollResult::Failed);
+        AlsaAssert(ClassifyMidiPollRevents(POLLNVAL) == MidiPollResult::Failed);
+        AlsaAssert(ClassifyMidiPollRevents(POLLIN | POLLHUP) == MidiPollResult::Failed);
+
+        // A pipe whose write end has been closed reports POLLHUP, the way an unplugged device does.
+        int fds[2];
+        AlsaAssert(pipe(fds) == 0);
+        close(fds[1]);
+
+        struct pollfd pfd;
+        pfd.fd = fds[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        AlsaAssert(poll(&pfd, 1, 0) == 1);
+        AlsaAssert(ClassifyMidiPollRevents(pfd.revents) == MidiPollResult::Failed);
+
+        // Once disabled, the descriptor must not wake poll() again.
+        DisableMidiPollFds(&pfd, 1);
+        AlsaAssert(poll(&pfd, 1, 0) == 0);
+        AlsaAssert(pfd.revents == 0);
+
+        close(fds[0]);
+    }
+
     void MidiDecoderTest()
     {
 #ifdef JUNK
@@ -39,6 +39,8 @@ namespace pipedal {
 
     // test only.
     void AlsaFormatEncodeDecodeTest(AudioDriverHost*driverHost);
+    void AlsaCaptureFaultTest(AudioDriverHost*driverHost);
     void MidiDecoderTest();
+    void AlsaMidiPollTest();
 }
 
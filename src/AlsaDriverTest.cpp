@@ -59,6 +59,11 @@ public:
 
     bool useJack = false;
 
+    void CaptureFaultTest()
+    {
+        AlsaCaptureFaultTest(this);
+    }
+
     void Test()
     {
 
@@ -276,9 +281,20 @@ TEST_CASE( "alsa_test", "[alsa_test]" ) {
 }
 
 
+TEST_CASE( "alsa_capture_fault_test", "[alsa_capture_fault_test]" ) {
+    AlsaTester alsaDriver(AlsaTester::TestType::NullTest);
+
+    alsaDriver.CaptureFaultTest();
+}
+
 TEST_CASE( "alsa_midi_test", "[alsa_midi_test]" ) {
     AlsaTester alsaDriver(AlsaTester::TestType::Oscillator);
 
     MidiDecoderTest();
 }
 
+
+TEST_CASE( "alsa_midi_poll_test", "[alsa_midi_poll_test][Build][Dev]" ) {
+    // A MIDI device that reports POLLHUP/POLLERR must be dropped from the poll set.
+    AlsaMidiPollTest();
+}
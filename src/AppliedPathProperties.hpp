@@ -0,0 +1,119 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pipedal
+{
+    /// <summary>
+    /// The last path property value (file name) sent to each (effect, property) by precompiled snapshots.
+    /// </summary>
+    /// <remarks>
+    /// Values are tracked as hashes of their atom bytes, so that the audio thread can skip patch sets
+    /// that would make a plugin reload a file it already has loaded. Slots are allocated when snapshots
+    /// are compiled; thereafter the audio thread neither blocks nor allocates.
+    /// </remarks>
+    class AppliedPathProperties
+    {
+    public:
+        // A hash of zero means that the current value is not known.
+        static constexpr uint64_t UNKNOWN = 0;
+
+        static uint64_t Hash(const void *data, size_t size)
+        {
+            // FNV-1a
+            uint64_t hash = 0xcbf29ce484222325ull;
+            const uint8_t *p = (const uint8_t *)data;
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= p[i];
+                hash *= 0x100000001b3ull;
+            }
+            if (hash == UNKNOWN)
+            {
+                hash = 1;
+            }
+            return hash;
+        }
+
+        // Non-realtime. Returns the slot for (instanceId, propertyUrid), creating it with the given
+        // current value if it doesn't exist.
+        int32_t AddSlot(int64_t instanceId, uint32_t propertyUrid, uint64_t currentHash)
+        {
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                if (slots[i].instanceId == instanceId && slots[i].propertyUrid == propertyUrid)
+                {
+                    return (int32_t)i;
+                }
+            }
+            slots.push_back(Slot{instanceId, propertyUrid, currentHash});
+            return (int32_t)(slots.size() - 1);
+        }
+
+        // Realtime. Records a value about to be sent; returns false if it is the value already applied.
+        bool Update(int32_t slot, uint64_t hash)
+        {
+            if (slot < 0 || (size_t)slot >= slots.size())
+            {
+                return true;
+            }
+            Slot &s = slots[slot];
+            if (s.hash == hash && hash != UNKNOWN)
+            {
+                return false;
+            }
+            s.hash = hash;
+            return true;
+        }
+
+        // Realtime. The property was set by something other than a precompiled snapshot.
+        void Invalidate(int64_t instanceId, uint32_t propertyUrid)
+        {
+            for (auto &slot : slots)
+            {
+                if (slot.instanceId == instanceId && slot.propertyUrid == propertyUrid)
+                {
+                    slot.hash = UNKNOWN;
+                }
+            }
+        }
+        // Realtime.
+        void InvalidateAll()
+        {
+            for (auto &slot : slots)
+            {
+                slot.hash = UNKNOWN;
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            int64_t instanceId;
+            uint32_t propertyUrid;
+            uint64_t hash;
+        };
+        std::vector<Slot> slots;
+    };
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "AppliedPathProperties.hpp"
+#include "catch.hpp"
+#include <string>
+#include <vector>
+
+using namespace pipedal;
+
+namespace
+{
+    constexpr int64_t CAB_INSTANCE = 7;
+    constexpr uint32_t IR_URID = 101;
+    constexpr int64_t NAM_INSTANCE = 8;
+    constexpr uint32_t MODEL_URID = 102;
+
+    uint64_t HashOf(const std::string &value)
+    {
+        return AppliedPathProperties::Hash(value.data(), value.size());
+    }
+
+    // A precompiled snapshot's path properties, as IndexedSnapshotValue holds them.
+    struct CompiledProperty
+    {
+        int32_t slot;
+        uint64_t hash;
+    };
+
+    // Mirrors IndexedSnapshotValue::ApplyValues: the number of patch sets sent to plugins.
+    size_t Apply(AppliedPathProperties &applied, const std::vector<CompiledProperty> &snapshot)
+    {
+        size_t patchSets = 0;
+        for (const auto &property : snapshot)
+        {
+            if (applied.Update(property.slot, property.hash))
+            {
+                ++patchSets;
+            }
+        }
+        return patchSets;
+    }
+}
+
+TEST_CASE("AppliedPathProperties", "[applied_path_properties][Build][Dev]")
+{
+    AppliedPathProperties applied;
+
+    // compiled against a pedalboard that currently has cab.wav and clean.nam loaded.
+    std::vector<CompiledProperty> snapshotA{
+        {applied.AddSlot(CAB_INSTANCE, IR_URID, HashOf("cab.wav")), HashOf("cab.wav")},
+        {applied.AddSlot(NAM_INSTANCE, MODEL_URID, HashOf("clean.nam")), HashOf("clean.nam")},
+    };
+    std::vector<CompiledProperty> snapshotB{
+        {applied.AddSlot(CAB_INSTANCE, IR_URID, HashOf("cab.wav")), HashOf("cab.wav")},
+        {applied.AddSlot(NAM_INSTANCE, MODEL_URID, HashOf("clean.nam")), HashOf("clean.nam")},
+    };
+    std::vector<CompiledProperty> snapshotC{
+        {applied.AddSlot(CAB_INSTANCE, IR_URID, HashOf("cab.wav")), HashOf("cab.wav")},
+        {applied.AddSlot(NAM_INSTANCE, MODEL_URID, HashOf("clean.nam")), HashOf("lead.nam")},
+    };
+    // slots are shared between snapshots.
+    REQUIRE(snapshotA[0].slot == snapshotB[0].slot);
+    REQUIRE(snapshotA[1].slot == snapshotC[1].slot);
+    REQUIRE(snapshotA[0].slot != snapshotA[1].slot);
+
+    SECTION("Same files send no patch sets")
+    {
+        REQUIRE(Apply(applied, snapshotA) == 0);
+        REQUIRE(Apply(applied, snapshotB) == 0);
+        REQUIRE(Apply(applied, snapshotA) == 0);
+    }
+    SECTION("Only changed files are sent")
+    {
+        REQUIRE(Apply(applied, snapshotC) == 1);
+        REQUIRE(Apply(applied, snapshotC) == 0);
+        REQUIRE(Apply(applied, snapshotA) == 1);
+        REQUIRE(Apply(applied, snapshotB) == 0);
+    }
+    SECTION("Properties set elsewhere are resent")
+    {
+        applied.Invalidate(CAB_INSTANCE, IR_URID);
+        REQUIRE(Apply(applied, snapshotA) == 1);
+        REQUIRE(Apply(applied, snapshotB) == 0);
+
+        applied.InvalidateAll();
+        REQUIRE(Apply(applied, snapshotB) == 2);
+        REQUIRE(Apply(applied, snapshotA) == 0);
+    }
+    SECTION("Unknown current values are sent")
+    {
+        AppliedPathProperties unknown;
+        CompiledProperty property{unknown.AddSlot(CAB_INSTANCE, IR_URID, AppliedPathProperties::UNKNOWN), HashOf("cab.wav")};
+        REQUIRE(Apply(unknown, {property}) == 1);
+        REQUIRE(Apply(unknown, {property}) == 0);
+        REQUIRE(unknown.Update(-1, HashOf("cab.wav")));
+    }
+}
@@ -25,6 +25,7 @@
 #include "Lv2Log.hpp"
 
 #include "SchedulerPriority.hpp"
+#include "ThreadPlacement.hpp"
 #include "JackDriver.hpp"
 #include "AlsaDriver.hpp"
 #include "DummyAudioDriver.hpp"
@@ -40,9 +41,14 @@ using namespace pipedal;
 #include <string.h>
 #include <stdio.h>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <semaphore.h>
 #include "VuUpdate.hpp"
+#include "Telemetry.hpp"
+#include "Metrics.hpp"
+#include "AudioTap.hpp"
+#include "AppliedPathProperties.hpp"
 #include "CpuGovernor.hpp"
 
 #include "RingBuffer.hpp"
@@ -51,6 +57,7 @@ using namespace pipedal;
 #include "PiPedalException.hpp"
 #include "pthread.h"
 #include "sched.h"
+#include <cassert>
 #include <cmath>
 #include <chrono>
 #include <fstream>
@@ -67,6 +74,7 @@ using namespace pipedal;
 #define JACK_SESSION_CALLBACKS 0
 
 #include "AdminClient.hpp"
+#include "PiPedalConfiguration.hpp"
 
 const double VU_UPDATE_RATE_S = 1.0 / 30;
 const double OVERRUN_GRACE_PERIOD_S = 15;
@@ -120,8 +128,42 @@ namespace pipedal
     {
         LV2_URID propertyUrid = 0;
         std::vector<uint8_t> atomBuffer;
+        // precompiled snapshots only.
+        int32_t appliedSlot = -1;
+        uint64_t hash = AppliedPathProperties::UNKNOWN;
     };
 
+    // Convert a json-encoded path property value to the atom sent to the plugin. Returns false if there is no value.
+    static bool PathPropertyToAtom(PluginHost &pluginHost, const std::string &propertyUri, const std::string &jsonValue, std::vector<uint8_t> &atomBuffer)
+    {
+        // convert to json variant so we do a mappath operation.
+        json_variant vProperty;
+        std::istringstream ss(jsonValue);
+        json_reader reader(ss);
+        reader.read(&vProperty);
+        if (vProperty.is_null())
+        {
+            return false;
+        }
+        try
+        {
+            vProperty = pluginHost.MapPath(vProperty);
+
+            // now to atom format (what we want on the rt thread0)
+            AtomConverter atomConverter(pluginHost.GetMapFeature());
+            LV2_Atom *atomValue = atomConverter.ToAtom(vProperty);
+
+            atomBuffer.resize(atomValue->size + sizeof(LV2_Atom));
+            memcpy(atomBuffer.data(), atomValue, atomBuffer.size());
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            Lv2Log::info(SS("IndexedSnapshotValue: Failed to map path property " << propertyUri << ". " << e.what()));
+            return false;
+        }
+    }
+
     class IndexedSnapshotValue
     {
     private:
@@ -132,7 +174,12 @@ namespace pipedal
         };
 
     public:
-        IndexedSnapshotValue(IEffect *effect, SnapshotValue *snapshotValue, PluginHost &pluginHost)
+        // If precompiled is false, only path properties that differ from the effect's current path properties are
+        // transmitted, and the effect's path properties are updated immediately. Precompiled snapshots may be applied
+        // at any later time, so they carry all path properties, and update the effect via UpdatePathProperties()
+        // once they have actually been applied. The audio thread sends only those that differ from the values last
+        // recorded in appliedPathProperties.
+        IndexedSnapshotValue(IEffect *effect, SnapshotValue *snapshotValue, PluginHost &pluginHost, bool precompiled = false, AppliedPathProperties *appliedPathProperties = nullptr)
             : pEffect(effect)
         {
             auto maxInputControl = effect->GetMaxInputControl();
@@ -153,57 +200,69 @@ namespace pipedal
             if (snapshotValue)
             {
                 this->enabled = snapshotValue->isEnabled_;
-                for (auto &controlValue : snapshotValue->controlValues_)
+                if (precompiled)
+                {
+                    // Controls missing from the snapshot keep their current values (as they do in the model), rather than
+                    // the values current when the snapshot was compiled.
+                    for (auto &entry : inputControlValues)
+                    {
+                        entry.isInputControl = false;
+                    }
+                }
+                for (auto &controlValue : *snapshotValue->controlValues_)
                 {
                     auto index = effect->GetControlIndex(controlValue.key());
                     if (index >= 0 && index < inputControlValues.size())
                     {
                         inputControlValues[index].value = controlValue.value();
+                        inputControlValues[index].isInputControl = effect->IsInputControl(index);
                     }
                 }
-                this->lv2State = snapshotValue->lv2State_;
+                this->lv2State = *snapshotValue->lv2State_;
 
                 if (effect->IsLv2Effect())
                 {
                     Lv2Effect *lv2Effect = (Lv2Effect *)effect;
-                    for (auto &pathProperty : snapshotValue->pathProperties_)
+                    if (precompiled)
+                    {
+                        this->pathProperties = snapshotValue->pathProperties_;
+                    }
+                    for (auto &pathProperty : *snapshotValue->pathProperties_)
                     {
                         // only transmit changed path patch properties.
-                        if (lv2Effect->GetPathPatchProperty(pathProperty.first) != pathProperty.second)
+                        if (precompiled || lv2Effect->GetPathPatchProperty(pathProperty.first) != pathProperty.second)
                         {
-                            lv2Effect->SetPathPatchProperty(pathProperty.first, pathProperty.second);
+                            if (!precompiled)
+                            {
+                                lv2Effect->SetPathPatchProperty(pathProperty.first, pathProperty.second);
+                            }
 
                             PathPatchProperty pathPatchProperty;
                             pathPatchProperty.propertyUrid = pluginHost.GetLv2Urid(pathProperty.first.c_str());
-                            // convert to json variant so we do a mappath operation.
-                            json_variant vProperty;
-                            std::istringstream ss(pathProperty.second);
-                            json_reader reader(ss);
-                            reader.read(&vProperty);
-                            if (!vProperty.is_null())
+                            if (PathPropertyToAtom(pluginHost, pathProperty.first, pathProperty.second, pathPatchProperty.atomBuffer))
                             {
-                                try {
-                                    vProperty = pluginHost.MapPath(vProperty);
-
-                                    // now to atom format (what we want on the rt thread0)
-                                    AtomConverter atomConverter(pluginHost.GetMapFeature());
-                                    LV2_Atom *atomValue = atomConverter.ToAtom(vProperty);
-
-                                    size_t atomBufferSize = (atomValue->size + sizeof(LV2_Atom) + 3) / 4 * 4;
-                                    pathPatchProperty.atomBuffer.resize(atomValue->size + sizeof(LV2_Atom));
-                                    memcpy(pathPatchProperty.atomBuffer.data(), atomValue, pathPatchProperty.atomBuffer.size());
-                                    this->pathPatchProperties.push_back(std::move(pathPatchProperty));
-                                } catch (const std::exception &e)
+                                if (appliedPathProperties)
                                 {
-                                    Lv2Log::info(SS("IndexedSnapshotValue: Failed to map path property " << pathProperty.first << ". " << e.what()));
+                                    // precompiled snapshots are filtered on the audio thread against the value last sent,
+                                    // starting from the effect's current value.
+                                    uint64_t currentHash = AppliedPathProperties::UNKNOWN;
+                                    std::vector<uint8_t> currentAtom;
+                                    if (PathPropertyToAtom(pluginHost, pathProperty.first, lv2Effect->GetPathPatchProperty(pathProperty.first), currentAtom))
+                                    {
+                                        currentHash = AppliedPathProperties::Hash(currentAtom.data(), currentAtom.size());
+                                    }
+                                    pathPatchProperty.hash = AppliedPathProperties::Hash(pathPatchProperty.atomBuffer.data(), pathPatchProperty.atomBuffer.size());
+                                    pathPatchProperty.appliedSlot = appliedPathProperties->AddSlot(
+                                        effect->GetInstanceId(), pathPatchProperty.propertyUrid, currentHash);
                                 }
+                                this->pathPatchProperties.push_back(std::move(pathPatchProperty));
                             }
                         }
                     }
                 }
             }
         }
-        void ApplyValues(IEffect *effect)
+        void ApplyValues(IEffect *effect, AppliedPathProperties *appliedPathProperties)
         {
 
             effect->SetBypass(this->enabled);            
@@ -222,15 +281,33 @@ namespace pipedal
 
             for (const auto &patchProperty : pathPatchProperties)
             {
+                if (appliedPathProperties && !appliedPathProperties->Update(patchProperty.appliedSlot, patchProperty.hash))
+                {
+                    // the plugin already has this file loaded; don't make it reload it.
+                    continue;
+                }
                 effect->SetPatchProperty(
                     patchProperty.propertyUrid, patchProperty.atomBuffer.size(), (LV2_Atom *)patchProperty.atomBuffer.data());
             }
             // effect->SetLv2State(lv2State);
         }
+        // non-realtime thread. Record path properties of a precompiled snapshot that has been applied.
+        void UpdatePathProperties()
+        {
+            if (pEffect->IsLv2Effect())
+            {
+                Lv2Effect *lv2Effect = (Lv2Effect *)pEffect;
+                for (auto &pathProperty : *pathProperties)
+                {
+                    lv2Effect->SetPathPatchProperty(pathProperty.first, pathProperty.second);
+                }
+            }
+        }
 
     private:
         IEffect *pEffect;
         Lv2PluginState lv2State;
+        CopyOnWrite<PedalboardItem::PathPropertyMap> pathProperties;
         bool enabled;
         std::vector<InputControlEntry> inputControlValues;
         std::vector<PathPatchProperty> pathPatchProperties;
@@ -238,7 +315,8 @@ namespace pipedal
     class IndexedSnapshot
     {
     public:
-        IndexedSnapshot(Snapshot *snapshot, std::shared_ptr<Lv2Pedalboard> currentPedalboard, PluginHost &pluginHost)
+        IndexedSnapshot(Snapshot *snapshot, std::shared_ptr<Lv2Pedalboard> currentPedalboard, PluginHost &pluginHost, bool precompiled = false, AppliedPathProperties *appliedPathProperties = nullptr)
+            : appliedPathProperties(appliedPathProperties)
         {
             std::unordered_map<uint64_t, SnapshotValue *> index;
             for (auto &value : snapshot->values_)
@@ -253,7 +331,7 @@ namespace pipedal
                 auto &effect = effects[i];
 
                 SnapshotValue *snapshotValue = getSnapshotValue(index, effect->GetInstanceId());
-                snapshotValues.push_back(IndexedSnapshotValue(effect, snapshotValue, pluginHost));
+                snapshotValues.push_back(IndexedSnapshotValue(effect, snapshotValue, pluginHost, precompiled, appliedPathProperties));
             }
         }
         static SnapshotValue *getSnapshotValue(std::unordered_map<uint64_t, SnapshotValue *> &index, uint64_t instanceId)
@@ -274,7 +352,14 @@ namespace pipedal
             }
             for (size_t i = 0; i < snapshotValues.size(); ++i)
             {
-                snapshotValues[i].ApplyValues(effects[i]);
+                snapshotValues[i].ApplyValues(effects[i], appliedPathProperties);
+            }
+        }
+        void UpdatePathProperties()
+        {
+            for (auto &snapshotValue : snapshotValues)
+            {
+                snapshotValue.UpdatePathProperties();
             }
         }
         ~IndexedSnapshot()
@@ -282,8 +367,46 @@ namespace pipedal
         }
 
     private:
+        AppliedPathProperties *appliedPathProperties;
         std::vector<IndexedSnapshotValue> snapshotValues;
     };
+
+    // All snapshots of the current pedalboard, compiled when the pedalboard is loaded, so that MIDI-triggered
+    // snapshots can be applied on the audio thread without a round trip through the model.
+    class RealtimeSnapshots
+    {
+    public:
+        RealtimeSnapshots(const std::vector<std::shared_ptr<Snapshot>> &snapshots, std::shared_ptr<Lv2Pedalboard> currentPedalboard, PluginHost &pluginHost)
+        {
+            this->snapshots.reserve(snapshots.size());
+            for (const auto &snapshot : snapshots)
+            {
+                if (snapshot)
+                {
+                    this->snapshots.push_back(std::make_unique<IndexedSnapshot>(snapshot.get(), currentPedalboard, pluginHost, true, &appliedPathProperties));
+                }
+                else
+                {
+                    this->snapshots.push_back(nullptr);
+                }
+            }
+        }
+        // nullptr if the snapshot is empty.
+        IndexedSnapshot *GetSnapshot(int32_t index)
+        {
+            if (index < 0 || index >= (int32_t)snapshots.size())
+            {
+                return nullptr;
+            }
+            return snapshots[index].get();
+        }
+        // audio thread only, once installed.
+        AppliedPathProperties &GetAppliedPathProperties() { return appliedPathProperties; }
+
+    private:
+        AppliedPathProperties appliedPathProperties;
+        std::vector<std::unique_ptr<IndexedSnapshot>> snapshots;
+    };
 }
 
 class SystemMidiBinding
@@ -505,6 +628,17 @@ private:
     std::atomic<bool> audioStopped = false;
     std::atomic<bool> isDummyAudioDriver = false;
 
+    // sample-accurate MIDI. (set before the audio thread starts)
+    bool sampleAccurateMidi = false;
+    uint32_t midiMinimumSubBlockFrames = 32;
+    float midiControlSmoothingMs = 0;
+
+    // Null-terminated channel buffer lists for the audio thread. (sized when the audio driver is opened.)
+    std::vector<float *> processInputBuffers;
+    std::vector<float *> processOutputBuffers;
+    std::vector<float *> subBlockInputBuffers;
+    std::vector<float *> subBlockOutputBuffers;
+
     std::shared_ptr<Lv2Pedalboard> currentPedalboard;
     std::vector<std::shared_ptr<Lv2Pedalboard>> activePedalboards; // pedalboards that have been sent to the audio queue.
     Lv2Pedalboard *realtimeActivePedalboard = nullptr;
@@ -541,6 +675,8 @@ private:
     virtual void OnUnderrun()
     {
         ++this->underruns;
+        Metrics::Instance().xruns.fetch_add(1, std::memory_order_relaxed);
+        bufferSizeGovernor.ObserveXrun();
         this->lastUnderrunTime = std::chrono::system_clock ::now();
     }
 
@@ -584,6 +720,16 @@ private:
             delete realtimeMonitorPortSubscriptions;
             realtimeMonitorPortSubscriptions = nullptr;
         }
+        if (realtimeAudioTaps != nullptr)
+        {
+            delete realtimeAudioTaps;
+            realtimeAudioTaps = nullptr;
+        }
+        if (realtimeSnapshots != nullptr)
+        {
+            delete realtimeSnapshots;
+            realtimeSnapshots = nullptr;
+        }
         this->inputRingBuffer.reset();
         this->outputRingBuffer.reset();
 
@@ -624,6 +770,28 @@ private:
         }
     }
 
+    RealtimeAudioTaps *realtimeAudioTaps = nullptr;
+
+    void freeRealtimeAudioTaps()
+    {
+        if (this->realtimeAudioTaps != nullptr)
+        {
+            realtimeWriter.FreeAudioTaps(this->realtimeAudioTaps);
+            this->realtimeAudioTaps = nullptr;
+        }
+    }
+
+    RealtimeSnapshots *realtimeSnapshots = nullptr;
+
+    void freeRealtimeSnapshots()
+    {
+        if (this->realtimeSnapshots != nullptr)
+        {
+            realtimeWriter.FreeRealtimeSnapshots(this->realtimeSnapshots);
+            this->realtimeSnapshots = nullptr;
+        }
+    }
+
     RealtimeMonitorPortSubscriptions *realtimeMonitorPortSubscriptions = nullptr;
 
     void freeRealtimeMonitorPortSubscriptions()
@@ -638,6 +806,24 @@ private:
 
     virtual void SetSystemMidiBindings(const std::vector<MidiBinding> &bindings);
 
+    virtual void SetConfiguration(const PiPedalConfiguration &configuration)
+    {
+        std::lock_guard guard(mutex);
+        this->sampleAccurateMidi = configuration.GetSampleAccurateMidi();
+        this->midiMinimumSubBlockFrames = std::max(configuration.GetMidiMinimumSubBlockFrames(), (uint32_t)1);
+        this->midiControlSmoothingMs = configuration.GetMidiControlSmoothingMs();
+        this->bufferSizeGovernor.SetConfiguration(
+            BufferSizeGovernor::ParseMode(configuration.GetBufferSizeGovernor()),
+            configuration.GetBufferSizeGovernorMargin(),
+            configuration.GetBufferSizeGovernorMinimum());
+    }
+
+    BufferSizeGovernor bufferSizeGovernor;
+    virtual BufferSizeGovernor &GetBufferSizeGovernor() override
+    {
+        return bufferSizeGovernor;
+    }
+
     void writeVu()
     {
         // throttling: we send one; but won't send another until the host thread
@@ -722,13 +908,6 @@ private:
             }
             switch (command)
             {
-            case RingBufferCommand::SetValue:
-            {
-                SetControlValueBody body;
-                realtimeReader.readComplete(&body);
-                this->realtimeActivePedalboard->SetControlValue(body.effectIndex, body.controlIndex, body.value);
-                break;
-            }
             case RingBufferCommand::SetInputVolume:
             {
                 SetVolumeBody body;
@@ -814,6 +993,19 @@ private:
                 realtimeReader.readComplete(&snapshot);
                 ApplySnapshot(snapshot);
                 realtimeWriter.FreeSnapshot(snapshot);
+                if (this->realtimeSnapshots != nullptr)
+                {
+                    // path properties were sent without going through the precompiled snapshots.
+                    this->realtimeSnapshots->GetAppliedPathProperties().InvalidateAll();
+                }
+                break;
+            }
+            case RingBufferCommand::SetRealtimeSnapshots:
+            {
+                RealtimeSnapshots *snapshots;
+                realtimeReader.readComplete(&snapshots);
+                this->freeRealtimeSnapshots();
+                this->realtimeSnapshots = snapshots;
                 break;
             }
             case RingBufferCommand::SetVuSubscriptions:
@@ -830,6 +1022,14 @@ private:
 
                 break;
             }
+            case RingBufferCommand::SetAudioTaps:
+            {
+                RealtimeAudioTaps *taps;
+                realtimeReader.readComplete(&taps);
+                this->freeRealtimeAudioTaps();
+                this->realtimeAudioTaps = taps;
+                break;
+            }
             case RingBufferCommand::SetBypass:
             {
                 SetBypassBody body;
@@ -852,6 +1052,8 @@ private:
                     // invalidate the possibly no-good subscriptions. Model will update them shortly.
                     freeRealtimeVuConfiguration();
                     freeRealtimeMonitorPortSubscriptions();
+                    freeRealtimeAudioTaps();
+                    freeRealtimeSnapshots(); // compiled for the previous pedalboard.
                     cancelParameterRequests();
 
                     if (realtimeActivePedalboard)
@@ -876,8 +1078,20 @@ private:
         return true;
     }
 
+    void InvalidateAppliedPathProperties(RealtimePatchPropertyRequest *pRequest)
+    {
+        auto &appliedPathProperties = this->realtimeSnapshots->GetAppliedPathProperties();
+        for (; pRequest != nullptr; pRequest = pRequest->pNext)
+        {
+            if (pRequest->requestType == RealtimePatchPropertyRequest::RequestType::PatchSet)
+            {
+                appliedPathProperties.Invalidate(pRequest->instanceId, pRequest->uridUri);
+            }
+        }
+    }
     void ApplySnapshot(IndexedSnapshot *snapshot)
     {
+        this->realtimeActivePedalboard->CancelControlRamps();
         auto &effects = this->realtimeActivePedalboard->GetEffects();
         snapshot->Apply(effects);
     }
@@ -926,6 +1140,20 @@ private:
 
     void OnSnapshotTriggered(int snapshotIndex)
     {
+        if (this->realtimeSnapshots != nullptr && this->realtimeActivePedalboard != nullptr)
+        {
+            IndexedSnapshot *snapshot = this->realtimeSnapshots->GetSnapshot(snapshotIndex);
+            if (snapshot != nullptr)
+            {
+                // apply in this period; the model catches up asynchronously.
+                // Control values still in flight from the UI predate the snapshot, and would
+                // otherwise overwrite it next period.
+                this->realtimeActivePedalboard->GetControlMailbox().Discard();
+                ApplySnapshot(snapshot);
+                this->realtimeWriter.OnRealtimeMidiSnapshotApplied(snapshotIndex, snapshot);
+                return;
+            }
+        }
         // midiProgramChangePending = true;
         this->midiSnapshotRequestPending = true;
         this->realtimeWriter.OnRealtimeMidiSnapshotRequest(snapshotIndex, ++snapshotRequestId);
@@ -1090,6 +1318,98 @@ private:
         }
     }
 
+    // Run the pedalboard in sub-blocks split at MIDI event times, so that
+    // MIDI-bound controls change at (approximately) the correct frame.
+    bool RunSubdivided(Lv2Pedalboard *pedalboard, float **inputBuffers, float **outputBuffers, uint32_t nframes)
+    {
+        Lv2EventBufferWriter eventBufferWriter(this->eventBufferUrids);
+        Lv2EventBufferWriter::LV2_EvBuf_Iterator iterator = eventBufferWriter.begin();
+
+        ProcessDeferredMidiMessages(eventBufferWriter, iterator);
+
+        size_t nEvents = audioDriver->GetMidiInputEventCount();
+        MidiEvent *events = audioDriver->GetMidiEvents();
+        size_t eventIndex = 0;
+
+        size_t nInputs = audioDriver->InputBufferCount();
+        size_t nOutputs = audioDriver->OutputBufferCount();
+        assert(subBlockInputBuffers.size() == nInputs + 1 && subBlockOutputBuffers.size() == nOutputs + 1);
+        float **subInputBuffers = subBlockInputBuffers.data();
+        float **subOutputBuffers = subBlockOutputBuffers.data();
+
+        uint32_t minimumFrames = this->midiMinimumSubBlockFrames;
+        bool processed = true;
+        uint32_t frame = 0;
+        while (frame < nframes)
+        {
+            while (eventIndex < nEvents && events[eventIndex].time <= frame)
+            {
+                ProcessMidiEvent(eventBufferWriter, iterator, events[eventIndex++]);
+            }
+            uint32_t end = nframes;
+            if (eventIndex < nEvents && events[eventIndex].time < end)
+            {
+                end = events[eventIndex].time;
+            }
+            if (pedalboard->HasControlRamps() && end > frame + minimumFrames)
+            {
+                // ramps advance once per sub-block.
+                end = frame + minimumFrames;
+            }
+            if (end < frame + minimumFrames)
+            {
+                end = frame + minimumFrames;
+            }
+            if (end + minimumFrames > nframes)
+            {
+                // don't leave a runt sub-block at the end of the period.
+                end = nframes;
+            }
+            uint32_t blockFrames = end - frame;
+
+            for (size_t i = 0; i < nInputs; ++i)
+            {
+                subInputBuffers[i] = inputBuffers[i] + frame;
+            }
+            for (size_t i = 0; i < nOutputs; ++i)
+            {
+                subOutputBuffers[i] = outputBuffers[i] + frame;
+            }
+            if (frame != 0)
+            {
+                // atom input was delivered with the first sub-block; output atoms have already been relayed.
+                pedalboard->ResetAtomBuffers();
+            }
+            if (!pedalboard->Run(subInputBuffers, subOutputBuffers, blockFrames, &realtimeWriter))
+            {
+                processed = false;
+                break;
+            }
+            // After Run, so that each sub-block runs with the ramp value at its start.
+            if (pedalboard->HasControlRamps())
+            {
+                pedalboard->TickControlRamps(blockFrames);
+            }
+            // Effect buffers only hold the current sub-block, so VUs and taps accumulate per sub-block.
+            if (this->realtimeVuBuffers != nullptr)
+            {
+                pedalboard->ComputeVus(this->realtimeVuBuffers, blockFrames, subInputBuffers, subOutputBuffers);
+            }
+            if (this->realtimeAudioTaps != nullptr)
+            {
+                pedalboard->ProcessAudioTaps(this->realtimeAudioTaps, blockFrames, subInputBuffers, subOutputBuffers);
+            }
+            pedalboard->GatherPathPatchProperties(this);
+            frame = end;
+        }
+        // events with out-of-range timestamps.
+        while (eventIndex < nEvents)
+        {
+            ProcessMidiEvent(eventBufferWriter, iterator, events[eventIndex++]);
+        }
+        return processed;
+    }
+
 #define RESET_XRUN_SAMPLES 22050ul // 1/2 a second-ish.
 
     std::mutex audioStoppedMutex;
@@ -1113,6 +1433,14 @@ private:
     {
         try
         {
+            std::chrono::steady_clock::time_point periodStartTime;
+            bool governed = bufferSizeGovernor.IsEnabled();
+            // idle input only matters when the governor restarts audio itself.
+            bool watchInput = governed && bufferSizeGovernor.IsAutomatic();
+            if (governed)
+            {
+                periodStartTime = std::chrono::steady_clock::now();
+            }
             float *in, *out;
 
             Lv2Pedalboard *pedalboard = nullptr;
@@ -1131,14 +1459,26 @@ private:
                 // else a new pedalboard was installed. start again.
                 pedalboard = this->realtimeActivePedalboard;
             }
+            if (pedalboard)
+            {
+                // after ring buffer commands, so that values set after a snapshot was sent aren't overwritten by it.
+                pedalboard->ApplyPendingControlValues();
+            }
 
             bool processed = false;
 
             if (pedalboard != nullptr)
             {
-                ProcessMidiInput();
-                float *inputBuffers[4];
-                float *outputBuffers[4];
+                // sub-blocks can't be used while parameter requests are pending, since responses are gathered once per period.
+                bool subdivide = this->sampleAccurateMidi && pParameterRequests == nullptr;
+                if (!subdivide)
+                {
+                    ProcessMidiInput();
+                }
+                assert(processInputBuffers.size() == audioDriver->InputBufferCount() + 1);
+                assert(processOutputBuffers.size() == audioDriver->OutputBufferCount() + 1);
+                float **inputBuffers = processInputBuffers.data();
+                float **outputBuffers = processOutputBuffers.data();
                 bool buffersValid = true;
                 for (int i = 0; i < audioDriver->InputBufferCount(); ++i)
                 {
@@ -1150,7 +1490,6 @@ private:
                     }
                     inputBuffers[i] = input;
                 }
-                inputBuffers[audioDriver->InputBufferCount()] = nullptr;
 
                 for (int i = 0; i < audioDriver->OutputBufferCount(); ++i)
                 {
@@ -1162,18 +1501,36 @@ private:
                     }
                     outputBuffers[i] = output;
                 }
-                outputBuffers[audioDriver->OutputBufferCount()] = nullptr;
 
                 if (buffersValid)
                 {
+                    pedalboard->SetTrackInputPeak(watchInput);
                     pedalboard->ProcessParameterRequests(pParameterRequests);
+                    if (pParameterRequests != nullptr && this->realtimeSnapshots != nullptr)
+                    {
+                        InvalidateAppliedPathProperties(pParameterRequests);
+                    }
 
-                    processed = pedalboard->Run(inputBuffers, outputBuffers, (uint32_t)nframes, &realtimeWriter);
+                    if (subdivide)
+                    {
+                        processed = RunSubdivided(pedalboard, inputBuffers, outputBuffers, (uint32_t)nframes);
+                    }
+                    else
+                    {
+                        processed = pedalboard->Run(inputBuffers, outputBuffers, (uint32_t)nframes, &realtimeWriter);
+                        if (pedalboard->HasControlRamps())
+                        {
+                            pedalboard->TickControlRamps((uint32_t)nframes);
+                        }
+                    }
                     if (processed)
                     {
                         if (this->realtimeVuBuffers != nullptr)
                         {
-                            pedalboard->ComputeVus(this->realtimeVuBuffers, (uint32_t)nframes, inputBuffers, outputBuffers);
+                            if (!subdivide) // (RunSubdivided accumulates VUs per sub-block)
+                            {
+                                pedalboard->ComputeVus(this->realtimeVuBuffers, (uint32_t)nframes, inputBuffers, outputBuffers);
+                            }
 
                             vuSamplesRemaining -= nframes;
                             if (vuSamplesRemaining <= 0)
@@ -1186,9 +1543,20 @@ private:
                         {
                             processMonitorPortSubscriptions(nframes);
                         }
+                        if (this->realtimeAudioTaps != nullptr && !subdivide)
+                        {
+                            pedalboard->ProcessAudioTaps(this->realtimeAudioTaps, (uint32_t)nframes, inputBuffers, outputBuffers);
+                        }
                     }
                     pedalboard->GatherPatchProperties(pParameterRequests);
-                    pedalboard->GatherPathPatchProperties(this);
+                    if (!subdivide)
+                    {
+                        pedalboard->GatherPathPatchProperties(this);
+                    }
+                }
+                else if (subdivide)
+                {
+                    ProcessMidiInput();
                 }
             }
 
@@ -1208,6 +1576,15 @@ private:
                 this->underruns = 0;
             }
             this->currentSample += nframes;
+            if (governed)
+            {
+                bufferSizeGovernor.ObservePeriod((uint32_t)nframes, std::chrono::steady_clock::now() - periodStartTime);
+                if (watchInput && processed)
+                {
+                    // (measured by the pedalboard's input volume stage.)
+                    bufferSizeGovernor.ObserveInput((uint32_t)nframes, pedalboard->TakeInputPeak());
+                }
+            }
         }
         catch (const std::exception &e)
         {
@@ -1263,7 +1640,87 @@ public:
     std::vector<uint8_t> realtimeAtomBuffer;
 
     bool terminateThread;
-    void ThreadProc()
+    std::string telemetrySegmentName;
+
+    virtual void SetTelemetrySegmentName(const std::string &segmentName) override
+    {
+        std::lock_guard guard(mutex);
+        this->telemetrySegmentName = segmentName;
+    }
+
+    static constexpr int TELEMETRY_STATUS_PERIOD_MS = 250;
+    static constexpr int SYSTEM_STATUS_PERIOD_MS = 2000; // temperature and cpu frequency.
+
+    // Temperature and CPU frequencies for telemetry. sysfs reads can block, so they are made on a housekeeping
+    // thread rather than on rtsvc, which has to keep draining the audio thread's ring buffer.
+    std::atomic<int32_t> systemTemperaturemC = -100000;
+    std::atomic<uint64_t> systemCpuFreqMin = 0;
+    std::atomic<uint64_t> systemCpuFreqMax = 0;
+    std::thread *systemStatusThread = nullptr;
+    std::mutex systemStatusMutex;
+    std::condition_variable systemStatusCv;
+    bool terminateSystemStatusThread = false;
+
+    void SystemStatusThreadProc()
+    {
+        SetThreadName("sysstat");
+        std::unique_lock lock(systemStatusMutex);
+        while (!terminateSystemStatusThread)
+        {
+            lock.unlock();
+            uint64_t freqMin = 0, freqMax = 0;
+            systemTemperaturemC.store(GetRaspberryPiTemperature(), std::memory_order_relaxed);
+            GetCpuFrequency(&freqMin, &freqMax);
+            systemCpuFreqMin.store(freqMin, std::memory_order_relaxed);
+            systemCpuFreqMax.store(freqMax, std::memory_order_relaxed);
+            lock.lock();
+
+            systemStatusCv.wait_for(
+                lock,
+                std::chrono::milliseconds(SYSTEM_STATUS_PERIOD_MS),
+                [this]()
+                { return terminateSystemStatusThread; });
+        }
+    }
+
+    void PublishTelemetryStatus(TelemetryWriter &telemetry)
+    {
+        TelemetryData &data = telemetry.Data();
+        data.statusTimeNs = TelemetryNow();
+        data.active = IsAudioRunning();
+        data.restarting = this->restarting;
+        data.underruns = this->underruns;
+        if (this->audioDriver != nullptr)
+        {
+            data.cpuUsage = audioDriver->CpuUse();
+        }
+        data.temperaturemC = systemTemperaturemC.load(std::memory_order_relaxed);
+        data.cpuFreqMin = systemCpuFreqMin.load(std::memory_order_relaxed);
+        data.cpuFreqMax = systemCpuFreqMax.load(std::memory_order_relaxed);
+        telemetry.Publish();
+    }
+    void PublishTelemetryVus(TelemetryWriter &telemetry, const std::vector<VuUpdate> &updates)
+    {
+        if (!telemetry.IsOpen())
+            return;
+        TelemetryData &data = telemetry.Data();
+        data.vuTimeNs = TelemetryNow();
+        size_t n = std::min(updates.size(), TELEMETRY_MAX_VUS);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const VuUpdate &update = updates[i];
+            TelemetryVu &vu = data.vus[i];
+            vu.instanceId = update.instanceId_;
+            vu.inputMaxValueL = update.inputMaxValueL_;
+            vu.inputMaxValueR = update.isStereoInput_ ? update.inputMaxValueR_ : update.inputMaxValueL_;
+            vu.outputMaxValueL = update.outputMaxValueL_;
+            vu.outputMaxValueR = update.isStereoOutput_ ? update.outputMaxValueR_ : update.outputMaxValueL_;
+        }
+        data.vuCount = (uint32_t)n;
+        telemetry.Publish();
+    }
+
+    void ThreadProc(const std::string &telemetrySegmentName)
     {
         SetThreadName("rtsvc");
         SetThreadPriority(SchedulerPriority::AudioService);
@@ -1283,19 +1740,46 @@ public:
                 std::chrono::duration_cast<clock_duration>(std::chrono::seconds(30));
             clock_time waitTime = std::chrono::steady_clock::now();
 
+            TelemetryWriter telemetry(telemetrySegmentName);
+            if (!telemetrySegmentName.empty() && !telemetry.Open())
+            {
+                Lv2Log::warning(SS("Failed to create telemetry shared memory segment " << telemetrySegmentName << ". (Is another instance of pipedald running?)"));
+            }
+            clock_duration telemetryPeriod =
+                std::chrono::duration_cast<clock_duration>(std::chrono::milliseconds(TELEMETRY_STATUS_PERIOD_MS));
+            clock_time telemetryTime = std::chrono::steady_clock::now();
+
             while (true)
             {
 
                 // wait for an event.
                 // 0 -> ready. -1: timed out. -2: closing.
 
-                auto result = hostReader.wait_until(sizeof(RingBufferCommand), waitTime);
+                auto result = hostReader.wait_until(sizeof(RingBufferCommand), std::min(waitTime, telemetryTime));
                 if (result == RingBufferStatus::Closed)
                 {
                     return;
                 }
-                else if (result == RingBufferStatus::TimedOut)
+                if (clock::now() >= telemetryTime)
                 {
+                    Metrics::Instance().audioHostQueueBytes.store(hostReader.readSpace(), std::memory_order_relaxed);
+                    Metrics::Instance().UpdatePluginTiming(clock::now());
+                    if (telemetry.IsOpen())
+                    {
+                        PublishTelemetryStatus(telemetry);
+                    }
+                    telemetryTime += telemetryPeriod;
+                    if (telemetryTime < clock::now())
+                    {
+                        telemetryTime = clock::now() + telemetryPeriod;
+                    }
+                }
+                if (result == RingBufferStatus::TimedOut)
+                {
+                    if (clock::now() < waitTime)
+                    {
+                        continue;
+                    }
                     // timeout.
                     if (underruns != lastUnderrunCount)
                     {
@@ -1403,6 +1887,7 @@ public:
                                 {
                                     this->pNotifyCallbacks->OnNotifyVusSubscription(*updates);
                                 }
+                                PublishTelemetryVus(telemetry, *updates);
                                 this->hostWriter.AckVuUpdate(); // please sir, can I have some more?
                             }
                             else if (command == RingBufferCommand::Lv2StateChanged)
@@ -1464,6 +1949,12 @@ public:
                                 hostReader.read(&config);
                                 delete config;
                             }
+                            else if (command == RingBufferCommand::FreeAudioTaps)
+                            {
+                                RealtimeAudioTaps *taps;
+                                hostReader.read(&taps);
+                                delete taps;
+                            }
                             else if (command == RingBufferCommand::FreeMonitorPortSubscription)
                             {
                                 RealtimeMonitorPortSubscriptions *pSubscriptions;
@@ -1482,6 +1973,12 @@ public:
                                 hostReader.read(&snapshot);
                                 OnFreeSnapshot(snapshot);
                             }
+                            else if (command == RingBufferCommand::FreeRealtimeSnapshots)
+                            {
+                                RealtimeSnapshots *snapshots;
+                                hostReader.read(&snapshots);
+                                delete snapshots;
+                            }
                             else if (command == RingBufferCommand::SendPathPropertyBuffer)
                             {
                                 PatchPropertyWriter::Buffer *buffer = nullptr;
@@ -1529,6 +2026,17 @@ public:
                                     request.snapshotIndex,
                                     request.snapshotRequestId);
                             }
+                            else if (command == RingBufferCommand::RealtimeMidiSnapshotApplied)
+                            {
+                                RealtimeMidiSnapshotApplied body;
+                                hostReader.read(&body);
+                                {
+                                    // the snapshot is still owned by the audio thread, which can only free it after this message.
+                                    std::lock_guard guard(mutex);
+                                    body.snapshot->UpdatePathProperties();
+                                }
+                                pNotifyCallbacks->OnNotifyMidiRealtimeSnapshotApplied(body.snapshotIndex);
+                            }
                             else if (command == RingBufferCommand::Lv2ErrorMessage)
                             {
                                 size_t size;
@@ -1573,16 +2081,39 @@ public:
             delete readerThread;
             readerThread = nullptr;
         }
+        if (systemStatusThread != nullptr)
+        {
+            {
+                std::lock_guard lock(systemStatusMutex);
+                terminateSystemStatusThread = true;
+            }
+            systemStatusCv.notify_all();
+            systemStatusThread->join();
+            delete systemStatusThread;
+            systemStatusThread = nullptr;
+        }
     }
     void StartReaderThread()
     {
         terminateThread = false;
-        auto f = [this]()
+        std::string telemetrySegmentName;
         {
-            this->ThreadProc();
+            std::lock_guard guard(mutex);
+            telemetrySegmentName = this->telemetrySegmentName;
+        }
+        auto f = [this, telemetrySegmentName]()
+        {
+            this->ThreadProc(telemetrySegmentName);
         };
 
         this->readerThread = new std::thread(f);
+
+        if (!telemetrySegmentName.empty())
+        {
+            terminateSystemStatusThread = false;
+            this->systemStatusThread = new std::thread([this]()
+                                                       { this->SystemStatusThreadProc(); });
+        }
     }
 
     bool isOpen = false;
@@ -1650,8 +2181,17 @@ public:
 
             this->sampleRate = audioDriver->GetSampleRate();
 
+            // drivers activate one buffer per selected port. (the trailing nullptr entries are never overwritten.)
+            size_t nInputs = this->channelSelection.GetInputAudioPorts().size();
+            size_t nOutputs = this->channelSelection.GetOutputAudioPorts().size();
+            processInputBuffers.assign(nInputs + 1, nullptr);
+            processOutputBuffers.assign(nOutputs + 1, nullptr);
+            subBlockInputBuffers.assign(nInputs + 1, nullptr);
+            subBlockOutputBuffers.assign(nOutputs + 1, nullptr);
+
             this->overrunGracePeriodSamples = (uint64_t)(((uint64_t)this->sampleRate) * OVERRUN_GRACE_PERIOD_S);
             this->vuSamplesPerUpdate = (size_t)(sampleRate * VU_UPDATE_RATE_S);
+            bufferSizeGovernor.Start(this->sampleRate, jackServerSettings.GetBufferSize(), jackServerSettings.GetNumberOfBuffers());
 
             active = true;
             audioStopped = false;
@@ -1706,9 +2246,18 @@ public:
         std::lock_guard guard(mutex);
 
         this->currentPedalboard = pedalboard;
+        Metrics::Instance().activePedalboardBytes = pedalboard ? pedalboard->GetBufferMemoryUse() : 0;
         if (active)
         {
+            if (sampleAccurateMidi && pedalboard)
+            {
+                pedalboard->SetControlSmoothingSamples((uint32_t)(midiControlSmoothingMs * 0.001f * this->sampleRate));
+            }
+            auto activateStart = std::chrono::steady_clock::now();
             pedalboard->Activate();
+            Lv2Log::debug(SS("Pedalboard activated. ("
+                             << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - activateStart).count()
+                             << "ms)"));
             this->activePedalboards.push_back(pedalboard);
             hostWriter.ReplaceEffect(pedalboard.get());
         }
@@ -1742,7 +2291,7 @@ public:
                     int controlIndex = this->currentPedalboard->GetControlIndex(instanceId, value.key());
                     if (controlIndex != -1 && effectIndex != -1)
                     {
-                        hostWriter.SetControlValue(effectIndex, controlIndex, value.value());
+                        currentPedalboard->GetControlMailbox().Set(effectIndex, controlIndex, value.value());
                     }
                 }
             }
@@ -1760,7 +2309,37 @@ public:
 
             if (controlIndex != -1 && effectIndex != -1)
             {
-                hostWriter.SetControlValue(effectIndex, controlIndex, value);
+                // latest value wins; the audio thread picks it up at the start of the next period.
+                currentPedalboard->GetControlMailbox().Set(effectIndex, controlIndex, value);
+            }
+        }
+    }
+
+    virtual void SetControlValue(uint64_t instanceId, int controlIndex, float value) override
+    {
+        std::lock_guard guard(mutex);
+        if (active && this->currentPedalboard)
+        {
+            auto effectIndex = currentPedalboard->GetIndexOfInstanceId(instanceId);
+            if (effectIndex != -1)
+            {
+                currentPedalboard->GetControlMailbox().Set(effectIndex, controlIndex, value);
+            }
+        }
+    }
+    virtual void SetControlValue(uint64_t instanceId, int effectIndex, int controlIndex, float value) override
+    {
+        std::lock_guard guard(mutex);
+        if (active && this->currentPedalboard)
+        {
+            auto &effects = currentPedalboard->GetEffects();
+            if (effectIndex < 0 || effectIndex >= (int)effects.size() || effects[effectIndex]->GetInstanceId() != instanceId)
+            {
+                effectIndex = currentPedalboard->GetIndexOfInstanceId(instanceId);
+            }
+            if (effectIndex != -1)
+            {
+                currentPedalboard->GetControlMailbox().Set(effectIndex, controlIndex, value);
             }
         }
     }
@@ -1792,10 +2371,21 @@ public:
         {
             IndexedSnapshot *indexedSnapshot = new IndexedSnapshot(&snapshot, this->currentPedalboard, pluginHost);
             pendingSnapshots.push_back(indexedSnapshot);
+            // the snapshot carries current values for every control, which supersede pending control changes.
+            this->currentPedalboard->GetControlMailbox().Discard();
             this->hostWriter.LoadSnapshot(indexedSnapshot);
         }
     }
 
+    virtual void SetSnapshots(const std::vector<std::shared_ptr<Snapshot>> &snapshots, PluginHost &pluginHost) override
+    {
+        std::lock_guard guard(mutex);
+        if (active && this->currentPedalboard)
+        {
+            this->hostWriter.SetRealtimeSnapshots(new RealtimeSnapshots(snapshots, this->currentPedalboard, pluginHost));
+        }
+    }
+
     void OnNotifyPathPatchPropertyReceived(
         int64_t instanceId,
         const std::string &pathPatchPropertyUri,
@@ -1882,6 +2472,46 @@ public:
         }
     }
 
+    virtual void SetAudioTaps(const std::vector<AudioTapInfo> &taps)
+    {
+        std::lock_guard guard(mutex);
+
+        if (active && this->currentPedalboard)
+        {
+            if (taps.size() == 0)
+            {
+                this->hostWriter.SetAudioTaps(nullptr);
+                return;
+            }
+            RealtimeAudioTaps *realtimeTaps = new RealtimeAudioTaps();
+            for (const auto &tap : taps)
+            {
+                int index;
+                if (tap.instanceId == Pedalboard::INPUT_VOLUME_ID || tap.instanceId == Pedalboard::OUTPUT_VOLUME_ID)
+                {
+                    index = (int)tap.instanceId;
+                }
+                else
+                {
+                    IEffect *effect = this->currentPedalboard->GetEffect(tap.instanceId);
+                    if (!effect)
+                    {
+                        continue;
+                    }
+                    int nPorts = tap.output ? effect->GetNumberOfOutputAudioPorts() : effect->GetNumberOfInputAudioPorts();
+                    if (nPorts == 0)
+                    {
+                        continue;
+                    }
+                    index = this->currentPedalboard->GetIndexOfInstanceId(tap.instanceId);
+                }
+                realtimeTaps->taps.push_back(RealtimeAudioTaps::Tap{index, tap.output, tap.channel, tap.ring.get()});
+                realtimeTaps->rings.push_back(tap.ring);
+            }
+            this->hostWriter.SetAudioTaps(realtimeTaps);
+        }
+    }
+
     RealtimeMonitorPortSubscription MakeRealtimeSubscription(const MonitorPortSubscription &subscription)
     {
         RealtimeMonitorPortSubscription result;
@@ -2079,6 +2709,8 @@ public:
         } else {
             result.governor_ = "";
         }
+        result.threadPlacement_ = GetThreadPlacementDescription();
+        result.bufferSizeRecommendation_ = bufferSizeGovernor.Evaluate();
 
         return result;
     }
@@ -2267,4 +2899,6 @@ JSON_MAP_REFERENCE(JackHostStatus, cpuFreqMin)
 JSON_MAP_REFERENCE(JackHostStatus, cpuFreqMax)
 JSON_MAP_REFERENCE(JackHostStatus, hasCpuGovernor)
 JSON_MAP_REFERENCE(JackHostStatus, governor)
+JSON_MAP_REFERENCE(JackHostStatus, threadPlacement)
+JSON_MAP_REFERENCE(JackHostStatus, bufferSizeRecommendation)
 JSON_MAP_END()
@@ -31,9 +31,12 @@
 #include "Promise.hpp"
 #include "json_variant.hpp"
 #include "RealtimeMidiEventType.hpp"
+#include "AudioTap.hpp"
+#include "BufferSizeGovernor.hpp"
 
 namespace pipedal
 {
+    class PiPedalConfiguration;
 
     struct RealtimeMidiProgramRequest;
     struct RealtimeNextMidiProgramRequest;
@@ -170,6 +173,8 @@ namespace pipedal
         virtual void OnNotifyLv2RealtimeError(int64_t instanceId, const std::string &error) = 0;
         virtual void OnNotifyMidiRealtimeEvent(RealtimeMidiEventType eventType) = 0;
         virtual void OnNotifyMidiRealtimeSnapshotRequest(int32_t snapshotIndex,int64_t snapshotRequestId) = 0;
+        // A MIDI-triggered snapshot that has already been applied by the audio thread.
+        virtual void OnNotifyMidiRealtimeSnapshotApplied(int32_t snapshotIndex) = 0;
     };
 
     class JackHostStatus
@@ -186,6 +191,8 @@ namespace pipedal
         uint64_t cpuFreqMin_ = 0;
         bool hasCpuGovernor_ = true;
         std::string governor_;
+        std::string threadPlacement_;
+        BufferSizeRecommendation bufferSizeRecommendation_;
 
         DECLARE_JSON_MAP(JackHostStatus);
     };
@@ -224,6 +231,9 @@ namespace pipedal
         virtual void SetPedalboard(const std::shared_ptr<Lv2Pedalboard> &pedalboard) = 0;
 
         virtual void SetControlValue(uint64_t instanceId, const std::string &symbol, float value) = 0;
+        virtual void SetControlValue(uint64_t instanceId, int controlIndex, float value) = 0;
+        // effectIndex: the index of the effect in the current pedalboard, if known. Checked against instanceId.
+        virtual void SetControlValue(uint64_t instanceId, int effectIndex, int controlIndex, float value) = 0;
         virtual void SetInputVolume(float value) = 0;
         virtual void SetOutputVolume(float value) = 0;
         virtual void SetPluginPreset(uint64_t instanceId, const std::vector<ControlValue> &values) = 0;
@@ -232,9 +242,14 @@ namespace pipedal
         virtual bool IsOpen() const = 0;
 
         virtual void SetVuSubscriptions(const std::vector<int64_t> &instanceIds) = 0;
+        virtual void SetAudioTaps(const std::vector<AudioTapInfo> &taps) = 0;
         virtual void SetMonitorPortSubscriptions(const std::vector<MonitorPortSubscription> &subscriptions) = 0;
 
         virtual void SetSystemMidiBindings(const std::vector<MidiBinding> &bindings) = 0;
+        virtual void SetConfiguration(const PiPedalConfiguration &configuration) = 0;
+        // The shared memory segment to publish telemetry to (see Telemetry.hpp). Empty (the default) disables
+        // telemetry. Call before Open().
+        virtual void SetTelemetrySegmentName(const std::string &segmentName) = 0;
 
         virtual void sendRealtimeParameterRequest(RealtimePatchPropertyRequest *pParameterRequest) = 0;
         virtual void AckMidiProgramRequest(uint64_t requestId) = 0;
@@ -243,7 +258,12 @@ namespace pipedal
 
         virtual JackHostStatus getJackStatus() = 0;
 
+        virtual BufferSizeGovernor &GetBufferSizeGovernor() = 0;
+
         virtual void LoadSnapshot(Snapshot &snapshot, PluginHost &pluginHost) = 0;
+        // Precompile the pedalboard's snapshots so that MIDI snapshot requests can be applied on the audio thread.
+        // Must be called after SetPedalboard, and again whenever the snapshots change.
+        virtual void SetSnapshots(const std::vector<std::shared_ptr<Snapshot>> &snapshots, PluginHost &pluginHost) = 0;
 
         virtual void OnNotifyPathPatchPropertyReceived(
             int64_t instanceId,
@@ -0,0 +1,500 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "AudioTap.hpp"
+#include "Lv2Log.hpp"
+#include "ss.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <stdexcept>
+
+using namespace pipedal;
+
+JSON_MAP_BEGIN(AudioTapRequest)
+JSON_MAP_REFERENCE(AudioTapRequest, instanceId)
+JSON_MAP_REFERENCE(AudioTapRequest, output)
+JSON_MAP_REFERENCE(AudioTapRequest, channel)
+JSON_MAP_REFERENCE(AudioTapRequest, mode)
+JSON_MAP_REFERENCE(AudioTapRequest, points)
+JSON_MAP_REFERENCE(AudioTapRequest, updateRate)
+JSON_MAP_END()
+
+static_assert(sizeof(AudioTapFrameHeader) == 32, "Binary frame layout is shared with the web client.");
+
+static constexpr size_t MIN_WAVEFORM_POINTS = 16;
+static constexpr size_t MAX_WAVEFORM_POINTS = 4096;
+static constexpr size_t MIN_FFT_SIZE = 64;
+static constexpr size_t MAX_FFT_SIZE = 16384;
+static constexpr float MIN_UPDATE_RATE = 0.5f;
+static constexpr float MAX_UPDATE_RATE = 60.0f;
+static constexpr size_t READ_CHUNK = 4096;
+static constexpr std::chrono::milliseconds SERVICE_INTERVAL{10};
+
+AudioTapRing::AudioTapRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+void AudioTapRing::Write(const float *samples, size_t count)
+{
+    size_t head = this->head.load(std::memory_order_relaxed);
+    size_t tail = this->tail.load(std::memory_order_acquire);
+    size_t available = buffer.size() - (head - tail);
+    if (count > available)
+    {
+        droppedSamples.fetch_add(count - available, std::memory_order_relaxed);
+        count = available;
+    }
+    size_t index = head & mask;
+    size_t n1 = std::min(count, buffer.size() - index);
+    std::memcpy(&buffer[index], samples, n1 * sizeof(float));
+    if (n1 != count)
+    {
+        std::memcpy(&buffer[0], samples + n1, (count - n1) * sizeof(float));
+    }
+    this->head.store(head + count, std::memory_order_release);
+}
+
+size_t AudioTapRing::Read(float *samples, size_t maxCount)
+{
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    size_t head = this->head.load(std::memory_order_acquire);
+    size_t count = std::min(maxCount, head - tail);
+    size_t index = tail & mask;
+    size_t n1 = std::min(count, buffer.size() - index);
+    std::memcpy(samples, &buffer[index], n1 * sizeof(float));
+    if (n1 != count)
+    {
+        std::memcpy(samples + n1, &buffer[0], (count - n1) * sizeof(float));
+    }
+    this->tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+class AudioTapService::Tap
+{
+public:
+    int64_t subscriptionHandle;
+    AudioTapRequest request;
+    AudioTapMode mode;
+    AudioTapCallback callback;
+    std::atomic<bool> removed{false};
+
+    // guarded by AudioTapService::mutex. Picked up by the service thread on its next pass.
+    std::shared_ptr<AudioTapRing> ring;
+    double targetSampleRate = 0;
+
+    // service thread only.
+    std::shared_ptr<AudioTapRing> activeRing;
+    double configuredSampleRate = 0;
+    std::vector<float> readBuffer;
+    std::vector<float> values;
+    uint32_t sampleRate = 0;
+
+    // waveform state.
+    size_t samplesPerPoint = 1;
+    size_t pointSamples = 0;
+    float pointMin = 0;
+    float pointMax = 0;
+
+    // spectrum state.
+    size_t fftSize = 0;
+    size_t hopSamples = 0;
+    size_t samplesSinceFrame = 0;
+    size_t historyCount = 0;
+    size_t historyPos = 0;
+    std::vector<float> history;
+    std::vector<float> window;
+    float windowGain = 1;
+    std::vector<std::complex<float>> fftBuffer;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<uint32_t> bitReverse;
+
+    void Configure(double sampleRate);
+    void AddWaveformSamples(const float *samples, size_t count);
+    void AddSpectrumSamples(const float *samples, size_t count);
+    void ComputeSpectrum();
+    void Emit();
+};
+
+static size_t RingCapacity(const AudioTapRequest &request, double sampleRate)
+{
+    // enough for several service intervals at the largest frame size we're likely to need.
+    size_t frameSamples = (size_t)(sampleRate / request.updateRate_);
+    return std::max({(size_t)16384, (size_t)request.points_ * 2, frameSamples * 2});
+}
+
+static int32_t ClampFftSize(int32_t points)
+{
+    size_t size = MIN_FFT_SIZE;
+    while (size < (size_t)points && size < MAX_FFT_SIZE)
+    {
+        size *= 2;
+    }
+    return (int32_t)size;
+}
+
+void AudioTapService::Tap::Configure(double sampleRate)
+{
+    this->configuredSampleRate = sampleRate;
+    this->sampleRate = (uint32_t)sampleRate;
+    values.clear();
+    size_t frameSamples = (size_t)std::max(1.0, sampleRate / request.updateRate_);
+    if (mode == AudioTapMode::Waveform)
+    {
+        values.reserve(request.points_ * 2);
+        samplesPerPoint = std::max((size_t)1, frameSamples / request.points_);
+        pointSamples = 0;
+    }
+    else
+    {
+        fftSize = request.points_;
+        hopSamples = frameSamples;
+        samplesSinceFrame = 0;
+        historyCount = 0;
+        historyPos = 0;
+        history.assign(fftSize, 0.0f);
+        values.reserve(fftSize / 2);
+
+        window.resize(fftSize);
+        double sum = 0;
+        for (size_t i = 0; i < fftSize; ++i)
+        {
+            window[i] = (float)(0.5 - 0.5 * std::cos(2 * M_PI * i / fftSize)); // Hann
+            sum += window[i];
+        }
+        windowGain = (float)(2.0 / sum); // full-scale sine reads 0 dBFS.
+
+        fftBuffer.resize(fftSize);
+        twiddles.resize(fftSize / 2);
+        for (size_t k = 0; k < fftSize / 2; ++k)
+        {
+            twiddles[k] = std::polar(1.0f, (float)(-2 * M_PI * k / fftSize));
+        }
+        bitReverse.resize(fftSize);
+        size_t bits = 0;
+        while (((size_t)1 << bits) < fftSize)
+        {
+            ++bits;
+        }
+        for (size_t i = 0; i < fftSize; ++i)
+        {
+            uint32_t r = 0;
+            for (size_t b = 0; b < bits; ++b)
+            {
+                if (i & ((size_t)1 << b))
+                {
+                    r |= 1u << (bits - 1 - b);
+                }
+            }
+            bitReverse[i] = r;
+        }
+    }
+}
+
+void AudioTapService::Tap::AddWaveformSamples(const float *samples, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        float v = samples[i];
+        if (pointSamples == 0)
+        {
+            pointMin = pointMax = v;
+        }
+        else
+        {
+            pointMin = std::min(pointMin, v);
+            pointMax = std::max(pointMax, v);
+        }
+        if (++pointSamples == samplesPerPoint)
+        {
+            pointSamples = 0;
+            values.push_back(pointMin);
+            values.push_back(pointMax);
+            if (values.size() == (size_t)request.points_ * 2)
+            {
+                Emit();
+            }
+        }
+    }
+}
+
+void AudioTapService::Tap::AddSpectrumSamples(const float *samples, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        history[historyPos] = samples[i];
+        historyPos = (historyPos + 1) & (fftSize - 1);
+        if (historyCount < fftSize)
+        {
+            ++historyCount;
+        }
+        if (++samplesSinceFrame >= hopSamples && historyCount == fftSize)
+        {
+            samplesSinceFrame = 0;
+            ComputeSpectrum();
+            Emit();
+        }
+    }
+}
+
+void AudioTapService::Tap::ComputeSpectrum()
+{
+    size_t n = fftSize;
+    // oldest sample is at historyPos.
+    for (size_t i = 0; i < n; ++i)
+    {
+        fftBuffer[bitReverse[i]] = std::complex<float>(history[(historyPos + i) & (n - 1)] * window[i], 0.0f);
+    }
+    for (size_t len = 2; len <= n; len <<= 1)
+    {
+        size_t half = len / 2;
+        size_t step = n / len;
+        for (size_t i = 0; i < n; i += len)
+        {
+            for (size_t k = 0; k < half; ++k)
+            {
+                std::complex<float> u = fftBuffer[i + k];
+                std::complex<float> v = fftBuffer[i + k + half] * twiddles[k * step];
+                fftBuffer[i + k] = u + v;
+                fftBuffer[i + k + half] = u - v;
+            }
+        }
+    }
+    values.clear();
+    for (size_t k = 0; k < n / 2; ++k)
+    {
+        float magnitude = std::abs(fftBuffer[k]) * windowGain;
+        values.push_back(20.0f * std::log10(std::max(magnitude, 1E-10f)));
+    }
+}
+
+void AudioTapService::Tap::Emit()
+{
+    AudioTapFrameHeader header;
+    header.magic = AUDIO_TAP_FRAME_MAGIC;
+    header.mode = (uint32_t)mode;
+    header.subscriptionHandle = subscriptionHandle;
+    header.sampleRate = sampleRate;
+    header.valueCount = (uint32_t)values.size();
+    header.droppedSamples = activeRing->TakeDroppedSamples();
+
+    std::vector<uint8_t> frame(sizeof(header) + values.size() * sizeof(float));
+    std::memcpy(&frame[0], &header, sizeof(header));
+    std::memcpy(&frame[sizeof(header)], values.data(), values.size() * sizeof(float));
+    values.clear();
+    if (removed.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    try
+    {
+        callback(frame);
+    }
+    catch (const std::exception &e)
+    {
+        Lv2Log::debug(SS("Audio tap delivery failed. (" << e.what() << ")"));
+    }
+}
+
+AudioTapService::AudioTapService()
+{
+}
+
+AudioTapService::~AudioTapService()
+{
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    cvStop.notify_all();
+    if (thread)
+    {
+        thread->join();
+        thread = nullptr;
+    }
+}
+
+void AudioTapService::SetSampleRate(double sampleRate)
+{
+    std::lock_guard lock{mutex};
+    if (sampleRate == this->sampleRate)
+    {
+        return;
+    }
+    this->sampleRate = sampleRate;
+    // the ring size depends on the sample rate. The caller hands the new rings to the audio host via GetTaps().
+    for (auto &tap : taps)
+    {
+        tap->targetSampleRate = sampleRate;
+        tap->ring = std::make_shared<AudioTapRing>(RingCapacity(tap->request, sampleRate));
+    }
+}
+
+void AudioTapService::AddTap(int64_t subscriptionHandle, const AudioTapRequest &request, AudioTapCallback callback)
+{
+    std::shared_ptr<Tap> tap = std::make_shared<Tap>();
+    tap->subscriptionHandle = subscriptionHandle;
+    tap->request = request;
+    tap->callback = callback;
+    if (request.mode_ == "waveform")
+    {
+        tap->mode = AudioTapMode::Waveform;
+        tap->request.points_ = std::clamp(request.points_, (int32_t)MIN_WAVEFORM_POINTS, (int32_t)MAX_WAVEFORM_POINTS);
+    }
+    else if (request.mode_ == "spectrum")
+    {
+        tap->mode = AudioTapMode::Spectrum;
+        tap->request.points_ = ClampFftSize(request.points_);
+    }
+    else
+    {
+        throw std::invalid_argument(SS("Invalid audio tap mode: " << request.mode_));
+    }
+    if (request.channel_ < 0)
+    {
+        throw std::invalid_argument("Invalid audio tap channel.");
+    }
+    if (!std::isfinite(request.updateRate_))
+    {
+        tap->request.updateRate_ = AudioTapRequest().updateRate_;
+    }
+    tap->request.updateRate_ = std::clamp(tap->request.updateRate_, MIN_UPDATE_RATE, MAX_UPDATE_RATE);
+    tap->readBuffer.resize(READ_CHUNK);
+
+    std::lock_guard lock{mutex};
+    tap->Configure(sampleRate);
+    tap->targetSampleRate = sampleRate;
+    tap->ring = std::make_shared<AudioTapRing>(RingCapacity(tap->request, sampleRate));
+    tap->activeRing = tap->ring;
+    taps.push_back(std::move(tap));
+    if (!thread)
+    {
+        CreateThread();
+    }
+}
+
+void AudioTapService::RemoveTap(int64_t subscriptionHandle)
+{
+    std::lock_guard lock{mutex};
+    for (auto i = taps.begin(); i != taps.end(); ++i)
+    {
+        if ((*i)->subscriptionHandle == subscriptionHandle)
+        {
+            // the service thread may still hold a reference; it checks the flag before each delivery.
+            (*i)->removed.store(true, std::memory_order_release);
+            taps.erase(i);
+            break;
+        }
+    }
+}
+
+std::vector<AudioTapInfo> AudioTapService::GetTaps()
+{
+    std::lock_guard lock{mutex};
+    std::vector<AudioTapInfo> result;
+    for (auto &tap : taps)
+    {
+        result.push_back(AudioTapInfo{tap->request.instanceId_, tap->request.output_, tap->request.channel_, tap->ring});
+    }
+    return result;
+}
+
+void AudioTapService::CreateThread()
+{
+    thread = std::make_unique<std::thread>([this]()
+                                           { ThreadProc(); });
+}
+
+void AudioTapService::ProcessTap(Tap &tap)
+{
+    while (true)
+    {
+        size_t n = tap.activeRing->Read(tap.readBuffer.data(), tap.readBuffer.size());
+        if (n == 0)
+        {
+            break;
+        }
+        if (tap.mode == AudioTapMode::Waveform)
+        {
+            tap.AddWaveformSamples(tap.readBuffer.data(), n);
+        }
+        else
+        {
+            tap.AddSpectrumSamples(tap.readBuffer.data(), n);
+        }
+    }
+}
+
+void AudioTapService::ThreadProc()
+{
+    SetThreadName("audioTap");
+    struct PendingTap
+    {
+        std::shared_ptr<Tap> tap;
+        std::shared_ptr<AudioTapRing> ring;
+        double sampleRate;
+    };
+    std::vector<PendingTap> pending;
+
+    std::unique_lock lock{mutex};
+    while (!stopping)
+    {
+        cvStop.wait_for(lock, SERVICE_INTERVAL);
+        if (stopping)
+        {
+            break;
+        }
+        for (auto &tap : taps)
+        {
+            pending.push_back(PendingTap{tap, tap->ring, tap->targetSampleRate});
+        }
+        lock.unlock();
+
+        for (auto &item : pending)
+        {
+            Tap &tap = *item.tap;
+            if (tap.removed.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            if (tap.activeRing != item.ring || tap.configuredSampleRate != item.sampleRate)
+            {
+                tap.activeRing = item.ring;
+                tap.Configure(item.sampleRate);
+            }
+            ProcessTap(tap);
+        }
+        // release taps (and rings) without the lock held.
+        pending.clear();
+        lock.lock();
+    }
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+
+namespace pipedal
+{
+    /// @brief Client parameters for an audio tap subscription.
+    class AudioTapRequest
+    {
+    public:
+        int64_t instanceId_ = -1; // an effect, or Pedalboard::INPUT_VOLUME_ID / OUTPUT_VOLUME_ID.
+        bool output_ = true;      // tap the output buffers of the instance (otherwise the input buffers).
+        int32_t channel_ = 0;
+        std::string mode_ = "waveform"; // "waveform" or "spectrum".
+        int32_t points_ = 256;          // waveform: min/max pairs per frame. spectrum: FFT size (power of 2).
+        float updateRate_ = 15;         // frames per second.
+
+        DECLARE_JSON_MAP(AudioTapRequest);
+    };
+
+    enum class AudioTapMode : uint32_t
+    {
+        Waveform = 0,
+        Spectrum = 1,
+    };
+
+    constexpr uint32_t AUDIO_TAP_FRAME_MAGIC = 0x50415450; // "PTAP", little-endian.
+
+    /// @brief Header of the binary websocket frames sent to tap subscribers.
+    ///
+    /// Little-endian. Followed by valueCount floats: interleaved min/max pairs for waveforms;
+    /// magnitudes in dBFS for bins 0..fftSize/2-1 for spectra.
+    struct AudioTapFrameHeader
+    {
+        uint32_t magic;
+        uint32_t mode; // AudioTapMode
+        int64_t subscriptionHandle;
+        uint32_t sampleRate;
+        uint32_t valueCount;
+        uint64_t droppedSamples; // samples lost since the previous frame because the reader fell behind.
+    };
+
+    /// @brief Preallocated single-producer/single-consumer sample ring.
+    ///
+    /// The audio thread writes; the tap service thread reads. Samples that don't fit are dropped and counted.
+    class AudioTapRing
+    {
+    public:
+        AudioTapRing(size_t capacity);
+
+        // Audio thread.
+        void Write(const float *samples, size_t count);
+
+        // Reader.
+        size_t Read(float *samples, size_t maxCount);
+        uint64_t TakeDroppedSamples() { return droppedSamples.exchange(0, std::memory_order_relaxed); }
+        size_t Capacity() const { return buffer.size(); }
+
+    private:
+        std::vector<float> buffer;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<uint64_t> droppedSamples{0};
+    };
+
+    /// @brief The audio thread's view of the active taps.
+    ///
+    /// Built on the host side, handed to the audio thread through the ring buffer, and handed back to the
+    /// host thread for deletion, so that the rings are never released on the audio thread.
+    class RealtimeAudioTaps
+    {
+    public:
+        struct Tap
+        {
+            int effectIndex; // or Pedalboard::INPUT_VOLUME_ID / OUTPUT_VOLUME_ID
+            bool output;
+            int channel;
+            AudioTapRing *ring;
+        };
+        std::vector<Tap> taps;
+        std::vector<std::shared_ptr<AudioTapRing>> rings; // ownership.
+    };
+
+    /// @brief A tap as seen by the audio host (which resolves instance ids against the current pedalboard).
+    class AudioTapInfo
+    {
+    public:
+        int64_t instanceId;
+        bool output;
+        int channel;
+        std::shared_ptr<AudioTapRing> ring;
+    };
+
+    using AudioTapCallback = std::function<void(const std::vector<uint8_t> &frame)>;
+
+    /// @brief Decimates or analyzes tapped audio off the audio thread, and delivers binary frames to subscribers.
+    class AudioTapService
+    {
+    public:
+        AudioTapService();
+        ~AudioTapService();
+
+        void SetSampleRate(double sampleRate);
+
+        // Out-of-range point counts and update rates are clamped. Throws std::invalid_argument if the mode or channel is invalid.
+        void AddTap(int64_t subscriptionHandle, const AudioTapRequest &request, AudioTapCallback callback);
+        // Does not wait for a callback that is already in progress; callbacks must not assume that
+        // their subscriber outlives this call.
+        void RemoveTap(int64_t subscriptionHandle);
+
+        std::vector<AudioTapInfo> GetTaps();
+
+    private:
+        class Tap;
+        void ThreadProc();
+        void ProcessTap(Tap &tap);
+        void CreateThread();
+
+        // taps are processed and delivered on the service thread without holding the mutex,
+        // so that a slow subscriber can't stall AddTap/RemoveTap callers.
+        std::mutex mutex;
+        std::condition_variable cvStop;
+        bool stopping = false;
+        double sampleRate = 48000;
+        std::vector<std::shared_ptr<Tap>> taps;
+        std::unique_ptr<std::thread> thread;
+    };
+}
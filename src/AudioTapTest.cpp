@@ -0,0 +1,208 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "AudioTap.hpp"
+#include "catch.hpp"
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace pipedal;
+
+TEST_CASE("AudioTapRing", "[audio_tap][Build][Dev]")
+{
+    AudioTapRing ring(100); // rounds up to 128.
+    std::vector<float> input(96);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        input[i] = (float)i;
+    }
+    std::vector<float> output(128);
+
+    ring.Write(input.data(), input.size());
+    REQUIRE(ring.Read(output.data(), 64) == 64);
+    // wraps.
+    ring.Write(input.data(), input.size());
+    REQUIRE(ring.TakeDroppedSamples() == 0);
+    REQUIRE(ring.Read(output.data(), output.size()) == 128);
+    REQUIRE(output[0] == 64);
+    REQUIRE(output[31] == 95);
+    REQUIRE(output[32] == 0);
+    REQUIRE(output[127] == 95);
+
+    // overrun drops the excess.
+    ring.Write(input.data(), input.size());
+    ring.Write(input.data(), input.size());
+    REQUIRE(ring.TakeDroppedSamples() == 64);
+    REQUIRE(ring.TakeDroppedSamples() == 0);
+    REQUIRE(ring.Read(output.data(), output.size()) == 128);
+    REQUIRE(ring.Read(output.data(), output.size()) == 0);
+}
+
+TEST_CASE("AudioTapService spectrum", "[audio_tap][Build][Dev]")
+{
+    constexpr double SAMPLE_RATE = 48000;
+    constexpr int FFT_SIZE = 1024;
+    constexpr int BIN = 100;
+
+    std::mutex resultMutex;
+    int frames = 0;
+    bool badFrame = false;
+    int peakBin = -1;
+    float peakDb = -1000;
+
+    {
+        AudioTapService service;
+        service.SetSampleRate(SAMPLE_RATE);
+
+        AudioTapRequest request;
+        request.mode_ = "spectrum";
+        request.points_ = FFT_SIZE;
+        request.updateRate_ = 20;
+        service.AddTap(
+            1, request,
+            [&](const std::vector<uint8_t> &frame)
+            {
+                // (catch assertions aren't thread-safe; check on the test thread.)
+                AudioTapFrameHeader header;
+                std::memcpy(&header, frame.data(), sizeof(header));
+                std::vector<float> values(header.valueCount);
+                std::memcpy(values.data(), frame.data() + sizeof(header), values.size() * sizeof(float));
+
+                std::lock_guard lock{resultMutex};
+                if (header.magic != AUDIO_TAP_FRAME_MAGIC || header.valueCount != FFT_SIZE / 2 ||
+                    frame.size() != sizeof(header) + header.valueCount * sizeof(float))
+                {
+                    badFrame = true;
+                    return;
+                }
+                ++frames;
+                peakBin = 0;
+                for (size_t i = 0; i < values.size(); ++i)
+                {
+                    if (values[i] > values[peakBin])
+                    {
+                        peakBin = (int)i;
+                    }
+                }
+                peakDb = values[peakBin];
+            });
+        REQUIRE_THROWS(service.AddTap(2, AudioTapRequest{-1, true, 0, "bogus", 1024, 20}, [](const std::vector<uint8_t> &) {}));
+
+        auto taps = service.GetTaps();
+        REQUIRE(taps.size() == 1);
+
+        // full-scale sine centered on BIN.
+        std::vector<float> buffer(SAMPLE_RATE / 10);
+        for (size_t i = 0; i < buffer.size(); ++i)
+        {
+            buffer[i] = (float)std::sin(2 * M_PI * BIN * i / FFT_SIZE);
+        }
+        taps[0].ring->Write(buffer.data(), buffer.size());
+
+        for (int retry = 0; retry < 100; ++retry)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::lock_guard lock{resultMutex};
+            if (frames >= 2)
+            {
+                break;
+            }
+        }
+        service.RemoveTap(1);
+    }
+    REQUIRE(!badFrame);
+    REQUIRE(frames >= 2);
+    REQUIRE(peakBin == BIN);
+    REQUIRE(std::abs(peakDb) < 0.1f);
+}
+
+TEST_CASE("AudioTapService clamps requests", "[audio_tap][Build][Dev]")
+{
+    AudioTapService service;
+    service.SetSampleRate(48000);
+
+    // points and update rate are client-supplied.
+    service.AddTap(1, AudioTapRequest{-1, true, 0, "waveform", 100000000, 1E-9f}, [](const std::vector<uint8_t> &) {});
+    service.AddTap(2, AudioTapRequest{-1, true, 0, "spectrum", 1000, NAN}, [](const std::vector<uint8_t> &) {});
+    service.AddTap(3, AudioTapRequest{-1, true, 0, "spectrum", 1 << 30, 1E9f}, [](const std::vector<uint8_t> &) {});
+    auto taps = service.GetTaps();
+    REQUIRE(taps.size() == 3);
+    for (auto &tap : taps)
+    {
+        REQUIRE(tap.ring->Capacity() <= 262144);
+    }
+}
+
+TEST_CASE("AudioTapService sample rate change", "[audio_tap][Build][Dev]")
+{
+    AudioTapService service;
+    service.SetSampleRate(48000);
+    service.AddTap(1, AudioTapRequest{-1, true, 0, "waveform", 256, 0.5f}, [](const std::vector<uint8_t> &) {});
+    auto before = service.GetTaps();
+    REQUIRE(before[0].ring->Capacity() >= 48000 * 2 * 2);
+
+    service.SetSampleRate(192000);
+    auto after = service.GetTaps();
+    REQUIRE(after[0].ring != before[0].ring);
+    REQUIRE(after[0].ring->Capacity() >= 192000 * 2 * 2);
+}
+
+TEST_CASE("AudioTapService slow subscriber", "[audio_tap][Build][Dev]")
+{
+    std::mutex callbackMutex;
+    std::condition_variable cv;
+    bool inCallback = false;
+    bool release = false;
+
+    AudioTapService service;
+    service.SetSampleRate(48000);
+    service.AddTap(
+        1, AudioTapRequest{-1, true, 0, "waveform", 16, 60},
+        [&](const std::vector<uint8_t> &)
+        {
+            std::unique_lock lock{callbackMutex};
+            inCallback = true;
+            cv.notify_all();
+            cv.wait_for(lock, std::chrono::seconds(5), [&]() { return release; });
+        });
+    std::vector<float> buffer(48000);
+    service.GetTaps()[0].ring->Write(buffer.data(), buffer.size());
+    {
+        std::unique_lock lock{callbackMutex};
+        REQUIRE(cv.wait_for(lock, std::chrono::seconds(5), [&]() { return inCallback; }));
+    }
+
+    // a blocked delivery must not block AddTap/RemoveTap.
+    auto start = std::chrono::steady_clock::now();
+    service.AddTap(2, AudioTapRequest{-1, true, 0, "waveform", 16, 60}, [](const std::vector<uint8_t> &) {});
+    service.RemoveTap(2);
+    service.RemoveTap(1);
+    REQUIRE(service.GetTaps().size() == 0);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    {
+        std::lock_guard lock{callbackMutex};
+        release = true;
+    }
+    cv.notify_all();
+    REQUIRE(elapsed < std::chrono::seconds(1));
+}
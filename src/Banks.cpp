@@ -59,4 +59,21 @@ JSON_MAP_BEGIN(BankFileEntry)
     JSON_MAP_REFERENCE(BankFileEntry,preset)
 JSON_MAP_END()
 
+JSON_MAP_BEGIN(BankFileIndexEntry)
+    JSON_MAP_REFERENCE(BankFileIndexEntry,instanceId)
+    JSON_MAP_REFERENCE(BankFileIndexEntry,name)
+    JSON_MAP_REFERENCE(BankFileIndexEntry,offset)
+    JSON_MAP_REFERENCE(BankFileIndexEntry,length)
+    JSON_MAP_REFERENCE(BankFileIndexEntry,blobKeys)
+JSON_MAP_END()
+
+JSON_MAP_BEGIN(BankFileIndex)
+    JSON_MAP_REFERENCE(BankFileIndex,bankFileSize)
+    JSON_MAP_REFERENCE(BankFileIndex,bankFileTime)
+    JSON_MAP_REFERENCE(BankFileIndex,nextInstanceId)
+    JSON_MAP_REFERENCE(BankFileIndex,selectedPreset)
+    JSON_MAP_REFERENCE(BankFileIndex,pluginStateBlobs)
+    JSON_MAP_REFERENCE(BankFileIndex,presets)
+JSON_MAP_END()
+
 
@@ -22,6 +22,7 @@
 #include "json.hpp"
 #include "Pedalboard.hpp"
 #include "PiPedalException.hpp"
+#include <filesystem>
 
 namespace pipedal {
 
@@ -76,9 +77,38 @@ public:
 class BankFileEntry {
     int64_t instanceId_;
     Pedalboard preset_;
+
+    // non-persistent. Presets of a bank loaded from its index aren't parsed until they are used.
+    // Until then, preset_ holds only the name, and the preset's JSON is at [fileOffset,fileOffset+fileLength) in the bank file.
+    bool isLoaded = true;
+    int64_t fileOffset = 0;
+    int64_t fileLength = 0;
+    std::vector<std::string> blobKeys;
 public:
     GETTER_SETTER(instanceId);
-    GETTER_SETTER_REF(preset);
+    Pedalboard&preset() { return preset_; }
+    const Pedalboard&preset() const { return preset_; }
+    void preset(const Pedalboard&value) { preset_ = value; isLoaded = true; }
+
+    bool IsLoaded() const { return isLoaded; }
+    void SetUnloaded(const std::string&name, int64_t fileOffset, int64_t fileLength, const std::vector<std::string>&blobKeys)
+    {
+        this->preset_ = Pedalboard();
+        this->preset_.name(name);
+        this->isLoaded = false;
+        this->fileOffset = fileOffset;
+        this->fileLength = fileLength;
+        this->blobKeys = blobKeys;
+    }
+    void SetFileLocation(int64_t fileOffset, int64_t fileLength)
+    {
+        this->fileOffset = fileOffset;
+        this->fileLength = fileLength;
+    }
+    int64_t FileOffset() const { return fileOffset; }
+    int64_t FileLength() const { return fileLength; }
+    // blob store keys referenced by an unloaded preset.
+    const std::vector<std::string>&BlobKeys() const { return blobKeys; }
 
     DECLARE_JSON_MAP(BankFileEntry);
 };
@@ -88,17 +118,29 @@ class BankFile {
     int64_t selectedPreset_ = -1;
     std::vector<std::unique_ptr<BankFileEntry>> presets_;
 
+    // non-persistent. True if large plugin state in every preset has been moved to the blob store.
+    bool stateExternalized = false;
+    // non-persistent. The file that unloaded presets are read from.
+    std::filesystem::path sourceFile;
+
 public:
     GETTER_SETTER(name);
     GETTER_SETTER(nextInstanceId);
     GETTER_SETTER(selectedPreset);
     GETTER_SETTER_VEC(presets);
 
+    bool IsStateExternalized() const { return stateExternalized; }
+    void SetStateExternalized(bool value) { stateExternalized = value; }
+    const std::filesystem::path &SourceFile() const { return sourceFile; }
+    void SetSourceFile(const std::filesystem::path &value) { sourceFile = value; }
+
     void clear()
     {
         nextInstanceId_ = 0;
         presets_.clear();
         selectedPreset_ = -1;
+        stateExternalized = false;
+        sourceFile.clear();
     }
     
     void move(size_t from, size_t to)
@@ -231,6 +273,32 @@ public:
     DECLARE_JSON_MAP(BankFile);
 };
 
+// Sidecar index of a bank file, from which a bank can be opened without parsing its presets.
+class BankFileIndexEntry {
+public:
+    int64_t instanceId_ = 0;
+    std::string name_;
+    int64_t offset_ = 0;
+    int64_t length_ = 0;
+    std::vector<std::string> blobKeys_;
+
+    DECLARE_JSON_MAP(BankFileIndexEntry);
+};
+
+class BankFileIndex {
+public:
+    // the bank file the index was built from. The index is ignored if the bank file has changed since.
+    int64_t bankFileSize_ = 0;
+    int64_t bankFileTime_ = 0;
+    int64_t nextInstanceId_ = 0;
+    int64_t selectedPreset_ = -1;
+    // true if large plugin state had been moved to the blob store when the bank was written.
+    bool pluginStateBlobs_ = false;
+    std::vector<BankFileIndexEntry> presets_;
+
+    DECLARE_JSON_MAP(BankFileIndex);
+};
+
 class BankIndexEntry {
     int64_t instanceId_ = 0;
     std::string name_;
@@ -0,0 +1,154 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "BlobStore.hpp"
+#include "Lv2Log.hpp"
+#include "ss.hpp"
+#include "ofstream_synced.hpp"
+#include "PiPedalException.hpp"
+#include <fstream>
+#include <sstream>
+#include <websocketpp/sha1/sha1.hpp>
+
+using namespace pipedal;
+namespace fs = std::filesystem;
+
+static const char *BLOB_EXTENSION = ".blob";
+
+BlobStore::BlobStore(const fs::path &directory)
+    : directory(directory)
+{
+    fs::create_directories(directory);
+}
+
+std::string BlobStore::GetKey(const std::string &content)
+{
+    unsigned char hash[20];
+    websocketpp::sha1::calc(content.c_str(), content.length(), hash);
+
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(sizeof(hash) * 2);
+    for (unsigned char c : hash)
+    {
+        result.push_back(hexDigits[c >> 4]);
+        result.push_back(hexDigits[c & 0x0F]);
+    }
+    return result;
+}
+
+bool BlobStore::IsValidKey(const std::string &key)
+{
+    if (key.length() != 40)
+        return false;
+    for (char c : key)
+    {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+fs::path BlobStore::GetPath(const std::string &key) const
+{
+    return directory / (key + BLOB_EXTENSION);
+}
+
+std::string BlobStore::Put(const std::string &content)
+{
+    std::string key = GetKey(content);
+    if (knownKeys.contains(key))
+    {
+        return key;
+    }
+    fs::path path = GetPath(key);
+    if (!fs::exists(path))
+    {
+        // write to a temporary file so that a power failure can't leave a truncated blob behind.
+        fs::path tempPath = directory / (key + ".$$$");
+        {
+            pipedal::ofstream_synced s;
+            s.open(tempPath, std::ios_base::trunc | std::ios_base::binary);
+            if (!s)
+            {
+                throw PiPedalException(SS("Can't write to " << tempPath));
+            }
+            s.write(content.c_str(), content.length());
+        }
+        fs::rename(tempPath, path);
+    }
+    knownKeys.insert(key);
+    return key;
+}
+
+bool BlobStore::Get(const std::string &key, std::string *content) const
+{
+    if (!IsValidKey(key))
+    {
+        return false;
+    }
+    std::ifstream s(GetPath(key), std::ios_base::binary);
+    if (!s)
+    {
+        return false;
+    }
+    std::stringstream ss;
+    ss << s.rdbuf();
+    *content = ss.str();
+    return true;
+}
+
+size_t BlobStore::CollectGarbage(const std::map<std::string, size_t> &referenceCounts)
+{
+    size_t deleted = 0;
+    std::error_code ec;
+    for (const auto &dirEntry : fs::directory_iterator(directory, ec))
+    {
+        if (dirEntry.is_directory())
+        {
+            continue;
+        }
+        const fs::path &path = dirEntry.path();
+        std::string key = path.stem();
+        bool referenced = false;
+        if (path.extension() == BLOB_EXTENSION)
+        {
+            auto f = referenceCounts.find(key);
+            referenced = f != referenceCounts.end() && f->second != 0;
+        }
+        // (also removes temporary files left behind by an interrupted Put.)
+        if (!referenced)
+        {
+            fs::remove(path, ec);
+            if (ec)
+            {
+                Lv2Log::warning(SS("Can't remove " << path << ". " << ec.message()));
+            }
+            else
+            {
+                knownKeys.erase(key);
+                ++deleted;
+            }
+        }
+    }
+    return deleted;
+}
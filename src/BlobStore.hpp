@@ -0,0 +1,65 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+
+namespace pipedal
+{
+    /// @brief Content-addressed file store.
+    ///
+    /// Each blob is stored once, in a file named by the SHA-1 hash of its content. Storing
+    /// content that is already present doesn't write anything, so identical plugin states
+    /// shared by many presets, copies and snapshots occupy a single file.
+    ///
+    /// Blobs are not deleted when references to them go away; CollectGarbage() removes blobs
+    /// that are no longer referenced.
+    class BlobStore
+    {
+    public:
+        BlobStore(const std::filesystem::path &directory);
+        BlobStore(const BlobStore &) = delete;
+        BlobStore &operator=(const BlobStore &) = delete;
+
+        // Store content. Returns the key by which the content can be retrieved.
+        std::string Put(const std::string &content);
+
+        // Returns false if the key is malformed, or the blob doesn't exist.
+        bool Get(const std::string &key, std::string *content) const;
+
+        static std::string GetKey(const std::string &content);
+        static bool IsValidKey(const std::string &key);
+
+        /// @brief Delete blobs that aren't referenced.
+        /// @param referenceCounts Number of references to each key. Keys with a count of zero, and keys that aren't present, are deleted.
+        /// @returns The number of blobs deleted.
+        size_t CollectGarbage(const std::map<std::string, size_t> &referenceCounts);
+
+    private:
+        std::filesystem::path GetPath(const std::string &key) const;
+
+        std::filesystem::path directory;
+        std::set<std::string> knownKeys; // blobs known to be present.
+    };
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "BlobStore.hpp"
+#include "StateInterface.hpp"
+#include "TemporaryDirectory.hpp"
+#include "json.hpp"
+#include "ss.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace pipedal;
+namespace fs = std::filesystem;
+
+namespace
+{
+    size_t FileCount(const fs::path &directory)
+    {
+        size_t result = 0;
+        for (const auto &entry : fs::directory_iterator(directory))
+        {
+            (void)entry;
+            ++result;
+        }
+        return result;
+    }
+
+    std::string ToJson(const Lv2PluginState &state)
+    {
+        std::stringstream s;
+        json_writer writer(s, true);
+        writer.write(state);
+        return s.str();
+    }
+    Lv2PluginState FromJson(const std::string &json)
+    {
+        std::stringstream s(json);
+        json_reader reader(s);
+        Lv2PluginState result;
+        reader.read(&result);
+        return result;
+    }
+}
+
+TEST_CASE("BlobStore put/get", "[blob_store][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("BlobStoreTest");
+    fs::path blobDirectory = testDirectory.Path() / "blobs";
+    BlobStore blobStore(blobDirectory);
+
+    std::string content1 = "{ \"model\": \"" + std::string(1000, 'a') + "\" }";
+    std::string content2 = "{ \"model\": \"" + std::string(1000, 'b') + "\" }";
+
+    std::string key1 = blobStore.Put(content1);
+    std::string key2 = blobStore.Put(content2);
+    REQUIRE(BlobStore::IsValidKey(key1));
+    REQUIRE(BlobStore::IsValidKey(key2));
+    REQUIRE(key1 != key2);
+    REQUIRE(key1 == BlobStore::GetKey(content1));
+
+    std::string content;
+    REQUIRE(blobStore.Get(key1, &content));
+    REQUIRE(content == content1);
+    REQUIRE(blobStore.Get(key2, &content));
+    REQUIRE(content == content2);
+
+    // identical content is stored once.
+    REQUIRE(blobStore.Put(content1) == key1);
+    REQUIRE(FileCount(blobDirectory) == 2);
+
+    // blobs written by another instance (i.e. a previous run) are found.
+    BlobStore reopened(blobDirectory);
+    REQUIRE(reopened.Get(key2, &content));
+    REQUIRE(content == content2);
+    REQUIRE(reopened.Put(content2) == key2);
+    REQUIRE(FileCount(blobDirectory) == 2);
+
+    REQUIRE(!blobStore.Get(BlobStore::GetKey("not stored"), &content));
+    REQUIRE(!blobStore.Get("../../etc/passwd", &content));
+    REQUIRE(!BlobStore::IsValidKey(key1.substr(1)));
+    REQUIRE(!BlobStore::IsValidKey("ABCDEF" + key1.substr(6)));
+}
+
+TEST_CASE("BlobStore garbage collection", "[blob_store][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("BlobStoreTest");
+    fs::path blobDirectory = testDirectory.Path() / "blobs";
+    BlobStore blobStore(blobDirectory);
+
+    std::string referencedKey = blobStore.Put("referenced");
+    std::string unreferencedKey = blobStore.Put("unreferenced");
+    std::string zeroCountKey = blobStore.Put("zero count");
+    // left behind by an interrupted Put.
+    {
+        std::ofstream f(blobDirectory / (BlobStore::GetKey("partial") + ".$$$"));
+        f << "part";
+    }
+    REQUIRE(FileCount(blobDirectory) == 4);
+
+    std::map<std::string, size_t> referenceCounts;
+    referenceCounts[referencedKey] = 2;
+    referenceCounts[zeroCountKey] = 0;
+    REQUIRE(blobStore.CollectGarbage(referenceCounts) == 3);
+    REQUIRE(FileCount(blobDirectory) == 1);
+
+    std::string content;
+    REQUIRE(blobStore.Get(referencedKey, &content));
+    REQUIRE(content == "referenced");
+    REQUIRE(!blobStore.Get(unreferencedKey, &content));
+    REQUIRE(!blobStore.Get(zeroCountKey, &content));
+
+    // a deleted blob is written again if it's stored again.
+    REQUIRE(blobStore.Put("unreferenced") == unreferencedKey);
+    REQUIRE(blobStore.Get(unreferencedKey, &content));
+    REQUIRE(content == "unreferenced");
+
+    // nothing left to delete.
+    referenceCounts[unreferencedKey] = 1;
+    REQUIRE(blobStore.CollectGarbage(referenceCounts) == 0);
+    REQUIRE(FileCount(blobDirectory) == 2);
+}
+
+TEST_CASE("Lv2PluginState encoding", "[blob_store][Build][Dev]")
+{
+    Lv2PluginStateEntry entry;
+    entry.atomType_ = "http://lv2plug.in/ns/ext/atom#String";
+    std::string value = "model.nam";
+    entry.value_ = std::vector<uint8_t>(value.c_str(), value.c_str() + value.length() + 1); // (strings are stored with their null.)
+
+    Lv2PluginState inlineState;
+    inlineState.isValid_ = true;
+    inlineState.values_["http://example.com/plugins/test#model"] = entry;
+
+    // inline state keeps the two-element form that earlier versions read.
+    std::string json = ToJson(inlineState);
+    std::stringstream s(json);
+    json_reader reader(s);
+    json_variant variant;
+    reader.read(&variant);
+    REQUIRE(variant.is_array());
+    REQUIRE(variant.as_array()->size() == 2);
+    REQUIRE(FromJson(json) == inlineState);
+
+    Lv2PluginState externalState;
+    externalState.isValid_ = true;
+    externalState.blobKey_ = BlobStore::GetKey("state");
+    Lv2PluginState readState = FromJson(ToJson(externalState));
+    REQUIRE(readState.IsExternal());
+    REQUIRE(readState == externalState);
+    REQUIRE(readState != inlineState);
+}
@@ -29,6 +29,7 @@ namespace pipedal {
 
 class BufferPool {
     std::vector<void*> allocatedBuffers;
+    size_t bytesAllocated = 0;
 
 public: 
     ~BufferPool() {
@@ -43,6 +44,7 @@ public:
             result[i] = 0;
         }
         allocatedBuffers.push_back(result);
+        bytesAllocated += size*sizeof(TYPE);
         return result;
     }
 
@@ -52,8 +54,11 @@ public:
             delete[] (char*)allocatedBuffers[i];
         }
         allocatedBuffers.resize(0);
+        bytesAllocated = 0;
     }
 
+    size_t GetBytesAllocated() const { return bytesAllocated; }
+
 
 };
 
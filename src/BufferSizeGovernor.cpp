@@ -0,0 +1,198 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "BufferSizeGovernor.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace pipedal;
+
+BufferSizeGovernor::Mode BufferSizeGovernor::ParseMode(const std::string &mode)
+{
+    if (mode == "recommend")
+    {
+        return Mode::Recommend;
+    }
+    if (mode == "auto")
+    {
+        return Mode::Auto;
+    }
+    return Mode::Off;
+}
+
+void BufferSizeGovernor::SetConfiguration(Mode mode, float safetyMargin, uint32_t minimumBufferSize)
+{
+    std::lock_guard lock(mutex);
+    this->mode = mode;
+    this->safetyMargin = std::clamp(safetyMargin, 0.1f, 1.0f);
+    this->minimumBufferSize = std::clamp(minimumBufferSize, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+    this->enabled = mode != Mode::Off;
+    this->automatic = mode == Mode::Auto;
+}
+
+void BufferSizeGovernor::Start(uint32_t sampleRate, uint32_t bufferSize, uint32_t numberOfBuffers)
+{
+    std::lock_guard lock(mutex);
+    this->sampleRate = sampleRate == 0 ? 48000 : sampleRate;
+    this->bufferSize = bufferSize;
+    this->numberOfBuffers = numberOfBuffers;
+    silentFrames = 0;
+    ResetMeasurements_();
+}
+
+void BufferSizeGovernor::ResetMeasurements_()
+{
+    uint32_t bufferSize = std::max(this->bufferSize, (uint32_t)1);
+    warmupPeriods = (int64_t)(WARMUP_SECONDS * sampleRate / bufferSize);
+    xruns = 0;
+    for (auto &bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+BufferSizeRecommendation BufferSizeGovernor::SelectPreset(int64_t bankId, int64_t presetId)
+{
+    std::lock_guard lock(mutex);
+    PresetKey preset{bankId, presetId};
+    if (preset == this->preset)
+    {
+        return BufferSizeRecommendation();
+    }
+    if (this->preset.second != -1)
+    {
+        BufferSizeRecommendation recommendation = Evaluate_();
+        if (recommendation.IsValid())
+        {
+            presetRecommendations[this->preset] = recommendation;
+        }
+    }
+    this->preset = preset;
+    ResetMeasurements_();
+
+    auto f = presetRecommendations.find(preset);
+    if (f == presetRecommendations.end())
+    {
+        return BufferSizeRecommendation();
+    }
+    return f->second;
+}
+
+BufferSizeRecommendation BufferSizeGovernor::Evaluate()
+{
+    std::lock_guard lock(mutex);
+    return Evaluate_();
+}
+
+bool BufferSizeGovernor::IsAllowed_(uint32_t bufferSize) const
+{
+    if (bufferSize < minimumBufferSize || bufferSize > MAX_BUFFER_SIZE)
+    {
+        return false;
+    }
+    auto f = presetXrunSizes.find(preset);
+    if (f != presetXrunSizes.end() && bufferSize <= f->second)
+    {
+        return false;
+    }
+    return true;
+}
+
+BufferSizeRecommendation BufferSizeGovernor::Evaluate_()
+{
+    BufferSizeRecommendation result;
+    if (mode == Mode::Off || bufferSize == 0)
+    {
+        return result;
+    }
+
+    uint64_t total = 0;
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    result.xruns_ = xruns.load(std::memory_order_relaxed);
+    result.numberOfBuffers_ = numberOfBuffers;
+
+    if (result.xruns_ != 0)
+    {
+        uint32_t &xrunSize = presetXrunSizes[preset];
+        xrunSize = std::max(xrunSize, bufferSize);
+    }
+
+    uint64_t minPeriods = (uint64_t)(MIN_MEASUREMENT_SECONDS * sampleRate / bufferSize);
+    if (total < minPeriods && result.xruns_ == 0)
+    {
+        result.reason_ = "Measuring.";
+        return result;
+    }
+
+    // 99.9th percentile, rounded up to the bucket's upper bound.
+    uint64_t threshold = (uint64_t)std::ceil(total * 0.999);
+    uint64_t count = 0;
+    size_t bucket = 0;
+    for (; bucket < NUM_BUCKETS - 1; ++bucket)
+    {
+        count += counts[bucket];
+        if (count >= threshold)
+        {
+            break;
+        }
+    }
+    double loadP999 = (bucket + 1) * BUCKET_WIDTH;
+    result.loadP999_ = (float)loadP999;
+    result.valid_ = true;
+
+    if (result.xruns_ != 0 || loadP999 > safetyMargin)
+    {
+        uint32_t size = bufferSize * 2;
+        while (size < MAX_BUFFER_SIZE && !IsAllowed_(size))
+        {
+            size *= 2;
+        }
+        result.bufferSize_ = std::min(size, MAX_BUFFER_SIZE);
+        result.reason_ = result.xruns_ != 0 ? SS(result.xruns_ << " xruns.") : SS("Over the " << (int)(safetyMargin * 100) << "% safety margin.");
+        return result;
+    }
+
+    result.bufferSize_ = bufferSize;
+    for (uint32_t size = bufferSize / 2; size >= MIN_BUFFER_SIZE; size /= 2)
+    {
+        if (!IsAllowed_(size) || loadP999 * bufferSize / size > safetyMargin)
+        {
+            break;
+        }
+        result.bufferSize_ = size;
+    }
+    result.reason_ = result.bufferSize_ == bufferSize ? "Current size is optimal." : "Under the safety margin at the smaller size.";
+    return result;
+}
+
+JSON_MAP_BEGIN(BufferSizeRecommendation)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, valid)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, bufferSize)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, numberOfBuffers)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, loadP999)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, xruns)
+JSON_MAP_REFERENCE(BufferSizeRecommendation, reason)
+JSON_MAP_END()
@@ -0,0 +1,187 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include "json.hpp"
+
+namespace pipedal
+{
+    class BufferSizeRecommendation
+    {
+    public:
+        bool valid_ = false;
+        uint32_t bufferSize_ = 0;
+        uint32_t numberOfBuffers_ = 0;
+        float loadP999_ = 0; // 99.9th percentile period cost, as a fraction of the period, at the measured buffer size.
+        uint64_t xruns_ = 0;
+        std::string reason_;
+
+        bool IsValid() const { return valid_; }
+        uint32_t GetBufferSize() const { return bufferSize_; }
+        uint32_t GetNumberOfBuffers() const { return numberOfBuffers_; }
+
+        DECLARE_JSON_MAP(BufferSizeRecommendation);
+    };
+
+    /// @brief Recommends the smallest ALSA period size that the current preset can run at without xruns.
+    ///
+    /// The audio thread records the cost of each period in a fixed histogram (lock-free, allocation-free).
+    /// A smaller period can't cost more than a larger one, so the load at a smaller period size is at most
+    /// load * (currentSize/smallerSize). The governor steps down to the smallest size for which that bound
+    /// keeps the 99.9th percentile load under the safety margin, and steps up one size when the margin is
+    /// exceeded or xruns occur. Sizes at which a preset has produced xruns aren't recommended for that preset again.
+    class BufferSizeGovernor
+    {
+    public:
+        enum class Mode
+        {
+            Off,
+            Recommend, // report recommendations in JackHostStatus; apply on request.
+            Auto,      // apply recommendations when the preset changes.
+        };
+        static Mode ParseMode(const std::string &mode);
+
+        static constexpr uint32_t MIN_BUFFER_SIZE = 16;
+        static constexpr uint32_t MAX_BUFFER_SIZE = 2048;
+
+        void SetConfiguration(Mode mode, float safetyMargin, uint32_t minimumBufferSize);
+        Mode GetMode() const { return mode; }
+        bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+        // True if audio is restarted automatically, which is the only use of ObserveInput.
+        bool IsAutomatic() const { return automatic.load(std::memory_order_relaxed); }
+
+        // Audio has (re)started. Discards measurements.
+        void Start(uint32_t sampleRate, uint32_t bufferSize, uint32_t numberOfBuffers);
+
+        // Saves the recommendation for the outgoing preset, and starts measuring the preset. Returns the
+        // recommendation saved for the preset when it was last used (not valid if there isn't one).
+        // (Preset ids are only unique within a bank.)
+        BufferSizeRecommendation SelectPreset(int64_t bankId, int64_t presetId);
+
+        // Recommendation for the current preset, from the measurements made so far.
+        BufferSizeRecommendation Evaluate();
+
+        // True if the audio input has been quiet (near its noise floor) for at least the given time, so
+        // that audio can be restarted without interrupting the player.
+        bool IsInputIdle(double seconds) const
+        {
+            return silentFrames.load(std::memory_order_relaxed) >= (uint64_t)(seconds * sampleRate.load(std::memory_order_relaxed));
+        }
+
+        // Realtime thread only.
+        void ObservePeriod(uint32_t frames, std::chrono::steady_clock::duration cost)
+        {
+            if (warmupPeriods.load(std::memory_order_relaxed) > 0)
+            {
+                warmupPeriods.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            double periodNs = frames * 1E9 / sampleRate.load(std::memory_order_relaxed);
+            double load = std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count() / periodNs;
+            size_t bucket = (size_t)(load / BUCKET_WIDTH);
+            if (bucket >= NUM_BUCKETS)
+            {
+                bucket = NUM_BUCKETS - 1;
+            }
+            // (a locked add, so that counts can be reset from another thread.)
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+        // Realtime thread only. peak: the peak absolute value of the period's input samples.
+        void ObserveInput(uint32_t frames, float peak)
+        {
+            // track the noise floor: follow quiet periods down immediately, and rise slowly while the input
+            // stays close to the floor, so that inputs with a noise floor above SILENCE_THRESHOLD (hum, noisy
+            // pickups) can still go idle. Anything louder is playing, and holds the floor where it is.
+            float noiseFloor = this->noiseFloor.load(std::memory_order_relaxed);
+            if (peak < noiseFloor)
+            {
+                noiseFloor = std::max(peak, MIN_NOISE_FLOOR);
+            }
+            else if (peak < noiseFloor * NOISE_FLOOR_RISE_MARGIN)
+            {
+                noiseFloor = std::min(
+                    noiseFloor * (1.0f + NOISE_FLOOR_RISE_PER_SECOND * frames / sampleRate.load(std::memory_order_relaxed)),
+                    MAX_NOISE_FLOOR);
+            }
+            this->noiseFloor.store(noiseFloor, std::memory_order_relaxed);
+
+            if (peak < std::max(SILENCE_THRESHOLD, noiseFloor * NOISE_FLOOR_MARGIN))
+            {
+                silentFrames.fetch_add(frames, std::memory_order_relaxed);
+            }
+            else
+            {
+                silentFrames.store(0, std::memory_order_relaxed);
+            }
+        }
+        void ObserveXrun()
+        {
+            if (warmupPeriods.load(std::memory_order_relaxed) == 0)
+            {
+                xruns.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static constexpr double BUCKET_WIDTH = 0.01;
+        static constexpr size_t NUM_BUCKETS = 201; // the last bucket holds loads >= 2.0.
+        static constexpr double WARMUP_SECONDS = 2;
+        static constexpr double MIN_MEASUREMENT_SECONDS = 10;
+        static constexpr float SILENCE_THRESHOLD = 0.001f;         // -60 dB.
+        static constexpr float MIN_NOISE_FLOOR = SILENCE_THRESHOLD; // (anything quieter is silent anyway.)
+        static constexpr float MAX_NOISE_FLOOR = 0.01f;            // -40 dB. Louder than that is playing.
+        static constexpr float NOISE_FLOOR_MARGIN = 4.0f;          // +12 dB.
+        static constexpr float NOISE_FLOOR_RISE_MARGIN = 8.0f;     // +18 dB.
+        static constexpr float NOISE_FLOOR_RISE_PER_SECOND = 0.4f; // about +3 dB/s.
+
+        void ResetMeasurements_();
+        BufferSizeRecommendation Evaluate_();
+        bool IsAllowed_(uint32_t bufferSize) const;
+
+        std::atomic<bool> enabled = false;
+        std::atomic<bool> automatic = false;
+        std::atomic<uint32_t> sampleRate = 48000;
+        std::atomic<int64_t> warmupPeriods = 0;
+        std::atomic<uint64_t> xruns = 0;
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{};
+        std::atomic<uint64_t> silentFrames = 0;
+        std::atomic<float> noiseFloor = SILENCE_THRESHOLD;
+
+        std::mutex mutex; // protects everything below. Not used by the audio thread.
+        Mode mode = Mode::Off;
+        float safetyMargin = 0.7f;
+        uint32_t minimumBufferSize = 32;
+        uint32_t bufferSize = 0;
+        uint32_t numberOfBuffers = 0;
+        using PresetKey = std::pair<int64_t, int64_t>; // (bankId, presetId)
+        PresetKey preset{-1, -1};
+        std::map<PresetKey, BufferSizeRecommendation> presetRecommendations;
+        std::map<PresetKey, uint32_t> presetXrunSizes; // largest buffer size at which each preset produced xruns.
+    };
+}
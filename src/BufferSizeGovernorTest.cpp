@@ -0,0 +1,174 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "BufferSizeGovernor.hpp"
+#include "catch.hpp"
+
+using namespace pipedal;
+
+static void ObservePeriods(BufferSizeGovernor &governor, uint32_t sampleRate, uint32_t bufferSize, double load, double seconds)
+{
+    auto cost = std::chrono::nanoseconds((int64_t)(load * bufferSize * 1E9 / sampleRate));
+    size_t periods = (size_t)(seconds * sampleRate / bufferSize);
+    for (size_t i = 0; i < periods; ++i)
+    {
+        governor.ObservePeriod(bufferSize, cost);
+    }
+}
+
+TEST_CASE("BufferSizeGovernor", "[buffer_size_governor][Build][Dev]")
+{
+    BufferSizeGovernor governor;
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Recommend, 0.7f, 32);
+    governor.Start(48000, 128, 3);
+    REQUIRE(!governor.SelectPreset(1, 1).IsValid());
+
+    // not enough data yet.
+    ObservePeriods(governor, 48000, 128, 0.2, 5);
+    REQUIRE(!governor.Evaluate().IsValid());
+
+    // 20% at 128 is at most 42% at 64, and 84% at 32.
+    ObservePeriods(governor, 48000, 128, 0.2, 10);
+    BufferSizeRecommendation recommendation = governor.Evaluate();
+    REQUIRE(recommendation.IsValid());
+    REQUIRE(recommendation.GetBufferSize() == 64);
+    REQUIRE(recommendation.GetNumberOfBuffers() == 3);
+
+    // the recommendation is remembered when the preset changes.
+    REQUIRE(!governor.SelectPreset(1, 2).IsValid());
+    ObservePeriods(governor, 48000, 128, 0.9, 15);
+    REQUIRE(governor.Evaluate().GetBufferSize() == 256);
+    REQUIRE(governor.SelectPreset(1, 1).GetBufferSize() == 64);
+
+    // xruns step up, and the size isn't recommended again for that preset.
+    governor.Start(48000, 64, 3);
+    ObservePeriods(governor, 48000, 64, 0.2, 15);
+    governor.ObserveXrun();
+    REQUIRE(governor.Evaluate().GetBufferSize() == 128);
+    governor.Start(48000, 128, 3);
+    ObservePeriods(governor, 48000, 128, 0.1, 15);
+    REQUIRE(governor.Evaluate().GetBufferSize() == 128);
+
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Off, 0.7f, 32);
+    REQUIRE(!governor.Evaluate().IsValid());
+}
+
+TEST_CASE("BufferSizeGovernor bank switch", "[buffer_size_governor][Build][Dev]")
+{
+    // preset ids are only unique within a bank.
+    BufferSizeGovernor governor;
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Recommend, 0.7f, 32);
+    governor.Start(48000, 128, 3);
+    governor.SelectPreset(1, 1);
+    ObservePeriods(governor, 48000, 128, 0.2, 15);
+    REQUIRE(governor.Evaluate().GetBufferSize() == 64);
+
+    REQUIRE(!governor.SelectPreset(2, 1).IsValid());
+    governor.Start(48000, 64, 3);
+    ObservePeriods(governor, 48000, 64, 0.2, 15);
+    governor.ObserveXrun();
+    REQUIRE(governor.Evaluate().GetBufferSize() == 128);
+
+    // bank 1's preset keeps its own recommendation, and bank 2's xrun doesn't rule out 64.
+    REQUIRE(governor.SelectPreset(1, 1).GetBufferSize() == 64);
+    governor.Start(48000, 128, 3);
+    ObservePeriods(governor, 48000, 128, 0.2, 15);
+    REQUIRE(governor.Evaluate().GetBufferSize() == 64);
+    REQUIRE(governor.SelectPreset(2, 1).GetBufferSize() == 128);
+}
+
+TEST_CASE("BufferSizeGovernor idle input", "[buffer_size_governor][Build][Dev]")
+{
+    BufferSizeGovernor governor;
+    // input is only observed in Auto mode.
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Recommend, 0.7f, 32);
+    REQUIRE(governor.IsEnabled());
+    REQUIRE(!governor.IsAutomatic());
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Auto, 0.7f, 32);
+    REQUIRE(governor.IsAutomatic());
+    governor.Start(48000, 128, 3);
+    REQUIRE(!governor.IsInputIdle(2.0));
+
+    for (int i = 0; i < 48000 * 3 / 128; ++i)
+    {
+        governor.ObserveInput(128, 0.0001f);
+    }
+    REQUIRE(governor.IsInputIdle(2.0));
+
+    // any signal restarts the count.
+    governor.ObserveInput(128, 0.5f);
+    REQUIRE(!governor.IsInputIdle(2.0));
+    governor.ObserveInput(48000, 0.0f);
+    REQUIRE(!governor.IsInputIdle(2.0));
+    REQUIRE(governor.IsInputIdle(1.0));
+}
+
+TEST_CASE("BufferSizeGovernor noisy input", "[buffer_size_governor][Build][Dev]")
+{
+    BufferSizeGovernor governor;
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Auto, 0.7f, 32);
+    governor.Start(48000, 128, 3);
+
+    // a noise floor of about -46 dB, well above the -60 dB silence threshold.
+    uint32_t seed = 1;
+    auto noise = [&seed]()
+    {
+        seed = seed * 1664525 + 1013904223;
+        return 0.004f + 0.001f * (seed >> 8) / (float)(1 << 24);
+    };
+    for (int i = 0; i < 48000 * 5 / 128; ++i)
+    {
+        governor.ObserveInput(128, noise());
+    }
+    REQUIRE(governor.IsInputIdle(2.0));
+
+    // playing over the noise is not idle.
+    governor.ObserveInput(128, 0.05f);
+    REQUIRE(!governor.IsInputIdle(0.001));
+    for (int i = 0; i < 48000 * 3 / 128; ++i)
+    {
+        governor.ObserveInput(128, noise());
+    }
+    REQUIRE(governor.IsInputIdle(2.0));
+
+    // and sustained playing doesn't become the noise floor.
+    for (int i = 0; i < 48000 * 30 / 128; ++i)
+    {
+        governor.ObserveInput(128, 0.1f);
+    }
+    REQUIRE(!governor.IsInputIdle(0.001));
+}
+
+TEST_CASE("BufferSizeGovernor quiet playing", "[buffer_size_governor][Build][Dev]")
+{
+    BufferSizeGovernor governor;
+    governor.SetConfiguration(BufferSizeGovernor::Mode::Auto, 0.7f, 32);
+    governor.Start(48000, 128, 3);
+
+    // playing loud doesn't raise the noise floor, so a quiet passage that follows isn't idle.
+    for (int i = 0; i < 48000 * 10 / 128; ++i)
+    {
+        governor.ObserveInput(128, 0.8f);
+    }
+    for (int i = 0; i < 48000 * 3 / 128; ++i)
+    {
+        governor.ObserveInput(128, 0.03f); // about -30 dB.
+    }
+    REQUIRE(!governor.IsInputIdle(2.0));
+}
@@ -0,0 +1,222 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "ControlHandles.hpp"
+#include "Pedalboard.hpp"
+#include "Lv2Pedalboard.hpp"
+#include <utility>
+
+using namespace pipedal;
+
+namespace
+{
+    struct ItemLocation
+    {
+        PedalboardItem *item;
+        std::vector<uint32_t> path;
+    };
+
+    // (in the same order as Pedalboard::GetAllPlugins())
+    void GetItemLocations(std::vector<PedalboardItem> &items, uint32_t chain, std::vector<uint32_t> &path, std::vector<ItemLocation> &result)
+    {
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            PedalboardItem &item = items[i];
+            path.push_back(((uint32_t)i << 1) | chain);
+            if (item.isSplit())
+            {
+                GetItemLocations(item.topChain(), 0, path, result);
+                GetItemLocations(item.bottomChain(), 1, path, result);
+            }
+            result.push_back(ItemLocation{&item, path});
+            path.pop_back();
+        }
+    }
+}
+
+void ControlHandles::Rebuild(Pedalboard &pedalboard, Lv2Pedalboard *lv2Pedalboard)
+{
+    std::vector<ItemLocation> locations;
+    {
+        std::vector<uint32_t> path;
+        GetItemLocations(pedalboard.items(), 0, path, locations);
+    }
+    std::vector<Entry> newEntries;
+    for (const ItemLocation &location : locations)
+    {
+        PedalboardItem *item = location.item;
+        if (item->isEmpty())
+        {
+            continue;
+        }
+        int effectIndex = lv2Pedalboard ? lv2Pedalboard->GetIndexOfInstanceId(item->instanceId()) : -1;
+        const auto &controlValues = item->controlValues();
+        for (size_t i = 0; i < controlValues.size() && newEntries.size() < MAX_ENTRIES; ++i)
+        {
+            Entry entry;
+            entry.instanceId = item->instanceId();
+            entry.symbol = controlValues[i].key();
+            entry.controlIndex = lv2Pedalboard ? lv2Pedalboard->GetControlIndex(item->instanceId(), entry.symbol) : -1;
+            entry.effectIndex = effectIndex;
+            entry.controlValueIndex = i;
+            entry.itemPath = location.path;
+            newEntries.push_back(std::move(entry));
+        }
+    }
+
+    if (IsBuilt() && SameLayout(newEntries))
+    {
+        // keep the handles that clients already hold; the running effects may still have changed.
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            entries[i].controlIndex = newEntries[i].controlIndex;
+            entries[i].effectIndex = newEntries[i].effectIndex;
+            entries[i].controlValueIndex = newEntries[i].controlValueIndex;
+            entries[i].itemPath = std::move(newEntries[i].itemPath);
+        }
+        return;
+    }
+
+    ++generation;
+    if (generation == 0) // (wrapped)
+    {
+        generation = 1;
+    }
+    previousEntries = std::move(entries);
+    entries = std::move(newEntries);
+    index.clear();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].handle = MakeHandle(generation, i);
+        index[entries[i].instanceId][entries[i].symbol] = i;
+    }
+}
+
+bool ControlHandles::SameLayout(const std::vector<Entry> &newEntries) const
+{
+    if (newEntries.size() != entries.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (newEntries[i].instanceId != entries[i].instanceId || newEntries[i].symbol != entries[i].symbol)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const ControlHandles::Entry *ControlHandles::Find(int64_t handle) const
+{
+    if (handle < 0)
+    {
+        return nullptr;
+    }
+    if ((handle >> INDEX_BITS) > (int64_t)UINT32_MAX)
+    {
+        return nullptr;
+    }
+    uint32_t handleGeneration = (uint32_t)(handle >> INDEX_BITS);
+    size_t handleIndex = (size_t)(handle & (MAX_ENTRIES - 1));
+    if (handleGeneration == generation)
+    {
+        if (handleIndex < entries.size())
+        {
+            return &entries[handleIndex];
+        }
+        return nullptr;
+    }
+    if (handleGeneration + 1 == generation && handleIndex < previousEntries.size())
+    {
+        // issued by the previous table.
+        const Entry &previousEntry = previousEntries[handleIndex];
+        return Find(previousEntry.instanceId, previousEntry.symbol);
+    }
+    return nullptr;
+}
+
+const ControlHandles::Entry *ControlHandles::Find(int64_t instanceId, const std::string &symbol) const
+{
+    auto itemIndex = index.find(instanceId);
+    if (itemIndex == index.end())
+    {
+        return nullptr;
+    }
+    auto i = itemIndex->second.find(symbol);
+    if (i == itemIndex->second.end())
+    {
+        return nullptr;
+    }
+    return &entries[i->second];
+}
+
+PedalboardItem *ControlHandles::GetItem(Pedalboard &pedalboard, const Entry &entry)
+{
+    std::vector<PedalboardItem> *items = &pedalboard.items();
+    PedalboardItem *item = nullptr;
+    for (size_t level = 0; level < entry.itemPath.size(); ++level)
+    {
+        uint32_t step = entry.itemPath[level];
+        if (level != 0)
+        {
+            if (!item->isSplit())
+            {
+                item = nullptr;
+                break;
+            }
+            items = (step & 1) ? &item->bottomChain() : &item->topChain();
+        }
+        size_t index = step >> 1;
+        if (index >= items->size())
+        {
+            item = nullptr;
+            break;
+        }
+        item = &(*items)[index];
+    }
+    if (item && item->instanceId() == entry.instanceId)
+    {
+        return item;
+    }
+    return pedalboard.GetItem(entry.instanceId);
+}
+
+std::vector<ControlHandle> ControlHandles::GetHandles() const
+{
+    std::vector<ControlHandle> result;
+    result.reserve(entries.size());
+    for (const auto &entry : entries)
+    {
+        ControlHandle handle;
+        handle.handle_ = entry.handle;
+        handle.instanceId_ = entry.instanceId;
+        handle.symbol_ = entry.symbol;
+        result.push_back(std::move(handle));
+    }
+    return result;
+}
+
+JSON_MAP_BEGIN(ControlHandle)
+JSON_MAP_REFERENCE(ControlHandle, handle)
+JSON_MAP_REFERENCE(ControlHandle, instanceId)
+JSON_MAP_REFERENCE(ControlHandle, symbol)
+JSON_MAP_END()
@@ -0,0 +1,94 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "json.hpp"
+
+namespace pipedal
+{
+    class Pedalboard;
+    class PedalboardItem;
+    class Lv2Pedalboard;
+
+    // A numeric handle for a pedalboard control, as published to clients.
+    class ControlHandle
+    {
+    public:
+        int64_t handle_ = -1;
+        int64_t instanceId_ = -1;
+        std::string symbol_;
+
+        DECLARE_JSON_MAP(ControlHandle);
+    };
+
+    /// @brief Compact numeric handles for the controls of the current pedalboard.
+    ///
+    /// Handles are reassigned only when the set of controls changes (plugins added, removed or reordered).
+    /// The upper bits of a handle hold the generation of the table that issued it, so that messages sent
+    /// against the previous table while a new one is in flight still resolve to the right control.
+    /// Handles fit in 53 bits, so they survive a round trip through a JavaScript number.
+    class ControlHandles
+    {
+    public:
+        struct Entry
+        {
+            int64_t handle = -1;
+            int64_t instanceId = -1;
+            std::string symbol;
+            // port index of the control in the running effect, or -1 if not known.
+            int controlIndex = -1;
+            // index of the running effect in Lv2Pedalboard::GetEffects(), or -1 if not known. A hint only.
+            int effectIndex = -1;
+            // position of the control in PedalboardItem::controlValues() when the table was built. A hint only.
+            size_t controlValueIndex = 0;
+            // location of the item in the pedalboard when the table was built: (index << 1) | chain for each level,
+            // where chain selects the top (0) or bottom (1) chain of the enclosing split. A hint only.
+            std::vector<uint32_t> itemPath;
+        };
+
+        void Rebuild(Pedalboard &pedalboard, Lv2Pedalboard *lv2Pedalboard);
+        bool IsBuilt() const { return generation != 0; }
+
+        // nullptr if the handle is stale or invalid.
+        const Entry *Find(int64_t handle) const;
+        const Entry *Find(int64_t instanceId, const std::string &symbol) const;
+
+        std::vector<ControlHandle> GetHandles() const;
+
+        // The pedalboard item that owns the control, located by the entry's path if it is still valid,
+        // or by instanceId. nullptr if the item no longer exists.
+        static PedalboardItem *GetItem(Pedalboard &pedalboard, const Entry &entry);
+
+    private:
+        static constexpr int INDEX_BITS = 20;
+        static constexpr size_t MAX_ENTRIES = (size_t)1 << INDEX_BITS;
+        static int64_t MakeHandle(uint32_t generation, size_t index) { return (((int64_t)generation) << INDEX_BITS) | (int64_t)index; }
+        bool SameLayout(const std::vector<Entry> &newEntries) const;
+
+        uint32_t generation = 0;
+        std::vector<Entry> entries;
+        std::vector<Entry> previousEntries;
+        std::unordered_map<int64_t, std::unordered_map<std::string, size_t>> index;
+    };
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "catch.hpp"
+#include "ControlHandles.hpp"
+#include "Pedalboard.hpp"
+
+using namespace pipedal;
+
+static PedalboardItem MakeTestPlugin(int64_t instanceId, std::vector<ControlValue> controlValues)
+{
+    PedalboardItem item;
+    item.instanceId(instanceId);
+    item.uri("http://example.com/plugins/test");
+    item.controlValues(std::move(controlValues));
+    return item;
+}
+
+TEST_CASE("ControlHandles", "[control_handles][Build][Dev]")
+{
+    Pedalboard pedalboard;
+    pedalboard.items().push_back(MakeTestPlugin(100, {ControlValue("gain", 1), ControlValue("tone", 0.5f)}));
+    pedalboard.items().push_back(pedalboard.MakeEmptyItem()); // empty items have no handles.
+    PedalboardItem split = pedalboard.MakeSplit();
+    split.topChain()[0] = MakeTestPlugin(200, {ControlValue("level", 0)});
+    pedalboard.items().push_back(split);
+
+    ControlHandles controlHandles;
+    REQUIRE(!controlHandles.IsBuilt());
+    controlHandles.Rebuild(pedalboard, nullptr);
+    REQUIRE(controlHandles.IsBuilt());
+
+    // one handle per control of each plugin, including split controls and plugins inside splits.
+    std::vector<ControlHandle> handles = controlHandles.GetHandles();
+    REQUIRE(handles.size() == 2 + split.controlValues().size() + 1);
+    for (const auto &handle : handles)
+    {
+        const ControlHandles::Entry *entry = controlHandles.Find(handle.handle_);
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->handle == handle.handle_);
+        REQUIRE(entry->instanceId == handle.instanceId_);
+        REQUIRE(entry->symbol == handle.symbol_);
+        REQUIRE(entry->controlIndex == -1); // no running pedalboard.
+        REQUIRE(controlHandles.Find(handle.instanceId_, handle.symbol_) == entry);
+    }
+
+    const ControlHandles::Entry *tone = controlHandles.Find(100, "tone");
+    REQUIRE(tone != nullptr);
+    REQUIRE(tone->controlValueIndex == 1);
+    const ControlHandles::Entry *level = controlHandles.Find(200, "level");
+    REQUIRE(level != nullptr);
+    REQUIRE(level->controlValueIndex == 0);
+
+    // items are located by path, and by instanceId once the path is out of date.
+    REQUIRE(tone->effectIndex == -1); // no running pedalboard.
+    REQUIRE(ControlHandles::GetItem(pedalboard, *tone) == &pedalboard.items()[0]);
+    REQUIRE(level->itemPath.size() == 2);
+    REQUIRE(ControlHandles::GetItem(pedalboard, *level) == &pedalboard.items()[2].topChain()[0]);
+    {
+        ControlHandles::Entry moved = *level;
+        moved.itemPath = {0};
+        REQUIRE(ControlHandles::GetItem(pedalboard, moved) == &pedalboard.items()[2].topChain()[0]);
+        moved.itemPath = {(2 << 1), (5 << 1) | 1};
+        REQUIRE(ControlHandles::GetItem(pedalboard, moved) == &pedalboard.items()[2].topChain()[0]);
+        moved.instanceId = 999;
+        REQUIRE(ControlHandles::GetItem(pedalboard, moved) == nullptr);
+    }
+
+    REQUIRE(controlHandles.Find(100, "missing") == nullptr);
+    REQUIRE(controlHandles.Find(999, "gain") == nullptr);
+    REQUIRE(controlHandles.Find(-1) == nullptr);
+    REQUIRE(controlHandles.Find(tone->handle + 1000) == nullptr);
+
+    // handles issued by the previous table still resolve, by (instanceId, symbol), after a rebuild.
+    int64_t oldToneHandle = tone->handle;
+    pedalboard.items().erase(pedalboard.items().begin()); // controls of later plugins move.
+    pedalboard.items().push_back(MakeTestPlugin(100, {ControlValue("tone", 0.5f)}));
+    controlHandles.Rebuild(pedalboard, nullptr);
+
+    const ControlHandles::Entry *rebuiltTone = controlHandles.Find(oldToneHandle);
+    REQUIRE(rebuiltTone != nullptr);
+    REQUIRE(rebuiltTone->instanceId == 100);
+    REQUIRE(rebuiltTone->symbol == "tone");
+    REQUIRE(rebuiltTone->handle != oldToneHandle);
+    REQUIRE(controlHandles.Find(100, "gain") == nullptr);
+
+    // rebuilding with the same controls keeps the current handles (and the previous table).
+    int64_t toneHandle = rebuiltTone->handle;
+    controlHandles.Rebuild(pedalboard, nullptr);
+    REQUIRE(controlHandles.Find(100, "tone")->handle == toneHandle);
+    REQUIRE(controlHandles.Find(toneHandle) == controlHandles.Find(100, "tone"));
+    REQUIRE(controlHandles.Find(oldToneHandle) == controlHandles.Find(100, "tone"));
+
+    // but a handle two layouts old no longer resolves.
+    pedalboard.items().push_back(MakeTestPlugin(300, {ControlValue("mix", 1)}));
+    controlHandles.Rebuild(pedalboard, nullptr);
+    REQUIRE(controlHandles.Find(oldToneHandle) == nullptr);
+    REQUIRE(controlHandles.Find(toneHandle) != nullptr);
+
+    // handles must survive a round trip through a javascript number.
+    constexpr int64_t MAX_SAFE_INTEGER = (1LL << 53) - 1;
+    for (const auto &handle : controlHandles.GetHandles())
+    {
+        REQUIRE(handle.handle_ <= MAX_SAFE_INTEGER);
+    }
+    REQUIRE(controlHandles.Find(MAX_SAFE_INTEGER) == nullptr);
+    REQUIRE(controlHandles.Find(INT64_MAX) == nullptr);
+}
+
+TEST_CASE("ControlHandles generation limit", "[control_handles][Build][Dev]")
+{
+    Pedalboard pedalboard;
+    ControlHandles controlHandles;
+    // far more layout changes than a 32-bit shift would allow before exceeding 2^53.
+    for (int64_t i = 0; i < 3000000; ++i)
+    {
+        pedalboard.items().clear();
+        pedalboard.items().push_back(MakeTestPlugin(100 + (i & 1), {ControlValue("gain", 1)}));
+        controlHandles.Rebuild(pedalboard, nullptr);
+    }
+    const ControlHandles::Entry *gain = controlHandles.Find(100 + (2999999 & 1), "gain");
+    REQUIRE(gain != nullptr);
+    REQUIRE(gain->handle <= (1LL << 53) - 1);
+    REQUIRE(controlHandles.Find(gain->handle) == gain);
+}
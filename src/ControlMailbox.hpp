@@ -0,0 +1,135 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace pipedal
+{
+    /// <summary>
+    /// Latest-value-wins control updates from non-realtime threads to the audio thread.
+    /// </summary>
+    /// <remarks>
+    /// Each (effect, control) pair has a preallocated value slot and a bit in a dirty bitset.
+    /// Writers overwrite the slot and set the bit; the audio thread applies each dirty control
+    /// once per period, however many times it was written. Neither side blocks or allocates
+    /// after Initialize().
+    /// </remarks>
+    class ControlMailbox
+    {
+    public:
+        // Non-realtime. controlCounts[i] is the number of controls of effect i.
+        void Initialize(const std::vector<size_t> &controlCounts)
+        {
+            effectOffsets.resize(controlCounts.size() + 1);
+            size_t nSlots = 0;
+            for (size_t i = 0; i < controlCounts.size(); ++i)
+            {
+                effectOffsets[i] = nSlots;
+                nSlots += controlCounts[i];
+            }
+            effectOffsets[controlCounts.size()] = nSlots;
+
+            slotAddresses.resize(nSlots);
+            for (size_t i = 0; i < controlCounts.size(); ++i)
+            {
+                for (size_t j = 0; j < controlCounts[i]; ++j)
+                {
+                    slotAddresses[effectOffsets[i] + j] = SlotAddress{(uint32_t)i, (uint32_t)j};
+                }
+            }
+            values = std::make_unique<std::atomic<float>[]>(nSlots);
+            nDirtyWords = (nSlots + 63) / 64;
+            dirty = std::make_unique<std::atomic<uint64_t>[]>(nDirtyWords);
+            for (size_t i = 0; i < nSlots; ++i)
+            {
+                values[i].store(0, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < nDirtyWords; ++i)
+            {
+                dirty[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Any thread. Returns false if the control does not exist.
+        bool Set(int effectIndex, int controlIndex, float value)
+        {
+            if (effectIndex < 0 || (size_t)effectIndex + 1 >= effectOffsets.size() || controlIndex < 0)
+            {
+                return false;
+            }
+            size_t slot = effectOffsets[effectIndex] + (size_t)controlIndex;
+            if (slot >= effectOffsets[effectIndex + 1])
+            {
+                return false;
+            }
+            values[slot].store(value, std::memory_order_relaxed);
+            dirty[slot / 64].fetch_or(uint64_t(1) << (slot % 64), std::memory_order_release);
+            return true;
+        }
+
+        // Any thread. Drop pending updates (e.g. because a snapshot that supersedes them is about to be sent).
+        void Discard()
+        {
+            for (size_t i = 0; i < nDirtyWords; ++i)
+            {
+                dirty[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Audio thread. Calls fn(effectIndex, controlIndex, value) for each dirty control.
+        template <typename FN>
+        void Apply(FN &&fn)
+        {
+            for (size_t i = 0; i < nDirtyWords; ++i)
+            {
+                if (dirty[i].load(std::memory_order_relaxed) == 0)
+                {
+                    continue;
+                }
+                uint64_t bits = dirty[i].exchange(0, std::memory_order_acquire);
+                while (bits != 0)
+                {
+                    int bit = __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    size_t slot = i * 64 + bit;
+                    const SlotAddress &address = slotAddresses[slot];
+                    fn((int)address.effectIndex, (int)address.controlIndex, values[slot].load(std::memory_order_relaxed));
+                }
+            }
+        }
+
+    private:
+        struct SlotAddress
+        {
+            uint32_t effectIndex;
+            uint32_t controlIndex;
+        };
+        std::vector<size_t> effectOffsets;
+        std::vector<SlotAddress> slotAddresses;
+        std::unique_ptr<std::atomic<float>[]> values;
+        std::unique_ptr<std::atomic<uint64_t>[]> dirty;
+        size_t nDirtyWords = 0;
+    };
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "ControlMailbox.hpp"
+#include "catch.hpp"
+#include <thread>
+#include <vector>
+
+using namespace pipedal;
+
+namespace
+{
+    struct Update
+    {
+        int effectIndex;
+        int controlIndex;
+        float value;
+    };
+    std::vector<Update> Drain(ControlMailbox &mailbox)
+    {
+        std::vector<Update> result;
+        mailbox.Apply(
+            [&result](int effectIndex, int controlIndex, float value)
+            {
+                result.push_back(Update{effectIndex, controlIndex, value});
+            });
+        return result;
+    }
+}
+
+TEST_CASE("ControlMailbox", "[control_mailbox][Build][Dev]")
+{
+    {
+        ControlMailbox mailbox;
+        mailbox.Initialize({3, 0, 70});
+
+        REQUIRE(Drain(mailbox).size() == 0);
+
+        // bounds.
+        REQUIRE(!mailbox.Set(-1, 0, 1.0f));
+        REQUIRE(!mailbox.Set(3, 0, 1.0f));
+        REQUIRE(!mailbox.Set(0, 3, 1.0f));
+        REQUIRE(!mailbox.Set(1, 0, 1.0f));
+        REQUIRE(!mailbox.Set(0, -1, 1.0f));
+        REQUIRE(Drain(mailbox).size() == 0);
+
+        // latest value wins; each control is applied once.
+        REQUIRE(mailbox.Set(0, 1, 1.0f));
+        REQUIRE(mailbox.Set(0, 1, 2.0f));
+        REQUIRE(mailbox.Set(2, 69, 3.0f)); // second dirty word.
+        REQUIRE(mailbox.Set(2, 0, 4.0f));
+
+        auto updates = Drain(mailbox);
+        REQUIRE(updates.size() == 3);
+        REQUIRE(updates[0].effectIndex == 0);
+        REQUIRE(updates[0].controlIndex == 1);
+        REQUIRE(updates[0].value == 2.0f);
+        REQUIRE(updates[1].effectIndex == 2);
+        REQUIRE(updates[1].controlIndex == 0);
+        REQUIRE(updates[1].value == 4.0f);
+        REQUIRE(updates[2].effectIndex == 2);
+        REQUIRE(updates[2].controlIndex == 69);
+        REQUIRE(updates[2].value == 3.0f);
+
+        REQUIRE(Drain(mailbox).size() == 0);
+
+        // discard.
+        REQUIRE(mailbox.Set(0, 0, 5.0f));
+        mailbox.Discard();
+        REQUIRE(Drain(mailbox).size() == 0);
+    }
+    {
+        // writer and audio thread on separate threads: the last value written is always delivered.
+        constexpr int N = 100000;
+        ControlMailbox mailbox;
+        mailbox.Initialize({4});
+        std::atomic<bool> done{false};
+        std::thread writer(
+            [&]()
+            {
+                for (int i = 1; i <= N; ++i)
+                {
+                    mailbox.Set(0, i % 4, (float)i);
+                }
+                done = true;
+            });
+        float lastValue[4] = {0, 0, 0, 0};
+        auto apply = [&](int effectIndex, int controlIndex, float value)
+        {
+            REQUIRE(value >= lastValue[controlIndex]);
+            lastValue[controlIndex] = value;
+        };
+        while (!done)
+        {
+            mailbox.Apply(apply);
+        }
+        writer.join();
+        mailbox.Apply(apply);
+        for (int i = 0; i < 4; ++i)
+        {
+            int expected = N;
+            while (expected % 4 != i)
+            {
+                --expected;
+            }
+            REQUIRE(lastValue[i] == (float)expected);
+        }
+    }
+}
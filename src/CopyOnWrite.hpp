@@ -0,0 +1,107 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+
+#include <memory>
+#include "json.hpp"
+
+namespace pipedal
+{
+    /// @brief A value that is shared between copies until one of them is modified.
+    ///
+    /// Copying is a reference-count increment; mutate() copies the value first if it is
+    /// shared. Values that have never been modified (or were copied from one another) can be
+    /// compared by identity, which makes diffing unchanged settings nearly free.
+    ///
+    /// Not thread-safe: as with the value it replaces, a CopyOnWrite must not be copied on one
+    /// thread while it is being modified on another.
+    template <typename T>
+    class CopyOnWrite : public JsonSerializable
+    {
+    public:
+        CopyOnWrite()
+            : value(Empty())
+        {
+        }
+        CopyOnWrite(const T &value)
+            : value(std::make_shared<T>(value))
+        {
+        }
+        CopyOnWrite(T &&value)
+            : value(std::make_shared<T>(std::move(value)))
+        {
+        }
+        CopyOnWrite &operator=(const T &value)
+        {
+            this->value = std::make_shared<T>(value);
+            return *this;
+        }
+        CopyOnWrite &operator=(T &&value)
+        {
+            this->value = std::make_shared<T>(std::move(value));
+            return *this;
+        }
+
+        const T &get() const { return *value; }
+        const T &operator*() const { return *value; }
+        const T *operator->() const { return value.get(); }
+
+        // Returns a modifiable reference, copying the value if it is shared.
+        // The reference is invalidated when this object is copied.
+        T &mutate()
+        {
+            if (value.use_count() != 1)
+            {
+                value = std::make_shared<T>(*value);
+            }
+            return const_cast<T &>(*value);
+        }
+
+        bool SharesValueWith(const CopyOnWrite &other) const { return value == other.value; }
+
+        bool operator==(const CopyOnWrite &other) const
+        {
+            return value == other.value || *value == *other.value;
+        }
+        bool operator!=(const CopyOnWrite &other) const { return !(*this == other); }
+
+    private:
+        // every default-constructed instance shares a single empty value.
+        static const std::shared_ptr<const T> &Empty()
+        {
+            static const std::shared_ptr<const T> empty = std::make_shared<T>();
+            return empty;
+        }
+
+        virtual void write_json(json_writer &writer) const
+        {
+            writer.write(*value);
+        }
+        virtual void read_json(json_reader &reader)
+        {
+            T newValue;
+            reader.read(&newValue);
+            this->value = std::make_shared<T>(std::move(newValue));
+        }
+
+        std::shared_ptr<const T> value;
+    };
+}
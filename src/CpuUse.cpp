@@ -23,6 +23,7 @@
  */
 
 #include "CpuUse.hpp"
+#include "Metrics.hpp"
 
 using namespace pipedal;
 using namespace std;
@@ -35,4 +36,9 @@ CpuUse::CpuUseAverager::CpuUseAverager()
         samples[i] = 0;
     }
     sampleTotal = 0;
-}
\ No newline at end of file
+}
+
+void CpuUse::AddMetricsSample(ProfileCategory category, DurationT duration)
+{
+    Metrics::Instance().AddCpuTime(category, duration);
+}
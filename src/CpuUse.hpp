@@ -96,6 +96,8 @@ namespace pipedal
         CpuUseAverager &GetCategory(ProfileCategory category) {
             return profileTimes[(size_t)category];
         }
+        // cumulative totals for the /metrics endpoint.
+        static void AddMetricsSample(ProfileCategory category, DurationT duration);
         
     public:
 
@@ -109,6 +111,7 @@ namespace pipedal
         void AddSample(ProfileCategory category, TimeT time)
         {
             profileTimes[(size_t)category].AddSample((time-lastSample));
+            AddMetricsSample(category, time-lastSample);
             lastSample = time;
         }
         void AddSample(ProfileCategory category) 
@@ -118,6 +121,7 @@ namespace pipedal
         void AddSample(ProfileCategory category, TimeT startTime, TimeT endTime)
         {
             profileTimes[(size_t)category].AddSample((endTime-startTime));
+            AddMetricsSample(category, endTime-startTime);
         }
 
         void UpdateCpuUse() {
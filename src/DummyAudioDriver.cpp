@@ -46,6 +46,12 @@
 #include "Lv2Log.hpp"
 #include <limits>
 #include "ss.hpp"
+#include <cmath>
+#include <array>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string.h>
 
 #undef ALSADRIVER_CONFIG_DBG
 
@@ -63,6 +69,210 @@ namespace pipedal
         throw PiPedalStateException(message);
     }
 
+    static std::mutex dummyDriverMutex;
+    static std::condition_variable dummyDriverCv;
+    static DummyAudioDriverOptions dummyDriverOptions;
+
+    // Raw statistics, published by the audio thread through a seqlock so that publishing
+    // never blocks or allocates. Readers retry if they overlap a publication.
+    struct PublishedDummyStats
+    {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<DummyAudioClock> clock{DummyAudioClock::Sleep};
+        std::atomic<uint32_t> sampleRate{0};
+        std::atomic<uint32_t> bufferSize{0};
+        std::atomic<uint64_t> periods{0};
+        std::atomic<double> wallTimeSeconds{0};
+        std::atomic<uint64_t> deadlineMisses{0};
+        std::atomic<double> totalLatency{0};
+        std::atomic<double> minLatency{0};
+        std::atomic<double> maxLatency{0};
+        std::atomic<bool> complete{false};
+        std::array<std::atomic<uint64_t>, DummyAudioDriverStats::HISTOGRAM_BUCKETS> histogram{};
+    };
+    static PublishedDummyStats publishedStats;
+
+    static void BeginPublishStats()
+    {
+        // odd sequence numbers mark a publication in progress.
+        while (true)
+        {
+            uint32_t sequence = publishedStats.sequence.load(std::memory_order_relaxed);
+            if ((sequence & 1) == 0 &&
+                publishedStats.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    static void EndPublishStats()
+    {
+        publishedStats.sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    static const char *ClockName(DummyAudioClock clock)
+    {
+        switch (clock)
+        {
+        case DummyAudioClock::Freewheel:
+            return "freewheel";
+        case DummyAudioClock::Deterministic:
+            return "deterministic";
+        case DummyAudioClock::Sleep:
+        default:
+            return "sleep";
+        }
+    }
+
+    static uint16_t ReadLe16(const uint8_t *p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+    static uint32_t ReadLe32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    // Load a PCM (16, 24 or 32-bit) or 32-bit float WAV file as deinterleaved channels.
+    static std::vector<std::vector<float>> LoadWavFile(const std::filesystem::path &path, uint32_t sampleRate)
+    {
+        std::ifstream f(path, std::ios_base::binary);
+        if (!f.is_open())
+        {
+            throw PiPedalException(SS("Can't open " << path));
+        }
+        uint8_t header[12];
+        if (!f.read((char *)header, sizeof(header)) || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+        {
+            throw PiPedalException(SS("Not a WAV file: " << path));
+        }
+        uint16_t format = 0, channels = 0, bitsPerSample = 0;
+        uint32_t fileSampleRate = 0;
+        while (true)
+        {
+            uint8_t chunkHeader[8];
+            if (!f.read((char *)chunkHeader, sizeof(chunkHeader)))
+            {
+                throw PiPedalException(SS("No audio data: " << path));
+            }
+            uint32_t chunkSize = ReadLe32(chunkHeader + 4);
+            if (memcmp(chunkHeader, "fmt ", 4) == 0)
+            {
+                uint8_t fmt[16];
+                if (chunkSize < sizeof(fmt) || !f.read((char *)fmt, sizeof(fmt)))
+                {
+                    throw PiPedalException(SS("Invalid WAV file: " << path));
+                }
+                format = ReadLe16(fmt);
+                channels = ReadLe16(fmt + 2);
+                fileSampleRate = ReadLe32(fmt + 4);
+                bitsPerSample = ReadLe16(fmt + 14);
+                if (format == 0xFFFE && chunkSize >= 26) // WAVE_FORMAT_EXTENSIBLE: the subformat starts with the format tag.
+                {
+                    uint8_t extension[10];
+                    if (!f.read((char *)extension, sizeof(extension)))
+                    {
+                        throw PiPedalException(SS("Invalid WAV file: " << path));
+                    }
+                    format = ReadLe16(extension + 8);
+                    f.seekg(chunkSize - sizeof(fmt) - sizeof(extension) + (chunkSize & 1), std::ios_base::cur);
+                }
+                else
+                {
+                    f.seekg(chunkSize - sizeof(fmt) + (chunkSize & 1), std::ios_base::cur);
+                }
+            }
+            else if (memcmp(chunkHeader, "data", 4) == 0)
+            {
+                bool isFloat = format == 3 && bitsPerSample == 32;
+                bool isPcm = format == 1 && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32);
+                if (channels == 0 || (!isFloat && !isPcm))
+                {
+                    throw PiPedalException(SS("Unsupported WAV format: " << path));
+                }
+                if (fileSampleRate != sampleRate)
+                {
+                    Lv2Log::warning(SS("Dummy audio input " << path << " has a sample rate of " << fileSampleRate << ". Playing at " << sampleRate << " without resampling."));
+                }
+                size_t bytesPerSample = bitsPerSample / 8;
+                size_t frameSize = bytesPerSample * channels;
+                std::vector<uint8_t> data(chunkSize);
+                f.read((char *)data.data(), chunkSize);
+                size_t frames = (size_t)f.gcount() / frameSize;
+                if (frames == 0)
+                {
+                    throw PiPedalException(SS("No audio data: " << path));
+                }
+
+                std::vector<std::vector<float>> result(channels);
+                for (auto &channel : result)
+                {
+                    channel.resize(frames);
+                }
+                const uint8_t *p = data.data();
+                for (size_t i = 0; i < frames; ++i)
+                {
+                    for (size_t c = 0; c < channels; ++c)
+                    {
+                        float value;
+                        if (isFloat)
+                        {
+                            uint32_t bits = ReadLe32(p);
+                            memcpy(&value, &bits, sizeof(value));
+                        }
+                        else if (bitsPerSample == 16)
+                        {
+                            value = (int16_t)ReadLe16(p) * (1.0f / 32768.0f);
+                        }
+                        else if (bitsPerSample == 24)
+                        {
+                            int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+                            value = v * (1.0f / 8388608.0f);
+                        }
+                        else
+                        {
+                            value = (float)((int32_t)ReadLe32(p) * (1.0 / 2147483648.0));
+                        }
+                        result[c][i] = value;
+                        p += bytesPerSample;
+                    }
+                }
+                return result;
+            }
+            else
+            {
+                f.seekg(chunkSize + (chunkSize & 1), std::ios_base::cur);
+            }
+        }
+    }
+
+    // A repeating 110Hz pluck with low-level noise. Identical on every run.
+    static std::vector<std::vector<float>> MakeSyntheticSignal(uint32_t sampleRate)
+    {
+        constexpr double FREQUENCY = 110.0;
+        constexpr int HARMONICS = 6;
+
+        size_t noteLength = sampleRate / 2;
+        std::vector<float> signal(noteLength * 4);
+        uint32_t seed = 0x1234567;
+        for (size_t i = 0; i < signal.size(); ++i)
+        {
+            double t = (double)(i % noteLength) / sampleRate;
+            double value = 0;
+            for (int h = 1; h <= HARMONICS; ++h)
+            {
+                value += std::sin(2 * M_PI * FREQUENCY * h * t) / h;
+            }
+            value *= 0.25 * std::exp(-6 * t);
+
+            seed = seed * 1664525 + 1013904223;
+            double noise = ((seed >> 8) * (1.0 / (1 << 24)) - 0.5) * 0.002;
+            signal[i] = (float)(value + noise);
+        }
+        return std::vector<std::vector<float>>{signal};
+    }
+
 
     class DummyDriverImpl : public AudioDriver
     {
@@ -96,6 +306,29 @@ namespace pipedal
         AudioDriverHost *driverHost = nullptr;
         uint32_t channels = 2;
 
+        DummyAudioDriverOptions options;
+
+        std::vector<std::vector<float>> inputSignal;
+        size_t inputPosition = 0;
+
+        static constexpr size_t MAX_SYNTHETIC_MIDI_EVENTS = 2;
+        MidiEvent midiEvents[MAX_SYNTHETIC_MIDI_EVENTS];
+        uint8_t midiData[MAX_SYNTHETIC_MIDI_EVENTS][3];
+        size_t midiEventCount = 0;
+        bool midiNoteOn = false;
+
+        using Clock = std::chrono::steady_clock;
+
+        // statistics, owned by the audio thread until published.
+        Clock::time_point statsStartTime;
+        Clock::duration periodDuration;
+        uint64_t statsPeriods = 0;
+        uint64_t statsDeadlineMisses = 0;
+        double statsTotalLatency = 0;
+        double statsMinLatency = 0;
+        double statsMaxLatency = 0;
+        std::array<uint64_t, DummyAudioDriverStats::HISTOGRAM_BUCKETS> statsHistogram{};
+
     public:
         DummyDriverImpl(AudioDriverHost *driverHost,const std::string&deviceName)
             : driverHost(driverHost)
@@ -103,7 +336,16 @@ namespace pipedal
         {
             captureChannels = channels;
             playbackChannels = channels;
-
+            {
+                std::lock_guard lock{dummyDriverMutex};
+                this->options = dummyDriverOptions;
+            }
+            for (size_t i = 0; i < MAX_SYNTHETIC_MIDI_EVENTS; ++i)
+            {
+                midiEvents[i].time = 0;
+                midiEvents[i].size = 3;
+                midiEvents[i].buffer = midiData[i];
+            }
         }
         virtual ~DummyDriverImpl()
         {
@@ -159,10 +401,10 @@ namespace pipedal
         }
 
         virtual size_t GetMidiInputEventCount() override {
-            return 0;
+            return midiEventCount;
         }
         virtual MidiEvent*GetMidiEvents() {
-            return nullptr;
+            return midiEventCount == 0 ? nullptr: midiEvents;
         }
 
 
@@ -211,7 +453,139 @@ namespace pipedal
             this->bufferSize = jackServerSettings.GetBufferSize();
             AllocateBuffers(captureBuffers, channels);
             AllocateBuffers(playbackBuffers, channels);
-     
+
+            inputSignal.clear();
+            inputPosition = 0;
+            if (!options.inputFile.empty())
+            {
+                inputSignal = LoadWavFile(options.inputFile, this->sampleRate);
+            }
+            else if (options.clock != DummyAudioClock::Sleep)
+            {
+                inputSignal = MakeSyntheticSignal(this->sampleRate);
+            }
+        }
+
+        void FillInputBuffers()
+        {
+            if (inputSignal.empty())
+            {
+                return;
+            }
+            size_t length = inputSignal[0].size();
+            for (size_t c = 0; c < captureBuffers.size(); ++c)
+            {
+                const std::vector<float> &source = inputSignal[c % inputSignal.size()];
+                float *output = captureBuffers[c];
+                size_t position = inputPosition;
+                size_t remaining = this->bufferSize;
+                while (remaining != 0)
+                {
+                    size_t n = std::min(remaining, length - position);
+                    std::copy(source.begin() + position, source.begin() + position + n, output);
+                    output += n;
+                    remaining -= n;
+                    position += n;
+                    if (position == length)
+                    {
+                        position = 0;
+                    }
+                }
+            }
+            inputPosition = (inputPosition + this->bufferSize) % length;
+        }
+
+        void FillMidiEvents(uint64_t period)
+        {
+            midiEventCount = 0;
+            if (!options.syntheticMidi)
+            {
+                return;
+            }
+            // CC1 triangle sweep, one event per period.
+            uint8_t value = (uint8_t)(period % 254);
+            if (value > 127)
+            {
+                value = 254 - value;
+            }
+            uint8_t *cc = midiData[midiEventCount];
+            cc[0] = 0xB0;
+            cc[1] = 1;
+            cc[2] = value;
+            midiEvents[midiEventCount++].time = 0;
+
+            // Toggle note E4 four times a second.
+            uint64_t notePeriods = std::max((uint64_t)1, (uint64_t)(this->sampleRate / 4 / this->bufferSize));
+            if (period % notePeriods == 0)
+            {
+                midiNoteOn = !midiNoteOn;
+                uint8_t *note = midiData[midiEventCount];
+                note[0] = midiNoteOn ? 0x90 : 0x80;
+                note[1] = 64;
+                note[2] = midiNoteOn ? 100 : 0;
+                midiEvents[midiEventCount++].time = this->bufferSize / 2;
+            }
+        }
+
+        void ResetStats()
+        {
+            statsStartTime = Clock::now();
+            periodDuration = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((double)this->bufferSize / this->sampleRate));
+            statsPeriods = 0;
+            statsDeadlineMisses = 0;
+            statsTotalLatency = 0;
+            statsMinLatency = std::numeric_limits<double>::max();
+            statsMaxLatency = 0;
+            statsHistogram.fill(0);
+            PublishStats(false);
+        }
+
+        void RecordPeriod(Clock::duration latency)
+        {
+            double seconds = std::chrono::duration<double>(latency).count();
+            ++statsPeriods;
+            statsTotalLatency += seconds;
+            statsMinLatency = std::min(statsMinLatency, seconds);
+            statsMaxLatency = std::max(statsMaxLatency, seconds);
+            if (latency > periodDuration)
+            {
+                ++statsDeadlineMisses;
+            }
+            size_t bucket = (size_t)(seconds * 100 / std::chrono::duration<double>(periodDuration).count());
+            if (bucket >= statsHistogram.size())
+            {
+                bucket = statsHistogram.size() - 1;
+            }
+            ++statsHistogram[bucket];
+        }
+
+        void PublishStats(bool complete)
+        {
+            // called on the audio thread. No locks, no allocations.
+            BeginPublishStats();
+            publishedStats.clock.store(options.clock, std::memory_order_relaxed);
+            publishedStats.sampleRate.store(this->sampleRate, std::memory_order_relaxed);
+            publishedStats.bufferSize.store(this->bufferSize, std::memory_order_relaxed);
+            publishedStats.periods.store(statsPeriods, std::memory_order_relaxed);
+            publishedStats.wallTimeSeconds.store(std::chrono::duration<double>(Clock::now() - statsStartTime).count(), std::memory_order_relaxed);
+            publishedStats.deadlineMisses.store(statsDeadlineMisses, std::memory_order_relaxed);
+            publishedStats.totalLatency.store(statsTotalLatency, std::memory_order_relaxed);
+            publishedStats.minLatency.store(statsMinLatency, std::memory_order_relaxed);
+            publishedStats.maxLatency.store(statsMaxLatency, std::memory_order_relaxed);
+            publishedStats.complete.store(complete, std::memory_order_relaxed);
+            for (size_t i = 0; i < statsHistogram.size(); ++i)
+            {
+                publishedStats.histogram[i].store(statsHistogram[i], std::memory_order_relaxed);
+            }
+            EndPublishStats();
+
+            if (complete)
+            {
+                // The measured run is over, so taking the lock here doesn't disturb the results.
+                std::lock_guard lock{dummyDriverMutex};
+                dummyDriverCv.notify_all();
+            }
         }
 
         std::jthread *audioThread;
@@ -227,7 +601,10 @@ namespace pipedal
 
                 SetThreadPriority(SchedulerPriority::RealtimeAudio);
 
-                bool ok = true;
+                DummyAudioClock clockMode = options.clock;
+                uint64_t period = 0;
+                ResetStats();
+                Clock::time_point periodStart = Clock::now();
 
                 while (true)
                 {
@@ -236,13 +613,52 @@ namespace pipedal
                         break;
                     }
 
-                    ssize_t framesRead = this->bufferSize;
-                    this->driverHost->OnProcess(framesRead);
+                    FillInputBuffers();
+                    FillMidiEvents(period++);
+
+                    if (clockMode == DummyAudioClock::Sleep)
+                    {
+                        this->driverHost->OnProcess(this->bufferSize);
+
+                        /// no attempt at realtime. Just as long as we run occasionally.
+                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                        continue;
+                    }
+
+                    if (clockMode == DummyAudioClock::Deterministic)
+                    {
+                        std::this_thread::sleep_until(periodStart);
+                    }
+                    else
+                    {
+                        periodStart = Clock::now();
+                    }
+
+                    this->driverHost->OnProcess(this->bufferSize);
 
-                    /// no attempt at realtime. Just as long as we run occasionally.
-                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    Clock::time_point now = Clock::now();
+                    RecordPeriod(now - periodStart);
 
+                    periodStart += periodDuration;
+                    if (now > periodStart)
+                    {
+                        // missed the deadline. Restart the period clock, as a real device would after an xrun.
+                        periodStart = now;
+                    }
 
+                    if (options.maxPeriods != 0 && statsPeriods >= options.maxPeriods)
+                    {
+                        PublishStats(true);
+                        clockMode = DummyAudioClock::Sleep;
+                    }
+                    else if ((statsPeriods & 0xFF) == 0)
+                    {
+                        PublishStats(false);
+                    }
+                }
+                if (clockMode != DummyAudioClock::Sleep)
+                {
+                    PublishStats(true);
                 }
             }
             catch (const std::exception &e)
@@ -408,6 +824,106 @@ namespace pipedal
         return new DummyDriverImpl(driverHost,deviceName);
     }
 
+    void SetDummyAudioDriverOptions(const DummyAudioDriverOptions &options)
+    {
+        std::lock_guard lock{dummyDriverMutex};
+        dummyDriverOptions = options;
+
+        BeginPublishStats();
+        publishedStats.clock.store(options.clock, std::memory_order_relaxed);
+        publishedStats.sampleRate.store(0, std::memory_order_relaxed);
+        publishedStats.bufferSize.store(0, std::memory_order_relaxed);
+        publishedStats.periods.store(0, std::memory_order_relaxed);
+        publishedStats.wallTimeSeconds.store(0, std::memory_order_relaxed);
+        publishedStats.deadlineMisses.store(0, std::memory_order_relaxed);
+        publishedStats.totalLatency.store(0, std::memory_order_relaxed);
+        publishedStats.minLatency.store(0, std::memory_order_relaxed);
+        publishedStats.maxLatency.store(0, std::memory_order_relaxed);
+        publishedStats.complete.store(false, std::memory_order_relaxed);
+        for (auto &bucket : publishedStats.histogram)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        EndPublishStats();
+    }
+
+    static double LatencyPercentile(const DummyAudioDriverStats &stats, double fraction)
+    {
+        double periodSeconds = (double)stats.bufferSize_ / stats.sampleRate_;
+        uint64_t target = (uint64_t)std::ceil(stats.periods_ * fraction);
+        uint64_t total = 0;
+        for (size_t i = 0; i < stats.latencyHistogram_.size() - 1; ++i)
+        {
+            total += stats.latencyHistogram_[i];
+            if (total >= target)
+            {
+                // upper bound of the bucket.
+                return std::min(stats.maxLatencyUs_, periodSeconds * (i + 1) / 100 * 1E6);
+            }
+        }
+        return stats.maxLatencyUs_;
+    }
+
+    DummyAudioDriverStats GetDummyAudioDriverStats()
+    {
+        DummyAudioDriverStats stats;
+        stats.latencyHistogram_.resize(DummyAudioDriverStats::HISTOGRAM_BUCKETS);
+        DummyAudioClock clock;
+        double totalLatency, minLatency, maxLatency;
+        while (true)
+        {
+            uint32_t sequence = publishedStats.sequence.load(std::memory_order_acquire);
+            if ((sequence & 1) != 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            clock = publishedStats.clock.load(std::memory_order_relaxed);
+            stats.sampleRate_ = publishedStats.sampleRate.load(std::memory_order_relaxed);
+            stats.bufferSize_ = publishedStats.bufferSize.load(std::memory_order_relaxed);
+            stats.periods_ = publishedStats.periods.load(std::memory_order_relaxed);
+            stats.wallTimeSeconds_ = publishedStats.wallTimeSeconds.load(std::memory_order_relaxed);
+            stats.deadlineMisses_ = publishedStats.deadlineMisses.load(std::memory_order_relaxed);
+            totalLatency = publishedStats.totalLatency.load(std::memory_order_relaxed);
+            minLatency = publishedStats.minLatency.load(std::memory_order_relaxed);
+            maxLatency = publishedStats.maxLatency.load(std::memory_order_relaxed);
+            stats.complete_ = publishedStats.complete.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < stats.latencyHistogram_.size(); ++i)
+            {
+                stats.latencyHistogram_[i] = publishedStats.histogram[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (publishedStats.sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                break;
+            }
+        }
+
+        stats.clock_ = ClockName(clock);
+        if (stats.sampleRate_ != 0)
+        {
+            stats.audioTimeSeconds_ = (double)stats.periods_ * stats.bufferSize_ / stats.sampleRate_;
+        }
+        stats.realtimeFactor_ = stats.wallTimeSeconds_ == 0 ? 0 : stats.audioTimeSeconds_ / stats.wallTimeSeconds_;
+        if (stats.periods_ != 0 && stats.sampleRate_ != 0)
+        {
+            stats.minLatencyUs_ = minLatency * 1E6;
+            stats.meanLatencyUs_ = totalLatency / stats.periods_ * 1E6;
+            stats.maxLatencyUs_ = maxLatency * 1E6;
+            stats.p50LatencyUs_ = LatencyPercentile(stats, 0.5);
+            stats.p99LatencyUs_ = LatencyPercentile(stats, 0.99);
+            stats.p999LatencyUs_ = LatencyPercentile(stats, 0.999);
+        }
+        return stats;
+    }
+
+    bool WaitForDummyAudioDriver(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock{dummyDriverMutex};
+        return dummyDriverCv.wait_for(lock, timeout, []() { return publishedStats.complete.load(); });
+    }
+
+
     bool GetDummyChannels(const JackServerSettings &jackServerSettings,
                          std::vector<std::string> &inputAudioPorts,
                          std::vector<std::string> &outputAudioPorts,
@@ -475,3 +991,21 @@ uint32_t pipedal::GetDummyAudioChannels(const std::string &deviceName)
 
 }
 
+JSON_MAP_BEGIN(DummyAudioDriverStats)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, clock)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, sampleRate)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, bufferSize)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, periods)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, audioTimeSeconds)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, wallTimeSeconds)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, realtimeFactor)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, deadlineMisses)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, minLatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, meanLatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, maxLatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, p50LatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, p99LatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, p999LatencyUs)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, complete)
+JSON_MAP_REFERENCE(DummyAudioDriverStats, latencyHistogram)
+JSON_MAP_END()
@@ -26,9 +26,72 @@
 
 #include "AudioDriver.hpp"
 #include "JackServerSettings.hpp"
+#include "json.hpp"
+#include <chrono>
+#include <filesystem>
+#include <vector>
 
 namespace pipedal {
 
+    enum class DummyAudioClock
+    {
+        // Sleep between periods. No attempt at realtime; just enough to keep the host alive.
+        Sleep,
+        // Call OnProcess back-to-back as fast as possible. Measures throughput.
+        Freewheel,
+        // Simulate a period clock (sleep until each period's start time). Measures latency and deadline misses.
+        Deterministic
+    };
+
+    class DummyAudioDriverOptions
+    {
+    public:
+        DummyAudioClock clock = DummyAudioClock::Sleep;
+        // WAV file that is looped on the capture channels. If empty, Freewheel and Deterministic
+        // modes use a synthetic test signal; Sleep mode uses silence.
+        std::filesystem::path inputFile;
+        // Send a MIDI CC sweep and a repeating note to the host.
+        bool syntheticMidi = false;
+        // Number of measured periods, after which the driver reverts to Sleep mode. 0: unlimited.
+        uint64_t maxPeriods = 0;
+    };
+
+    class DummyAudioDriverStats
+    {
+    public:
+        static constexpr size_t HISTOGRAM_BUCKETS = 201; // 1% of the period per bucket. The last bucket holds everything >= 200%.
+
+        std::string clock_;
+        uint32_t sampleRate_ = 0;
+        uint32_t bufferSize_ = 0;
+        uint64_t periods_ = 0;
+        double audioTimeSeconds_ = 0;
+        double wallTimeSeconds_ = 0;
+        double realtimeFactor_ = 0; // audio time/wall time.
+        uint64_t deadlineMisses_ = 0;
+        double minLatencyUs_ = 0;
+        double meanLatencyUs_ = 0;
+        double maxLatencyUs_ = 0;
+        double p50LatencyUs_ = 0;
+        double p99LatencyUs_ = 0;
+        double p999LatencyUs_ = 0;
+        bool complete_ = false;
+        // Per-period latency (from the period's scheduled start until OnProcess returns) in units of 1% of the period.
+        std::vector<uint64_t> latencyHistogram_;
+
+        DECLARE_JSON_MAP(DummyAudioDriverStats);
+    };
+
+    /// @brief Set the mode of dummy audio drivers that are subsequently opened.
+    void SetDummyAudioDriverOptions(const DummyAudioDriverOptions &options);
+
+    /// @brief Statistics for the current (or most recent) Freewheel or Deterministic dummy driver run.
+    DummyAudioDriverStats GetDummyAudioDriverStats();
+
+    /// @brief Wait until the current dummy driver run has processed DummyAudioDriverOptions::maxPeriods periods.
+    /// @returns false on timeout.
+    bool WaitForDummyAudioDriver(std::chrono::milliseconds timeout);
+
     AlsaDeviceInfo MakeDummyDeviceInfo(uint32_t channels);
 
     uint32_t GetDummyAudioChannels(const std::string &deviceName);
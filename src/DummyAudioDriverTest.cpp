@@ -0,0 +1,131 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pch.h"
+#include "catch.hpp"
+#include "DummyAudioDriver.hpp"
+#include <atomic>
+#include <memory>
+#include <numeric>
+
+using namespace pipedal;
+
+namespace
+{
+    class DummyDriverTestHost : public AudioDriverHost
+    {
+    public:
+        AudioDriver *audioDriver = nullptr;
+        std::atomic<uint64_t> processCalls{0};
+        bool sawInput = false;
+
+        virtual void OnProcess(size_t nFrames) override
+        {
+            ++processCalls;
+            for (size_t c = 0; c < audioDriver->OutputBufferCount(); ++c)
+            {
+                const float *input = audioDriver->GetInputBuffer(c % audioDriver->InputBufferCount());
+                float *output = audioDriver->GetOutputBuffer(c);
+                for (size_t i = 0; i < nFrames; ++i)
+                {
+                    if (input[i] != 0)
+                    {
+                        sawInput = true;
+                    }
+                    output[i] = input[i];
+                }
+            }
+        }
+        virtual void OnUnderrun() override {}
+        virtual void OnAudioStopped() override {}
+        virtual void OnAudioTerminated() override {}
+    };
+
+    DummyAudioDriverStats RunDummyDriver(DummyAudioClock clock, uint64_t maxPeriods, DummyDriverTestHost &host)
+    {
+        DummyAudioDriverOptions options;
+        options.clock = clock;
+        options.maxPeriods = maxPeriods;
+        SetDummyAudioDriverOptions(options);
+
+        std::unique_ptr<AudioDriver> driver{CreateDummyAudioDriver(&host, "dummy:channels_2")};
+        host.audioDriver = driver.get();
+
+        JackServerSettings serverSettings("dummy:channels_2", 48000, 64, 3);
+        JackChannelSelection channelSelection(
+            {"system:capture_0", "system:capture_1"},
+            {"system:playback_0", "system:playback_1"},
+            {});
+        driver->Open(serverSettings, channelSelection);
+        driver->Activate();
+        bool completed = WaitForDummyAudioDriver(std::chrono::seconds(30));
+        DummyAudioDriverStats stats = GetDummyAudioDriverStats();
+        driver->Deactivate();
+        driver->Close();
+        REQUIRE(completed);
+        return stats;
+    }
+}
+
+TEST_CASE("DummyAudioDriver freewheel stats", "[dummy_audio_driver][Build][Dev]")
+{
+    DummyDriverTestHost host;
+    DummyAudioDriverStats stats = RunDummyDriver(DummyAudioClock::Freewheel, 2000, host);
+
+    REQUIRE(stats.complete_);
+    REQUIRE(stats.clock_ == "freewheel");
+    REQUIRE(stats.sampleRate_ == 48000);
+    REQUIRE(stats.bufferSize_ == 64);
+    REQUIRE(stats.periods_ == 2000);
+    REQUIRE(host.processCalls >= 2000);
+    REQUIRE(host.sawInput); // the synthetic test signal.
+    REQUIRE(stats.audioTimeSeconds_ == Approx(2000.0 * 64 / 48000));
+    REQUIRE(stats.realtimeFactor_ > 0);
+    REQUIRE(stats.latencyHistogram_.size() == DummyAudioDriverStats::HISTOGRAM_BUCKETS);
+    REQUIRE(std::accumulate(stats.latencyHistogram_.begin(), stats.latencyHistogram_.end(), (uint64_t)0) == stats.periods_);
+    REQUIRE(stats.minLatencyUs_ <= stats.meanLatencyUs_);
+    REQUIRE(stats.meanLatencyUs_ <= stats.maxLatencyUs_);
+    REQUIRE(stats.p50LatencyUs_ <= stats.p99LatencyUs_);
+    REQUIRE(stats.p99LatencyUs_ <= stats.p999LatencyUs_);
+    REQUIRE(stats.p999LatencyUs_ <= stats.maxLatencyUs_);
+
+    // stats are reset for the next run.
+    SetDummyAudioDriverOptions(DummyAudioDriverOptions());
+    stats = GetDummyAudioDriverStats();
+    REQUIRE(!stats.complete_);
+    REQUIRE(stats.periods_ == 0);
+}
+
+TEST_CASE("DummyAudioDriver deterministic clock", "[dummy_audio_driver][Build][Dev]")
+{
+    DummyDriverTestHost host;
+    auto start = std::chrono::steady_clock::now();
+    DummyAudioDriverStats stats = RunDummyDriver(DummyAudioClock::Deterministic, 375, host); // 0.5s of audio.
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    REQUIRE(stats.complete_);
+    REQUIRE(stats.clock_ == "deterministic");
+    REQUIRE(stats.periods_ == 375);
+    REQUIRE(stats.deadlineMisses_ <= stats.periods_);
+    // paced by the simulated period clock rather than running flat out.
+    REQUIRE(elapsed >= 0.45);
+    REQUIRE(stats.realtimeFactor_ <= 1.1);
+
+    SetDummyAudioDriverOptions(DummyAudioDriverOptions());
+}
@@ -26,6 +26,12 @@ JSON_MAP_BEGIN(FileEntry)
     JSON_MAP_REFERENCE(FileEntry,displayName)
     JSON_MAP_REFERENCE(FileEntry,isProtected)
     JSON_MAP_REFERENCE(FileEntry,isDirectory)
+    JSON_MAP_REFERENCE(FileEntry,fileSize)
+    JSON_MAP_REFERENCE(FileEntry,lastModified)
+    JSON_MAP_REFERENCE(FileEntry,sampleRate)
+    JSON_MAP_REFERENCE(FileEntry,channels)
+    JSON_MAP_REFERENCE(FileEntry,duration)
+    JSON_MAP_REFERENCE(FileEntry,namArchitecture)
 JSON_MAP_END()
 
 JSON_MAP_BEGIN(BreadcrumbEntry)
@@ -39,4 +45,5 @@ JSON_MAP_BEGIN(FileRequestResult)
     JSON_MAP_REFERENCE(FileRequestResult,isProtected)
     JSON_MAP_REFERENCE(FileRequestResult,breadcrumbs)
     JSON_MAP_REFERENCE(FileRequestResult,currentDirectory)
+    JSON_MAP_REFERENCE(FileRequestResult,totalFiles)
 JSON_MAP_END()
@@ -36,6 +36,14 @@ namespace pipedal {
         bool isDirectory_ = false;
         bool isProtected_ = false;
 
+        // metadata. (0/empty if not known)
+        uint64_t fileSize_ = 0;
+        int64_t lastModified_ = 0; // seconds since the epoch.
+        uint32_t sampleRate_ = 0;
+        uint32_t channels_ = 0;
+        float duration_ = 0; // seconds.
+        std::string namArchitecture_;
+
         DECLARE_JSON_MAP(FileEntry);
 
     };
@@ -53,6 +61,8 @@ namespace pipedal {
         bool isProtected_ = false;
         std::vector<BreadcrumbEntry> breadcrumbs_;
         std::string currentDirectory_;
+        // total number of files that matched the request. (files_ may contain a page of them)
+        uint64_t totalFiles_ = 0;
         DECLARE_JSON_MAP(FileRequestResult);
 
     };
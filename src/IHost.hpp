@@ -25,7 +25,7 @@ namespace pipedal {
     class PedalboardItem;
     class Lv2PluginInfo;
     class IEffect;
-    class HostWorkerThread;
+    class HostWorkerPool;
 
     class IHost
     {
@@ -46,11 +46,14 @@ namespace pipedal {
         virtual int GetNumberOfInputAudioChannels() const = 0;
         virtual int GetNumberOfOutputAudioChannels() const = 0;
         virtual std::shared_ptr<Lv2PluginInfo> GetPluginInfo(const std::string &uri) const = 0;
-        virtual std::shared_ptr<HostWorkerThread> GetHostWorkerThread() = 0;
+        virtual std::shared_ptr<HostWorkerPool> GetHostWorkerPool() = 0;
 
         virtual IEffect *CreateEffect(PedalboardItem &pedalboard) = 0;
 
         virtual std::string GetPluginStoragePath() const = 0;
 
+        // Number of frames a bypassed plugin keeps running after its bypass crossfade completes. -1: never stop running the plugin.
+        virtual int64_t GetHardBypassDelaySamples(const std::string &pluginUri) const = 0;
+
     };
 }
\ No newline at end of file
@@ -225,6 +225,10 @@ bool pipedal::IsOnLocalSubnet(const std::string &fromAddress)
                 uint32_t remoteAddress = GetIpv4MappedAddress(inetAddr6);
                 return IsIpv4OnLocalSubnet(remoteAddress);
             }
+            if (IN6_IS_ADDR_LOOPBACK(&inetAddr6))
+            {
+                return true;
+            }
             if (IN6_IS_ADDR_LINKLOCAL(&inetAddr6))
             {
                 return true;
@@ -49,6 +49,7 @@ as appropriate.
 #include <jack/session.h>
 #include <jack/midiport.h>
 #include "Lv2Log.hpp"
+#include "SchedulerPriority.hpp"
 
 namespace pipedal {
 
@@ -470,6 +471,7 @@ private:
 
     static int process_fn(jack_nframes_t nframes, void *arg)
     {
+        MarkRealtimeThread();
         ((AudioDriverHost *)arg)->OnProcess(nframes);
         return 0;
     }
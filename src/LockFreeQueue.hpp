@@ -0,0 +1,213 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace pipedal
+{
+    /// <summary>
+    /// Fixed-capacity single-producer/single-consumer queue.
+    /// </summary>
+    /// <remarks>
+    /// Neither end ever blocks or allocates, so either end may be a realtime thread.
+    /// T should be trivially copyable.
+    /// </remarks>
+    template <typename T>
+    class LockFreeQueue
+    {
+    public:
+        LockFreeQueue(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+            {
+                size *= 2;
+            }
+            buffer.resize(size);
+            mask = size - 1;
+        }
+
+        size_t capacity() const { return buffer.size(); }
+
+        // Producer only. Returns false if the queue is full.
+        bool push(const T &value)
+        {
+            size_t head = this->head.load(std::memory_order_relaxed);
+            size_t tail = this->tail.load(std::memory_order_acquire);
+            if (head - tail >= buffer.size())
+            {
+                return false;
+            }
+            buffer[head & mask] = value;
+            this->head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Returns nullptr if the queue is empty. The item remains valid until pop() is called.
+        T *peek()
+        {
+            size_t tail = this->tail.load(std::memory_order_relaxed);
+            size_t head = this->head.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                return nullptr;
+            }
+            return &buffer[tail & mask];
+        }
+
+        // Consumer only.
+        bool pop(T *value)
+        {
+            T *p = peek();
+            if (p == nullptr)
+            {
+                return false;
+            }
+            *value = *p;
+            pop();
+            return true;
+        }
+        // Consumer only. Discards the item returned by peek().
+        void pop()
+        {
+            this->tail.store(this->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Consumer only. Discards all items currently in the queue.
+        void clear()
+        {
+            this->tail.store(this->head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        bool empty() const
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::vector<T> buffer;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    /// <summary>
+    /// Fixed-capacity single-producer/single-consumer queue of variable-length packets.
+    /// </summary>
+    /// <remarks>
+    /// Each packet is stored as a uint32_t length followed by the packet data. Packets are written
+    /// in full or not at all. Neither end ever blocks; the consumer allocates nothing.
+    /// </remarks>
+    class LockFreePacketQueue
+    {
+    public:
+        LockFreePacketQueue(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+            {
+                size *= 2;
+            }
+            buffer.resize(size);
+            mask = size - 1;
+        }
+
+        size_t capacity() const { return buffer.size(); }
+
+        // Producer only. Returns false if there isn't room for the packet.
+        bool write(size_t size, const void *data)
+        {
+            uint32_t packetSize = (uint32_t)size;
+            if (packetSize != size)
+            {
+                return false;
+            }
+            size_t head = this->head.load(std::memory_order_relaxed);
+            size_t tail = this->tail.load(std::memory_order_acquire);
+            if (buffer.size() - (head - tail) < sizeof(packetSize) + size)
+            {
+                return false;
+            }
+            copyIn(head, &packetSize, sizeof(packetSize));
+            copyIn(head + sizeof(packetSize), data, size);
+            this->head.store(head + sizeof(packetSize) + size, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Returns false if the queue is empty.
+        bool peekSize(uint32_t *size)
+        {
+            size_t tail = this->tail.load(std::memory_order_relaxed);
+            size_t head = this->head.load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                return false;
+            }
+            copyOut(tail, size, sizeof(*size));
+            return true;
+        }
+
+        // Consumer only. Removes the next packet, whose size was obtained from peekSize().
+        void read(uint32_t size, void *data)
+        {
+            size_t tail = this->tail.load(std::memory_order_relaxed);
+            copyOut(tail + sizeof(size), data, size);
+            this->tail.store(tail + sizeof(size) + size, std::memory_order_release);
+        }
+
+        bool empty() const
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        // Consumer only. Bytes of complete packets (including their length headers) available to read.
+        size_t readSpace() const
+        {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void copyIn(size_t position, const void *data, size_t size)
+        {
+            size_t offset = position & mask;
+            size_t firstPart = std::min(size, buffer.size() - offset);
+            std::memcpy(buffer.data() + offset, data, firstPart);
+            std::memcpy(buffer.data(), (const uint8_t *)data + firstPart, size - firstPart);
+        }
+        void copyOut(size_t position, void *data, size_t size) const
+        {
+            size_t offset = position & mask;
+            size_t firstPart = std::min(size, buffer.size() - offset);
+            std::memcpy(data, buffer.data() + offset, firstPart);
+            std::memcpy((uint8_t *)data + firstPart, buffer.data(), size - firstPart);
+        }
+
+        std::vector<uint8_t> buffer;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+}
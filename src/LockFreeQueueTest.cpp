@@ -0,0 +1,180 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LockFreeQueue.hpp"
+#include "catch.hpp"
+#include <thread>
+#include <cstring>
+
+using namespace pipedal;
+
+TEST_CASE("LockFreeQueue", "[lock_free_queue][Build][Dev]")
+{
+    {
+        LockFreeQueue<int> queue(3);
+        REQUIRE(queue.capacity() == 4);
+        REQUIRE(queue.empty());
+        REQUIRE(queue.peek() == nullptr);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            REQUIRE(queue.push(i));
+        }
+        REQUIRE(!queue.push(4)); // full.
+
+        REQUIRE(*queue.peek() == 0);
+        int value;
+        REQUIRE(queue.pop(&value));
+        REQUIRE(value == 0);
+        REQUIRE(queue.push(4));
+        for (int i = 1; i <= 4; ++i)
+        {
+            REQUIRE(queue.pop(&value));
+            REQUIRE(value == i);
+        }
+        REQUIRE(!queue.pop(&value));
+
+        REQUIRE(queue.push(5));
+        REQUIRE(queue.push(6));
+        queue.clear();
+        REQUIRE(queue.empty());
+        REQUIRE(queue.push(7));
+        REQUIRE(queue.pop(&value));
+        REQUIRE(value == 7);
+    }
+    {
+        // producer and consumer on separate threads.
+        constexpr int N = 1000000;
+        LockFreeQueue<int> queue(64);
+        std::thread producer(
+            [&queue]()
+            {
+                for (int i = 0; i < N; /**/)
+                {
+                    if (queue.push(i))
+                    {
+                        ++i;
+                    }
+                }
+            });
+        int expected = 0;
+        bool ordered = true;
+        while (expected < N)
+        {
+            int value;
+            if (queue.pop(&value))
+            {
+                if (value != expected)
+                {
+                    ordered = false;
+                }
+                ++expected;
+            }
+        }
+        producer.join();
+        REQUIRE(ordered);
+        REQUIRE(queue.empty());
+    }
+}
+
+TEST_CASE("LockFreePacketQueue", "[lock_free_queue][Build][Dev]")
+{
+    {
+        LockFreePacketQueue queue(15);
+        REQUIRE(queue.capacity() == 16);
+        uint32_t size;
+        REQUIRE(!queue.peekSize(&size));
+
+        uint8_t data[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            data[i] = (uint8_t)i;
+        }
+        REQUIRE(queue.write(6, data));
+        REQUIRE(!queue.write(7, data)); // 10 + 11 bytes won't fit.
+        REQUIRE(queue.write(2, data + 6));
+
+        uint8_t result[16];
+        REQUIRE(queue.peekSize(&size));
+        REQUIRE(size == 6);
+        queue.read(size, result);
+        REQUIRE(memcmp(result, data, 6) == 0);
+
+        // wraps around the end of the buffer.
+        REQUIRE(queue.write(4, data + 8));
+        REQUIRE(queue.peekSize(&size));
+        REQUIRE(size == 2);
+        queue.read(size, result);
+        REQUIRE(memcmp(result, data + 6, 2) == 0);
+        REQUIRE(queue.peekSize(&size));
+        REQUIRE(size == 4);
+        queue.read(size, result);
+        REQUIRE(memcmp(result, data + 8, 4) == 0);
+        REQUIRE(queue.empty());
+    }
+    {
+        // producer and consumer on separate threads.
+        constexpr uint32_t N = 100000;
+        LockFreePacketQueue queue(1024);
+        std::thread producer(
+            [&queue]()
+            {
+                uint32_t packet[8];
+                for (uint32_t i = 0; i < N; /**/)
+                {
+                    size_t count = i % 8 + 1;
+                    for (size_t j = 0; j < count; ++j)
+                    {
+                        packet[j] = i;
+                    }
+                    if (queue.write(count * sizeof(uint32_t), packet))
+                    {
+                        ++i;
+                    }
+                }
+            });
+        uint32_t expected = 0;
+        bool ordered = true;
+        while (expected < N)
+        {
+            uint32_t size;
+            if (queue.peekSize(&size))
+            {
+                uint32_t packet[8];
+                if (size != (expected % 8 + 1) * sizeof(uint32_t))
+                {
+                    ordered = false;
+                    break;
+                }
+                queue.read(size, packet);
+                for (size_t j = 0; j < size / sizeof(uint32_t); ++j)
+                {
+                    if (packet[j] != expected)
+                    {
+                        ordered = false;
+                    }
+                }
+                ++expected;
+            }
+        }
+        producer.join();
+        REQUIRE(ordered);
+        REQUIRE(queue.empty());
+    }
+}
@@ -21,6 +21,15 @@
 #include <mutex>
 #include <cstdio>
 #include "Lv2Log.hpp"
+#include "SchedulerPriority.hpp"
+#include "util.hpp"
+#include "ss.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <time.h>
 
 
 using namespace pipedal;
@@ -46,50 +55,208 @@ int LogFeature::vprintfFn(LV2_Log_Handle handle,
 	return logFeature->vprintf(type, fmt, ap);
 }
 
+namespace pipedal
+{
+	// Background thread that delivers messages logged on realtime threads.
+	class LogFeatureDrain
+	{
+	public:
+		static LogFeatureDrain &Instance()
+		{
+			static LogFeatureDrain instance;
+			return instance;
+		}
+		~LogFeatureDrain()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				closed = true;
+			}
+			cv.notify_all();
+			if (thread.joinable())
+			{
+				thread.join();
+			}
+		}
+		void Register(LogFeature *logFeature)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			logFeatures.push_back(logFeature);
+			if (!thread.joinable())
+			{
+				thread = std::thread([this]() { ThreadProc(); });
+			}
+		}
+		void Unregister(LogFeature *logFeature)
+		{
+			// The drain thread holds mutex for the whole of each pass, so this blocks until any
+			// in-progress delivery to logFeature has completed.
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto i = logFeatures.begin(); i != logFeatures.end(); ++i)
+			{
+				if (*i == logFeature)
+				{
+					logFeatures.erase(i);
+					break;
+				}
+			}
+		}
+
+	private:
+		static constexpr std::chrono::milliseconds POLL_INTERVAL{50};
+
+		void ThreadProc()
+		{
+			SetThreadName("lv2_log");
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!closed)
+			{
+				cv.wait_for(lock, POLL_INTERVAL);
+				for (LogFeature *logFeature : logFeatures)
+				{
+					logFeature->DrainRealtimeMessages();
+				}
+			}
+		}
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool closed = false;
+		std::vector<LogFeature *> logFeatures;
+		std::thread thread;
+	};
+}
+
+static int64_t MonotonicNanoseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 int LogFeature::vprintf(LV2_URID type,const char*fmt, va_list va)
 {
+	if (IsRealtimeThread())
+	{
+		return vprintfRt(type, fmt, va);
+	}
 	std::lock_guard<std::mutex> guard(logMutex);
 
 	int result = 0;
 	if (this->logMessageListener)
 	{
-		const char* prefix = "";
 		char buffer[1024];
-		strcpy(buffer,messagePrefix.c_str());
-		char *p = buffer+messagePrefix.length();
+		result = vsnprintf(buffer, sizeof(buffer), fmt, va);
+		buffer[sizeof(buffer)-1] = '\0';
+		Deliver(type, buffer);
+	}
+    return result;
+}
 
+int LogFeature::vprintfRt(LV2_URID type, const char *fmt, va_list va)
+{
+	// No locks, no allocation: format into a fixed-size message and queue it. If the queue is full, the
+	// message is dropped and counted.
+	if (this->logMessageListener == nullptr)
+	{
+		return 0;
+	}
+	RtMessage message;
+	message.type = type;
+	message.timeNs = MonotonicNanoseconds();
+	int result = vsnprintf(message.text, sizeof(message.text), fmt, va);
+	message.text[sizeof(message.text) - 1] = '\0';
+	if (!rtQueue.push(message))
+	{
+		rtOverruns.fetch_add(1, std::memory_order_relaxed);
+	}
+	return result;
+}
 
-		result = vsnprintf(p, sizeof(buffer)-messagePrefix.length(), fmt, va);
-		buffer[sizeof(buffer)-1] = '\0';
-		
-		// strip trailing \n
-		size_t len = strlen(buffer);
-		if (len != 0 && buffer[len-1] == '\n')
-		{
-			buffer[len-1] = '\0';
-		}
+void LogFeature::DrainRealtimeMessages()
+{
+	// Called on the drain thread. Limit each plugin to MAX_MESSAGES_PER_SECOND so that a plugin logging
+	// on every cycle doesn't flood the system log.
+	constexpr int64_t RATE_WINDOW_NS = 1000000000LL;
+	constexpr uint32_t MAX_MESSAGES_PER_SECOND = 10;
 
-		if (type == uris.ridError)
-		{
-			logMessageListener->OnLogError(buffer);
-		}
-		else if (type == uris.ridWarning)
+	RtMessage *message;
+	while ((message = rtQueue.peek()) != nullptr)
+	{
+		if (message->timeNs - rateWindowStartNs >= RATE_WINDOW_NS)
 		{
-			logMessageListener->OnLogWarning(buffer);
+			if (suppressedCount != 0)
+			{
+				std::string text = SS("(" << suppressedCount << " log messages suppressed)");
+				std::lock_guard<std::mutex> guard(logMutex);
+				Deliver(uris.ridWarning, text.c_str());
+			}
+			rateWindowStartNs = message->timeNs;
+			rateWindowCount = 0;
+			suppressedCount = 0;
 		}
-		else if (type == uris.ridNote)
+		if (rateWindowCount < MAX_MESSAGES_PER_SECOND)
 		{
-			logMessageListener->OnLogInfo(buffer);
+			++rateWindowCount;
+			std::lock_guard<std::mutex> guard(logMutex);
+			Deliver(message->type, message->text);
 		}
-		else if (type == uris.ridTrace)
+		else
 		{
-			logMessageListener->OnLogDebug(buffer);
-		}
-		else {
-			logMessageListener->OnLogInfo(buffer);
+			++suppressedCount;
 		}
+		rtQueue.pop();
+	}
+	if (suppressedCount != 0 && MonotonicNanoseconds() - rateWindowStartNs >= RATE_WINDOW_NS)
+	{
+		std::string text = SS("(" << suppressedCount << " log messages suppressed)");
+		std::lock_guard<std::mutex> guard(logMutex);
+		Deliver(uris.ridWarning, text.c_str());
+		suppressedCount = 0;
+	}
+	uint32_t overruns = rtOverruns.exchange(0, std::memory_order_relaxed);
+	if (overruns != 0)
+	{
+		std::string text = SS("(" << overruns << " log messages dropped on the audio thread)");
+		std::lock_guard<std::mutex> guard(logMutex);
+		Deliver(uris.ridWarning, text.c_str());
+	}
+}
+
+void LogFeature::Deliver(LV2_URID type, const char *message)
+{
+	if (this->logMessageListener == nullptr)
+	{
+		return;
+	}
+	char buffer[1024];
+	snprintf(buffer, sizeof(buffer), "%s%s", messagePrefix.c_str(), message);
+
+	// strip trailing \n
+	size_t len = strlen(buffer);
+	if (len != 0 && buffer[len-1] == '\n')
+	{
+		buffer[len-1] = '\0';
+	}
+
+	if (type == uris.ridError)
+	{
+		logMessageListener->OnLogError(buffer);
+	}
+	else if (type == uris.ridWarning)
+	{
+		logMessageListener->OnLogWarning(buffer);
+	}
+	else if (type == uris.ridNote)
+	{
+		logMessageListener->OnLogInfo(buffer);
+	}
+	else if (type == uris.ridTrace)
+	{
+		logMessageListener->OnLogDebug(buffer);
+	}
+	else {
+		logMessageListener->OnLogInfo(buffer);
 	}
-    return result;
 }
 
 
@@ -101,11 +268,30 @@ LogFeature::LogFeature()
 	log.printf = printfFn;
 	log.vprintf = vprintfFn;
 }
+LogFeature::~LogFeature()
+{
+	Close();
+}
+void LogFeature::Close()
+{
+	if (registered)
+	{
+		registered = false;
+		LogFeatureDrain::Instance().Unregister(this);
+	}
+	std::lock_guard<std::mutex> guard(logMutex);
+	this->logMessageListener = nullptr;
+}
 void LogFeature::Prepare(MapFeature*map, const std::string &messagePrefix, LogMessageListener*listener)
 {
 	uris.Map(map);
 	this->messagePrefix = messagePrefix;
 	this->logMessageListener = listener;
+	if (!registered)
+	{
+		registered = true;
+		LogFeatureDrain::Instance().Register(this);
+	}
 
 }
 
@@ -28,9 +28,12 @@
 #include "lv2/urid/urid.h"
 #include "lv2/atom/atom.h"
 #include "MapFeature.hpp"
+#include "LockFreeQueue.hpp"
 #include <map>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
 
 
 namespace pipedal {
@@ -67,9 +70,37 @@ namespace pipedal {
 
 		Uri uris;
 
+		// Messages logged on realtime threads are formatted into a fixed-size buffer, queued, and
+		// delivered to the listener by a background thread.
+		static constexpr size_t RT_MESSAGE_SIZE = 256;
+		static constexpr size_t RT_QUEUE_SIZE = 64;
+		struct RtMessage {
+			LV2_URID type;
+			int64_t timeNs;
+			char text[RT_MESSAGE_SIZE];
+		};
+		LockFreeQueue<RtMessage> rtQueue { RT_QUEUE_SIZE };
+		std::atomic<uint32_t> rtOverruns { 0 };
+
+		// rate limiting (background thread only).
+		int64_t rateWindowStartNs = 0;
+		uint32_t rateWindowCount = 0;
+		uint32_t suppressedCount = 0;
+
+		bool registered = false;
+		friend class LogFeatureDrain;
+		void DrainRealtimeMessages();
+		void Deliver(LV2_URID type, const char*message);
+
 	public:
 		LogFeature();
+		~LogFeature();
+		LogFeature(const LogFeature&) = delete;
+		LogFeature&operator=(const LogFeature&) = delete;
+
 		void Prepare(MapFeature* map, const std::string &messagePrefix, LogMessageListener*listener);
+		// Stop delivering messages to the listener. Waits for any delivery in progress on another thread to complete.
+		void Close();
 
 
 		void LogError(const char*fmt,...);
@@ -93,6 +124,7 @@ namespace pipedal {
 			va_list        ap);
 
 		int vprintf(LV2_URID type, const char* fmt, va_list va);
+		int vprintfRt(LV2_URID type, const char* fmt, va_list va);
 
 
 
@@ -0,0 +1,217 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "LogFeature.hpp"
+#include "MapFeature.hpp"
+#include "SchedulerPriority.hpp"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pipedal;
+
+namespace
+{
+    class TestListener : public LogFeature::LogMessageListener
+    {
+    public:
+        struct Message
+        {
+            char level;
+            std::string text;
+        };
+
+        virtual void OnLogError(const char *message) override { Add('E', message); }
+        virtual void OnLogWarning(const char *message) override { Add('W', message); }
+        virtual void OnLogInfo(const char *message) override { Add('I', message); }
+        virtual void OnLogDebug(const char *message) override { Add('D', message); }
+
+        std::vector<Message> Messages()
+        {
+            std::lock_guard lock(mutex);
+            return messages;
+        }
+
+        // Wait (for up to 5 seconds) until the drain thread has delivered at least count messages.
+        std::vector<Message> WaitFor(size_t count)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                auto result = Messages();
+                if (result.size() >= count)
+                {
+                    return result;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return Messages();
+        }
+
+    private:
+        void Add(char level, const char *message)
+        {
+            std::lock_guard lock(mutex);
+            messages.push_back(Message{level, message});
+        }
+        std::mutex mutex;
+        std::vector<Message> messages;
+    };
+
+    // Run fn on a thread marked as realtime, so that LogFeature takes its realtime path.
+    template <typename FN>
+    void OnRealtimeThread(FN fn)
+    {
+        std::thread thread([&fn]()
+                           {
+                               MarkRealtimeThread();
+                               fn();
+                           });
+        thread.join();
+    }
+
+    // The count from a message of the form "(<count><suffix>".
+    int Count(const std::vector<TestListener::Message> &messages, const std::string &suffix)
+    {
+        for (const auto &message : messages)
+        {
+            const std::string &text = message.text;
+            if (text.size() > suffix.size() && text[0] == '(' && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0)
+            {
+                return std::stoi(text.substr(1));
+            }
+        }
+        return 0;
+    }
+}
+
+TEST_CASE("LogFeature realtime formatting", "[log_feature][Build][Dev]")
+{
+    MapFeature map;
+    TestListener listener;
+    LogFeature logFeature;
+    logFeature.Prepare(&map, "Test: ", &listener);
+
+    std::string longText(1000, 'x');
+    OnRealtimeThread(
+        [&]()
+        {
+            logFeature.LogError("error %d\n", 1);
+            logFeature.LogWarning("warning %s", "two");
+            logFeature.LogNote("note %.1f", 3.0);
+            logFeature.LogError("%s", longText.c_str());
+        });
+
+    auto messages = listener.WaitFor(4);
+    REQUIRE(messages.size() == 4);
+
+    // delivered in order, formatted on the realtime thread, with the prefix added and trailing newlines removed.
+    REQUIRE(messages[0].level == 'E');
+    REQUIRE(messages[0].text == "Test: error 1");
+    REQUIRE(messages[1].level == 'W');
+    REQUIRE(messages[1].text == "Test: warning two");
+    REQUIRE(messages[2].level == 'I');
+    REQUIRE(messages[2].text == "Test: note 3.0");
+    // truncated to the fixed-size realtime message buffer.
+    REQUIRE(messages[3].text == "Test: " + std::string(255, 'x'));
+}
+
+TEST_CASE("LogFeature realtime queue overflow", "[log_feature][Build][Dev]")
+{
+    MapFeature map;
+    TestListener listener;
+    LogFeature logFeature;
+    logFeature.Prepare(&map, "", &listener);
+
+    constexpr int N = 200; // more than the queue holds.
+    OnRealtimeThread(
+        [&]()
+        {
+            for (int i = 0; i < N; ++i)
+            {
+                logFeature.LogNote("message %d", i);
+            }
+        });
+
+    // 10 messages, a report of the messages dropped when the queue was full, and (once the
+    // rate-limiting window closes) a report of the messages that were suppressed.
+    auto messages = listener.WaitFor(12);
+    REQUIRE(messages.size() == 12);
+
+    int delivered = 0;
+    for (const auto &message : messages)
+    {
+        if (message.level == 'I')
+        {
+            REQUIRE(message.text == "message " + std::to_string(delivered));
+            ++delivered;
+        }
+    }
+    REQUIRE(delivered == 10);
+    int dropped = Count(messages, " log messages dropped on the audio thread)");
+    int suppressed = Count(messages, " log messages suppressed)");
+    REQUIRE(dropped > 0);
+    REQUIRE(suppressed > 0);
+    REQUIRE(delivered + dropped + suppressed == N);
+}
+
+TEST_CASE("LogFeature rate limiting", "[log_feature][Build][Dev]")
+{
+    MapFeature map;
+    TestListener listener;
+    LogFeature logFeature;
+    logFeature.Prepare(&map, "", &listener);
+
+    OnRealtimeThread(
+        [&]()
+        {
+            for (int i = 0; i < 15; ++i)
+            {
+                logFeature.LogWarning("burst %d", i);
+            }
+        });
+    auto messages = listener.WaitFor(11);
+    REQUIRE(messages.size() == 11);
+    for (int i = 0; i < 10; ++i)
+    {
+        REQUIRE(messages[i].text == "burst " + std::to_string(i));
+    }
+    REQUIRE(messages[10].level == 'W');
+    REQUIRE(messages[10].text == "(5 log messages suppressed)");
+
+    // a new window starts for later messages.
+    OnRealtimeThread(
+        [&]()
+        { logFeature.LogWarning("later"); });
+    messages = listener.WaitFor(12);
+    REQUIRE(messages.size() == 12);
+    REQUIRE(messages[11].text == "later");
+
+    // messages logged on other threads are delivered immediately, and aren't rate limited.
+    for (int i = 0; i < 15; ++i)
+    {
+        logFeature.LogError("direct %d", i);
+    }
+    REQUIRE(listener.Messages().size() == 27);
+}
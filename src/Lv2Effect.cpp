@@ -40,6 +40,8 @@
 #include "lv2/atom/util.h"
 #include "AudioHost.hpp"
 #include <exception>
+#include <algorithm>
+#include <cstring>
 #include "RingBufferReader.hpp"
 
 using namespace pipedal;
@@ -62,15 +64,22 @@ Lv2Effect::Lv2Effect(
     IHost *pHost_,
     const std::shared_ptr<Lv2PluginInfo> &info_,
     PedalboardItem &pedalboardItem)
-    : pHost(pHost_), pInstance(nullptr), info(info_), urids(pHost), instanceId(pedalboardItem.instanceId())
+    : Lv2Effect(pHost_, info_)
+{
+    Bind(pedalboardItem);
+}
+
+Lv2Effect::Lv2Effect(
+    IHost *pHost_,
+    const std::shared_ptr<Lv2PluginInfo> &info_)
+    : pHost(pHost_), pInstance(nullptr), info(info_), urids(pHost), instanceId(0)
 {
     auto pWorld = pHost_->getWorld();
 
     logFeature.Prepare(&pHost_->GetMapFeature(), info_->name() + ": ", this);
 
     this->bypassStartingSamples = (uint32_t)(pHost->GetSampleRate() * BYPASS_TIME_S);
-
-    this->bypass = pedalboardItem.isEnabled();
+    this->hardBypassDelaySamples = pHost->GetHardBypassDelaySamples(info_->uri());
 
     // stash a list of known file properties that we want to keep synced.
     if (info->piPedalUI())
@@ -79,14 +88,8 @@ Lv2Effect::Lv2Effect(
         {
             LV2_URID filePropertyUrid = pHost->GetLv2Urid(fileProperty->patchProperty().c_str());
             this->pathProperties.push_back(filePropertyUrid);
-
-            this->pathPropertyWriters.push_back(PatchPropertyWriter(instanceId, filePropertyUrid));
         }
     }
-    for (auto &pathProperty: pedalboardItem.pathProperties_)
-    {
-        SetPathPatchProperty(pathProperty.first,pathProperty.second);
-    }
 
     // initialize the atom forge used on the realtime thread.
     LV2_URID_Map *map = this->pHost->GetLv2UridMap();
@@ -96,7 +99,7 @@ Lv2Effect::Lv2Effect(
     const LilvPlugins *plugins = lilv_world_get_all_plugins(pWorld);
 
     // xxx: could we not stash the pPlugin in the plugin info?
-    auto uriNode = lilv_new_uri(pWorld, pedalboardItem.uri().c_str());
+    auto uriNode = lilv_new_uri(pWorld, info_->uri().c_str());
     const LilvPlugin *pPlugin = lilv_plugins_get_by_uri(plugins, uriNode);
 
     lilv_node_free(uriNode);
@@ -186,7 +189,7 @@ Lv2Effect::Lv2Effect(
                                                                        LV2_WORKER__interface);
     if (worker_interface)
     {
-        this->worker = std::make_unique<Worker>(pHost->GetHostWorkerThread(), pInstance, worker_interface);
+        this->worker = std::make_unique<Worker>(pHost->GetHostWorkerPool(), pInstance, worker_interface);
     }
     const LV2_State_Interface *state_interface =
         (const LV2_State_Interface *)lilv_instance_get_extension_data(pInstance,
@@ -197,8 +200,6 @@ Lv2Effect::Lv2Effect(
         this->stateInterface = std::make_unique<StateInterface>(pHost, &(this->features[0]), pInstance, state_interface);
     }
 
-    this->instanceId = pedalboardItem.instanceId();
-
     PreparePortIndices();
 
     // Copy default pedalboard settings.
@@ -221,6 +222,30 @@ Lv2Effect::Lv2Effect(
     }
 
     this->controlValues.resize(info->ports().size());
+
+    ConnectControlPorts();
+}
+
+void Lv2Effect::Bind(PedalboardItem &pedalboardItem)
+{
+    auto pWorld = pHost->getWorld();
+
+    this->instanceId = pedalboardItem.instanceId();
+    this->bypass = pedalboardItem.isEnabled();
+
+    this->pathPropertyWriters.clear();
+    for (LV2_URID filePropertyUrid : this->pathProperties)
+    {
+        this->pathPropertyWriters.push_back(PatchPropertyWriter(instanceId, filePropertyUrid));
+    }
+    this->mainThreadPathProperties.clear();
+    for (auto &pathProperty : *pedalboardItem.pathProperties_)
+    {
+        SetPathPatchProperty(pathProperty.first, pathProperty.second);
+    }
+
+    // (controlValues must not be reallocated; the plugin's control ports point into it.)
+    std::fill(this->controlValues.begin(), this->controlValues.end(), 0.0f);
     for (auto i = pedalboardItem.controlValues().begin(); i != pedalboardItem.controlValues().end(); ++i)
     {
         auto &v = (*i);
@@ -231,24 +256,36 @@ Lv2Effect::Lv2Effect(
         }
     }
 
-    ConnectControlPorts();
-
     if (!pedalboardItem.lilvPresetUri().empty())
     {
+        // the lilv world isn't thread-safe, so load the preset here. It gets applied in RestoreInitialState.
         AutoLilvNode presetNode = lilv_new_uri(pWorld, pedalboardItem.lilvPresetUri().c_str());
         lilv_world_load_resource(pWorld, presetNode);
-        LilvState *pState = lilv_state_new_from_world(pWorld, pHost->GetMapFeature().GetMap(), presetNode);
-        if (pState)
+        this->pendingPresetState = lilv_state_new_from_world(pWorld, pHost->GetMapFeature().GetMap(), presetNode);
+        this->hasPendingPreset = true;
+    }
+}
+
+void Lv2Effect::RestoreInitialState(PedalboardItem &pedalboardItem)
+{
+    if (hasPendingPreset)
+    {
+        hasPendingPreset = false;
+        if (pendingPresetState)
         {
             if (this->stateInterface)
             {
-                this->stateInterface->RestoreState(pState);
+                this->stateInterface->RestoreState(pendingPresetState);
             }
-            lilv_state_free(pState);
+            lilv_state_free(pendingPresetState);
+            pendingPresetState = nullptr;
         }
         // now that we've loaded the preset, clear the uri, and save new state
         // Why? because lilv doesn't provide facilities for reading state.
-        pedalboardItem.lv2State(this->stateInterface->Save());
+        if (this->stateInterface)
+        {
+            pedalboardItem.lv2State(this->stateInterface->Save());
+        }
         pedalboardItem.lilvPresetUri("");
     }
     else
@@ -256,6 +293,15 @@ Lv2Effect::Lv2Effect(
         RestoreState(pedalboardItem);
     }
 }
+
+bool Lv2Effect::WaitForPendingWork(std::chrono::steady_clock::time_point deadline)
+{
+    if (!worker)
+    {
+        return true;
+    }
+    return worker->WaitForPendingRequests(deadline);
+}
 void Lv2Effect::RestoreState(PedalboardItem &pedalboardItem)
 {
     // Restore state if present.
@@ -378,7 +424,7 @@ void Lv2Effect::SetAudioInputBuffer(int index, float *buffer)
     }
     this->inputAudioBuffers[index] = buffer;
     int pluginIndex = this->inputAudioPortIndices[index];
-    lilv_instance_connect_port(this->pInstance, pluginIndex, buffer);
+    lilv_instance_connect_port(this->pInstance, pluginIndex, inputsSilenced ? silenceBuffer : buffer);
 }
 
 void Lv2Effect::SetAudioInputBuffer(float *left)
@@ -426,6 +472,13 @@ int Lv2Effect::GetControlIndex(const std::string &key) const
 
 Lv2Effect::~Lv2Effect()
 {
+    // Stop log delivery before any state the listener touches is destroyed.
+    logFeature.Close();
+    if (pendingPresetState)
+    {
+        lilv_state_free(pendingPresetState);
+        pendingPresetState = nullptr;
+    }
     if (worker)
     {
         worker->Close();
@@ -462,6 +515,10 @@ void Lv2Effect::AssignUnconnectedPorts()
             lilv_instance_connect_port(pInstance, pluginIndex, buffer);
         }
     }
+    if (this->hardBypassDelaySamples >= 0 && this->GetNumberOfInputAudioPorts() != 0 && this->silenceBuffer == nullptr)
+    {
+        this->silenceBuffer = bufferPool.AllocateBuffer<float>(pHost->GetMaxAudioBufferSize());
+    }
     for (int i = 0; i < this->GetNumberOfOutputAudioPorts(); ++i)
     {
         if (GetAudioOutputBuffer(i) == nullptr)
@@ -506,11 +563,77 @@ void Lv2Effect::Deactivate()
     lilv_instance_deactivate(pInstance);
 }
 
-static inline void CopyBuffer(float *input, float *output, uint32_t frames)
+static inline void CopyBuffer(const float *input, float *output, uint32_t frames)
+{
+    if (input != output)
+    {
+        std::memcpy(output, input, frames * sizeof(float));
+    }
+}
+
+// output = input + gain*(output-input), with gain ramping linearly from startGain by dx per frame.
+static inline void CrossfadeBuffer(const float *__restrict input, float *__restrict output, float startGain, float dx, uint32_t frames)
 {
     for (uint32_t i = 0; i < frames; ++i)
     {
-        output[i] = input[i];
+        float gain = startGain + dx * (float)i;
+        output[i] = input[i] + gain * (output[i] - input[i]);
+    }
+}
+
+bool Lv2Effect::HasInputAtomEvents() const
+{
+    for (char *buffer : this->inputAtomBuffers)
+    {
+        const LV2_Atom_Sequence *sequence = (const LV2_Atom_Sequence *)buffer;
+        if (sequence->atom.size > sizeof(LV2_Atom_Sequence_Body))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Lv2Effect::CopyInputToOutput(uint32_t offset, uint32_t frames)
+{
+    if (this->outputAudioBuffers.size() == 1)
+    {
+        CopyBuffer(this->inputAudioBuffers[0] + offset, this->outputAudioBuffers[0] + offset, frames);
+    }
+    else
+    {
+        float *inputR = this->inputAudioBuffers.size() == 1 ? this->inputAudioBuffers[0] : this->inputAudioBuffers[1];
+        CopyBuffer(this->inputAudioBuffers[0] + offset, this->outputAudioBuffers[0] + offset, frames);
+        CopyBuffer(inputR + offset, this->outputAudioBuffers[1] + offset, frames);
+    }
+}
+
+void Lv2Effect::CrossfadeInputToOutput(uint32_t frames)
+{
+    float startGain = (float)this->currentBypass;
+    float dx = (float)this->currentBypassDx;
+    if (this->outputAudioBuffers.size() == 1)
+    {
+        CrossfadeBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[0], startGain, dx, frames);
+    }
+    else
+    {
+        float *inputR = this->inputAudioBuffers.size() == 1 ? this->inputAudioBuffers[0] : this->inputAudioBuffers[1];
+        CrossfadeBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[0], startGain, dx, frames);
+        CrossfadeBuffer(inputR, this->outputAudioBuffers[1], startGain, dx, frames);
+    }
+}
+
+void Lv2Effect::SilenceAudioInputs(bool silence)
+{
+    this->inputsSilenced = silence;
+    for (size_t i = 0; i < this->inputAudioPortIndices.size(); ++i)
+    {
+        float *buffer = silence ? this->silenceBuffer : this->inputAudioBuffers[i];
+        if (buffer != nullptr)
+        {
+            lilv_instance_connect_port(pInstance, this->inputAudioPortIndices[i], buffer);
+        }
     }
 }
 
@@ -522,12 +645,21 @@ void Lv2Effect::Run(uint32_t samples, RealtimeRingBufferWriter *realtimeRingBuff
         lv2_atom_forge_pop(&this->inputForgeRt, &input_frame);
     }
 
-    lilv_instance_run(pInstance, samples);
+    // Once fully bypassed, a plugin that will be hard-bypassed runs on silence, so that its tail decays
+    // and it doesn't replay stale input when it is re-enabled.
+    bool silenceInputs =
+        this->silenceBuffer != nullptr && this->bypassSamplesRemaining == 0 && this->currentBypass == 0;
+    if (silenceInputs != this->inputsSilenced)
+    {
+        SilenceAudioInputs(silenceInputs);
+    }
 
-    if (worker)
+    // A hard-bypassed plugin is only run when it has pending atom input (patch messages from the UI, MIDI),
+    // so that state changes made while bypassed aren't lost.
+    bool runPlugin = !this->hardBypassed || HasInputAtomEvents();
+    if (runPlugin)
     {
-        // relay worker response
-        worker->EmitResponses();
+        lilv_instance_run(pInstance, samples);
     }
 
     // do soft bypass.
@@ -536,88 +668,42 @@ void Lv2Effect::Run(uint32_t samples, RealtimeRingBufferWriter *realtimeRingBuff
         if (this->currentBypass == 0)
         {
             // replace the contents of the output buffer(s) with the input buffer(s).
-            if (this->outputAudioBuffers.size() == 1)
-            {
-                CopyBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[0], samples);
-            }
-            else
+            CopyInputToOutput(0, samples);
+
+            if (!this->hardBypassed && this->hardBypassDelaySamples >= 0)
             {
-                if (this->inputAudioBuffers.size() == 1)
+                this->hardBypassSamplesRemaining -= samples;
+                if (this->hardBypassSamplesRemaining <= 0)
                 {
-                    CopyBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[0], samples);
-                    CopyBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[1], samples);
-                }
-                else
-                {
-                    CopyBuffer(this->inputAudioBuffers[0], this->outputAudioBuffers[0], samples);
-                    CopyBuffer(this->inputAudioBuffers[1], this->outputAudioBuffers[1], samples);
+                    this->hardBypassed = true;
                 }
             }
         } // else leave the output alone.
     }
     else
     {
-        double currentBypass = this->currentBypass;
-        double currentBypassDx = this->currentBypassDx;
-        int32_t bypassSamplesRemaining = (int)this->bypassSamplesRemaining;
+        uint32_t fadeFrames = std::min(samples, this->bypassSamplesRemaining);
+        CrossfadeInputToOutput(fadeFrames);
 
-        if (this->outputAudioBuffers.size() == 1)
+        this->bypassSamplesRemaining -= fadeFrames;
+        if (this->bypassSamplesRemaining == 0)
         {
-            float *input = this->inputAudioBuffers[0];
-            float *output = this->outputAudioBuffers[0];
-            for (uint32_t i = 0; i < samples; ++i)
-            {
-                output[i] = currentBypass * output[i] + (1 - currentBypass) * input[i];
-
-                if (--bypassSamplesRemaining == 0)
-                {
-                    currentBypassDx = 0;
-                    currentBypass = this->targetBypass;
-                }
-                currentBypass += currentBypassDx;
-            }
-        }
-        else
-        {
-            float *inputL;
-            float *inputR;
-            if (this->inputAudioBuffers.size() == 1)
-            {
-                inputL = inputR = inputAudioBuffers[0];
-            }
-            else
-            {
-                inputL = inputAudioBuffers[0];
-                inputR = inputAudioBuffers[1];
-            }
-            float *outputL = outputAudioBuffers[0];
-            float *outputR = outputAudioBuffers[1];
-            for (uint32_t i = 0; i < samples; ++i)
-            {
-                outputL[i] = currentBypass * outputL[i] + (1 - currentBypass) * inputL[i];
-                outputR[i] = currentBypass * outputR[i] + (1 - currentBypass) * inputR[i];
-                if (--bypassSamplesRemaining == 0)
-                {
-                    currentBypassDx = 0;
-                    currentBypass = this->targetBypass;
-                }
-                currentBypass += currentBypassDx;
-            }
-        }
-        if (bypassSamplesRemaining <= 0)
-        {
-            this->bypassSamplesRemaining = 0;
             this->currentBypass = this->targetBypass;
             this->currentBypassDx = 0;
+            if (this->targetBypass == 0 && fadeFrames != samples)
+            {
+                CopyInputToOutput(fadeFrames, samples - fadeFrames);
+            }
         }
         else
         {
-            this->currentBypass = currentBypass;
-            this->currentBypassDx = currentBypassDx;
-            this->bypassSamplesRemaining = bypassSamplesRemaining;
+            this->currentBypass += this->currentBypassDx * fadeFrames;
         }
     }
-    RelayPatchSetMessages(this->instanceId, realtimeRingBufferWriter);
+    if (runPlugin)
+    {
+        RelayPatchSetMessages(this->instanceId, realtimeRingBufferWriter);
+    }
 }
 
 LV2_Worker_Status Lv2Effect::worker_schedule_fn(LV2_Worker_Schedule_Handle handle,
@@ -651,6 +737,14 @@ void Lv2Effect::ResetOutputAtomBuffer(char *data)
 void Lv2Effect::BypassTo(float targetValue)
 {
     this->targetBypass = targetValue;
+    if (targetValue != 0)
+    {
+        this->hardBypassed = false;
+    }
+    else
+    {
+        this->hardBypassSamplesRemaining = this->hardBypassDelaySamples;
+    }
     double dx = targetValue - this->currentBypass;
     if (dx != 0)
     {
@@ -711,6 +805,11 @@ void Lv2Effect::RequestAllPathPatchProperties()
 
 void Lv2Effect::SetPatchProperty(LV2_URID uridUri, size_t size, LV2_Atom *value)
 {
+    if (worker)
+    {
+        // file loads that result from user actions take precedence over background preloading.
+        worker->SetPriority(WorkerPriority::Interactive);
+    }
     lv2_atom_forge_frame_time(&inputForgeRt, 0);
 
     LV2_Atom_Forge_Frame objectFrame;
@@ -912,10 +1011,26 @@ bool Lv2Effect::GetLv2State(Lv2PluginState *state)
 
 void Lv2Effect::OnLogError(const char *message)
 {
-    // only errors get transmitted to the client.
+    // only errors get transmitted to the client. Called with the LogFeature's mutex held, so there is
+    // only one writer at a time.
+    if (this->hasErrorMessage.load(std::memory_order_acquire))
+    {
+        // the previous message hasn't been taken yet.
+        Lv2Log::error(message);
+        return;
+    }
     strncpy(this->errorMessage, message, sizeof(errorMessage));
     errorMessage[sizeof(errorMessage) - 1] = '\0';
-    this->hasErrorMessage = true;
+    this->hasErrorMessage.store(true, std::memory_order_release);
+}
+
+const char *Lv2Effect::TakeErrorMessage()
+{
+    // Copy the message out before releasing the buffer back to the writer.
+    strncpy(this->takenErrorMessage, this->errorMessage, sizeof(takenErrorMessage));
+    takenErrorMessage[sizeof(takenErrorMessage) - 1] = '\0';
+    this->hasErrorMessage.store(false, std::memory_order_release);
+    return this->takenErrorMessage;
 }
 
 void Lv2Effect::OnLogWarning(const char *message)
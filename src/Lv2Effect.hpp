@@ -39,6 +39,7 @@
 #include "AtomBuffer.hpp"
 #include "StateInterface.hpp"
 #include "LogFeature.hpp"
+#include <atomic>
 
 
 namespace pipedal
@@ -61,6 +62,8 @@ namespace pipedal
         FileBrowserFilesFeature fileBrowserFilesFeature;
         std::unique_ptr<StateInterface> stateInterface;
         void RestoreState(PedalboardItem&pedalboardItem);
+        LilvState *pendingPresetState = nullptr; // lilv preset, loaded by the constructor, applied by RestoreInitialState.
+        bool hasPendingPreset = false;
         LogFeature logFeature;
         std::map<std::string,AtomBuffer> patchPropertyPrototypes;
 
@@ -191,12 +194,37 @@ namespace pipedal
         double currentBypassDx = 0;
         uint32_t bypassSamplesRemaining = 0;
 
+        // Once the bypass crossfade has completed, the plugin keeps running on silent input for
+        // hardBypassDelaySamples (so that tails decay, and no stale audio is left in its buffers),
+        // after which lilv_instance_run is no longer called.
+        int64_t hardBypassDelaySamples = -1;
+        int64_t hardBypassSamplesRemaining = 0;
+        bool hardBypassed = false;
+        float *silenceBuffer = nullptr;
+        bool inputsSilenced = false;
+
+        void SilenceAudioInputs(bool silence);
+        bool HasInputAtomEvents() const;
+        void CopyInputToOutput(uint32_t offset, uint32_t frames);
+        void CrossfadeInputToOutput(uint32_t frames);
+
         bool requestStateChangedNotification = false;
 
         void BypassTo(float value);
 
 
     public:
+        // Restore the item's saved state (or its lilv preset). Must be called once after construction, before activation.
+        // Doesn't access the lilv world, so effects of a pedalboard can restore their state concurrently.
+        void RestoreInitialState(PedalboardItem &pedalboardItem);
+        // Wait until file loads that the plugin has scheduled on its worker have executed. Returns false on timeout.
+        bool WaitForPendingWork(std::chrono::steady_clock::time_point deadline);
+
+        bool HasWorker() const { return worker != nullptr; }
+        // The worker's bit in HostWorkerPool::TakePendingResponses(). 0 if the plugin has no worker.
+        uint64_t GetWorkerResponseMask() const { return worker ? worker->GetResponseMask() : 0; }
+        // Deliver worker responses to the plugin. Realtime thread only.
+        void EmitWorkerResponses() { worker->EmitResponses(); }
 
         // non RT-thread use only.
         std::string GetPathPatchProperty(const std::string&propertyUri);
@@ -230,17 +258,28 @@ namespace pipedal
 
         }
 
-        bool hasErrorMessage = false;
+        // Written by the log listener only while hasErrorMessage is false; read by TakeErrorMessage only
+        // while it is true.
+        std::atomic<bool> hasErrorMessage = false;
         char errorMessage[1024];
+        char takenErrorMessage[1024];
     public:
         Lv2Effect(
             IHost *pHost,
             const std::shared_ptr<Lv2PluginInfo> &info,
             PedalboardItem &pedalboardItem);
+        // An instance that isn't bound to a pedalboard item yet (see PluginInstancePool). Call Bind() before use.
+        Lv2Effect(
+            IHost *pHost,
+            const std::shared_ptr<Lv2PluginInfo> &info);
         ~Lv2Effect();
 
-        bool HasErrorMessage() const { return this->hasErrorMessage; }
-        const char*TakeErrorMessage() { this->hasErrorMessage = false; return this->errorMessage; }
+        // Take instance id, bypass, control values, path properties and lilv preset from the pedalboard item.
+        // Must be called before the effect is activated.
+        void Bind(PedalboardItem &pedalboardItem);
+
+        bool HasErrorMessage() const { return this->hasErrorMessage.load(std::memory_order_acquire); }
+        const char*TakeErrorMessage();
 
         virtual void ResetAtomBuffers();
         virtual uint64_t GetInstanceId() const { return instanceId; }
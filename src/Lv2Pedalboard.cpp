@@ -27,6 +27,12 @@
 #include "AudioHost.hpp"
 #include "Lv2EventBufferWriter.hpp"
 #include "Lv2Log.hpp"
+#include "AudioTap.hpp"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
 
 using namespace pipedal;
 
@@ -121,6 +127,15 @@ std::vector<float *> Lv2Pedalboard::PrepareItems(
 
                 if (pLv2Effect)
                 {
+                    if (pLv2Effect->IsLv2Effect())
+                    {
+                        Lv2Effect *effect = dynamic_cast<Lv2Effect *>(pLv2Effect);
+                        this->pendingStateRestores.push_back({effect, &item});
+                        if (effect->HasWorker())
+                        {
+                            this->workerEffects.push_back(effect);
+                        }
+                    }
                     if (pLv2Effect->HasErrorMessage())
                     {
                         std::string error = pLv2Effect->TakeErrorMessage();
@@ -162,10 +177,22 @@ std::vector<float *> Lv2Pedalboard::PrepareItems(
                         }
                     }
 
+                    auto metrics = Metrics::Instance().GetPluginMetrics(item.instanceId(), item.pluginName());
+                    this->pluginMetrics.push_back(metrics);
+                    PluginMetrics *pMetrics = metrics.get();
                     this->processActions.push_back(
-                        [pLv2Effect, this](uint32_t frames)
+                        [pLv2Effect, pMetrics, this](uint32_t frames)
                         {
-                            pLv2Effect->Run(frames, this->ringBufferWriter);
+                            if (this->timePluginsThisCycle)
+                            {
+                                auto start = std::chrono::steady_clock::now();
+                                pLv2Effect->Run(frames, this->ringBufferWriter);
+                                pMetrics->dspTime.Observe(std::chrono::steady_clock::now() - start);
+                            }
+                            else
+                            {
+                                pLv2Effect->Run(frames, this->ringBufferWriter);
+                            }
                         });
                 }
             }
@@ -235,7 +262,24 @@ void Lv2Pedalboard::Prepare(IHost *pHost, Pedalboard &pedalboard, Lv2PedalboardE
         this->pedalboardInputBuffers.push_back(bufferPool.AllocateBuffer<float>(pHost->GetMaxAudioBufferSize()));
     }
 
+    // Construction proceeds in phases. Instantiation accesses the lilv world, which isn't thread-safe, so it
+    // runs serially; state restore (where plugins load models and impulse files) runs concurrently; and then we
+    // wait for file loads that plugins have handed off to their workers. Activation happens when the pedalboard
+    // is published to the audio thread (AudioHost::SetPedalboard).
+    using Clock = std::chrono::steady_clock;
+    auto startTime = Clock::now();
+
+    this->pendingStateRestores.clear();
+    this->hostWorkerPool = pHost->GetHostWorkerPool();
     auto outputs = PrepareItems(pedalboard.items(), this->pedalboardInputBuffers, errorList);
+    auto instantiateTime = Clock::now();
+
+    RestoreInitialStates(errorList);
+    auto restoreTime = Clock::now();
+
+    WaitForPendingWork();
+    auto primeTime = Clock::now();
+
     int nOutputs = pHost->GetNumberOfOutputAudioChannels();
     if (nOutputs == 1)
     {
@@ -255,6 +299,119 @@ void Lv2Pedalboard::Prepare(IHost *pHost, Pedalboard &pedalboard, Lv2PedalboardE
         }
     }
     PrepareMidiMap(pedalboard);
+
+    std::vector<size_t> controlCounts;
+    controlCounts.reserve(realtimeEffects.size());
+    for (IEffect *effect : realtimeEffects)
+    {
+        controlCounts.push_back(effect->GetMaxInputControl());
+    }
+    controlMailbox.Initialize(controlCounts);
+
+    auto ms = [](Clock::duration d)
+    { return std::chrono::duration_cast<std::chrono::milliseconds>(d).count(); };
+    Lv2Log::debug(SS("Pedalboard prepared. instantiate: " << ms(instantiateTime - startTime) << "ms"
+                                                          << " restore state: " << ms(restoreTime - instantiateTime) << "ms"
+                                                          << " worker file loads: " << ms(primeTime - restoreTime) << "ms"
+                                                          << " (" << realtimeEffects.size() << " effects)"));
+}
+
+void Lv2Pedalboard::RestoreInitialStates(Lv2PedalboardErrorList &errorList)
+{
+    // Restores run on this thread, helped by up to (thread count - 1) tasks posted to the host worker pool.
+    // Helpers that start late find nothing left to do, so only the shared state has to outlive this call.
+    struct RestoreState
+    {
+        const std::vector<PendingStateRestore> *restores;
+        size_t count;
+        std::vector<std::string> exceptionMessages;
+        std::atomic<size_t> nextRestore = 0;
+        std::mutex mutex;
+        std::condition_variable cvComplete;
+        size_t completed = 0;
+    };
+    auto state = std::make_shared<RestoreState>();
+    state->restores = &pendingStateRestores;
+    state->count = pendingStateRestores.size();
+    state->exceptionMessages.resize(state->count);
+
+    auto restoreProc = [](RestoreState &state)
+    {
+        size_t restored = 0;
+        while (true)
+        {
+            size_t i = state.nextRestore++;
+            if (i >= state.count)
+            {
+                break;
+            }
+            const PendingStateRestore &pending = (*state.restores)[i];
+            try
+            {
+                pending.effect->RestoreInitialState(*pending.item);
+            }
+            catch (const std::exception &e)
+            {
+                state.exceptionMessages[i] = SS(pending.item->pluginName() << ": " << e.what());
+            }
+            ++restored;
+        }
+        if (restored != 0)
+        {
+            std::lock_guard lock(state.mutex);
+            state.completed += restored;
+            if (state.completed == state.count)
+            {
+                state.cvComplete.notify_all();
+            }
+        }
+    };
+    if (hostWorkerPool && state->count > 1)
+    {
+        size_t helperCount = std::min(hostWorkerPool->GetThreadCount(), state->count) - 1;
+        for (size_t i = 0; i < helperCount; ++i)
+        {
+            hostWorkerPool->Post([state, restoreProc]()
+                                 { restoreProc(*state); });
+        }
+    }
+    restoreProc(*state);
+    {
+        std::unique_lock lock(state->mutex);
+        state->cvComplete.wait(lock, [&state]()
+                               { return state->completed == state->count; });
+    }
+    const std::vector<std::string> &exceptionMessages = state->exceptionMessages;
+
+    for (size_t i = 0; i < pendingStateRestores.size(); ++i)
+    {
+        const auto &pending = pendingStateRestores[i];
+        if (!exceptionMessages[i].empty())
+        {
+            Lv2Log::error(exceptionMessages[i]);
+            errorList.push_back({pending.item->instanceId(), exceptionMessages[i]});
+        }
+        if (pending.effect->HasErrorMessage())
+        {
+            std::string error = pending.effect->TakeErrorMessage();
+            Lv2Log::error(error);
+            errorList.push_back({pending.item->instanceId(), error});
+        }
+    }
+}
+
+void Lv2Pedalboard::WaitForPendingWork()
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (const auto &pending : pendingStateRestores)
+    {
+        if (!pending.effect->WaitForPendingWork(deadline))
+        {
+            Lv2Log::warning(SS(pending.item->pluginName() << ": Timed out waiting for files to load."));
+            break;
+        }
+    }
+    pendingStateRestores.clear();
 }
 
 void Lv2Pedalboard::PrepareMidiMap(const PedalboardItem &pedalboardItem)
@@ -307,6 +464,7 @@ void Lv2Pedalboard::PrepareMidiMap(const PedalboardItem &pedalboardItem)
                     mapping.controlIndex = controlIndex;
                     mapping.midiBinding = binding;
                     mapping.instanceId = pedalboardItem.instanceId();
+                    mapping.canRamp = controlIndex != -1 && !pPortInfo->integer_property() && !pPortInfo->enumeration_property() && !pPortInfo->toggled_property();
                     if (pPortInfo->IsSwitch())
                     {
                         mapping.mappingType = binding.switchControlType() == LATCH_CONTROL_TYPE ? MappingType::Latched : MappingType::Momentary;
@@ -355,6 +513,7 @@ void Lv2Pedalboard::PrepareMidiMap(const Pedalboard &pedalboard)
     std::sort(this->midiMappings.begin(), this->midiMappings.end(),
                 [](const MidiMapping &left, const MidiMapping &right)
                 { return left.key < right.key; });
+    this->activeControlRamps.reserve(this->midiMappings.size());
 }
 void Lv2Pedalboard::Activate()
 {
@@ -362,6 +521,8 @@ void Lv2Pedalboard::Activate()
     {
         this->realtimeEffects[i]->Activate();
     }
+    // responses that arrived while we were being prepared may have had their pending bits taken by the previous pedalboard.
+    this->emitAllWorkerResponses = true;
 }
 void Lv2Pedalboard::Deactivate()
 {
@@ -388,14 +549,35 @@ bool Lv2Pedalboard::Run(float **inputBuffers, float **outputBuffers, uint32_t sa
             return false;
         }
     }
-    for (size_t i = 0; i < samples; ++i)
+    if (trackInputPeak)
+    {
+        float peak = this->inputPeak;
+        for (size_t i = 0; i < samples; ++i)
+        {
+            float volume = this->inputVolume.Tick();
+            for (int c = 0; c < this->pedalboardInputBuffers.size(); ++c)
+            {
+                float value = inputBuffers[c][i];
+                peak = std::max(peak, std::abs(value));
+                this->pedalboardInputBuffers[c][i] = value * volume;
+            }
+        }
+        this->inputPeak = peak;
+    }
+    else
     {
-        float volume = this->inputVolume.Tick();
-        for (int c = 0; c < this->pedalboardInputBuffers.size(); ++c)
+        for (size_t i = 0; i < samples; ++i)
         {
-            this->pedalboardInputBuffers[c][i] = inputBuffers[c][i] * volume;
+            float volume = this->inputVolume.Tick();
+            for (int c = 0; c < this->pedalboardInputBuffers.size(); ++c)
+            {
+                this->pedalboardInputBuffers[c][i] = inputBuffers[c][i] * volume;
+            }
         }
     }
+    EmitWorkerResponses();
+    this->timePluginsThisCycle =
+        Metrics::Instance().IsPluginTimingEnabled() && (++this->timingCycle % Metrics::PLUGIN_TIMING_INTERVAL) == 0;
     for (int i = 0; i < this->processActions.size(); ++i)
     {
         processActions[i](samples);
@@ -419,6 +601,27 @@ bool Lv2Pedalboard::Run(float **inputBuffers, float **outputBuffers, uint32_t sa
     return true;
 }
 
+void Lv2Pedalboard::EmitWorkerResponses()
+{
+    if (workerEffects.empty())
+    {
+        return;
+    }
+    uint64_t pending = hostWorkerPool->TakePendingResponses();
+    if (pending == 0 && !emitAllWorkerResponses)
+    {
+        return;
+    }
+    for (Lv2Effect *effect : workerEffects)
+    {
+        if (emitAllWorkerResponses || (pending & effect->GetWorkerResponseMask()) != 0)
+        {
+            effect->EmitWorkerResponses();
+        }
+    }
+    emitAllWorkerResponses = false;
+}
+
 float Lv2Pedalboard::GetControlOutputValue(int effectIndex, int portIndex)
 {
     auto effect = realtimeEffects[effectIndex];
@@ -427,9 +630,84 @@ float Lv2Pedalboard::GetControlOutputValue(int effectIndex, int portIndex)
 
 void Lv2Pedalboard::SetControlValue(int effectIndex, int index, float value)
 {
+    if (activeControlRamps.size() != 0)
+    {
+        CancelControlRamp(effectIndex, index);
+    }
     auto effect = realtimeEffects[effectIndex];
     effect->SetControl(index, value);
 }
+
+void Lv2Pedalboard::ApplyPendingControlValues()
+{
+    controlMailbox.Apply(
+        [this](int effectIndex, int controlIndex, float value)
+        {
+            SetControlValue(effectIndex, controlIndex, value);
+        });
+}
+
+void Lv2Pedalboard::StartControlRamp(MidiMapping &mapping, float targetValue)
+{
+    IEffect *pEffect = this->realtimeEffects[mapping.effectIndex];
+    if (mapping.rampSamplesRemaining == 0)
+    {
+        mapping.rampValue = pEffect->GetControlValue(mapping.controlIndex);
+        activeControlRamps.push_back(&mapping);
+    }
+    mapping.rampTarget = targetValue;
+    mapping.rampSamplesRemaining = controlSmoothingSamples;
+    mapping.rampDx = (targetValue - mapping.rampValue) / controlSmoothingSamples;
+}
+
+void Lv2Pedalboard::TickControlRamps(uint32_t samples)
+{
+    for (size_t i = 0; i < activeControlRamps.size(); /**/)
+    {
+        MidiMapping *mapping = activeControlRamps[i];
+        IEffect *pEffect = this->realtimeEffects[mapping->effectIndex];
+        if (mapping->rampSamplesRemaining <= samples)
+        {
+            mapping->rampSamplesRemaining = 0;
+            mapping->rampValue = mapping->rampTarget;
+            pEffect->SetControl(mapping->controlIndex, mapping->rampTarget);
+
+            activeControlRamps[i] = activeControlRamps[activeControlRamps.size() - 1];
+            activeControlRamps.pop_back();
+        }
+        else
+        {
+            mapping->rampSamplesRemaining -= samples;
+            mapping->rampValue += mapping->rampDx * samples;
+            pEffect->SetControl(mapping->controlIndex, mapping->rampValue);
+            ++i;
+        }
+    }
+}
+
+void Lv2Pedalboard::CancelControlRamp(int effectIndex, int controlIndex)
+{
+    for (size_t i = 0; i < activeControlRamps.size(); ++i)
+    {
+        MidiMapping *mapping = activeControlRamps[i];
+        if (mapping->effectIndex == effectIndex && mapping->controlIndex == controlIndex)
+        {
+            mapping->rampSamplesRemaining = 0;
+            activeControlRamps[i] = activeControlRamps[activeControlRamps.size() - 1];
+            activeControlRamps.pop_back();
+            return;
+        }
+    }
+}
+
+void Lv2Pedalboard::CancelControlRamps()
+{
+    for (MidiMapping *mapping : activeControlRamps)
+    {
+        mapping->rampSamplesRemaining = 0;
+    }
+    activeControlRamps.clear();
+}
 void Lv2Pedalboard::SetBypass(int effectIndex, bool enabled)
 {
     auto effect = realtimeEffects[effectIndex];
@@ -498,6 +776,67 @@ void Lv2Pedalboard::ComputeVus(RealtimeVuBuffers *vuConfiguration, uint32_t samp
     }
 }
 
+static const float *GetDriverBuffer(float **buffers, int channel)
+{
+    // null-terminated.
+    int i = 0;
+    while (buffers[i] != nullptr && i < channel)
+    {
+        ++i;
+    }
+    if (buffers[i] == nullptr)
+    {
+        return i == 0 ? nullptr : buffers[i - 1];
+    }
+    return buffers[i];
+}
+
+void Lv2Pedalboard::ProcessAudioTaps(RealtimeAudioTaps *audioTaps, uint32_t samples, float **inputBuffers, float **outputBuffers)
+{
+    for (const auto &tap : audioTaps->taps)
+    {
+        const float *buffer = nullptr;
+        if (tap.effectIndex == Pedalboard::INPUT_VOLUME_ID)
+        {
+            if (tap.output)
+            {
+                buffer = this->pedalboardInputBuffers[std::min((size_t)tap.channel, pedalboardInputBuffers.size() - 1)];
+            }
+            else
+            {
+                buffer = GetDriverBuffer(inputBuffers, tap.channel);
+            }
+        }
+        else if (tap.effectIndex == Pedalboard::OUTPUT_VOLUME_ID)
+        {
+            if (tap.output)
+            {
+                buffer = GetDriverBuffer(outputBuffers, tap.channel);
+            }
+            else
+            {
+                buffer = this->pedalboardOutputBuffers[std::min((size_t)tap.channel, pedalboardOutputBuffers.size() - 1)];
+            }
+        }
+        else
+        {
+            auto effect = this->realtimeEffects[tap.effectIndex];
+            if (tap.output)
+            {
+                buffer = effect->GetAudioOutputBuffer(std::min(tap.channel, effect->GetNumberOfOutputAudioPorts() - 1));
+            }
+            else
+            {
+                buffer = effect->GetAudioInputBuffer(std::min(tap.channel, effect->GetNumberOfInputAudioPorts() - 1));
+            }
+        }
+        if (buffer)
+        {
+            tap.ring->Write(buffer, samples);
+        }
+    }
+}
+
 void Lv2Pedalboard::ResetAtomBuffers()
 {
     for (size_t i = 0; i < this->effects.size(); ++i)
@@ -676,7 +1015,14 @@ void Lv2Pedalboard::OnMidiMessage(size_t size, uint8_t *message,
                 {
                     float thisRange = (mapping.midiBinding.maxValue() - mapping.midiBinding.minValue()) * range + mapping.midiBinding.minValue();
                     float value = mapping.pPortInfo->rangeToValue(thisRange);
-                    this->SetControlValue(mapping.effectIndex, mapping.controlIndex, value);
+                    if (controlSmoothingSamples != 0 && mapping.canRamp)
+                    {
+                        StartControlRamp(mapping, value);
+                    }
+                    else
+                    {
+                        this->SetControlValue(mapping.effectIndex, mapping.controlIndex, value);
+                    }
                     pfnCallback(callbackHandle, mapping.instanceId, mapping.pPortInfo->index(), value);
                     break;
                 }
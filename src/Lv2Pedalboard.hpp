@@ -26,12 +26,15 @@
 #include <lv2/urid/urid.h>
 #include <functional>
 #include "DbDezipper.hpp"
+#include "Metrics.hpp"
+#include "ControlMailbox.hpp"
 
 namespace pipedal
 {
 
     class IPatchWriterCallback;
     class RealtimeVuBuffers;
+    class RealtimeAudioTaps;
     class RealtimePatchPropertyRequest;
     class RealtimeRingBufferWriter;
 
@@ -51,6 +54,8 @@ namespace pipedal
 
         DbDezipper inputVolume;
         DbDezipper outputVolume;
+        bool trackInputPeak = false;
+        float inputPeak = 0;
 
         BufferPool bufferPool;
         std::vector<float *> pedalboardInputBuffers;
@@ -68,6 +73,10 @@ namespace pipedal
 
         std::vector<Action> deactivateActions;
 
+        std::vector<std::shared_ptr<PluginMetrics>> pluginMetrics; // keeps per-plugin metrics registered while the pedalboard is alive.
+        uint32_t timingCycle = 0;
+        bool timePluginsThisCycle = false;
+
         float *CreateNewAudioBuffer();
 
         RealtimeRingBufferWriter *ringBufferWriter;
@@ -92,15 +101,45 @@ namespace pipedal
             float lastValue = -1;
             MappingType mappingType;
             MidiBinding midiBinding;
+
+            // host-side smoothing of continuous controls.
+            bool canRamp = false;
+            float rampValue = 0;
+            float rampTarget = 0;
+            float rampDx = 0;
+            uint32_t rampSamplesRemaining = 0;
         };
 
         std::vector<MidiMapping> midiMappings;
 
+        uint32_t controlSmoothingSamples = 0;
+        ControlMailbox controlMailbox;
+
+        std::vector<MidiMapping *> activeControlRamps; // capacity reserved in PrepareMidiMap. Realtime-safe.
+        void StartControlRamp(MidiMapping &mapping, float targetValue);
+        void CancelControlRamp(int effectIndex, int controlIndex);
+
         std::vector<float *> PrepareItems(
             std::vector<PedalboardItem> &items,
             std::vector<float *> inputBuffers,
             Lv2PedalboardErrorList &errorList);
 
+        // Effects created by PrepareItems whose state hasn't been restored yet. (Valid only during Prepare).
+        struct PendingStateRestore
+        {
+            Lv2Effect *effect;
+            PedalboardItem *item;
+        };
+        std::vector<PendingStateRestore> pendingStateRestores;
+
+        // Effects that have workers; their responses are delivered by EmitWorkerResponses.
+        std::vector<Lv2Effect *> workerEffects;
+        std::shared_ptr<HostWorkerPool> hostWorkerPool;
+        bool emitAllWorkerResponses = true;
+        void EmitWorkerResponses();
+        void RestoreInitialStates(Lv2PedalboardErrorList &errorList);
+        void WaitForPendingWork();
+
         void PrepareMidiMap(const Pedalboard &pedalboard);
         void PrepareMidiMap(const PedalboardItem &pedalboardItem);
 
@@ -116,6 +155,9 @@ namespace pipedal
 
         std::vector<IEffect *> &GetEffects() { return realtimeEffects; }
 
+        // Approximate memory used by the pedalboard's audio buffers, in bytes.
+        size_t GetBufferMemoryUse() const { return bufferPool.GetBytesAllocated(); }
+
         int GetIndexOfInstanceId(uint64_t instanceId)
         {
             for (int i = 0; i < this->realtimeEffects.size(); ++i)
@@ -151,11 +193,25 @@ namespace pipedal
 
         int GetControlIndex(uint64_t instanceId, const std::string &symbol);
         void SetControlValue(int effectIndex, int portIndex, float value);
+
+        // Non-realtime control changes. Written from any thread; applied by ApplyPendingControlValues on the audio thread.
+        ControlMailbox &GetControlMailbox() { return controlMailbox; }
+        void ApplyPendingControlValues();
         void SetInputVolume(float value) { this->inputVolume.SetTarget(value); }
+        // Track the peak absolute value of the input (before input volume) while running.
+        void SetTrackInputPeak(bool track) { this->trackInputPeak = track; }
+        // The peak input value since the last call.
+        float TakeInputPeak()
+        {
+            float result = this->inputPeak;
+            this->inputPeak = 0;
+            return result;
+        }
         void SetOutputVolume(float value) { this->outputVolume.SetTarget(value); }
         void SetBypass(int effectIndex, bool enabled);
 
         void ComputeVus(RealtimeVuBuffers *vuConfiguration, uint32_t samples, float **inputBuffers, float **outputBuffers);
+        void ProcessAudioTaps(RealtimeAudioTaps *audioTaps, uint32_t samples, float **inputBuffers, float **outputBuffers);
 
         float GetControlOutputValue(int effectIndex, int portIndex);
 
@@ -163,6 +219,15 @@ namespace pipedal
         void OnMidiMessage(size_t size, uint8_t *data,
                            void *callbackHandle,
                            MidiCallbackFn *pfnCallback);
+
+        // Ramp MIDI-bound continuous controls over the given number of samples instead of jumping
+        // to the new value. Ramps advance in TickControlRamps, so they only sound smooth if the
+        // caller runs the pedalboard in sub-blocks. 0 disables smoothing.
+        void SetControlSmoothingSamples(uint32_t samples) { this->controlSmoothingSamples = samples; }
+        bool HasControlRamps() const { return activeControlRamps.size() != 0; }
+        // Call after running a block of the given size; sets ramped controls to their values for the start of the next block.
+        void TickControlRamps(uint32_t samples);
+        void CancelControlRamps();
     };
 
 } // namespace
\ No newline at end of file
@@ -19,6 +19,17 @@
 
 #include "MapFeature.hpp"
 #include <mutex>
+#include <cstring>
+#include "lv2/atom/atom.h"
+#include "lv2/midi/midi.h"
+#include "lv2/patch/patch.h"
+#include "lv2/state/state.h"
+#include "lv2/time/time.h"
+#include "lv2/units/units.h"
+#include "lv2/parameters/parameters.h"
+#include "lv2/worker/worker.h"
+#include "lv2/lv2plug.in/ns/ext/buf-size/buf-size.h"
+#include "lv2/lv2plug.in/ns/ext/options/options.h"
 
 using namespace pipedal;
 
@@ -33,6 +44,84 @@ static const char* unmapFn(LV2_URID_Map_Handle handle, LV2_URID urid)
 	return feature->UridToString(urid);
 }
 
+// URIs that nearly every plugin maps at instantiation time.
+static const char *wellKnownUris[] = {
+    LV2_ATOM__Atom,
+    LV2_ATOM__AtomPort,
+    LV2_ATOM__Blank,
+    LV2_ATOM__Bool,
+    LV2_ATOM__Chunk,
+    LV2_ATOM__Double,
+    LV2_ATOM__Event,
+    LV2_ATOM__Float,
+    LV2_ATOM__Int,
+    LV2_ATOM__Literal,
+    LV2_ATOM__Long,
+    LV2_ATOM__Number,
+    LV2_ATOM__Object,
+    LV2_ATOM__Path,
+    LV2_ATOM__Property,
+    LV2_ATOM__Resource,
+    LV2_ATOM__Sequence,
+    LV2_ATOM__Sound,
+    LV2_ATOM__String,
+    LV2_ATOM__Tuple,
+    LV2_ATOM__URI,
+    LV2_ATOM__URID,
+    LV2_ATOM__Vector,
+    LV2_ATOM__beatTime,
+    LV2_ATOM__frameTime,
+    LV2_ATOM__eventTransfer,
+    LV2_ATOM__atomTransfer,
+    LV2_MIDI__MidiEvent,
+    LV2_PATCH__Get,
+    LV2_PATCH__Set,
+    LV2_PATCH__Put,
+    LV2_PATCH__Patch,
+    LV2_PATCH__Message,
+    LV2_PATCH__property,
+    LV2_PATCH__value,
+    LV2_PATCH__subject,
+    LV2_PATCH__body,
+    LV2_PATCH__writable,
+    LV2_PATCH__readable,
+    LV2_STATE__StateChanged,
+    LV2_TIME__Position,
+    LV2_TIME__bar,
+    LV2_TIME__barBeat,
+    LV2_TIME__beat,
+    LV2_TIME__beatUnit,
+    LV2_TIME__beatsPerBar,
+    LV2_TIME__beatsPerMinute,
+    LV2_TIME__frame,
+    LV2_TIME__speed,
+    LV2_UNITS__frame,
+    LV2_UNITS__beat,
+    LV2_UNITS__s,
+    LV2_UNITS__ms,
+    LV2_UNITS__hz,
+    LV2_UNITS__db,
+    LV2_PARAMETERS__sampleRate,
+    LV2_BUF_SIZE__maxBlockLength,
+    LV2_BUF_SIZE__minBlockLength,
+    LV2_BUF_SIZE__nominalBlockLength,
+    LV2_BUF_SIZE__sequenceSize,
+    LV2_OPTIONS__options,
+    LV2_OPTIONS__interface,
+    LV2_WORKER__schedule,
+    LV2_WORKER__interface,
+};
+
+MapFeature::HashIndex::HashIndex(size_t size)
+    : mask(size - 1),
+      slots(size)
+{
+    for (auto &slot : slots)
+    {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
 MapFeature::MapFeature()
 {
 	mapFeature.URI = LV2_URID__map;
@@ -44,39 +133,170 @@ MapFeature::MapFeature()
     unmapFeature.data = &unmap;
     unmap.handle = (void*)this;
     unmap.unmap = &unmapFn;
+
+    for (auto &chunk : unmapChunks)
+    {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    hashIndex.store(new HashIndex(1024), std::memory_order_release);
+    PreSeed();
 }
 
 MapFeature::~MapFeature()
 {
-    for (auto i = stdUnmap.begin(); i != stdUnmap.end(); ++i)
+    for (auto &chunk : unmapChunks)
+    {
+        UnmapChunk *pChunk = chunk.load();
+        if (pChunk == nullptr)
+        {
+            break;
+        }
+        for (auto &entry : *pChunk)
+        {
+            delete entry.load();
+        }
+        delete[] pChunk;
+    }
+    delete hashIndex.load();
+    for (HashIndex *index : retiredIndexes)
     {
-        delete i->second;
+        delete index;
     }
 }
 
-LV2_URID MapFeature::GetUrid(const char* uri)
+void MapFeature::PreSeed()
 {
+    for (const char *uri : wellKnownUris)
+    {
+        GetUrid(uri);
+    }
+}
 
-	std::lock_guard<std::mutex> guard(mapMutex);
-
-	LV2_URID result = stdMap[uri];
-	if (result == 0)
-	{
-		stdMap[uri] = ++nextAtom;
-		result = nextAtom;
-        std::string *stringRef = new std::string(uri);
-        stdUnmap[result] = stringRef;
-	}
-	return result;
+uint32_t MapFeature::Hash(const char *uri)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char *p = uri; *p != 0; ++p)
+    {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-const char*MapFeature::UridToString(LV2_URID urid)
+const MapFeature::Entry *MapFeature::Find(const HashIndex *index, const char *uri, uint32_t hash)
 {
-	std::lock_guard<std::mutex> guard(mapMutex);
+    size_t slot = hash & index->mask;
+    while (true)
+    {
+        const Entry *entry = index->slots[slot].load(std::memory_order_acquire);
+        if (entry == nullptr)
+        {
+            return nullptr;
+        }
+        if (entry->hash == hash && std::strcmp(entry->uri.c_str(), uri) == 0)
+        {
+            return entry;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+}
 
-    std::string*pResult = stdUnmap[urid];
-    if (pResult == nullptr) return nullptr;
+void MapFeature::Insert(HashIndex *index, const Entry *entry)
+{
+    size_t slot = entry->hash & index->mask;
+    while (index->slots[slot].load(std::memory_order_relaxed) != nullptr)
+    {
+        slot = (slot + 1) & index->mask;
+    }
+    index->slots[slot].store(entry, std::memory_order_release);
+    ++index->count;
+}
 
-    return pResult->c_str();
+LV2_URID MapFeature::Add(const char *uri, uint32_t hash)
+{
+    std::lock_guard<std::mutex> guard(mapMutex);
 
+    HashIndex *index = hashIndex.load(std::memory_order_relaxed);
+    // another thread may have added it in the meantime.
+    const Entry *existing = Find(index, uri, hash);
+    if (existing)
+    {
+        return existing->urid;
+    }
+
+    LV2_URID urid = nextAtom + 1;
+    size_t chunkIndex = urid >> UNMAP_CHUNK_BITS;
+    if (chunkIndex >= MAX_UNMAP_CHUNKS)
+    {
+        return 0; // table full. (0 is the LV2 error value)
+    }
+    ++nextAtom;
+
+    Entry *entry = new Entry{uri, hash, urid};
+
+    UnmapChunk *chunk = unmapChunks[chunkIndex].load(std::memory_order_relaxed);
+    if (chunk == nullptr)
+    {
+        chunk = new UnmapChunk[1];
+        for (auto &slot : *chunk)
+        {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+        unmapChunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    (*chunk)[urid & (UNMAP_CHUNK_SIZE - 1)].store(entry, std::memory_order_release);
+
+    if ((index->count + 1) * 2 > index->slots.size())
+    {
+        // grow, and publish the new index. Readers of the old index fall through to this (locked) path on a miss.
+        HashIndex *newIndex = new HashIndex(index->slots.size() * 2);
+        for (auto &slot : index->slots)
+        {
+            const Entry *e = slot.load(std::memory_order_relaxed);
+            if (e)
+            {
+                Insert(newIndex, e);
+            }
+        }
+        Insert(newIndex, entry);
+        hashIndex.store(newIndex, std::memory_order_release);
+        retiredIndexes.push_back(index);
+    }
+    else
+    {
+        Insert(index, entry);
+    }
+    return urid;
+}
+
+LV2_URID MapFeature::GetUrid(const char* uri)
+{
+    uint32_t hash = Hash(uri);
+    const Entry *entry = Find(hashIndex.load(std::memory_order_acquire), uri, hash);
+    if (entry)
+    {
+        return entry->urid;
+    }
+    return Add(uri, hash);
+}
+
+const char*MapFeature::UridToString(LV2_URID urid)
+{
+    size_t chunkIndex = urid >> UNMAP_CHUNK_BITS;
+    if (chunkIndex >= MAX_UNMAP_CHUNKS)
+    {
+        return nullptr;
+    }
+    UnmapChunk *chunk = unmapChunks[chunkIndex].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+    {
+        return nullptr;
+    }
+    const Entry *entry = (*chunk)[urid & (UNMAP_CHUNK_SIZE - 1)].load(std::memory_order_acquire);
+    if (entry == nullptr)
+    {
+        return nullptr;
+    }
+    return entry->uri.c_str();
 }
@@ -27,28 +27,62 @@
 #include "lv2/midi/midi.h"
 #include "lv2/urid/urid.h"
 #include "lv2/atom/atom.h"
-#include <map>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <mutex>
+#include <vector>
 
 
 namespace pipedal {
+	/// @brief URID map/unmap feature.
+	///
+	/// Reads are lock-free and never allocate. The table is append-only: new URIs are added under a mutex,
+	/// and the hash index is republished atomically when it grows. Retired indexes are kept until destruction,
+	/// since readers may still hold them.
 	class MapFeature {
 
 	private:
+		struct Entry {
+			std::string uri;
+			uint32_t hash;
+			LV2_URID urid;
+		};
+		struct HashIndex {
+			HashIndex(size_t size);
+			size_t mask;
+			size_t count = 0;
+			std::vector<std::atomic<const Entry*>> slots;
+		};
+
+		static constexpr size_t UNMAP_CHUNK_BITS = 10;
+		static constexpr size_t UNMAP_CHUNK_SIZE = 1 << UNMAP_CHUNK_BITS;
+		static constexpr size_t MAX_UNMAP_CHUNKS = 1024; // ~1M URIDs.
+
+		using UnmapChunk = std::atomic<const Entry*>[UNMAP_CHUNK_SIZE];
+
 		LV2_URID nextAtom = 0;
 		LV2_Feature mapFeature;
 		LV2_Feature unmapFeature;
 		LV2_URID_Map map;
 		LV2_URID_Unmap unmap;
-		std::map<std::string, LV2_URID> stdMap;
-		std::map<LV2_URID, std::string*> stdUnmap;
-		std::mutex mapMutex;
 
+		std::atomic<HashIndex*> hashIndex;
+		std::vector<HashIndex*> retiredIndexes;
+		std::atomic<UnmapChunk*> unmapChunks[MAX_UNMAP_CHUNKS];
+		std::mutex mapMutex; // writers only.
+
+		static uint32_t Hash(const char *uri);
+		static const Entry *Find(const HashIndex *index, const char *uri, uint32_t hash);
+		static void Insert(HashIndex *index, const Entry *entry);
+		LV2_URID Add(const char *uri, uint32_t hash);
+		void PreSeed();
 
 	public:
 		MapFeature();
         ~MapFeature();
+		MapFeature(const MapFeature&) = delete;
+		MapFeature&operator=(const MapFeature&) = delete;
 	public:
 		const LV2_Feature* GetMapFeature()
 		{
@@ -0,0 +1,163 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "MapFeature.hpp"
+#include "catch.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+
+using namespace pipedal;
+
+static std::string TestUri(int i)
+{
+    return "http://example.com/test#uri" + std::to_string(i);
+}
+
+TEST_CASE("MapFeature map/unmap", "[map_feature][Build][Dev]")
+{
+    MapFeature mapFeature;
+
+    // well-known URIs are pre-seeded, and map consistently.
+    LV2_URID atomFloat = mapFeature.GetUrid(LV2_ATOM__Float);
+    REQUIRE(atomFloat != 0);
+    REQUIRE(mapFeature.GetUrid(LV2_ATOM__Float) == atomFloat);
+    REQUIRE(std::strcmp(mapFeature.UridToString(atomFloat), LV2_ATOM__Float) == 0);
+
+    LV2_URID a = mapFeature.GetUrid("http://example.com/test#a");
+    LV2_URID b = mapFeature.GetUrid("http://example.com/test#b");
+    REQUIRE(a != 0);
+    REQUIRE(b != 0);
+    REQUIRE(a != b);
+    REQUIRE(a != atomFloat);
+    REQUIRE(mapFeature.GetUrid("http://example.com/test#a") == a);
+    REQUIRE(std::string(mapFeature.UridToString(a)) == "http://example.com/test#a");
+    REQUIRE(std::string(mapFeature.UridToString(b)) == "http://example.com/test#b");
+
+    // unknown URIDs.
+    REQUIRE(mapFeature.UridToString(0) == nullptr);
+    REQUIRE(mapFeature.UridToString(b + 1000) == nullptr);
+    REQUIRE(mapFeature.UridToString(0xFFFFFFFFu) == nullptr);
+
+    // through the LV2 features.
+    const LV2_Feature *mapLv2Feature = mapFeature.GetMapFeature();
+    REQUIRE(std::string(mapLv2Feature->URI) == LV2_URID__map);
+    LV2_URID_Map *map = (LV2_URID_Map *)mapLv2Feature->data;
+    REQUIRE(map->map(map->handle, "http://example.com/test#a") == a);
+
+    const LV2_Feature *unmapLv2Feature = mapFeature.GetUnmapFeature();
+    REQUIRE(std::string(unmapLv2Feature->URI) == LV2_URID__unmap);
+    LV2_URID_Unmap *unmap = (LV2_URID_Unmap *)unmapLv2Feature->data;
+    REQUIRE(std::string(unmap->unmap(unmap->handle, b)) == "http://example.com/test#b");
+}
+
+TEST_CASE("MapFeature growth", "[map_feature][Build][Dev]")
+{
+    // enough URIs to grow the hash index several times, and to span several unmap chunks.
+    constexpr int N = 5000;
+    MapFeature mapFeature;
+    std::vector<LV2_URID> urids;
+    for (int i = 0; i < N; ++i)
+    {
+        LV2_URID urid = mapFeature.GetUrid(TestUri(i).c_str());
+        REQUIRE(urid != 0);
+        if (i != 0)
+        {
+            REQUIRE(urid == urids.back() + 1);
+        }
+        urids.push_back(urid);
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        REQUIRE(mapFeature.GetUrid(TestUri(i).c_str()) == urids[i]);
+        REQUIRE(mapFeature.UridToString(urids[i]) == TestUri(i));
+    }
+}
+
+TEST_CASE("MapFeature concurrent access", "[map_feature][Build][Dev]")
+{
+    // readers map existing URIs while writers add new ones (growing the index underneath the readers).
+    constexpr int N_EXISTING = 500;
+    constexpr int N_NEW = 4000;
+    MapFeature mapFeature;
+    std::vector<LV2_URID> existing;
+    for (int i = 0; i < N_EXISTING; ++i)
+    {
+        existing.push_back(mapFeature.GetUrid(TestUri(i).c_str()));
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int> readerErrors{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t)
+    {
+        readers.emplace_back(
+            [&]()
+            {
+                while (!done)
+                {
+                    for (int i = 0; i < N_EXISTING; ++i)
+                    {
+                        std::string uri = TestUri(i);
+                        if (mapFeature.GetUrid(uri.c_str()) != existing[i])
+                        {
+                            ++readerErrors;
+                        }
+                        const char *unmapped = mapFeature.UridToString(existing[i]);
+                        if (unmapped == nullptr || uri != unmapped)
+                        {
+                            ++readerErrors;
+                        }
+                    }
+                }
+            });
+    }
+    // two writers adding overlapping URIs must agree on their URIDs.
+    std::vector<LV2_URID> writerResults[2];
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t)
+    {
+        writers.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < N_NEW; ++i)
+                {
+                    writerResults[t].push_back(mapFeature.GetUrid(TestUri(N_EXISTING + i).c_str()));
+                }
+            });
+    }
+    for (auto &writer : writers)
+    {
+        writer.join();
+    }
+    done = true;
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(readerErrors == 0);
+    REQUIRE(writerResults[0] == writerResults[1]);
+    for (int i = 0; i < N_NEW; ++i)
+    {
+        REQUIRE(mapFeature.UridToString(writerResults[0][i]) == TestUri(N_EXISTING + i));
+    }
+}
@@ -0,0 +1,609 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "MediaIndex.hpp"
+#include "Lv2Log.hpp"
+#include "ss.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <poll.h>
+
+using namespace pipedal;
+namespace fs = std::filesystem;
+
+static bool IsHiddenFile(const FileEntry &entry)
+{
+    return !entry.isDirectory_ && (entry.displayName_.empty() || entry.displayName_[0] == '.');
+}
+
+static bool IsListable(const fs::path &path)
+{
+    // regular files and directories (or symlinks to them) only. No sockets, fifos or devices.
+    std::error_code ec;
+    auto status = fs::status(path, ec);
+    return !ec && (fs::is_regular_file(status) || fs::is_directory(status));
+}
+
+static std::string DirectoryKey(const fs::path &directory)
+{
+    std::string key = directory.lexically_normal().string();
+    while (key.length() > 1 && key.ends_with('/'))
+    {
+        key.resize(key.length() - 1);
+    }
+    return key;
+}
+
+static constexpr uint32_t WATCH_MASK =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+static uint16_t ReadLe16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+static uint32_t ReadLe32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void ReadWavMetadata(const fs::path &path, FileEntry *entry)
+{
+    std::ifstream f(path, std::ios_base::binary);
+    uint8_t header[12];
+    if (!f.read((char *)header, sizeof(header)))
+        return;
+    if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+        return;
+
+    uint16_t blockAlign = 0;
+    while (true)
+    {
+        uint8_t chunkHeader[8];
+        if (!f.read((char *)chunkHeader, sizeof(chunkHeader)))
+            return;
+        uint32_t chunkSize = ReadLe32(chunkHeader + 4);
+        if (memcmp(chunkHeader, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            if (chunkSize < sizeof(fmt) || !f.read((char *)fmt, sizeof(fmt)))
+                return;
+            entry->channels_ = ReadLe16(fmt + 2);
+            entry->sampleRate_ = ReadLe32(fmt + 4);
+            blockAlign = ReadLe16(fmt + 12);
+            f.seekg(chunkSize - sizeof(fmt) + (chunkSize & 1), std::ios_base::cur);
+        }
+        else if (memcmp(chunkHeader, "data", 4) == 0)
+        {
+            if (blockAlign != 0 && entry->sampleRate_ != 0)
+            {
+                entry->duration_ = (float)((double)(chunkSize / blockAlign) / entry->sampleRate_);
+            }
+            return;
+        }
+        else
+        {
+            f.seekg(chunkSize + (chunkSize & 1), std::ios_base::cur);
+        }
+    }
+}
+
+static void ReadFlacMetadata(const fs::path &path, FileEntry *entry)
+{
+    std::ifstream f(path, std::ios_base::binary);
+    uint8_t header[8 + 18]; // "fLaC", block header, STREAMINFO
+    if (!f.read((char *)header, sizeof(header)))
+        return;
+    if (memcmp(header, "fLaC", 4) != 0 || (header[4] & 0x7F) != 0)
+        return;
+    const uint8_t *streamInfo = header + 8;
+    const uint8_t *p = streamInfo + 10;
+    uint32_t sampleRate = ((uint32_t)p[0] << 12) | ((uint32_t)p[1] << 4) | (p[2] >> 4);
+    uint32_t channels = ((p[2] >> 1) & 0x07) + 1;
+    uint64_t totalSamples = ((uint64_t)(p[3] & 0x0F) << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | p[7];
+    entry->sampleRate_ = sampleRate;
+    entry->channels_ = channels;
+    if (sampleRate != 0)
+    {
+        entry->duration_ = (float)((double)totalSamples / sampleRate);
+    }
+}
+
+static void ReadNamMetadata(const fs::path &path, FileEntry *entry)
+{
+    // .nam files are JSON, with the (small) "architecture" property preceding the (large) weights.
+    // Look for it in the head of the file rather than parsing the whole file.
+    std::ifstream f(path, std::ios_base::binary);
+    std::string head(16 * 1024, '\0');
+    f.read(head.data(), (std::streamsize)head.size());
+    head.resize((size_t)f.gcount());
+
+    size_t pos = head.find("\"architecture\"");
+    if (pos == std::string::npos)
+        return;
+    pos = head.find(':', pos);
+    if (pos == std::string::npos)
+        return;
+    size_t start = head.find('"', pos);
+    if (start == std::string::npos)
+        return;
+    size_t end = head.find('"', start + 1);
+    if (end == std::string::npos)
+        return;
+    entry->namArchitecture_ = head.substr(start + 1, end - start - 1);
+}
+
+FileEntry MediaIndex::MakeFileEntry(const fs::path &path)
+{
+    FileEntry entry;
+    entry.pathname_ = path.string();
+    entry.displayName_ = path.filename().string();
+
+    std::error_code ec;
+    auto status = fs::symlink_status(path, ec);
+    if (ec)
+    {
+        return entry;
+    }
+    bool isSymlink = fs::is_symlink(status);
+    if (isSymlink)
+    {
+        status = fs::status(path, ec);
+    }
+    entry.isDirectory_ = fs::is_directory(status);
+    entry.isProtected_ = entry.isDirectory_ && isSymlink;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+    {
+        entry.lastModified_ = (int64_t)st.st_mtime;
+        if (!entry.isDirectory_)
+        {
+            entry.fileSize_ = (uint64_t)st.st_size;
+        }
+    }
+    if (fs::is_regular_file(status))
+    {
+        std::string extension = path.extension().string();
+        for (auto &c : extension)
+        {
+            c = (char)std::tolower(c);
+        }
+        try
+        {
+            if (extension == ".wav")
+            {
+                ReadWavMetadata(path, &entry);
+            }
+            else if (extension == ".flac")
+            {
+                ReadFlacMetadata(path, &entry);
+            }
+            else if (extension == ".nam")
+            {
+                ReadNamMetadata(path, &entry);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            // metadata is best-effort.
+        }
+    }
+    return entry;
+}
+
+MediaIndex::MediaIndex()
+{
+}
+
+MediaIndex::~MediaIndex()
+{
+    Close();
+}
+
+void MediaIndex::Close()
+{
+    std::unique_ptr<std::thread> thread;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed)
+            return;
+        closed = true;
+        thread = std::move(monitorThread);
+    }
+    if (thread)
+    {
+        uint64_t val = 1;
+        write(shutdownEventFd, (void *)&val, sizeof(val));
+        thread->join();
+    }
+    if (inotifyFd != -1)
+    {
+        close(inotifyFd); // also removes all watches.
+        inotifyFd = -1;
+    }
+    if (shutdownEventFd != -1)
+    {
+        close(shutdownEventFd);
+        shutdownEventFd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        directories.clear();
+        watchDescriptors.clear();
+    }
+    scanComplete.notify_all();
+}
+
+void MediaIndex::StartMonitor()
+{
+    // mutex held.
+    if (monitorThread || inotifyFd != -1 || closed)
+        return;
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd == -1)
+    {
+        Lv2Log::warning("MediaIndex: Failed to initialize inotify. File listings will not be cached.");
+        return;
+    }
+    shutdownEventFd = eventfd(0, EFD_CLOEXEC);
+    monitorThread = std::make_unique<std::thread>([this]()
+                                                  { ThreadProc(); });
+}
+
+MediaIndex::EntryMap MediaIndex::ScanDirectory(const fs::path &directory)
+{
+    EntryMap result;
+    for (auto const &dir_entry : fs::directory_iterator(directory))
+    {
+        if (dir_entry.is_regular_file() || dir_entry.is_directory())
+        {
+            auto name = dir_entry.path().filename().string();
+            result[name] = MakeFileEntry(dir_entry.path());
+        }
+    }
+    return result;
+}
+
+void MediaIndex::UpdateEntry(EntryMap &entries, const fs::path &directory, const std::string &name, bool deleted)
+{
+    fs::path path = directory / name;
+    if (deleted || !IsListable(path))
+    {
+        entries.erase(name);
+    }
+    else
+    {
+        entries[name] = MakeFileEntry(path);
+    }
+}
+
+void MediaIndex::UpdateEntry(CachedDirectory &cachedDirectory, const std::string &directory, const std::string &name, bool deleted)
+{
+    // mutex held.
+    if (cachedDirectory.scanning)
+    {
+        // the file is checked again when the scan completes.
+        cachedDirectory.pendingChanges.push_back(name);
+    }
+    else
+    {
+        UpdateEntry(cachedDirectory.entries, directory, name, deleted);
+    }
+}
+
+void MediaIndex::VisitDirectory(const fs::path &directory, const std::function<void(const EntryMap &)> &visitor)
+{
+    std::string key = DirectoryKey(directory);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        auto i = directories.find(key);
+        if (i == directories.end())
+        {
+            break;
+        }
+        if (!i->second.scanning)
+        {
+            visitor(i->second.entries);
+            return;
+        }
+        scanComplete.wait(lock);
+    }
+
+    StartMonitor();
+    int wd = -1;
+    if (inotifyFd != -1)
+    {
+        // watch before scanning so that no changes are missed.
+        wd = inotify_add_watch(inotifyFd, key.c_str(), WATCH_MASK);
+    }
+    if (wd == -1)
+    {
+        // can't keep it up to date, so don't cache it.
+        lock.unlock();
+        visitor(ScanDirectory(key));
+        return;
+    }
+    CachedDirectory &cachedDirectory = directories[key];
+    cachedDirectory.watchDescriptor = wd;
+    cachedDirectory.scanning = true;
+    watchDescriptors[wd].insert(key);
+
+    // Scanning reads the metadata of every file, so it's done without holding the mutex.
+    EntryMap entries;
+    lock.unlock();
+    try
+    {
+        entries = ScanDirectory(key);
+    }
+    catch (const std::exception &)
+    {
+        lock.lock();
+        auto i = directories.find(key);
+        if (i != directories.end() && i->second.scanning)
+        {
+            DropCachedDirectory(i);
+        }
+        scanComplete.notify_all();
+        throw;
+    }
+    lock.lock();
+
+    auto i = directories.find(key);
+    if (i == directories.end() || !i->second.scanning)
+    {
+        // dropped while it was being scanned (or replaced by a later scan).
+        scanComplete.notify_all();
+        visitor(entries);
+        return;
+    }
+    for (const auto &name : i->second.pendingChanges)
+    {
+        UpdateEntry(entries, key, name, false);
+    }
+    i->second.pendingChanges.clear();
+    i->second.entries = std::move(entries);
+    i->second.scanning = false;
+    scanComplete.notify_all();
+    visitor(i->second.entries);
+}
+
+std::vector<FileEntry> MediaIndex::GetDirectoryEntries(const fs::path &directory)
+{
+    std::vector<FileEntry> result;
+    if (!fs::exists(directory))
+    {
+        return result;
+    }
+    VisitDirectory(
+        directory,
+        [&result](const EntryMap &entries)
+        {
+            result.reserve(entries.size());
+            for (const auto &entry : entries)
+            {
+                if (!IsHiddenFile(entry.second))
+                {
+                    result.push_back(entry.second);
+                }
+            }
+        });
+    return result;
+}
+
+std::vector<FileEntry> MediaIndex::GetDirectoryPage(
+    const fs::path &directory,
+    const EntryPredicate &predicate,
+    const EntryOrder &less,
+    size_t offset,
+    size_t count,
+    size_t *totalEntries)
+{
+    std::vector<FileEntry> result;
+    *totalEntries = 0;
+    if (!fs::exists(directory))
+    {
+        return result;
+    }
+    VisitDirectory(
+        directory,
+        [&](const EntryMap &entries)
+        {
+            std::vector<const FileEntry *> matches;
+            matches.reserve(entries.size());
+            for (const auto &entry : entries)
+            {
+                if (!IsHiddenFile(entry.second) && predicate(entry.second))
+                {
+                    matches.push_back(&entry.second);
+                }
+            }
+            *totalEntries = matches.size();
+            if (offset >= matches.size())
+            {
+                return;
+            }
+            size_t end = std::min(matches.size(), offset + count);
+            std::partial_sort(
+                matches.begin(), matches.begin() + end, matches.end(),
+                [&less](const FileEntry *l, const FileEntry *r)
+                { return less(*l, *r); });
+            result.reserve(end - offset);
+            for (size_t i = offset; i < end; ++i)
+            {
+                result.push_back(*matches[i]);
+            }
+        });
+    return result;
+}
+
+void MediaIndex::InvalidatePath(const fs::path &path)
+{
+    std::string key = DirectoryKey(path);
+    fs::path normalizedPath{key};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fs::is_directory(normalizedPath))
+    {
+        // deleted or renamed away; forget the directory and everything cached beneath it.
+        std::string prefix = key + "/";
+        for (auto i = directories.begin(); i != directories.end();)
+        {
+            auto next = std::next(i);
+            if (i->first == key || i->first.starts_with(prefix))
+            {
+                DropCachedDirectory(i);
+            }
+            i = next;
+        }
+    }
+    auto iParent = directories.find(normalizedPath.parent_path().string());
+    if (iParent != directories.end())
+    {
+        UpdateEntry(iParent->second, iParent->first, normalizedPath.filename().string(), false);
+    }
+    // (a directory that was being scanned may have been dropped.)
+    scanComplete.notify_all();
+}
+
+void MediaIndex::DropCachedDirectory(std::map<std::string, CachedDirectory>::iterator iDirectory)
+{
+    // mutex held.
+    int wd = iDirectory->second.watchDescriptor;
+    if (wd != -1)
+    {
+        auto iWd = watchDescriptors.find(wd);
+        if (iWd != watchDescriptors.end())
+        {
+            iWd->second.erase(iDirectory->first);
+            if (iWd->second.empty())
+            {
+                // no other path shares the watch.
+                watchDescriptors.erase(iWd);
+                inotify_rm_watch(inotifyFd, wd);
+            }
+        }
+    }
+    directories.erase(iDirectory);
+}
+
+void MediaIndex::OnFileChanged(int watchDescriptor, const std::string &name, bool deleted)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iWd = watchDescriptors.find(watchDescriptor);
+    if (iWd == watchDescriptors.end())
+        return;
+    for (const auto &key : iWd->second)
+    {
+        auto iDirectory = directories.find(key);
+        if (iDirectory != directories.end())
+        {
+            UpdateEntry(iDirectory->second, key, name, deleted);
+        }
+    }
+}
+
+void MediaIndex::OnDirectoryRemoved(int watchDescriptor)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iWd = watchDescriptors.find(watchDescriptor);
+        if (iWd == watchDescriptors.end())
+            return;
+        std::set<std::string> keys = iWd->second;
+        watchDescriptors.erase(iWd);
+        inotify_rm_watch(inotifyFd, watchDescriptor);
+        for (const auto &key : keys)
+        {
+            directories.erase(key);
+        }
+    }
+    scanComplete.notify_all();
+}
+
+void MediaIndex::ClearCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &wd : watchDescriptors)
+        {
+            inotify_rm_watch(inotifyFd, wd.first);
+        }
+        watchDescriptors.clear();
+        directories.clear();
+    }
+    scanComplete.notify_all();
+}
+
+void MediaIndex::ThreadProc()
+{
+    SetThreadName("mediaIndex");
+
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    while (true)
+    {
+        struct pollfd pfds[2] = {
+            {.fd = inotifyFd, .events = POLLIN},
+            {.fd = shutdownEventFd, .events = POLLIN}};
+        int ret = poll(pfds, 2, -1);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            Lv2Log::error("MediaIndex: poll() failed.");
+            break;
+        }
+        if (pfds[1].revents & POLLIN)
+        {
+            break;
+        }
+        ssize_t num_bytes = read(inotifyFd, buffer, sizeof(buffer));
+        if (num_bytes <= 0)
+        {
+            continue;
+        }
+        size_t i = 0;
+        while (i < static_cast<size_t>(num_bytes))
+        {
+            struct inotify_event *event = reinterpret_cast<struct inotify_event *>(&buffer[i]);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                ClearCache();
+            }
+            else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                OnDirectoryRemoved(event->wd);
+            }
+            else if (event->len > 0)
+            {
+                bool deleted = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+                OnFileChanged(event->wd, event->name, deleted);
+            }
+            i += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
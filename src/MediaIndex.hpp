@@ -0,0 +1,113 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "FileEntry.hpp"
+#include <filesystem>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pipedal
+{
+    /// @brief Cached listings of upload directories.
+    ///
+    /// Directories are scanned once, on first use, and then kept up to date incrementally using inotify.
+    /// Entries carry file size, modification time, and audio/model metadata (sample rate, channels and
+    /// duration of .wav and .flac files; architecture of .nam files), so that metadata doesn't have to be
+    /// re-read each time a file dialog is displayed.
+    ///
+    /// If inotify isn't available, or the watch limit has been reached, directories are rescanned on each request.
+    class MediaIndex
+    {
+    public:
+        MediaIndex();
+        ~MediaIndex();
+        MediaIndex(const MediaIndex &) = delete;
+        MediaIndex &operator=(const MediaIndex &) = delete;
+
+        void Close();
+
+        /// @brief Get the contents of a directory, unsorted.
+        /// Hidden files are excluded. Returns an empty list if the directory does not exist.
+        std::vector<FileEntry> GetDirectoryEntries(const std::filesystem::path &directory);
+
+        using EntryPredicate = std::function<bool(const FileEntry &)>;
+        using EntryOrder = std::function<bool(const FileEntry &, const FileEntry &)>;
+
+        /// @brief Get one page of the sorted, filtered contents of a directory.
+        /// Only the entries on the requested page are copied out of the index.
+        /// @param totalEntries Receives the number of entries that match the predicate.
+        std::vector<FileEntry> GetDirectoryPage(
+            const std::filesystem::path &directory,
+            const EntryPredicate &predicate,
+            const EntryOrder &less,
+            size_t offset,
+            size_t count,
+            size_t *totalEntries);
+
+        /// @brief Update the index after a file or directory has been created, written, renamed or deleted.
+        /// Call after modifying an upload directory, so that the next listing is correct without waiting for inotify.
+        void InvalidatePath(const std::filesystem::path &path);
+
+        // Read metadata for a single file. (exposed for testing)
+        static FileEntry MakeFileEntry(const std::filesystem::path &path);
+
+    private:
+        struct CachedDirectory
+        {
+            int watchDescriptor = -1;
+            // Directories are scanned without the mutex held. Changes notified in the meantime are
+            // applied when the scan completes.
+            bool scanning = false;
+            std::vector<std::string> pendingChanges;
+            std::map<std::string, FileEntry> entries;
+        };
+        using EntryMap = std::map<std::string, FileEntry>;
+
+        void StartMonitor();
+        void VisitDirectory(const std::filesystem::path &directory, const std::function<void(const EntryMap &)> &visitor);
+        void DropCachedDirectory(std::map<std::string, CachedDirectory>::iterator iDirectory);
+        void ThreadProc();
+        void OnFileChanged(int watchDescriptor, const std::string &name, bool deleted);
+        void OnDirectoryRemoved(int watchDescriptor);
+        void ClearCache();
+        static EntryMap ScanDirectory(const std::filesystem::path &directory);
+        static void UpdateEntry(EntryMap &entries, const std::filesystem::path &directory, const std::string &name, bool deleted);
+        static void UpdateEntry(CachedDirectory &cachedDirectory, const std::string &directory, const std::string &name, bool deleted);
+
+        std::mutex mutex;
+        std::condition_variable scanComplete;
+        std::map<std::string, CachedDirectory> directories;
+        // inotify returns the same watch descriptor for paths that refer to the same directory (e.g. through a symlink).
+        std::map<int, std::set<std::string>> watchDescriptors;
+
+        int inotifyFd = -1;
+        int shutdownEventFd = -1;
+        bool closed = false;
+        std::unique_ptr<std::thread> monitorThread;
+    };
+}
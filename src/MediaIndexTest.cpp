@@ -0,0 +1,285 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "MediaIndex.hpp"
+#include "TemporaryDirectory.hpp"
+#include "catch.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+using namespace pipedal;
+namespace fs = std::filesystem;
+
+namespace
+{
+    void WriteFile(const fs::path &path, const std::vector<uint8_t> &data)
+    {
+        std::ofstream f(path, std::ios_base::binary | std::ios_base::trunc);
+        f.write((const char *)data.data(), (std::streamsize)data.size());
+    }
+    void WriteFile(const fs::path &path, const std::string &data)
+    {
+        WriteFile(path, std::vector<uint8_t>(data.begin(), data.end()));
+    }
+
+    void Append(std::vector<uint8_t> &data, const char *tag)
+    {
+        data.insert(data.end(), tag, tag + 4);
+    }
+    void AppendLe16(std::vector<uint8_t> &data, uint16_t value)
+    {
+        data.push_back((uint8_t)value);
+        data.push_back((uint8_t)(value >> 8));
+    }
+    void AppendLe32(std::vector<uint8_t> &data, uint32_t value)
+    {
+        AppendLe16(data, (uint16_t)value);
+        AppendLe16(data, (uint16_t)(value >> 16));
+    }
+
+    std::vector<uint8_t> MakeWav(uint16_t channels, uint32_t sampleRate, uint32_t frames)
+    {
+        uint16_t blockAlign = (uint16_t)(channels * 2);
+        std::vector<uint8_t> data;
+        Append(data, "RIFF");
+        AppendLe32(data, 0); // not checked.
+        Append(data, "WAVE");
+
+        // a chunk with an odd size, which must be skipped along with its pad byte.
+        Append(data, "LIST");
+        AppendLe32(data, 3);
+        data.insert(data.end(), {'a', 'b', 'c', 0});
+
+        Append(data, "fmt ");
+        AppendLe32(data, 16);
+        AppendLe16(data, 1); // PCM
+        AppendLe16(data, channels);
+        AppendLe32(data, sampleRate);
+        AppendLe32(data, sampleRate * blockAlign);
+        AppendLe16(data, blockAlign);
+        AppendLe16(data, 16);
+
+        Append(data, "data");
+        AppendLe32(data, frames * blockAlign); // samples themselves aren't read.
+        return data;
+    }
+
+    std::vector<uint8_t> MakeFlac(uint32_t channels, uint32_t sampleRate, uint64_t totalSamples)
+    {
+        std::vector<uint8_t> data;
+        Append(data, "fLaC");
+        data.insert(data.end(), {0x80, 0, 0, 34}); // last metadata block, STREAMINFO, length 34.
+        data.insert(data.end(), 10, 0);            // block and frame sizes.
+        uint64_t packed = ((uint64_t)sampleRate << 44) | ((uint64_t)(channels - 1) << 41) | ((uint64_t)(16 - 1) << 36) | totalSamples;
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            data.push_back((uint8_t)(packed >> shift));
+        }
+        data.insert(data.end(), 16, 0); // md5
+        return data;
+    }
+
+    std::vector<std::string> Names(const std::vector<FileEntry> &entries)
+    {
+        std::vector<std::string> result;
+        for (const auto &entry : entries)
+        {
+            result.push_back(entry.displayName_);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+}
+
+TEST_CASE("MediaIndex metadata", "[media_index][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("MediaIndexTest");
+
+    fs::path wavPath = testDirectory.Path() / "stereo.wav";
+    WriteFile(wavPath, MakeWav(2, 48000, 24000));
+    FileEntry wav = MediaIndex::MakeFileEntry(wavPath);
+    REQUIRE(wav.displayName_ == "stereo.wav");
+    REQUIRE(!wav.isDirectory_);
+    REQUIRE(wav.fileSize_ == fs::file_size(wavPath));
+    REQUIRE(wav.lastModified_ != 0);
+    REQUIRE(wav.channels_ == 2);
+    REQUIRE(wav.sampleRate_ == 48000);
+    REQUIRE(wav.duration_ == 0.5f);
+
+    fs::path flacPath = testDirectory.Path() / "mono.FLAC";
+    WriteFile(flacPath, MakeFlac(1, 44100, 88200));
+    FileEntry flac = MediaIndex::MakeFileEntry(flacPath);
+    REQUIRE(flac.channels_ == 1);
+    REQUIRE(flac.sampleRate_ == 44100);
+    REQUIRE(flac.duration_ == 2.0f);
+
+    fs::path namPath = testDirectory.Path() / "amp.nam";
+    WriteFile(namPath, std::string(R"({"version": "0.5.2", "architecture": "WaveNet", "config": {}, "weights": [0.1, 0.2]})"));
+    FileEntry nam = MediaIndex::MakeFileEntry(namPath);
+    REQUIRE(nam.namArchitecture_ == "WaveNet");
+
+    // malformed and truncated files have no metadata, but don't fail.
+    fs::path badWavPath = testDirectory.Path() / "bad.wav";
+    auto truncated = MakeWav(2, 48000, 24000);
+    truncated.resize(30);
+    WriteFile(badWavPath, truncated);
+    FileEntry badWav = MediaIndex::MakeFileEntry(badWavPath);
+    REQUIRE(badWav.duration_ == 0);
+    REQUIRE(badWav.fileSize_ == 30);
+
+    fs::path badFlacPath = testDirectory.Path() / "bad.flac";
+    WriteFile(badFlacPath, std::string("not a flac file at all"));
+    FileEntry badFlac = MediaIndex::MakeFileEntry(badFlacPath);
+    REQUIRE(badFlac.sampleRate_ == 0);
+
+    FileEntry directory = MediaIndex::MakeFileEntry(testDirectory.Path());
+    REQUIRE(directory.isDirectory_);
+    REQUIRE(!directory.isProtected_);
+    REQUIRE(directory.fileSize_ == 0);
+}
+
+TEST_CASE("MediaIndex directory listing", "[media_index][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("MediaIndexTest");
+    const fs::path &root = testDirectory.Path();
+
+    WriteFile(root / "b.wav", MakeWav(1, 48000, 48000));
+    WriteFile(root / "a.nam", std::string("{}"));
+    WriteFile(root / ".hidden.wav", MakeWav(1, 48000, 48000));
+    fs::create_directories(root / "subdirectory");
+    fs::create_directory_symlink(root / "subdirectory", root / "link");
+    REQUIRE(mkfifo((root / "fifo").c_str(), 0600) == 0);
+
+    MediaIndex mediaIndex;
+    auto entries = mediaIndex.GetDirectoryEntries(root);
+    // hidden files and non-regular files are excluded.
+    REQUIRE(Names(entries) == std::vector<std::string>{"a.nam", "b.wav", "link", "subdirectory"});
+    for (const auto &entry : entries)
+    {
+        if (entry.displayName_ == "b.wav")
+        {
+            REQUIRE(entry.duration_ == 1.0f);
+        }
+        if (entry.displayName_ == "link")
+        {
+            REQUIRE(entry.isDirectory_);
+            REQUIRE(entry.isProtected_);
+        }
+    }
+    REQUIRE(mediaIndex.GetDirectoryEntries(root / "missing").empty());
+
+    // paging.
+    auto byName = [](const FileEntry &l, const FileEntry &r)
+    { return l.displayName_ < r.displayName_; };
+    auto filesOnly = [](const FileEntry &entry)
+    { return !entry.isDirectory_; };
+    size_t total = 0;
+    auto page = mediaIndex.GetDirectoryPage(root, filesOnly, byName, 1, 5, &total);
+    REQUIRE(total == 2);
+    REQUIRE(page.size() == 1);
+    REQUIRE(page[0].displayName_ == "b.wav");
+    page = mediaIndex.GetDirectoryPage(root, [](const FileEntry &) { return true; }, byName, 0, 2, &total);
+    REQUIRE(total == 4);
+    REQUIRE(page.size() == 2);
+    REQUIRE(page[0].displayName_ == "a.nam");
+    REQUIRE(page[1].displayName_ == "b.wav");
+    page = mediaIndex.GetDirectoryPage(root, filesOnly, byName, 2, 5, &total);
+    REQUIRE(total == 2);
+    REQUIRE(page.empty());
+}
+
+TEST_CASE("MediaIndex InvalidatePath", "[media_index][Build][Dev]")
+{
+    // changes made through InvalidatePath are visible immediately, without waiting for inotify.
+    TemporaryDirectory testDirectory("MediaIndexTest");
+    const fs::path &root = testDirectory.Path();
+    fs::create_directories(root / "old");
+    WriteFile(root / "old" / "x.wav", MakeWav(1, 48000, 48000));
+
+    MediaIndex mediaIndex;
+    REQUIRE(Names(mediaIndex.GetDirectoryEntries(root)) == std::vector<std::string>{"old"});
+    REQUIRE(Names(mediaIndex.GetDirectoryEntries(root / "old")) == std::vector<std::string>{"x.wav"});
+
+    WriteFile(root / "new.wav", MakeWav(2, 44100, 44100));
+    mediaIndex.InvalidatePath(root / "new.wav");
+    auto entries = mediaIndex.GetDirectoryEntries(root);
+    REQUIRE(Names(entries) == std::vector<std::string>{"new.wav", "old"});
+
+    // rewritten.
+    WriteFile(root / "new.wav", MakeWav(2, 44100, 88200));
+    mediaIndex.InvalidatePath(root / "new.wav");
+    for (const auto &entry : mediaIndex.GetDirectoryEntries(root))
+    {
+        if (entry.displayName_ == "new.wav")
+        {
+            REQUIRE(entry.duration_ == 2.0f);
+        }
+    }
+
+    // renamed directory. The cached listing of the old directory must not survive.
+    fs::rename(root / "old", root / "renamed");
+    mediaIndex.InvalidatePath(root / "old");
+    mediaIndex.InvalidatePath(root / "renamed");
+    REQUIRE(Names(mediaIndex.GetDirectoryEntries(root)) == std::vector<std::string>{"new.wav", "renamed"});
+    REQUIRE(Names(mediaIndex.GetDirectoryEntries(root / "renamed")) == std::vector<std::string>{"x.wav"});
+    REQUIRE(mediaIndex.GetDirectoryEntries(root / "old").empty());
+
+    // deleted.
+    fs::remove(root / "new.wav");
+    mediaIndex.InvalidatePath(root / "new.wav");
+    fs::remove_all(root / "renamed");
+    mediaIndex.InvalidatePath(root / "renamed");
+    REQUIRE(mediaIndex.GetDirectoryEntries(root).empty());
+}
+
+TEST_CASE("MediaIndex shared watch", "[media_index][Build][Dev]")
+{
+    // a directory and a symlink to it share an inotify watch descriptor.
+    TemporaryDirectory testDirectory("MediaIndexTest");
+    const fs::path &root = testDirectory.Path();
+    fs::create_directories(root / "subdirectory");
+    fs::create_directory_symlink(root / "subdirectory", root / "link");
+
+    MediaIndex mediaIndex;
+    REQUIRE(mediaIndex.GetDirectoryEntries(root / "subdirectory").empty());
+    REQUIRE(mediaIndex.GetDirectoryEntries(root / "link").empty());
+
+    // dropping one of them doesn't stop updates to the other.
+    fs::remove(root / "link");
+    mediaIndex.InvalidatePath(root / "link");
+
+    WriteFile(root / "subdirectory" / "x.wav", MakeWav(1, 48000, 48000));
+    std::vector<std::string> names;
+    for (int i = 0; i < 200; ++i)
+    {
+        names = Names(mediaIndex.GetDirectoryEntries(root / "subdirectory"));
+        if (!names.empty())
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(names == std::vector<std::string>{"x.wav"});
+}
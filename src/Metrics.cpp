@@ -0,0 +1,210 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Metrics.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace pipedal;
+
+static const std::vector<double> DSP_TIME_BUCKETS{
+    0.000010, 0.000025, 0.000050, 0.000100, 0.000250, 0.000500, 0.001, 0.0025, 0.005, 0.010};
+
+static const char *profileCategoryNames[NUM_PROFILE_CATEGORIES] = {
+    "init",
+    "read",
+    "driver",
+    "execute",
+    "write"};
+
+static std::string EscapeLabel(const std::string &value)
+{
+    std::string result;
+    result.reserve(value.size());
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '\\':
+            result += "\\\\";
+            break;
+        case '"':
+            result += "\\\"";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        default:
+            result += c;
+            break;
+        }
+    }
+    return result;
+}
+
+void MetricsHistogram::Write(std::ostream &s, const std::string &name, const std::string &labels) const
+{
+    std::string separator = labels.empty() ? "" : ",";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < upperBounds.size(); ++i)
+    {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        s << name << "_bucket{" << labels << separator << "le=\"" << upperBounds[i] << "\"} " << cumulative << "\n";
+    }
+    cumulative += buckets[upperBounds.size()].load(std::memory_order_relaxed);
+    s << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << cumulative << "\n";
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    s << name << "_sum" << braces << " " << (sumNs.load(std::memory_order_relaxed) * 1E-9) << "\n";
+    s << name << "_count" << braces << " " << cumulative << "\n";
+}
+
+PluginMetrics::PluginMetrics(int64_t instanceId, const std::string &pluginName)
+    : instanceId(instanceId),
+      pluginName(pluginName),
+      dspTime(DSP_TIME_BUCKETS)
+{
+}
+
+std::shared_ptr<PluginMetrics> Metrics::GetPluginMetrics(int64_t instanceId, const std::string &pluginName)
+{
+    std::lock_guard<std::mutex> lock(pluginMetricsMutex);
+    for (auto i = pluginMetrics.begin(); i != pluginMetrics.end();)
+    {
+        if (i->second.use_count() == 1)
+        {
+            i = pluginMetrics.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    auto i = pluginMetrics.find(instanceId);
+    if (i != pluginMetrics.end() && i->second->pluginName == pluginName)
+    {
+        return i->second;
+    }
+    auto result = std::make_shared<PluginMetrics>(instanceId, pluginName);
+    pluginMetrics[instanceId] = result;
+    return result;
+}
+
+static uint64_t GetResidentMemoryBytes()
+{
+    std::ifstream f("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    f >> size >> resident;
+    if (!f)
+    {
+        return 0;
+    }
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+void Metrics::SetWebsocketSendBufferSampler(std::function<int64_t()> &&sampler)
+{
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    websocketSendBufferSampler = std::move(sampler);
+}
+
+void Metrics::UpdatePluginTiming(std::chrono::steady_clock::time_point now)
+{
+    if (!pluginTimingEnabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    std::chrono::steady_clock::time_point lastScrape{std::chrono::steady_clock::duration(lastScrapeTime.load(std::memory_order_relaxed))};
+    if (now - lastScrape > PLUGIN_TIMING_TIMEOUT)
+    {
+        pluginTimingEnabled.store(false, std::memory_order_relaxed);
+    }
+}
+
+std::string Metrics::ToPrometheusText()
+{
+    lastScrapeTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    pluginTimingEnabled.store(true, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(samplerMutex);
+        if (websocketSendBufferSampler)
+        {
+            websocketSendBufferBytes.store(websocketSendBufferSampler(), std::memory_order_relaxed);
+        }
+    }
+    std::stringstream s;
+
+    s << "# HELP pipedal_xruns_total Audio buffer underruns and overruns.\n"
+      << "# TYPE pipedal_xruns_total counter\n"
+      << "pipedal_xruns_total " << xruns.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP pipedal_audio_cpu_seconds_total Time spent by the audio thread, by activity.\n"
+      << "# TYPE pipedal_audio_cpu_seconds_total counter\n";
+    for (size_t i = 0; i < NUM_PROFILE_CATEGORIES; ++i)
+    {
+        s << "pipedal_audio_cpu_seconds_total{category=\"" << profileCategoryNames[i] << "\"} "
+          << (cpuTimeNs[i].load(std::memory_order_relaxed) * 1E-9) << "\n";
+    }
+
+    s << "# HELP pipedal_plugin_dsp_seconds Time spent in each plugin's run() method per audio cycle (sampled; only while metrics are being read).\n"
+      << "# TYPE pipedal_plugin_dsp_seconds histogram\n";
+    {
+        std::lock_guard<std::mutex> lock(pluginMetricsMutex);
+        for (const auto &entry : pluginMetrics)
+        {
+            if (entry.second.use_count() == 1)
+            {
+                continue; // no longer active.
+            }
+            const PluginMetrics &plugin = *entry.second;
+            std::string labels = "instance=\"" + std::to_string(plugin.instanceId) + "\",plugin=\"" + EscapeLabel(plugin.pluginName) + "\"";
+            plugin.dspTime.Write(s, "pipedal_plugin_dsp_seconds", labels);
+        }
+    }
+
+    s << "# HELP pipedal_pedalboard_load_seconds Time taken to construct a pedalboard when a preset is loaded or modified.\n"
+      << "# TYPE pipedal_pedalboard_load_seconds histogram\n";
+    pedalboardLoadTime.Write(s, "pipedal_pedalboard_load_seconds", "");
+
+    s << "# HELP pipedal_pedalboard_buffer_bytes Audio buffer memory allocated by the active pedalboard.\n"
+      << "# TYPE pipedal_pedalboard_buffer_bytes gauge\n"
+      << "pipedal_pedalboard_buffer_bytes " << activePedalboardBytes.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP pipedal_websocket_clients Connected websocket clients.\n"
+      << "# TYPE pipedal_websocket_clients gauge\n"
+      << "pipedal_websocket_clients " << websocketClients.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP pipedal_websocket_send_buffer_bytes Websocket data queued but not yet sent, across all clients.\n"
+      << "# TYPE pipedal_websocket_send_buffer_bytes gauge\n"
+      << "pipedal_websocket_send_buffer_bytes " << websocketSendBufferBytes.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP pipedal_websocket_messages_sent_total Websocket messages sent.\n"
+      << "# TYPE pipedal_websocket_messages_sent_total counter\n"
+      << "pipedal_websocket_messages_sent_total " << websocketMessagesSent.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP pipedal_audio_host_queue_bytes Pending data in the audio thread to host ring buffer.\n"
+      << "# TYPE pipedal_audio_host_queue_bytes gauge\n"
+      << "pipedal_audio_host_queue_bytes " << audioHostQueueBytes.load(std::memory_order_relaxed) << "\n";
+
+    s << "# HELP process_resident_memory_bytes Resident memory size in bytes.\n"
+      << "# TYPE process_resident_memory_bytes gauge\n"
+      << "process_resident_memory_bytes " << GetResidentMemoryBytes() << "\n";
+
+    return s.str();
+}
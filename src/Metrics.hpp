@@ -0,0 +1,161 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+#include "CpuUse.hpp"
+
+namespace pipedal
+{
+    /// @brief Fixed-bucket histogram. Observe() is lock-free and allocation-free.
+    class MetricsHistogram
+    {
+    public:
+        MetricsHistogram(const std::vector<double> &upperBounds)
+            : upperBounds(upperBounds),
+              buckets(new std::atomic<uint64_t>[upperBounds.size() + 1])
+        {
+            for (size_t i = 0; i <= upperBounds.size(); ++i)
+            {
+                buckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void Observe(double value)
+        {
+            size_t i = 0;
+            while (i < upperBounds.size() && value > upperBounds[i])
+            {
+                ++i;
+            }
+            buckets[i].fetch_add(1, std::memory_order_relaxed);
+            sumNs.fetch_add((uint64_t)(value * 1E9), std::memory_order_relaxed);
+        }
+        void Observe(std::chrono::steady_clock::duration duration)
+        {
+            Observe(std::chrono::duration<double>(duration).count());
+        }
+
+        void Write(std::ostream &s, const std::string &name, const std::string &labels) const;
+
+    private:
+        std::vector<double> upperBounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets; // upperBounds.size()+1 entries; the last is +Inf.
+        std::atomic<uint64_t> sumNs{0};
+    };
+
+    class PluginMetrics
+    {
+    public:
+        PluginMetrics(int64_t instanceId, const std::string &pluginName);
+
+        const int64_t instanceId;
+        const std::string pluginName;
+        MetricsHistogram dspTime; // seconds per call to run().
+    };
+
+    /// @brief Process-wide counters for the /metrics endpoint.
+    ///
+    /// Producers update atomics directly (the audio thread included); the metrics request handler reads them
+    /// without taking any of the model or audio host locks.
+    class Metrics
+    {
+    public:
+        static Metrics &Instance()
+        {
+            static Metrics instance;
+            return instance;
+        }
+
+        std::atomic<uint64_t> xruns{0};
+        std::atomic<uint64_t> cpuTimeNs[NUM_PROFILE_CATEGORIES]{};
+
+        // single writer (the audio thread), so avoid the locked add.
+        void AddCpuTime(ProfileCategory category, std::chrono::steady_clock::duration duration)
+        {
+            auto &counter = cpuTimeNs[(size_t)category];
+            counter.store(
+                counter.load(std::memory_order_relaxed) + (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+                std::memory_order_relaxed);
+        }
+
+        MetricsHistogram pedalboardLoadTime;
+        std::atomic<uint64_t> activePedalboardBytes{0};
+        std::atomic<int64_t> websocketClients{0};
+        std::atomic<int64_t> websocketSendBufferBytes{0}; // (the last value sampled, if there is a sampler.)
+        std::atomic<uint64_t> websocketMessagesSent{0};
+        std::atomic<uint64_t> audioHostQueueBytes{0};
+
+        /// @brief Get (or create) the metrics for a plugin instance.
+        ///
+        /// Metrics for an instance survive pedalboard rebuilds so that counters remain monotonic. Entries
+        /// that are no longer referenced by any pedalboard are discarded on subsequent calls.
+        std::shared_ptr<PluginMetrics> GetPluginMetrics(int64_t instanceId, const std::string &pluginName);
+
+        /// @brief Set the function that samples websocketSendBufferBytes when metrics are rendered.
+        ///
+        /// Send buffers drain without notifying anyone, so the gauge can't be maintained by producers. The
+        /// sampler runs on the thread that renders the metrics, and may take the web server's locks.
+        /// nullptr removes the sampler.
+        void SetWebsocketSendBufferSampler(std::function<int64_t()> &&sampler);
+
+        // Prometheus text exposition format. Enables plugin timing until scrapes stop.
+        std::string ToPrometheusText();
+
+        // Plugin dsp time is only measured on one audio cycle in PLUGIN_TIMING_INTERVAL.
+        static constexpr uint32_t PLUGIN_TIMING_INTERVAL = 16;
+
+        // Plugins are only timed while somebody is reading the metrics. Realtime.
+        bool IsPluginTimingEnabled() const
+        {
+            return pluginTimingEnabled.load(std::memory_order_relaxed);
+        }
+        /// @brief Turn plugin timing off if there hasn't been a scrape for a while.
+        ///
+        /// Call periodically from a non-realtime thread.
+        void UpdatePluginTiming(std::chrono::steady_clock::time_point now);
+
+        // Use Instance(). (Public so that tests can format a known snapshot.)
+        Metrics()
+            : pedalboardLoadTime({0.010, 0.050, 0.100, 0.250, 0.500, 1.0, 2.5, 5.0, 10.0})
+        {
+        }
+
+    private:
+        static constexpr std::chrono::seconds PLUGIN_TIMING_TIMEOUT{300};
+
+        std::atomic<bool> pluginTimingEnabled{false};
+        std::atomic<std::chrono::steady_clock::rep> lastScrapeTime{0};
+
+        std::mutex samplerMutex;
+        std::function<int64_t()> websocketSendBufferSampler;
+
+        std::mutex pluginMetricsMutex; // not used on the audio thread.
+        std::map<int64_t, std::shared_ptr<PluginMetrics>> pluginMetrics;
+    };
+}
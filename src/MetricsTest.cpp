@@ -0,0 +1,199 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "Metrics.hpp"
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pipedal;
+
+namespace
+{
+    std::vector<std::string> Lines(const std::string &text)
+    {
+        std::vector<std::string> result;
+        std::stringstream s(text);
+        std::string line;
+        while (std::getline(s, line))
+        {
+            result.push_back(line);
+        }
+        return result;
+    }
+
+    // sample line (name and labels) -> value.
+    std::map<std::string, std::string> Samples(const std::vector<std::string> &lines)
+    {
+        std::map<std::string, std::string> result;
+        for (const auto &line : lines)
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            size_t space = line.rfind(' ');
+            result[line.substr(0, space)] = line.substr(space + 1);
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Metrics Prometheus text", "[metrics][Build][Dev]")
+{
+    Metrics metrics;
+    metrics.xruns = 3;
+    metrics.AddCpuTime(ProfileCategory::Execute, std::chrono::milliseconds(1500));
+    metrics.activePedalboardBytes = 4096;
+    metrics.websocketClients = 2;
+    metrics.websocketSendBufferBytes = 100;
+    metrics.websocketMessagesSent = 42;
+    metrics.audioHostQueueBytes = 8;
+    metrics.pedalboardLoadTime.Observe(0.02);
+    metrics.pedalboardLoadTime.Observe(3.0);
+
+    auto plugin = metrics.GetPluginMetrics(5, "Amp \"X\"");
+    plugin->dspTime.Observe(0.00002);
+    metrics.GetPluginMetrics(6, "Inactive"); // (not referenced by a pedalboard, so not reported.)
+
+    std::string text = metrics.ToPrometheusText();
+    std::vector<std::string> lines = Lines(text);
+    REQUIRE(!text.empty());
+    REQUIRE(text.back() == '\n');
+
+    SECTION("Exposition format")
+    {
+        // every family has HELP and TYPE lines ahead of its samples, and every sample belongs to the current family.
+        static const std::regex helpLine{R"(# HELP ([a-zA-Z_:][a-zA-Z0-9_:]*) .+)"};
+        static const std::regex typeLine{R"(# TYPE ([a-zA-Z_:][a-zA-Z0-9_:]*) (counter|gauge|histogram))"};
+        static const std::regex sampleLine{R"(([a-zA-Z_:][a-zA-Z0-9_:]*)(\{([a-zA-Z_][a-zA-Z0-9_]*="([^"\\]|\\.)*",?)*\})? [-+]?([0-9.e+-]+|Inf))"};
+
+        std::string family;
+        std::string type;
+        bool haveHelp = false;
+        std::map<std::string, int> familyCounts;
+        for (const auto &line : lines)
+        {
+            std::smatch match;
+            INFO(line);
+            if (std::regex_match(line, match, helpLine))
+            {
+                family = match[1];
+                type = "";
+                haveHelp = true;
+                REQUIRE(++familyCounts[family] == 1);
+            }
+            else if (std::regex_match(line, match, typeLine))
+            {
+                REQUIRE(haveHelp);
+                REQUIRE(match[1] == family);
+                type = match[2];
+                haveHelp = false;
+            }
+            else
+            {
+                REQUIRE(std::regex_match(line, match, sampleLine));
+                REQUIRE(!type.empty());
+                std::string name = match[1];
+                if (type == "histogram")
+                {
+                    REQUIRE((name == family + "_bucket" || name == family + "_sum" || name == family + "_count"));
+                }
+                else
+                {
+                    REQUIRE(name == family);
+                }
+                if (type == "counter")
+                {
+                    REQUIRE(name.ends_with("_total"));
+                }
+            }
+        }
+        REQUIRE(familyCounts.size() == 10);
+    }
+    SECTION("Values")
+    {
+        auto samples = Samples(lines);
+        REQUIRE(samples["pipedal_xruns_total"] == "3");
+        REQUIRE(samples["pipedal_audio_cpu_seconds_total{category=\"execute\"}"] == "1.5");
+        REQUIRE(samples["pipedal_audio_cpu_seconds_total{category=\"read\"}"] == "0");
+        REQUIRE(samples["pipedal_pedalboard_buffer_bytes"] == "4096");
+        REQUIRE(samples["pipedal_websocket_clients"] == "2");
+        REQUIRE(samples["pipedal_websocket_send_buffer_bytes"] == "100");
+        REQUIRE(samples["pipedal_websocket_messages_sent_total"] == "42");
+        REQUIRE(samples["pipedal_audio_host_queue_bytes"] == "8");
+        REQUIRE(samples.contains("process_resident_memory_bytes"));
+
+        // histogram buckets are cumulative.
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_bucket{le=\"0.01\"}"] == "0");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_bucket{le=\"0.05\"}"] == "1");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_bucket{le=\"2.5\"}"] == "1");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_bucket{le=\"5\"}"] == "2");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_bucket{le=\"+Inf\"}"] == "2");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_count"] == "2");
+        REQUIRE(samples["pipedal_pedalboard_load_seconds_sum"] == "3.02");
+
+        // plugin labels are escaped; inactive plugins aren't reported.
+        std::string labels = "instance=\"5\",plugin=\"Amp \\\"X\\\"\"";
+        REQUIRE(samples["pipedal_plugin_dsp_seconds_bucket{" + labels + ",le=\"1e-05\"}"] == "0");
+        REQUIRE(samples["pipedal_plugin_dsp_seconds_bucket{" + labels + ",le=\"2.5e-05\"}"] == "1");
+        REQUIRE(samples["pipedal_plugin_dsp_seconds_count{" + labels + "}"] == "1");
+        REQUIRE(text.find("Inactive") == std::string::npos);
+    }
+}
+
+TEST_CASE("Metrics send buffer sampler", "[metrics][Build][Dev]")
+{
+    // the send buffer gauge is sampled each time metrics are rendered, so it falls as the buffers drain.
+    Metrics metrics;
+    int64_t bufferedAmount = 5000;
+    metrics.SetWebsocketSendBufferSampler([&bufferedAmount]()
+                                          { return bufferedAmount; });
+    REQUIRE(Samples(Lines(metrics.ToPrometheusText()))["pipedal_websocket_send_buffer_bytes"] == "5000");
+    bufferedAmount = 0;
+    REQUIRE(Samples(Lines(metrics.ToPrometheusText()))["pipedal_websocket_send_buffer_bytes"] == "0");
+
+    metrics.SetWebsocketSendBufferSampler(nullptr);
+    metrics.websocketSendBufferBytes = 7;
+    REQUIRE(Samples(Lines(metrics.ToPrometheusText()))["pipedal_websocket_send_buffer_bytes"] == "7");
+}
+
+TEST_CASE("Metrics plugin timing", "[metrics][Build][Dev]")
+{
+    Metrics metrics;
+    REQUIRE(!metrics.IsPluginTimingEnabled());
+
+    auto now = std::chrono::steady_clock::now();
+    metrics.ToPrometheusText();
+    REQUIRE(metrics.IsPluginTimingEnabled());
+
+    metrics.UpdatePluginTiming(now + std::chrono::seconds(10));
+    REQUIRE(metrics.IsPluginTimingEnabled());
+
+    metrics.UpdatePluginTiming(now + std::chrono::hours(1));
+    REQUIRE(!metrics.IsPluginTimingEnabled());
+
+    metrics.ToPrometheusText();
+    REQUIRE(metrics.IsPluginTimingEnabled());
+}
@@ -78,29 +78,36 @@ PedalboardItem*Pedalboard::GetItem(int64_t pedalItemId)
  }
 
 
-ControlValue* PedalboardItem::GetControlValue(const std::string&symbol)
+bool PedalboardItem::SetControlValue(const std::string&symbol, float value)
 {
-    for (size_t i = 0; i < this->controlValues().size(); ++i)
+    const auto &controlValues = this->controlValues();
+    for (size_t i = 0; i < controlValues.size(); ++i)
     {
-        if (this->controlValues()[i].key() == symbol)
+        if (controlValues[i].key() == symbol)
         {
-            return &(this->controlValues()[i]);
+            if (controlValues[i].value() == value)
+            {
+                return false;
+            }
+            this->mutableControlValues()[i].value(value);
+            return true;
         }
     }
-    return nullptr;
+    return false;
 }
 
-
-bool PedalboardItem::SetControlValue(const std::string&symbol, float value)
+bool PedalboardItem::SetControlValue(size_t indexHint, const std::string&symbol, float value)
 {
-    ControlValue*controlValue = GetControlValue(symbol);
-    if (controlValue == nullptr) return false;
-    if (controlValue->value() != value)
+    if (indexHint < this->controlValues().size() && this->controlValues()[indexHint].key() == symbol)
     {
-        controlValue->value(value);
-        return true;
+        if (this->controlValues()[indexHint].value() != value)
+        {
+            this->mutableControlValues()[indexHint].value(value);
+            return true;
+        }
+        return false;
     }
-    return false;
+    return SetControlValue(symbol, value);
 }
 
 const ControlValue* PedalboardItem::GetControlValue(const std::string&symbol) const
@@ -162,19 +169,19 @@ PedalboardItem Pedalboard::MakeSplit()
 
     result.topChain().push_back(MakeEmptyItem());
     result.bottomChain().push_back(MakeEmptyItem());
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_SPLITTYPE_KEY,0));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_SELECT_KEY,0));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_MIX_KEY,0));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_PANL_KEY,0));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_VOLL_KEY,-3));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_PANR_KEY,0));
-    result.controlValues().push_back(
+    result.mutableControlValues().push_back(
         ControlValue(SPLIT_VOLR_KEY,-3));
     
     return result;
@@ -252,9 +259,12 @@ void PedalboardItem::ApplyDefaultValues(PluginHost&pluginHost)
             this->SetControlValue(port->symbol(),port->default_value());
         }
         // a cheat. this isn't actually true, but close enough.
-        for (auto &pathProperty: this->pathProperties_)
+        if (!this->pathProperties_->empty())
         {
-            pathProperties_[pathProperty.first] = AtomConverter::EmptyPathstring();
+            for (auto &pathProperty: this->mutablePathProperties())
+            {
+                pathProperty.second = AtomConverter::EmptyPathstring();
+            }
         }
     }
 }
@@ -262,33 +272,42 @@ void PedalboardItem::ApplyDefaultValues(PluginHost&pluginHost)
 
 void PedalboardItem::ApplySnapshotValue(SnapshotValue*snapshotValue)
 {
-    std::map<std::string,float> cumulativeValues;
-    for (auto &controlValue: this->controlValues())
+    if (!this->controlValues_.SharesValueWith(snapshotValue->controlValues_))
     {
-        cumulativeValues[controlValue.key()] = controlValue.value();
-    }
-    for (auto&controlValue : snapshotValue->controlValues_)
-    {
-        cumulativeValues[controlValue.key()] = controlValue.value();
-    }
-    this->controlValues().clear();
-    for (auto&pair: cumulativeValues)
-    {
-        this->controlValues_.push_back(ControlValue(pair.first.c_str(),pair.second));
+        std::map<std::string,float> cumulativeValues;
+        for (auto &controlValue: *this->controlValues_)
+        {
+            cumulativeValues[controlValue.key()] = controlValue.value();
+        }
+        for (auto&controlValue : *snapshotValue->controlValues_)
+        {
+            cumulativeValues[controlValue.key()] = controlValue.value();
+        }
+        std::vector<ControlValue> controlValues;
+        controlValues.reserve(cumulativeValues.size());
+        for (auto&pair: cumulativeValues)
+        {
+            controlValues.push_back(ControlValue(pair.first.c_str(),pair.second));
+        }
+        this->controlValues_ = std::move(controlValues);
     }
-    if (this->lv2State() != snapshotValue->lv2State_)
+    if (this->lv2State_ != snapshotValue->lv2State_)
     {
-        this->lv2State(snapshotValue->lv2State_);
+        this->lv2State_ = snapshotValue->lv2State_;
         this->stateUpdateCount(this->stateUpdateCount()+1);
     }
-    for (auto&property: snapshotValue->pathProperties_)
+    if (!this->pathProperties_.SharesValueWith(snapshotValue->pathProperties_) && !snapshotValue->pathProperties_->empty())
     {
-        if (property.second == "null")
+        auto &pathProperties = this->mutablePathProperties();
+        for (auto&property: *snapshotValue->pathProperties_)
         {
-            this->pathProperties_[property.first] = AtomConverter::EmptyPathstring();
+            if (property.second == "null")
+            {
+                pathProperties[property.first] = AtomConverter::EmptyPathstring();
 
-        } else {
-            this->pathProperties_[property.first] = property.second;
+            } else {
+                pathProperties[property.first] = property.second;
+            }
         }
     }
     this->isEnabled(snapshotValue->isEnabled_);
@@ -327,7 +346,7 @@ bool PedalboardItem::IsStructurallyIdentical(const PedalboardItem&other) const
     {
         return false;
     }
-    if (this->midiBindings() != other.midiBindings())
+    if (this->midiBindings_ != other.midiBindings_)
     {
         return false;
     }
@@ -377,14 +396,9 @@ void PedalboardItem::AddToSnapshotFromCurrentSettings(Snapshot&snapshot) const
     snapshotValue.instanceId_ = this->instanceId_;
     snapshotValue.isEnabled_ = this->isEnabled_;
 
-    for (const ControlValue &value: this->controlValues_)
-    {
-        snapshotValue.controlValues_.push_back(value);
-    }
-    for (const auto&pathProperty: this->pathProperties_)
-    {
-        snapshotValue.pathProperties_[pathProperty.first] = pathProperty.second;
-    }
+    // shared, not copied.
+    snapshotValue.controlValues_ = this->controlValues_;
+    snapshotValue.pathProperties_ = this->pathProperties_;
     snapshotValue.lv2State_ = this->lv2State_;
     snapshot.values_.push_back(std::move(snapshotValue));
 
@@ -412,12 +426,12 @@ void PedalboardItem::AddResetsForMissingProperties(Snapshot&snapshot, size_t*ind
         throw std::runtime_error("Pedalboard structure does not match.");
     }
 
-    for (auto&property: this->pathProperties_)
+    for (auto&property: *this->pathProperties_)
     {
-        auto f = snapshotValue.pathProperties_.find(property.first);
-        if (f == snapshotValue.pathProperties_.end())
+        auto f = snapshotValue.pathProperties_->find(property.first);
+        if (f == snapshotValue.pathProperties_->end())
         {
-            snapshotValue.pathProperties_[property.first] = AtomConverter::EmptyPathstring();
+            snapshotValue.pathProperties_.mutate()[property.first] = AtomConverter::EmptyPathstring();
         }
     }   
     ++(*index);
@@ -24,6 +24,7 @@
 #include "MidiBinding.hpp"
 #include "StateInterface.hpp"
 #include "atom_object.hpp"
+#include "CopyOnWrite.hpp"
 
 namespace pipedal {
     class SnapshotValue;
@@ -58,6 +59,15 @@ namespace pipedal {
     decltype(name##_) name() const { return name##_;} \
     void name(decltype(name##_) value) { name##_ = value; }
 
+// CopyOnWrite members. Reads always go through the const getter, which leaves the value shared;
+// mutableName() un-shares it, and should only be used to make a modification. The reference
+// it returns is invalidated when the item is copied.
+#define GETTER_SETTER_COW(name, mutableName) \
+    const auto& name() const { return name##_.get(); } \
+    auto& mutableName() { return name##_.mutate(); } \
+    void name(const std::remove_cvref_t<decltype(name##_.get())> &value) { name##_ = value; } \
+    void name(std::remove_cvref_t<decltype(name##_.get())> &&value) { name##_ = std::move(value); }
+
 class ControlValue {
 private:
     std::string key_;
@@ -84,26 +94,31 @@ public:
 class PedalboardItem: public JsonMemberWritable {
 public:
     using PropertyMap = std::map<std::string,atom_object>;
+    using PathPropertyMap = std::map<std::string,std::string>;
+
     int64_t instanceId_ = 0;
     std::string uri_;
     std::string pluginName_;
     bool isEnabled_ = true;
-    std::vector<ControlValue> controlValues_;
+    // Settings payloads are shared between copies of the item (and with snapshots taken from it)
+    // until modified, so copying a pedalboard doesn't deep-copy plugin settings and state.
+    CopyOnWrite<std::vector<ControlValue>> controlValues_;
     std::vector<PedalboardItem> topChain_;
     std::vector<PedalboardItem> bottomChain_;
-    std::vector<MidiBinding> midiBindings_;
-    std::string vstState_;
+    CopyOnWrite<std::vector<MidiBinding>> midiBindings_;
+    CopyOnWrite<std::string> vstState_;
     uint32_t stateUpdateCount_ = 0;
-    Lv2PluginState lv2State_;
+    CopyOnWrite<Lv2PluginState> lv2State_;
     std::string lilvPresetUri_;
-    std::map<std::string,std::string> pathProperties_;
+    CopyOnWrite<PathPropertyMap> pathProperties_;
 
     // non persistent state.
     PropertyMap patchProperties;
 public:
-    ControlValue*GetControlValue(const std::string&symbol);
     const ControlValue*GetControlValue(const std::string&symbol) const;
     bool SetControlValue(const std::string&key, float value);
+    // as above, checking position indexHint in controlValues() first.
+    bool SetControlValue(size_t indexHint, const std::string&key, float value);
 
 
     bool IsStructurallyIdentical(const PedalboardItem&other) const;
@@ -111,21 +126,21 @@ public:
     void ApplySnapshotValue(SnapshotValue*snapshotValue);
     void ApplyDefaultValues(PluginHost&pluginHost);
     bool hasLv2State() const {
-        return lv2State_.isValid_ != 0;
+        return lv2State_->isValid_ != 0;
     }
     GETTER_SETTER(instanceId)
     GETTER_SETTER_REF(uri)
-    GETTER_SETTER_REF(vstState);
+    GETTER_SETTER_COW(vstState, mutableVstState)
     GETTER_SETTER_REF(pluginName)
     GETTER_SETTER(isEnabled)
-    GETTER_SETTER_VEC(controlValues)
+    GETTER_SETTER_COW(controlValues, mutableControlValues)
     GETTER_SETTER_VEC(topChain)
     GETTER_SETTER_VEC(bottomChain)
-    GETTER_SETTER_VEC(midiBindings)
+    GETTER_SETTER_COW(midiBindings, mutableMidiBindings)
     GETTER_SETTER(stateUpdateCount)
-    GETTER_SETTER_REF(lv2State)
-    Lv2PluginState&lv2State() { return lv2State_; } // non-const version.
+    GETTER_SETTER_COW(lv2State, mutableLv2State)
     GETTER_SETTER_REF(lilvPresetUri)
+    GETTER_SETTER_COW(pathProperties, mutablePathProperties)
 
     PropertyMap&PatchProperties() { return patchProperties; }
 
@@ -160,9 +175,9 @@ class SnapshotValue {
 public:
     uint64_t instanceId_;
     bool isEnabled_ = true;
-    std::vector<ControlValue> controlValues_;
-    Lv2PluginState lv2State_;
-    std::map<std::string,std::string> pathProperties_;
+    CopyOnWrite<std::vector<ControlValue>> controlValues_;
+    CopyOnWrite<Lv2PluginState> lv2State_;
+    CopyOnWrite<PedalboardItem::PathPropertyMap> pathProperties_;
     DECLARE_JSON_MAP(SnapshotValue);
     
 };
@@ -229,6 +244,7 @@ public:
 #undef GETTER_SETTER_REF
 #undef GETTER_SETTER_VEC
 #undef GETTER_SETTER
+#undef GETTER_SETTER_COW
 
 
 
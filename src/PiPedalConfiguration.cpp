@@ -104,5 +104,20 @@ JSON_MAP_REFERENCE(PiPedalConfiguration, maxUploadSize)
 JSON_MAP_REFERENCE(PiPedalConfiguration, accessPointGateway)
 JSON_MAP_REFERENCE(PiPedalConfiguration, accessPointServerAddress)
 JSON_MAP_REFERENCE(PiPedalConfiguration, isVst3Enabled)
+JSON_MAP_REFERENCE(PiPedalConfiguration, sampleAccurateMidi)
+JSON_MAP_REFERENCE(PiPedalConfiguration, midiMinimumSubBlockFrames)
+JSON_MAP_REFERENCE(PiPedalConfiguration, midiControlSmoothingMs)
+JSON_MAP_REFERENCE(PiPedalConfiguration, hardBypass)
+JSON_MAP_REFERENCE(PiPedalConfiguration, hardBypassDelaySeconds)
+JSON_MAP_REFERENCE(PiPedalConfiguration, keepWarmPlugins)
+JSON_MAP_REFERENCE(PiPedalConfiguration, pluginInstancePoolSize)
+JSON_MAP_REFERENCE(PiPedalConfiguration, pluginInstancePoolPlugins)
+JSON_MAP_REFERENCE(PiPedalConfiguration, pluginStateBlobs)
+JSON_MAP_REFERENCE(PiPedalConfiguration, bufferSizeGovernor)
+JSON_MAP_REFERENCE(PiPedalConfiguration, bufferSizeGovernorMargin)
+JSON_MAP_REFERENCE(PiPedalConfiguration, bufferSizeGovernorMinimum)
+JSON_MAP_REFERENCE(PiPedalConfiguration, threadPlacement)
+JSON_MAP_REFERENCE(PiPedalConfiguration, realtimeCpus)
+JSON_MAP_REFERENCE(PiPedalConfiguration, housekeepingCpus)
 JSON_MAP_REFERENCE(PiPedalConfiguration, end)
 JSON_MAP_END()
@@ -48,6 +48,21 @@ private:
     std::string accessPointGateway_;
     std::string accessPointServerAddress_;
     bool isVst3Enabled_ = true;
+    bool sampleAccurateMidi_ = false;
+    uint32_t midiMinimumSubBlockFrames_ = 32;
+    float midiControlSmoothingMs_ = 5;
+    bool hardBypass_ = false;
+    float hardBypassDelaySeconds_ = 2;
+    std::vector<std::string> keepWarmPlugins_;
+    uint32_t pluginInstancePoolSize_ = 0;
+    uint32_t pluginInstancePoolPlugins_ = 8;
+    bool pluginStateBlobs_ = false;
+    std::string bufferSizeGovernor_ = "off";
+    float bufferSizeGovernorMargin_ = 0.7f;
+    uint32_t bufferSizeGovernorMinimum_ = 32;
+    bool threadPlacement_ = false;
+    std::string realtimeCpus_;
+    std::string housekeepingCpus_;
     bool end_ = false; // dummy target for /var/pipedal/config/config.json
 
 public:
@@ -95,6 +110,25 @@ public:
 
     uint32_t GetThreads() const { return threads_; }
 
+    bool GetSampleAccurateMidi() const { return sampleAccurateMidi_; }
+    uint32_t GetMidiMinimumSubBlockFrames() const { return midiMinimumSubBlockFrames_; }
+    float GetMidiControlSmoothingMs() const { return midiControlSmoothingMs_; }
+
+    bool GetHardBypass() const { return hardBypass_; }
+    float GetHardBypassDelaySeconds() const { return hardBypassDelaySeconds_; }
+    const std::vector<std::string> &GetKeepWarmPlugins() const { return keepWarmPlugins_; }
+    uint32_t GetPluginInstancePoolSize() const { return pluginInstancePoolSize_; }
+    uint32_t GetPluginInstancePoolPlugins() const { return pluginInstancePoolPlugins_; }
+    bool GetPluginStateBlobs() const { return pluginStateBlobs_; }
+
+    const std::string &GetBufferSizeGovernor() const { return bufferSizeGovernor_; }
+    float GetBufferSizeGovernorMargin() const { return bufferSizeGovernorMargin_; }
+    uint32_t GetBufferSizeGovernorMinimum() const { return bufferSizeGovernorMinimum_; }
+
+    bool GetThreadPlacement() const { return threadPlacement_; }
+    const std::string &GetRealtimeCpus() const { return realtimeCpus_; }
+    const std::string &GetHousekeepingCpus() const { return housekeepingCpus_; }
+
     DECLARE_JSON_MAP(PiPedalConfiguration);
 };
 
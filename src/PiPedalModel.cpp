@@ -59,6 +59,9 @@ T &constMutex(const T &mutex)
 
 static const char *hexChars = "0123456789ABCDEF";
 
+// seconds of input silence before the buffer size governor may restart audio.
+static constexpr double GOVERNOR_IDLE_SECONDS = 2.0;
+
 static std::string BytesToHex(const std::vector<uint8_t> &bytes)
 {
     std::stringstream s;
@@ -164,6 +167,8 @@ void PiPedalModel::Close()
 PiPedalModel::~PiPedalModel()
 {
     CancelNetworkChangingTimer();
+    CancelInstancePoolRefill();
+    CancelGovernorRestart();
     hotspotManager = nullptr; // turn off the hotspot.
 
     pluginChangeMonitor = nullptr; // stop monitorin LV2 directories.
@@ -208,6 +213,7 @@ void PiPedalModel::Init(const PiPedalConfiguration &configuration)
     pluginHost.SetConfiguration(configuration);
     storage.SetConfigRoot(configuration.GetDocRoot());
     storage.SetDataRoot(configuration.GetLocalStoragePath());
+    storage.SetPluginStateBlobs(configuration.GetPluginStateBlobs());
     storage.Initialize();
     pluginHost.SetPluginStoragePath(storage.GetPluginUploadDirectory());
 
@@ -287,6 +293,8 @@ void PiPedalModel::Load()
     this->audioHost = std::move(p);
 
     this->audioHost->SetNotificationCallbacks(this);
+    this->audioHost->SetConfiguration(this->configuration);
+    this->audioHost->SetTelemetrySegmentName(this->telemetrySegmentName);
 
     this->systemMidiBindings = storage.GetSystemMidiBindings();
 
@@ -305,6 +313,10 @@ void PiPedalModel::Load()
     }
 
     RestartAudio();
+    OnBufferSizeGovernorPresetChanged();
+
+    UpdateInstancePoolFavorites();
+    ScheduleInstancePoolRefill();
 }
 
 IPiPedalModelSubscriber *PiPedalModel::GetNotificationSubscriber(int64_t clientId)
@@ -353,6 +365,51 @@ void PiPedalModel::RemoveNotificationSubsription(std::shared_ptr<IPiPedalModelSu
     }
 }
 
+void PiPedalModel::PreviewControl(int64_t clientId, int64_t controlHandle, int64_t pedalItemId, const std::string &symbol, float value)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    const ControlHandles::Entry *control = controlHandles.Find(controlHandle);
+    if (control && (symbol.empty() || (control->instanceId == pedalItemId && control->symbol == symbol)))
+    {
+        PreviewControl(clientId, *control, value);
+    }
+    else if (!symbol.empty())
+    {
+        PreviewControl(clientId, pedalItemId, symbol, value);
+    }
+}
+
+void PiPedalModel::PreviewControl(int64_t clientId, const ControlHandles::Entry &control, float value)
+{
+    if (control.controlIndex == -1)
+    {
+        PreviewControl(clientId, control.instanceId, control.symbol, value);
+        return;
+    }
+    IEffect *effect = nullptr;
+    auto &effects = lv2Pedalboard->GetEffects();
+    if (control.effectIndex >= 0 && control.effectIndex < (int)effects.size() && effects[control.effectIndex]->GetInstanceId() == control.instanceId)
+    {
+        effect = effects[control.effectIndex];
+    }
+    else
+    {
+        effect = lv2Pedalboard->GetEffect(control.instanceId);
+    }
+    if (!effect)
+    {
+        return;
+    }
+    if (effect->IsVst3())
+    {
+        effect->SetControl(control.controlIndex, value);
+    }
+    else
+    {
+        audioHost->SetControlValue(control.instanceId, control.effectIndex, control.controlIndex, value);
+    }
+}
+
 void PiPedalModel::PreviewControl(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value)
 {
     IEffect *effect = lv2Pedalboard->GetEffect(pedalItemId);
@@ -449,11 +506,66 @@ void PiPedalModel::PreviewOutputVolume(float value)
     audioHost->SetOutputVolume(value);
 }
 
+void PiPedalModel::SetControl(int64_t clientId, int64_t controlHandle, int64_t pedalItemId, const std::string &symbol, float value)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    const ControlHandles::Entry *control = controlHandles.Find(controlHandle);
+    if (control && (symbol.empty() || (control->instanceId == pedalItemId && control->symbol == symbol)))
+    {
+        SetControl(clientId, *control, value);
+    }
+    else if (!symbol.empty())
+    {
+        SetControl(clientId, pedalItemId, symbol, value);
+    }
+}
+
+void PiPedalModel::SetControl(int64_t clientId, const ControlHandles::Entry &control, float value)
+{
+    PedalboardItem *item = ControlHandles::GetItem(pedalboard, control);
+    if (item == nullptr || !item->SetControlValue(control.controlValueIndex, control.symbol, value))
+    {
+        return;
+    }
+    if (item->isSplit() && control.symbol == "splitType")
+    {
+        this->FirePedalboardChanged(clientId);
+        return;
+    }
+    PreviewControl(clientId, control, value);
+
+    // take a snapshot incase a client unsusbscribes in the notification handler (in which case the mutex won't protect us)
+    std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
+    for (auto &subscriber : t)
+    {
+        subscriber->OnControlChanged(clientId, control.instanceId, control.symbol, control.handle, value);
+    }
+
+    this->SetPresetChanged(clientId, true);
+}
+
+std::vector<ControlHandle> PiPedalModel::GetControlHandles()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!controlHandles.IsBuilt())
+    {
+        controlHandles.Rebuild(this->pedalboard, this->lv2Pedalboard.get());
+    }
+    return controlHandles.GetHandles();
+}
+
 void PiPedalModel::SetControl(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value)
 {
     {
         std::lock_guard<std::recursive_mutex> lock(mutex);
 
+        const ControlHandles::Entry *control = controlHandles.Find(pedalItemId, symbol);
+        if (control)
+        {
+            SetControl(clientId, *control, value);
+            return;
+        }
+
         if (!this->pedalboard.SetControlValue(pedalItemId, symbol, value))
         {
             return;
@@ -476,7 +588,7 @@ void PiPedalModel::SetControl(int64_t clientId, int64_t pedalItemId, const std::
             std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
             for (auto &subscriber : t)
             {
-                subscriber->OnControlChanged(clientId, pedalItemId, symbol, value);
+                subscriber->OnControlChanged(clientId, pedalItemId, symbol, -1, value);
             }
 
             this->SetPresetChanged(clientId, true);
@@ -516,13 +628,17 @@ void PiPedalModel::FirePedalboardChanged(int64_t clientId, bool loadAudioThread)
 
             UpdateRealtimeVuSubscriptions();
             UpdateRealtimeMonitorPortSubscriptions();
+            UpdateRealtimeAudioTaps();
         }
     }
+    controlHandles.Rebuild(this->pedalboard, this->lv2Pedalboard.get());
+    std::vector<ControlHandle> handles = controlHandles.GetHandles();
+
     // noify subscribers.
     std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
     for (auto &subscriber : t)
     {
-        subscriber->OnPedalboardChanged(clientId, this->pedalboard);
+        subscriber->OnPedalboardChanged(clientId, this->pedalboard, handles);
     }
 }
 void PiPedalModel::SetPedalboard(int64_t clientId, Pedalboard &pedalboard)
@@ -538,6 +654,11 @@ void PiPedalModel::SetPedalboard(int64_t clientId, Pedalboard &pedalboard)
 }
 
 void PiPedalModel::SetSnapshot(int64_t selectedSnapshot)
+{
+    SelectSnapshot(selectedSnapshot, true);
+}
+
+void PiPedalModel::SelectSnapshot(int64_t selectedSnapshot, bool loadAudioThread)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
     if (this->pedalboard.ApplySnapshot(selectedSnapshot, pluginHost))
@@ -550,7 +671,12 @@ void PiPedalModel::SetSnapshot(int64_t selectedSnapshot)
                 snapshot->isModified_ = false;
             }
         }
-        FirePedalboardChanged(-1, true);
+        if (!loadAudioThread && previousPedalboardLoaded)
+        {
+            // the audio thread is already running with the snapshot's settings.
+            this->previousPedalboard = this->pedalboard;
+        }
+        FirePedalboardChanged(-1, loadAudioThread);
     }
 }
 
@@ -574,6 +700,10 @@ void PiPedalModel::SetSnapshots(std::vector<std::shared_ptr<Snapshot>> &snapshot
         }
     }
 
+    if (audioHost && audioHost->IsOpen() && previousPedalboardLoaded)
+    {
+        UpdateRealtimeSnapshots(false);
+    }
     this->FirePedalboardChanged(-1, false); // notify clients (but don't change the running pedalboard, because it's still the same)
                                             // this means that all clients get an up-to-date copy of the snapshots AND the currently selected snapshot if that applies
                                             // (and a fresh copy of the pedalboard settings as well, which is harmless, since they have not changed)
@@ -985,6 +1115,27 @@ void PiPedalModel::OnNotifyMidiRealtimeSnapshotRequest(int32_t snapshotIndex, in
     }
 }
 
+void PiPedalModel::OnNotifyMidiRealtimeSnapshotApplied(int32_t snapshotIndex)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    try
+    {
+        if (this->pedalboard.snapshots() != this->realtimeSnapshots)
+        {
+            // snapshots were edited while the notification was in flight. Reload from the model's copy.
+            SelectSnapshot((int64_t)snapshotIndex, true);
+        }
+        else
+        {
+            SelectSnapshot((int64_t)snapshotIndex, false);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        Lv2Log::error(SS("SetSnapshot failed. " << e.what()));
+    }
+}
+
 void PiPedalModel::OnNotifyNextMidiBank(const RealtimeNextMidiProgramRequest &request)
 {
     std::lock_guard<std::recursive_mutex> guard{mutex};
@@ -1053,6 +1204,7 @@ void PiPedalModel::LoadPreset(int64_t clientId, int64_t instanceId)
     {
         this->pedalboard = storage.GetCurrentPreset();
         UpdateDefaults(&this->pedalboard);
+        OnBufferSizeGovernorPresetChanged();
 
         this->hasPresetChanged = false; // no fire.
         this->FirePedalboardChanged(clientId);
@@ -1316,7 +1468,7 @@ void PiPedalModel::RestartAudio(bool useDummyAudioDriver)
         this->audioHost->SetPedalboard(nullptr);
 
         previousPedalboardLoaded = false;
-        auto jackServerSettings = this->jackServerSettings;
+        auto jackServerSettings = this->GetEffectiveServerSettings();
         if (useDummyAudioDriver)
         {
             jackServerSettings.UseDummyAudioDevice();
@@ -1354,6 +1506,7 @@ void PiPedalModel::RestartAudio(bool useDummyAudioDriver)
 
         this->UpdateRealtimeVuSubscriptions();
         UpdateRealtimeMonitorPortSubscriptions();
+        UpdateRealtimeAudioTaps();
     }
     catch (const std::exception &e)
     {
@@ -1434,6 +1587,23 @@ void PiPedalModel::RemoveVuSubscription(int64_t subscriptionHandle)
     UpdateRealtimeVuSubscriptions();
 }
 
+int64_t PiPedalModel::AddAudioTap(const AudioTapRequest &request, AudioTapCallback onFrame)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    int64_t subscriptionId = ++nextSubscriptionId;
+    audioTapService.AddTap(subscriptionId, request, onFrame);
+
+    UpdateRealtimeAudioTaps();
+
+    return subscriptionId;
+}
+void PiPedalModel::RemoveAudioTap(int64_t subscriptionHandle)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    audioTapService.RemoveTap(subscriptionHandle);
+    UpdateRealtimeAudioTaps();
+}
+
 void PiPedalModel::OnNotifyMidiValueChanged(int64_t instanceId, int portIndex, float value)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
@@ -1526,6 +1696,18 @@ void PiPedalModel::UpdateRealtimeVuSubscriptions()
     }
 }
 
+void PiPedalModel::UpdateRealtimeAudioTaps()
+{
+    if (audioHost)
+    {
+        if (audioHost->IsOpen())
+        {
+            audioTapService.SetSampleRate(audioHost->GetSampleRate());
+        }
+        audioHost->SetAudioTaps(audioTapService.GetTaps());
+    }
+}
+
 void PiPedalModel::UpdateRealtimeMonitorPortSubscriptions()
 {
     if (!audioHost)
@@ -1597,7 +1779,7 @@ void PiPedalModel::SendSetPatchProperty(
         json_writer writer(ss);
         writer.write(abstractPath);
         std::string atomString = ss.str();
-        pedalboardItem->pathProperties_[propertyUri] = atomString;
+        pedalboardItem->mutablePathProperties()[propertyUri] = atomString;
     }
     this->SetPresetChanged(clientId, true);
     LV2_Atom *atomValue = atomConverter.ToAtom(value);
@@ -1749,6 +1931,7 @@ void PiPedalModel::OpenBank(int64_t clientId, int64_t bankId)
     this->pedalboard = storage.GetCurrentPreset();
 
     UpdateDefaults(&this->pedalboard);
+    OnBufferSizeGovernorPresetChanged();
     this->hasPresetChanged = false;
     this->FirePedalboardChanged(clientId);
 }
@@ -1759,6 +1942,134 @@ JackServerSettings PiPedalModel::GetJackServerSettings()
     return this->jackServerSettings;
 }
 
+bool PiPedalModel::GetGovernedServerSettings(const BufferSizeRecommendation &recommendation, JackServerSettings *result)
+{
+    if (!recommendation.IsValid() || recommendation.GetBufferSize() == GetEffectiveServerSettings().GetBufferSize())
+    {
+        return false;
+    }
+    if (!jackServerSettings.IsValid() || jackServerSettings.IsDummyAudioDevice())
+    {
+        return false;
+    }
+    uint32_t bufferSize = recommendation.GetBufferSize();
+    uint32_t numberOfBuffers = jackServerSettings.GetNumberOfBuffers();
+
+    // respect the device's limits on total buffer size (as the settings dialog does).
+    for (const auto &device : GetAlsaDevices())
+    {
+        if (device.id_ == jackServerSettings.GetAlsaInputDevice())
+        {
+            if (bufferSize * numberOfBuffers < device.minBufferSize_)
+            {
+                numberOfBuffers = (device.minBufferSize_ + bufferSize - 1) / bufferSize;
+            }
+            if (device.maxBufferSize_ != 0 && bufferSize * numberOfBuffers > device.maxBufferSize_)
+            {
+                return false;
+            }
+            break;
+        }
+    }
+    *result = JackServerSettings(
+        jackServerSettings.GetAlsaInputDevice(),
+        jackServerSettings.GetSampleRate(),
+        bufferSize,
+        numberOfBuffers);
+    return true;
+}
+
+void PiPedalModel::OnBufferSizeGovernorPresetChanged()
+{
+    if (!audioHost)
+    {
+        return;
+    }
+    BufferSizeGovernor &governor = audioHost->GetBufferSizeGovernor();
+    BufferSizeRecommendation recommendation = governor.SelectPreset(storage.GetBanks().selectedBank(), storage.GetCurrentPresetId());
+    if (governor.GetMode() != BufferSizeGovernor::Mode::Auto)
+    {
+        return;
+    }
+    // (a change requested for the previous preset no longer applies.)
+    pendingGovernorSettings.reset();
+    JackServerSettings newSettings;
+    if (GetGovernedServerSettings(recommendation, &newSettings))
+    {
+        Lv2Log::info(SS("Buffer size governor: changing buffer size to " << newSettings.GetBufferSize()
+                                                                         << "x" << newSettings.GetNumberOfBuffers() << " when the input is idle. " << recommendation.reason_));
+        pendingGovernorSettings = newSettings;
+        ScheduleGovernorRestart();
+    }
+}
+
+void PiPedalModel::ScheduleGovernorRestart()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (governorRestartHandle != 0 || closed || !hotspotManager || !pendingGovernorSettings)
+    {
+        return;
+    }
+    governorRestartHandle = PostDelayed(
+        std::chrono::milliseconds(500),
+        [this]()
+        {
+            JackServerSettings newSettings;
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex);
+                this->governorRestartHandle = 0;
+                if (closed || !pendingGovernorSettings || !audioHost)
+                {
+                    return;
+                }
+                if (!audioHost->GetBufferSizeGovernor().IsInputIdle(GOVERNOR_IDLE_SECONDS))
+                {
+                    ScheduleGovernorRestart();
+                    return;
+                }
+                newSettings = *pendingGovernorSettings;
+                pendingGovernorSettings.reset();
+            }
+            // ApplyJackServerSettings releases the model mutex before restarting audio, which it can't
+            // do if the caller still holds the (recursive) mutex.
+            ApplyJackServerSettings(newSettings, false);
+        });
+}
+
+void PiPedalModel::CancelGovernorRestart()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (governorRestartHandle && hotspotManager)
+    {
+        CancelPost(governorRestartHandle);
+    }
+    governorRestartHandle = 0;
+    pendingGovernorSettings.reset();
+}
+
+bool PiPedalModel::ApplyBufferSizeRecommendation()
+{
+    JackServerSettings newSettings;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (pendingGovernorSettings)
+        {
+            newSettings = *pendingGovernorSettings;
+        }
+        else
+        {
+            BufferSizeRecommendation recommendation = audioHost->GetBufferSizeGovernor().Evaluate();
+            if (!GetGovernedServerSettings(recommendation, &newSettings))
+            {
+                return false;
+            }
+        }
+        CancelGovernorRestart();
+    }
+    ApplyJackServerSettings(newSettings, false);
+    return true;
+}
+
 void PiPedalModel::SetOnboarding(bool value)
 {
     std::unique_lock<std::recursive_mutex> guard(mutex);
@@ -1767,6 +2078,11 @@ void PiPedalModel::SetOnboarding(bool value)
 }
 
 void PiPedalModel::SetJackServerSettings(const JackServerSettings &jackServerSettings)
+{
+    ApplyJackServerSettings(jackServerSettings, true);
+}
+
+void PiPedalModel::ApplyJackServerSettings(const JackServerSettings &jackServerSettings, bool persist)
 {
     std::unique_lock<std::recursive_mutex> guard(mutex);
 
@@ -1777,17 +2093,33 @@ void PiPedalModel::SetJackServerSettings(const JackServerSettings &jackServerSet
     }
 #endif
 
-    this->jackServerSettings = jackServerSettings;
+    if (persist)
+    {
+        this->jackServerSettings = jackServerSettings;
+        this->governedServerSettings.reset();
 
-    // take a snapshot incase a client unsusbscribes in the notification handler (in which case the mutex won't protect us)
-    std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
-    for (auto &subscriber : t)
+        // take a snapshot incase a client unsusbscribes in the notification handler (in which case the mutex won't protect us)
+        std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
+        for (auto &subscriber : t)
+        {
+            subscriber->OnJackServerSettingsChanged(jackServerSettings);
+        }
+    }
+    else if (this->jackServerSettings.Equals(jackServerSettings))
+    {
+        this->governedServerSettings.reset();
+    }
+    else
     {
-        subscriber->OnJackServerSettingsChanged(jackServerSettings);
+        // Clients keep seeing the user's settings, so that the settings dialog doesn't save the governor's choice.
+        this->governedServerSettings = jackServerSettings;
     }
 
 #if ALSA_HOST
-    storage.SetJackServerSettings(jackServerSettings);
+    if (persist)
+    {
+        storage.SetJackServerSettings(jackServerSettings);
+    }
 
     FireJackConfigurationChanged(this->jackConfiguration);
 
@@ -1871,11 +2203,11 @@ void PiPedalModel::UpdateDefaults(PedalboardItem *pedalboardItem, std::unordered
             auto port = pPlugin->ports()[i];
             if (port->is_control_port() && port->is_input())
             {
-                ControlValue *pValue = pedalboardItem->GetControlValue(port->symbol());
+                const ControlValue *pValue = pedalboardItem->GetControlValue(port->symbol());
                 if (pValue == nullptr)
                 {
                     // Missing? Set it to default value.
-                    pedalboardItem->controlValues().push_back(
+                    pedalboardItem->mutableControlValues().push_back(
                         pipedal::ControlValue(port->symbol().c_str(), port->default_value()));
                 }
             }
@@ -1885,10 +2217,10 @@ void PiPedalModel::UpdateDefaults(PedalboardItem *pedalboardItem, std::unordered
             PiPedalUI::ptr piPedalUI = pPlugin->piPedalUI();
             for (auto &fileProperty : piPedalUI->fileProperties())
             {
-                if (!pedalboardItem->pathProperties_.contains(fileProperty->patchProperty()))
+                if (!pedalboardItem->pathProperties_->contains(fileProperty->patchProperty()))
                 {
                     // make sure each pedalboard item has a complete list of path properties, even if it doesn't yet have values.
-                    pedalboardItem->pathProperties_[fileProperty->patchProperty()] = "null";
+                    pedalboardItem->mutablePathProperties()[fileProperty->patchProperty()] = "null";
                 }
             }
         }
@@ -2116,10 +2448,10 @@ void PiPedalModel::OnNotifyPathPatchPropertyReceived(
         return;
     }
 
-    auto i = pedalboardItem->pathProperties_.find(pathPatchPropertyUri);
-    if (i != pedalboardItem->pathProperties_.end())
+    auto i = pedalboardItem->pathProperties_->find(pathPatchPropertyUri);
+    if (i != pedalboardItem->pathProperties_->end())
     {
-        pedalboardItem->pathProperties_[pathPatchPropertyUri] = atomString;
+        pedalboardItem->mutablePathProperties()[pathPatchPropertyUri] = atomString;
 
         std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
         for (auto &subscriber : t)
@@ -2257,6 +2589,8 @@ void PiPedalModel::SetFavorites(const std::map<std::string, bool> &favorites)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
     storage.SetFavorites(favorites);
+    UpdateInstancePoolFavorites();
+    ScheduleInstancePoolRefill();
 
     // take a snapshot incase a client unsusbscribes in the notification handler (in which case the mutex won't protect us)
     std::vector<IPiPedalModelSubscriber::ptr> t{subscribers.begin(), subscribers.end()};
@@ -2311,6 +2645,23 @@ FileRequestResult PiPedalModel::GetFileList2(const std::string &relativePath, co
         throw;
     }
 }
+FileRequestResult PiPedalModel::GetFileListPage(
+    const std::string &relativePath,
+    const UiFileProperty &fileProperty,
+    const std::string &filter,
+    size_t offset,
+    size_t count)
+{
+    try
+    {
+        return this->storage.GetFileListPage(relativePath, fileProperty, filter, offset, count);
+    }
+    catch (const std::exception &e)
+    {
+        Lv2Log::warning("GetFileListPage() failed:  (%s)", e.what());
+        throw;
+    }
+}
 
 std::string PiPedalModel::RenameFilePropertyFile(
     const std::string &oldRelativePath,
@@ -2383,6 +2734,7 @@ bool PiPedalModel::LoadCurrentPedalboard()
         Snapshot snapshot = pedalboard.MakeSnapshotFromCurrentSettings(previousPedalboard);
         audioHost->LoadSnapshot(snapshot, pluginHost);
         this->previousPedalboard = this->pedalboard;
+        UpdateRealtimeSnapshots(false);
         return true;
     }
 
@@ -2396,9 +2748,23 @@ bool PiPedalModel::LoadCurrentPedalboard()
     audioHost->SetPedalboard(lv2Pedalboard);
     previousPedalboard = this->pedalboard;
     previousPedalboardLoaded = true;
+    UpdateRealtimeSnapshots(true);
+
+    // replace any spares that the new pedalboard consumed.
+    ScheduleInstancePoolRefill();
     return true;
 }
 
+void PiPedalModel::UpdateRealtimeSnapshots(bool force)
+{
+    // Snapshots are replaced rather than modified in place, so pointer comparison suffices.
+    if (force || this->pedalboard.snapshots() != this->realtimeSnapshots)
+    {
+        this->realtimeSnapshots = this->pedalboard.snapshots();
+        audioHost->SetSnapshots(this->realtimeSnapshots, pluginHost);
+    }
+}
+
 void PiPedalModel::OnNotifyLv2RealtimeError(int64_t instanceId, const std::string &error)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
@@ -2590,6 +2956,75 @@ void PiPedalModel::CancelNetworkChangingTimer()
     }
 }
 
+void PiPedalModel::UpdateInstancePoolFavorites()
+{
+    std::set<std::string> favoriteUris;
+    for (const auto &favorite : storage.GetFavorites())
+    {
+        if (favorite.second)
+        {
+            favoriteUris.insert(favorite.first);
+        }
+    }
+    pluginHost.GetInstancePool().SetFavorites(favoriteUris);
+}
+
+void PiPedalModel::ScheduleInstancePoolRefill()
+{
+    // Spares are instantiated one at a time, with a gap in between, and without the model
+    // mutex held, so that refilling the pool doesn't hold up other work.
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (instancePoolRefillHandle != 0 || closed || !hotspotManager)
+    {
+        return;
+    }
+    if (!pluginHost.GetInstancePool().NeedsRefill())
+    {
+        return;
+    }
+    instancePoolRefillHandle = PostDelayed(
+        std::chrono::milliseconds(500),
+        [this]()
+        {
+            std::string uri;
+            uint64_t generation;
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex);
+                this->instancePoolRefillHandle = 0;
+                if (closed)
+                {
+                    return;
+                }
+                uri = pluginHost.GetInstancePool().GetMissingSpare(&generation);
+                if (uri.empty())
+                {
+                    return;
+                }
+            }
+            auto instance = pluginHost.GetInstancePool().CreateSpare(uri);
+
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            if (closed)
+            {
+                return;
+            }
+            if (pluginHost.GetInstancePool().AddSpare(uri, generation, std::move(instance)))
+            {
+                ScheduleInstancePoolRefill();
+            }
+        });
+}
+
+void PiPedalModel::CancelInstancePoolRefill()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (instancePoolRefillHandle && hotspotManager)
+    {
+        CancelPost(instancePoolRefillHandle);
+    }
+    instancePoolRefillHandle = 0;
+}
+
 std::vector<std::string> PiPedalModel::GetKnownWifiNetworks()
 {
     if (!this->hotspotManager)
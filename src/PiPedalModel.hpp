@@ -30,6 +30,7 @@
 #include "VuUpdate.hpp"
 #include <functional>
 #include <filesystem>
+#include <optional>
 #include "Banks.hpp"
 #include "PiPedalConfiguration.hpp"
 #include "JackServerSettings.hpp"
@@ -40,6 +41,8 @@
 #include "Promise.hpp"
 #include "AtomConverter.hpp"
 #include "FileEntry.hpp"
+#include "AudioTap.hpp"
+#include "ControlHandles.hpp"
 #include <unordered_map>
 
 namespace pipedal
@@ -59,13 +62,14 @@ namespace pipedal
         
         virtual int64_t GetClientId() = 0;
         virtual void OnItemEnabledChanged(int64_t clientId, int64_t pedalItemId, bool enabled) = 0;
-        virtual void OnControlChanged(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value) = 0;
+        // controlHandle is -1 if the control has no handle.
+        virtual void OnControlChanged(int64_t clientId, int64_t pedalItemId, const std::string &symbol, int64_t controlHandle, float value) = 0;
         virtual void OnInputVolumeChanged(float value) = 0;
         virtual void OnOutputVolumeChanged(float value) = 0;
         virtual void OnUpdateStatusChanged(const UpdateStatus &updateStatus) = 0;
         virtual void OnLv2StateChanged(int64_t pedalItemId, const Lv2PluginState &newState) = 0;
         virtual void OnVst3ControlChanged(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value, const std::string &state) = 0;
-        virtual void OnPedalboardChanged(int64_t clientId, const Pedalboard &pedalboard) = 0;
+        virtual void OnPedalboardChanged(int64_t clientId, const Pedalboard &pedalboard, const std::vector<ControlHandle> &controlHandles) = 0;
         virtual void OnPresetsChanged(int64_t clientId, const PresetIndex &presets) = 0;
         virtual void OnPresetChanged(bool changed) = 0;
         virtual void OnSnapshotModified(int64_t selectedSnapshot, bool modified) = 0;
@@ -118,6 +122,7 @@ namespace pipedal
         UpdateStatus currentUpdateStatus;
         void OnUpdateStatusChanged(const UpdateStatus &updateStatus);
         std::function<void(void)> restartListener;
+        std::string telemetrySegmentName;
 
         std::unique_ptr<Lv2PluginChangeMonitor> pluginChangeMonitor;
 
@@ -167,6 +172,14 @@ namespace pipedal
         Pedalboard pedalboard;
         bool previousPedalboardLoaded = false;
         Pedalboard previousPedalboard;
+        // the snapshots most recently precompiled by the audio host.
+        std::vector<std::shared_ptr<Snapshot>> realtimeSnapshots;
+        void UpdateRealtimeSnapshots(bool force);
+
+        ControlHandles controlHandles;
+        void SetControl(int64_t clientId, const ControlHandles::Entry &control, float value);
+        void PreviewControl(int64_t clientId, const ControlHandles::Entry &control, float value);
+        void SelectSnapshot(int64_t selectedSnapshot, bool loadAudioThread);
         Storage storage;
         bool hasPresetChanged = false;
 
@@ -210,7 +223,10 @@ namespace pipedal
 
         std::vector<MonitorPortSubscription> activeMonitorPortSubscriptions;
 
+        AudioTapService audioTapService;
+
         void UpdateRealtimeVuSubscriptions();
+        void UpdateRealtimeAudioTaps();
         void UpdateRealtimeMonitorPortSubscriptions();
 
         void RestartAudio(bool useDummyAudioDriver = false);
@@ -230,6 +246,7 @@ namespace pipedal
         virtual void OnPatchSetReply(uint64_t instanceId, LV2_URID patchSetProperty, const LV2_Atom *atomValue) override;
         virtual void OnNotifyMidiRealtimeEvent(RealtimeMidiEventType eventType) override;
         virtual void OnNotifyMidiRealtimeSnapshotRequest(int32_t snapshotIndex,int64_t snapshotRequestId) override;
+        virtual void OnNotifyMidiRealtimeSnapshotApplied(int32_t snapshotIndex) override;
 
         void OnNotifyPathPatchPropertyReceived(
             int64_t instanceId,
@@ -244,6 +261,25 @@ namespace pipedal
         PostHandle networkChangingDelayHandle = 0;
         void CancelNetworkChangingTimer();
 
+        PostHandle instancePoolRefillHandle = 0;
+        void UpdateInstancePoolFavorites();
+
+        void OnBufferSizeGovernorPresetChanged();
+        bool GetGovernedServerSettings(const BufferSizeRecommendation &recommendation, JackServerSettings *result);
+        // Auto-mode buffer size changes wait until the input is idle (or the user applies them), since restarting audio interrupts the sound.
+        std::optional<JackServerSettings> pendingGovernorSettings;
+        PostHandle governorRestartHandle = 0;
+        void ScheduleGovernorRestart();
+        void CancelGovernorRestart();
+        // persist == false: a temporary change (e.g. by the buffer size governor) that doesn't replace the saved settings.
+        void ApplyJackServerSettings(const JackServerSettings &jackServerSettings, bool persist);
+        // The settings audio runs with while the buffer size governor has changed the buffer size. jackServerSettings
+        // remains the user's settings, which are what clients see and what the settings dialog saves.
+        std::optional<JackServerSettings> governedServerSettings;
+        const JackServerSettings &GetEffectiveServerSettings() const { return governedServerSettings ? *governedServerSettings : jackServerSettings; }
+        void ScheduleInstancePoolRefill();
+        void CancelInstancePoolRefill();
+
         void OnNetworkChanging(bool ethernetConnected, bool hotspotConnected);
         void OnNetworkChanged(bool ethernetConnected, bool hotspotConnected);
 
@@ -303,6 +339,8 @@ namespace pipedal
         void Close();
 
         void SetRestartListener(std::function<void(void)> &&listener);
+        // Publish telemetry to the named shared memory segment. Only pipedald does. Call before Load().
+        void SetTelemetrySegmentName(const std::string &name) { this->telemetrySegmentName = name; }
         void OnLv2PluginsChanged();
         void SetOnboarding(bool value);
         std::map<std::string,std::string> GetWifiRegulatoryDomains();
@@ -333,6 +371,11 @@ namespace pipedal
         void SetPedalboardItemEnable(int64_t clientId, int64_t instanceId, bool enabled);
         void SetControl(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value);
         void PreviewControl(int64_t clientId, int64_t pedalItemId, const std::string &symbol, float value);
+        // Handle forms. Handles are published with the pedalboard (see GetControlHandles).
+        // Falls back to (pedalItemId, symbol) if the handle is stale.
+        void SetControl(int64_t clientId, int64_t controlHandle, int64_t pedalItemId, const std::string &symbol, float value);
+        void PreviewControl(int64_t clientId, int64_t controlHandle, int64_t pedalItemId, const std::string &symbol, float value);
+        std::vector<ControlHandle> GetControlHandles();
 
         void SetInputVolume(float value);
         void SetOutputVolume(float value);
@@ -394,6 +437,10 @@ namespace pipedal
         int64_t AddVuSubscription(int64_t instanceId);
         void RemoveVuSubscription(int64_t subscriptionHandle);
 
+        // onFrame is called on the audio tap service thread.
+        int64_t AddAudioTap(const AudioTapRequest &request, AudioTapCallback onFrame);
+        void RemoveAudioTap(int64_t subscriptionHandle);
+
         void SetSystemMidiBindings(std::vector<MidiBinding> &bindings);
         std::vector<MidiBinding> GetSystemMidiBidings();
 
@@ -426,6 +473,8 @@ namespace pipedal
         }
         JackServerSettings GetJackServerSettings();
         void SetJackServerSettings(const JackServerSettings &jackServerSettings);
+        // Apply the buffer size governor's current recommendation. Returns false if there's nothing to apply.
+        bool ApplyBufferSizeRecommendation();
 
         void ListenForMidiEvent(int64_t clientId, int64_t clientHandle, bool listenForControlsOnly);
         void CancelListenForMidiEvent(int64_t clientId, int64_t clientHandle);
@@ -442,6 +491,12 @@ namespace pipedal
         void ForceUpdateCheck();
         std::vector<std::string> GetFileList(const UiFileProperty &fileProperty);
         FileRequestResult GetFileList2(const std::string &relativePath, const UiFileProperty &fileProperty);
+        FileRequestResult GetFileListPage(
+            const std::string &relativePath,
+            const UiFileProperty &fileProperty,
+            const std::string &filter,
+            size_t offset,
+            size_t count);
 
         void DeleteSampleFile(const std::filesystem::path &fileName);
         std::string CreateNewSampleDirectory(const std::string &relativePath, const UiFileProperty &uiFileProperty);
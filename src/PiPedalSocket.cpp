@@ -41,6 +41,7 @@
 #include "SysExec.hpp"
 #include "PiPedalAlsa.hpp"
 #include <filesystem>
+#include <algorithm>
 #include "FileEntry.hpp"
 
 using namespace std;
@@ -255,6 +256,25 @@ JSON_MAP_REFERENCE(FileRequestArgs, relativePath)
 JSON_MAP_REFERENCE(FileRequestArgs, fileProperty)
 JSON_MAP_END()
 
+class FileListPageArgs
+{
+public:
+    std::string relativePath_;
+    UiFileProperty fileProperty_;
+    std::string filter_;
+    uint64_t offset_ = 0;
+    uint64_t count_ = 100;
+
+    DECLARE_JSON_MAP(FileListPageArgs);
+};
+JSON_MAP_BEGIN(FileListPageArgs)
+JSON_MAP_REFERENCE(FileListPageArgs, relativePath)
+JSON_MAP_REFERENCE(FileListPageArgs, fileProperty)
+JSON_MAP_REFERENCE(FileListPageArgs, filter)
+JSON_MAP_REFERENCE(FileListPageArgs, offset)
+JSON_MAP_REFERENCE(FileListPageArgs, count)
+JSON_MAP_END()
+
 class MonitorPortBody
 {
 public:
@@ -382,6 +402,22 @@ JSON_MAP_REFERENCE(UpdateCurrentPedalboardBody, clientId)
 JSON_MAP_REFERENCE(UpdateCurrentPedalboardBody, pedalboard)
 JSON_MAP_END()
 
+class PedalboardChangedBody
+{
+public:
+    int64_t clientId_ = -1;
+    Pedalboard pedalboard_;
+    std::vector<ControlHandle> controlHandles_;
+
+    DECLARE_JSON_MAP(PedalboardChangedBody);
+};
+
+JSON_MAP_BEGIN(PedalboardChangedBody)
+JSON_MAP_REFERENCE(PedalboardChangedBody, clientId)
+JSON_MAP_REFERENCE(PedalboardChangedBody, pedalboard)
+JSON_MAP_REFERENCE(PedalboardChangedBody, controlHandles)
+JSON_MAP_END()
+
 class SetSnapshotsBody
 {
 public:
@@ -442,6 +478,7 @@ public:
     int64_t instanceId_;
     std::string symbol_;
     float value_;
+    int64_t handle_ = -1;
 
     DECLARE_JSON_MAP(ControlChangedBody);
 };
@@ -451,6 +488,28 @@ JSON_MAP_REFERENCE(ControlChangedBody, clientId)
 JSON_MAP_REFERENCE(ControlChangedBody, instanceId)
 JSON_MAP_REFERENCE(ControlChangedBody, symbol)
 JSON_MAP_REFERENCE(ControlChangedBody, value)
+JSON_MAP_REFERENCE(ControlChangedBody, handle)
+JSON_MAP_END()
+
+// setControl/previewControl by control handle. instanceId and symbol are used if the handle is stale.
+class ControlHandleValueBody
+{
+public:
+    int64_t clientId_;
+    int64_t handle_;
+    int64_t instanceId_ = -1;
+    std::string symbol_;
+    float value_;
+
+    DECLARE_JSON_MAP(ControlHandleValueBody);
+};
+
+JSON_MAP_BEGIN(ControlHandleValueBody)
+JSON_MAP_REFERENCE(ControlHandleValueBody, clientId)
+JSON_MAP_REFERENCE(ControlHandleValueBody, handle)
+JSON_MAP_REFERENCE(ControlHandleValueBody, instanceId)
+JSON_MAP_REFERENCE(ControlHandleValueBody, symbol)
+JSON_MAP_REFERENCE(ControlHandleValueBody, value)
 JSON_MAP_END()
 
 class PatchPropertyChangedBody
@@ -512,6 +571,7 @@ private:
         int64_t instanceId;
     };
     std::vector<VuSubscription> activeVuSubscriptions;
+    std::vector<int64_t> activeAudioTaps;
 
     struct PortMonitorSubscription
     {
@@ -585,6 +645,11 @@ public:
             model.RemoveVuSubscription(activeVuSubscriptions[i].subscriptionHandle);
         }
         activeVuSubscriptions.resize(0);
+        for (int64_t audioTap : this->activeAudioTaps)
+        {
+            model.RemoveAudioTap(audioTap);
+        }
+        activeAudioTaps.resize(0);
 
         model.RemoveNotificationSubsription(shared_from_this());
         // Warning: potentially deleted after return.
@@ -1008,7 +1073,19 @@ public:
         {
             this->SendError(replyTo, "Server has shut down.");
         }
-        if (message == "setControl")
+        if (message == "previewControlByHandle")
+        {
+            ControlHandleValueBody message;
+            pReader->read(&message);
+            this->model.PreviewControl(message.clientId_, message.handle_, message.instanceId_, message.symbol_, message.value_);
+        }
+        else if (message == "setControlByHandle")
+        {
+            ControlHandleValueBody message;
+            pReader->read(&message);
+            this->model.SetControl(message.clientId_, message.handle_, message.instanceId_, message.symbol_, message.value_);
+        }
+        else if (message == "setControl")
         {
             ControlChangedBody message;
             pReader->read(&message);
@@ -1134,6 +1211,11 @@ public:
             this->model.SetJackServerSettings(jackServerSettings);
             this->Reply(replyTo, "setJackserverSettings");
         }
+        else if (message == "applyBufferSizeRecommendation")
+        {
+            bool result = this->model.ApplyBufferSizeRecommendation();
+            this->Reply(replyTo, "applyBufferSizeRecommendation", result);
+        }
         else if (message == "setGovernorSettings")
         {
             std::string governor;
@@ -1269,6 +1351,11 @@ public:
             auto pedalboard = model.GetCurrentPedalboardCopy();
             Reply(replyTo, "currentPedalboard", pedalboard);
         }
+        else if (message == "getControlHandles")
+        {
+            auto controlHandles = model.GetControlHandles();
+            Reply(replyTo, "getControlHandles", controlHandles);
+        }
         else if (message == "plugins")
         {
             auto ui_plugins = model.GetLv2Host().GetUiPlugins();
@@ -1545,6 +1632,47 @@ public:
             }
             model.RemoveVuSubscription(subscriptionHandle);
         }
+        else if (message == "addAudioTap")
+        {
+            AudioTapRequest request;
+            pReader->read(&request);
+
+            // a delivery may still be in progress after the tap is removed, so don't capture a raw this.
+            std::weak_ptr<PiPedalSocketHandler> weakThis = shared_from_this();
+            int64_t subscriptionHandle = model.AddAudioTap(
+                request,
+                [weakThis](const std::vector<uint8_t> &frame)
+                {
+                    // audio tap service thread.
+                    auto self = weakThis.lock();
+                    if (!self)
+                    {
+                        return;
+                    }
+                    std::lock_guard<std::recursive_mutex> guard(self->writeMutex);
+                    self->sendBinary(frame.data(), frame.size());
+                });
+            {
+                std::lock_guard<std::recursive_mutex> guard(subscriptionMutex);
+                activeAudioTaps.push_back(subscriptionHandle);
+            }
+            this->Reply(replyTo, "addAudioTap", subscriptionHandle);
+        }
+        else if (message == "removeAudioTap")
+        {
+            int64_t subscriptionHandle = -1;
+            pReader->read(&subscriptionHandle);
+            {
+                std::lock_guard<std::recursive_mutex> guard(subscriptionMutex);
+                auto i = std::find(activeAudioTaps.begin(), activeAudioTaps.end(), subscriptionHandle);
+                if (i == activeAudioTaps.end())
+                {
+                    return;
+                }
+                activeAudioTaps.erase(i);
+            }
+            model.RemoveAudioTap(subscriptionHandle);
+        }
         else if (message == "imageList")
         {
 
@@ -1597,6 +1725,15 @@ public:
             FileRequestResult result = this->model.GetFileList2(requestArgs.relativePath_, requestArgs.fileProperty_);
             this->Reply(replyTo, "requestFileList2", result);
         }
+        else if (message == "requestFileListPage")
+        {
+            FileListPageArgs requestArgs;
+            pReader->read(&requestArgs);
+            FileRequestResult result = this->model.GetFileListPage(
+                requestArgs.relativePath_, requestArgs.fileProperty_,
+                requestArgs.filter_, requestArgs.offset_, requestArgs.count_);
+            this->Reply(replyTo, "requestFileListPage", result);
+        }
         else if (message == "newPreset")
         {
             int64_t presetId = this->model.CreateNewPreset();
@@ -1893,13 +2030,14 @@ private:
         Send("onVst3ControlChanged", body);
     }
 
-    virtual void OnControlChanged(int64_t clientId, int64_t instanceId, const std::string &key, float value)
+    virtual void OnControlChanged(int64_t clientId, int64_t instanceId, const std::string &key, int64_t controlHandle, float value)
     {
         ControlChangedBody body;
         body.clientId_ = clientId;
         body.instanceId_ = instanceId;
         body.symbol_ = key;
         body.value_ = value;
+        body.handle_ = controlHandle;
         Send("onControlChanged", body);
     }
     virtual void OnInputVolumeChanged(float value)
@@ -2087,11 +2225,12 @@ private:
         Send("onGovernorSettingsChanged", governor);
     }
 
-    virtual void OnPedalboardChanged(int64_t clientId, const Pedalboard &pedalboard)
+    virtual void OnPedalboardChanged(int64_t clientId, const Pedalboard &pedalboard, const std::vector<ControlHandle> &controlHandles)
     {
-        UpdateCurrentPedalboardBody body;
+        PedalboardChangedBody body;
         body.clientId_ = clientId;
         body.pedalboard_ = pedalboard;
+        body.controlHandles_ = controlHandles;
         Send("onPedalboardChanged", body);
     }
 
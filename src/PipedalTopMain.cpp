@@ -0,0 +1,172 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "CommandLineParser.hpp"
+#include "PrettyPrinter.hpp"
+#include "Telemetry.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+using namespace pipedal;
+
+static void PrintHelp()
+{
+    PrettyPrinter pp;
+    pp.width(78);
+
+    pp << "pipedal_top - Display PiPedal runtime status\n";
+    pp << "Copyright (c) 2024 Robin Davies\n";
+    pp << "\n";
+    pp << Indent(0) << "Syntax\n\n";
+    pp << Indent(2) << "pipedal_top [<options>]\n\n";
+    pp << "Reads the telemetry shared memory segment published by pipedald. Does not require a connection to the web server.\n\n";
+    pp << Indent(0) << "Options\n\n";
+    pp << Indent(15);
+
+    pp << HangingIndent() << "  -h --help\t"
+       << "Display this message.\n\n";
+    pp << HangingIndent() << "  -n --interval\t"
+       << "Update interval in milliseconds (default 1000).\n\n";
+    pp << HangingIndent() << "  -1 --once\t"
+       << "Display status once, and exit.\n\n";
+    pp << HangingIndent() << "  -r --raw\t"
+       << "Display one line per update (key=value pairs), suitable for logging.\n\n";
+}
+
+static std::string ToDb(float value)
+{
+    if (value <= 0)
+        return "  -inf";
+    std::stringstream s;
+    s << std::fixed << std::setprecision(1) << std::setw(6) << 20 * std::log10(value);
+    return s.str();
+}
+
+static void PrintRaw(const TelemetryData &data)
+{
+    std::cout
+        << "time=" << data.statusTimeNs / 1000000
+        << " active=" << data.active
+        << " restarting=" << data.restarting
+        << " underruns=" << data.underruns
+        << " cpu=" << data.cpuUsage
+        << " temperaturemC=" << data.temperaturemC
+        << " cpuFreqMin=" << data.cpuFreqMin
+        << " cpuFreqMax=" << data.cpuFreqMax
+        << std::endl;
+}
+
+static void PrintScreen(const TelemetryData &data, uint32_t pid)
+{
+    std::cout << "\033[H\033[2J"; // home, clear screen.
+    std::cout << "pipedald (pid " << pid << ")   " << (data.active ? "Running" : "Stopped")
+              << (data.restarting ? " (restarting)" : "") << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "CPU: " << data.cpuUsage << "%   Underruns: " << data.underruns;
+    if (data.temperaturemC > -100000)
+    {
+        std::cout << "   Temp: " << data.temperaturemC / 1000.0 << "C";
+    }
+    if (data.cpuFreqMax != 0)
+    {
+        std::cout << "   Freq: " << data.cpuFreqMin / 1000 << "-" << data.cpuFreqMax / 1000 << "MHz";
+    }
+    std::cout << std::endl
+              << std::endl;
+
+    int64_t vuAgeMs = (TelemetryNow() - data.vuTimeNs) / 1000000;
+    if (data.vuCount == 0 || vuAgeMs > 2000)
+    {
+        std::cout << "(VU levels are only available while the PiPedal UI is displaying them.)" << std::endl;
+        return;
+    }
+    std::cout << std::setw(10) << "Instance" << "   In L   In R  Out L  Out R  (dB)" << std::endl;
+    for (uint32_t i = 0; i < data.vuCount && i < TELEMETRY_MAX_VUS; ++i)
+    {
+        const TelemetryVu &vu = data.vus[i];
+        std::cout << std::setw(10) << vu.instanceId
+                  << " " << ToDb(vu.inputMaxValueL) << " " << ToDb(vu.inputMaxValueR)
+                  << " " << ToDb(vu.outputMaxValueL) << " " << ToDb(vu.outputMaxValueR)
+                  << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    CommandLineParser parser;
+    bool help = false;
+    bool once = false;
+    bool raw = false;
+    uint32_t interval = 1000;
+
+    parser.AddOption("h", "help", &help);
+    parser.AddOption("n", "interval", &interval);
+    parser.AddOption("1", "once", &once);
+    parser.AddOption("r", "raw", &raw);
+
+    try
+    {
+        parser.Parse(argc, (const char **)argv);
+        if (help || parser.Arguments().size() != 0)
+        {
+            PrintHelp();
+            return help ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (interval == 0)
+        {
+            interval = 1;
+        }
+
+        TelemetryReader reader;
+        reader.Open();
+        TelemetryData data;
+        while (true)
+        {
+            if (!reader.Read(&data))
+            {
+                // pipedald restarted the audio thread (or exited). Re-attach.
+                reader.Open();
+                continue;
+            }
+            if (raw || once)
+            {
+                PrintRaw(data);
+            }
+            else
+            {
+                PrintScreen(data, reader.GetWriterPid());
+            }
+            if (once)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
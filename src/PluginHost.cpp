@@ -47,6 +47,7 @@
 #include "StdErrorCapture.hpp"
 #include "util.hpp"
 #include "ModFileTypes.hpp"
+#include "Metrics.hpp"
 
 #include "Locale.hpp"
 
@@ -104,6 +105,27 @@ void PluginHost::SetConfiguration(const PiPedalConfiguration &configuration)
     this->vst3CachePath =
         std::filesystem::path(configuration.GetLocalStoragePath()) / "vst3cache.json";
     this->vst3Enabled = configuration.IsVst3Enabled();
+    this->hardBypass = configuration.GetHardBypass();
+    this->hardBypassDelaySeconds = configuration.GetHardBypassDelaySeconds();
+    if (this->hardBypassDelaySeconds < 0)
+    {
+        this->hardBypassDelaySeconds = 0;
+    }
+    this->keepWarmPlugins.clear();
+    for (const auto &uri : configuration.GetKeepWarmPlugins())
+    {
+        this->keepWarmPlugins.insert(uri);
+    }
+    instancePool->SetPoolSize(configuration.GetPluginInstancePoolSize(), configuration.GetPluginInstancePoolPlugins());
+}
+
+int64_t PluginHost::GetHardBypassDelaySamples(const std::string &pluginUri) const
+{
+    if (!hardBypass || keepWarmPlugins.contains(pluginUri))
+    {
+        return -1;
+    }
+    return (int64_t)(hardBypassDelaySeconds * sampleRate);
 }
 
 void PluginHost::LilvUris::Initialize(LilvWorld *pWorld)
@@ -266,12 +288,14 @@ PluginHost::PluginHost()
 
     this->urids = new Urids(mapFeature);
 
-    pHostWorkerThread = std::make_shared<HostWorkerThread>();
+    pHostWorkerPool = std::make_shared<HostWorkerPool>();
+    instancePool = std::make_unique<PluginInstancePool>(this);
 }
 
 void PluginHost::OnConfigurationChanged(const JackConfiguration &configuration, const JackChannelSelection &settings)
 {
     this->sampleRate = configuration.sampleRate();
+    instancePool->Clear(); // spares were instantiated with the old sample rate and buffer sizes.
     if (configuration.isValid())
     {
         this->numberOfAudioInputChannels = settings.GetInputAudioPorts().size();
@@ -283,6 +307,7 @@ void PluginHost::OnConfigurationChanged(const JackConfiguration &configuration,
 
 PluginHost::~PluginHost()
 {
+    instancePool = nullptr; // (before the lilv world is freed)
     delete lilvUris;
     lilvUris = nullptr;
     delete urids;
@@ -398,6 +423,7 @@ void PluginHost::Load(const char *lv2Path)
         this->classesMap.clear();
     }
 
+    instancePool->Clear();
     free_world();
 
     Lv2Log::info("Scanning for LV2 Plugins");
@@ -1189,7 +1215,9 @@ Lv2Pedalboard *PluginHost::CreateLv2Pedalboard(Pedalboard &pedalboard, Lv2Pedalb
     Lv2Pedalboard *pPedalboard = new Lv2Pedalboard();
     try
     {
+        auto start = std::chrono::steady_clock::now();
         pPedalboard->Prepare(this, pedalboard, errorMessages);
+        Metrics::Instance().pedalboardLoadTime.Observe(std::chrono::steady_clock::now() - start);
         return pPedalboard;
     }
     catch (const std::exception &e)
@@ -1390,6 +1418,13 @@ IEffect *PluginHost::CreateEffect(PedalboardItem &pedalboardItem)
         if (!info)
             return nullptr;
 
+        instancePool->NoteUsage(pedalboardItem.uri());
+        std::unique_ptr<Lv2Effect> spare = instancePool->Take(pedalboardItem.uri());
+        if (spare)
+        {
+            spare->Bind(pedalboardItem);
+            return spare.release();
+        }
         return new Lv2Effect(this, info, pedalboardItem);
     }
 }
@@ -1410,9 +1445,9 @@ bool Lv2PluginInfo::isSplit() const
 {
     return uri_ == SPLIT_PEDALBOARD_ITEM_URI;
 }
-std::shared_ptr<HostWorkerThread> PluginHost::GetHostWorkerThread()
+std::shared_ptr<HostWorkerPool> PluginHost::GetHostWorkerPool()
 {
-    return pHostWorkerThread;
+    return pHostWorkerPool;
 }
 
 class ResourceInfo
@@ -41,6 +41,7 @@
 #include "AutoLilvNode.hpp"
 #include "PiPedalUI.hpp"
 #include "MapPathFeature.hpp"
+#include "PluginInstancePool.hpp"
 
 namespace pipedal
 {
@@ -742,6 +743,9 @@ namespace pipedal
 
     private:
         bool vst3Enabled = true;
+        bool hardBypass = false;
+        double hardBypassDelaySeconds = 2;
+        std::set<std::string> keepWarmPlugins;
 
         LilvNode *get_comment(const std::string &uri);
 
@@ -807,7 +811,8 @@ namespace pipedal
         }
 
     private:
-        std::shared_ptr<HostWorkerThread> pHostWorkerThread;
+        std::shared_ptr<HostWorkerPool> pHostWorkerPool;
+        std::unique_ptr<PluginInstancePool> instancePool;
         // IHost implementation.
         virtual void SetMaxAudioBufferSize(size_t size) { maxBufferSize = size; }
         virtual size_t GetMaxAudioBufferSize() const { return maxBufferSize; }
@@ -816,7 +821,8 @@ namespace pipedal
         virtual int GetNumberOfInputAudioChannels() const { return numberOfAudioInputChannels; }
         virtual int GetNumberOfOutputAudioChannels() const { return numberOfAudioOutputChannels; }
         virtual LV2_Feature *const *GetLv2Features() const { return (LV2_Feature *const *)&(this->lv2Features[0]); }
-        virtual std::shared_ptr<HostWorkerThread> GetHostWorkerThread();
+        virtual std::shared_ptr<HostWorkerPool> GetHostWorkerPool();
+        virtual int64_t GetHardBypassDelaySamples(const std::string &pluginUri) const;
 
     public:
         virtual MapFeature &GetMapFeature() { return this->mapFeature; }
@@ -859,6 +865,9 @@ namespace pipedal
 
         void SetConfiguration(const PiPedalConfiguration &configuration);
 
+        // Spare instances for CreateEffect. (Refilled by PiPedalModel).
+        PluginInstancePool &GetInstancePool() { return *instancePool; }
+
         virtual ~PluginHost();
 
         IHost *asIHost() { return this; }
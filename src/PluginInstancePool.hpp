@@ -0,0 +1,279 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Lv2Log.hpp"
+#include "ss.hpp"
+
+namespace pipedal
+{
+    class PluginHost;
+    class Lv2Effect;
+
+    /// @brief Pre-instantiated spare instances of frequently used plugins.
+    ///
+    /// Spares are created in the background, and handed out in place of new instances.
+    /// Spares are kept for favorite plugins, and for the plugins that have been used most often.
+    ///
+    /// Not thread-safe, except for CreateSpare(), which doesn't touch the pool, so that the (slow)
+    /// instantiation can run without holding the lock that guards the pool.
+    template <typename INSTANCE>
+    class InstancePool
+    {
+    public:
+        // Returns nullptr (or throws) if the plugin can't be instantiated.
+        using Factory = std::function<std::unique_ptr<INSTANCE>(const std::string &uri)>;
+
+        InstancePool(Factory factory) : factory(std::move(factory)) {}
+        InstancePool(const InstancePool &) = delete;
+        InstancePool &operator=(const InstancePool &) = delete;
+
+        // sparesPerPlugin == 0 disables the pool.
+        void SetPoolSize(size_t sparesPerPlugin, size_t maxPlugins);
+        void SetFavorites(const std::set<std::string> &favorites) { this->favorites = favorites; }
+
+        // Record that the plugin has been instantiated.
+        void NoteUsage(const std::string &uri) { ++usageCounts[uri]; }
+
+        // Returns nullptr if there is no spare instance of the plugin.
+        std::unique_ptr<INSTANCE> Take(const std::string &uri);
+
+        // Instantiate one missing spare. Returns true if more spares are required.
+        bool RefillOne();
+
+        // RefillOne() in three steps: GetMissingSpare() and AddSpare() must be called under the pool's
+        // lock; CreateSpare() may be called without it.
+        //
+        // Returns "" if no spares are required.
+        std::string GetMissingSpare(uint64_t *pGeneration) const;
+        // Returns nullptr if the plugin can't be instantiated.
+        std::unique_ptr<INSTANCE> CreateSpare(const std::string &uri) const;
+        // Returns true if more spares are required. Spares created before the last Clear() are discarded.
+        bool AddSpare(const std::string &uri, uint64_t generation, std::unique_ptr<INSTANCE> instance);
+        bool NeedsRefill() const { return !FindMissingSpare().empty(); }
+
+        // Discard all spares. (e.g. when the sample rate or buffer size changes).
+        void Clear();
+
+        // Plugins for which spares are kept: favorites first, then the most used plugins.
+        std::vector<std::string> GetPooledUris() const;
+        size_t GetSpareCount(const std::string &uri) const;
+
+    private:
+        std::string FindMissingSpare() const;
+
+        Factory factory;
+        uint64_t generation = 0; // incremented by Clear().
+        size_t sparesPerPlugin = 0;
+        size_t maxPlugins = 0;
+        std::set<std::string> favorites;
+        std::map<std::string, uint64_t> usageCounts;
+        std::set<std::string> failedUris; // plugins that couldn't be instantiated; not retried until Clear().
+        std::map<std::string, std::vector<std::unique_ptr<INSTANCE>>> spares;
+    };
+
+    /// @brief Spare Lv2Effect instances, handed out by PluginHost::CreateEffect.
+    ///
+    /// Spares are unbound, never activated, and in their default state. Calls must be made with the
+    /// model's mutex held, except for CreateSpare().
+    class PluginInstancePool : public InstancePool<Lv2Effect>
+    {
+    public:
+        PluginInstancePool(PluginHost *pluginHost);
+        ~PluginInstancePool();
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////////
+
+    template <typename INSTANCE>
+    void InstancePool<INSTANCE>::SetPoolSize(size_t sparesPerPlugin, size_t maxPlugins)
+    {
+        this->sparesPerPlugin = sparesPerPlugin;
+        this->maxPlugins = maxPlugins;
+
+        // trim excess spares.
+        std::vector<std::string> pooledUris = GetPooledUris();
+        for (auto i = spares.begin(); i != spares.end();)
+        {
+            if (std::find(pooledUris.begin(), pooledUris.end(), i->first) == pooledUris.end())
+            {
+                i = spares.erase(i);
+            }
+            else
+            {
+                if (i->second.size() > sparesPerPlugin)
+                {
+                    i->second.resize(sparesPerPlugin);
+                }
+                ++i;
+            }
+        }
+    }
+
+    template <typename INSTANCE>
+    std::vector<std::string> InstancePool<INSTANCE>::GetPooledUris() const
+    {
+        std::vector<std::string> result;
+        if (sparesPerPlugin == 0)
+        {
+            return result;
+        }
+        // favorites first, then the most used plugins.
+        std::vector<std::pair<std::string, uint64_t>> candidates;
+        for (const auto &usage : usageCounts)
+        {
+            candidates.push_back(usage);
+        }
+        for (const auto &favorite : favorites)
+        {
+            if (!usageCounts.contains(favorite))
+            {
+                candidates.push_back({favorite, 0});
+            }
+        }
+        std::stable_sort(
+            candidates.begin(), candidates.end(),
+            [this](const std::pair<std::string, uint64_t> &left, const std::pair<std::string, uint64_t> &right)
+            {
+                bool leftFavorite = favorites.contains(left.first);
+                bool rightFavorite = favorites.contains(right.first);
+                if (leftFavorite != rightFavorite)
+                {
+                    return leftFavorite;
+                }
+                return left.second > right.second;
+            });
+        for (const auto &candidate : candidates)
+        {
+            if (result.size() >= maxPlugins)
+            {
+                break;
+            }
+            if (failedUris.contains(candidate.first) || candidate.first.starts_with("vst3:"))
+            {
+                continue;
+            }
+            result.push_back(candidate.first);
+        }
+        return result;
+    }
+
+    template <typename INSTANCE>
+    size_t InstancePool<INSTANCE>::GetSpareCount(const std::string &uri) const
+    {
+        auto f = spares.find(uri);
+        return f == spares.end() ? 0 : f->second.size();
+    }
+
+    template <typename INSTANCE>
+    std::string InstancePool<INSTANCE>::FindMissingSpare() const
+    {
+        for (const auto &uri : GetPooledUris())
+        {
+            if (GetSpareCount(uri) < sparesPerPlugin)
+            {
+                return uri;
+            }
+        }
+        return "";
+    }
+
+    template <typename INSTANCE>
+    std::unique_ptr<INSTANCE> InstancePool<INSTANCE>::Take(const std::string &uri)
+    {
+        auto f = spares.find(uri);
+        if (f == spares.end() || f->second.empty())
+        {
+            return nullptr;
+        }
+        std::unique_ptr<INSTANCE> result = std::move(f->second.back());
+        f->second.pop_back();
+        return result;
+    }
+
+    template <typename INSTANCE>
+    bool InstancePool<INSTANCE>::RefillOne()
+    {
+        uint64_t generation;
+        std::string uri = GetMissingSpare(&generation);
+        if (uri.empty())
+        {
+            return false;
+        }
+        return AddSpare(uri, generation, CreateSpare(uri));
+    }
+
+    template <typename INSTANCE>
+    std::string InstancePool<INSTANCE>::GetMissingSpare(uint64_t *pGeneration) const
+    {
+        *pGeneration = this->generation;
+        return FindMissingSpare();
+    }
+
+    template <typename INSTANCE>
+    std::unique_ptr<INSTANCE> InstancePool<INSTANCE>::CreateSpare(const std::string &uri) const
+    {
+        try
+        {
+            return factory(uri);
+        }
+        catch (const std::exception &e)
+        {
+            Lv2Log::warning(SS("Can't create a spare instance of " << uri << ". " << e.what()));
+            return nullptr;
+        }
+    }
+
+    template <typename INSTANCE>
+    bool InstancePool<INSTANCE>::AddSpare(const std::string &uri, uint64_t generation, std::unique_ptr<INSTANCE> instance)
+    {
+        if (generation != this->generation)
+        {
+            // e.g. created for a sample rate that is no longer current.
+            return NeedsRefill();
+        }
+        if (!instance)
+        {
+            failedUris.insert(uri);
+        }
+        else if (GetSpareCount(uri) < sparesPerPlugin)
+        {
+            spares[uri].push_back(std::move(instance));
+        }
+        return NeedsRefill();
+    }
+
+    template <typename INSTANCE>
+    void InstancePool<INSTANCE>::Clear()
+    {
+        ++generation;
+        spares.clear();
+        failedUris.clear();
+    }
+}
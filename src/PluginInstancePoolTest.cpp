@@ -0,0 +1,237 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "PluginInstancePool.hpp"
+
+using namespace pipedal;
+
+namespace
+{
+    struct TestInstance
+    {
+        std::string uri;
+    };
+
+    class TestPool : public InstancePool<TestInstance>
+    {
+    public:
+        TestPool()
+            : InstancePool<TestInstance>(
+                  [this](const std::string &uri) -> std::unique_ptr<TestInstance>
+                  {
+                      ++instancesCreated;
+                      if (uri == "missing")
+                      {
+                          return nullptr;
+                      }
+                      if (uri == "throws")
+                      {
+                          throw std::runtime_error("Instantiation failed.");
+                      }
+                      return std::unique_ptr<TestInstance>(new TestInstance{uri});
+                  })
+        {
+        }
+        size_t instancesCreated = 0;
+
+        void Use(const std::string &uri, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                NoteUsage(uri);
+            }
+        }
+        size_t RefillAll()
+        {
+            size_t calls = 0;
+            while (NeedsRefill())
+            {
+                RefillOne();
+                if (++calls > 100)
+                {
+                    throw std::runtime_error("RefillOne doesn't terminate.");
+                }
+            }
+            return calls;
+        }
+    };
+
+    using Uris = std::vector<std::string>;
+}
+
+TEST_CASE("PluginInstancePool ordering", "[plugin_instance_pool][Build][Dev]")
+{
+    TestPool pool;
+    pool.Use("a", 1);
+    pool.Use("b", 5);
+    pool.Use("c", 3);
+    pool.Use("d", 3);
+    pool.Use("vst3:e", 10);
+
+    // disabled by default.
+    REQUIRE(pool.GetPooledUris().empty());
+    REQUIRE(!pool.NeedsRefill());
+
+    pool.SetPoolSize(1, 10);
+    // most used first; ties in uri order. VST3 plugins aren't pooled.
+    REQUIRE(pool.GetPooledUris() == Uris{"b", "c", "d", "a"});
+
+    // favorites come first, whether or not they have been used.
+    pool.SetFavorites({"a", "z"});
+    REQUIRE(pool.GetPooledUris() == Uris{"a", "z", "b", "c", "d"});
+
+    pool.SetPoolSize(1, 3);
+    REQUIRE(pool.GetPooledUris() == Uris{"a", "z", "b"});
+
+    pool.Use("c", 10);
+    REQUIRE(pool.GetPooledUris() == Uris{"a", "z", "c"});
+
+    pool.SetPoolSize(0, 3);
+    REQUIRE(pool.GetPooledUris().empty());
+}
+
+TEST_CASE("PluginInstancePool refill and take", "[plugin_instance_pool][Build][Dev]")
+{
+    TestPool pool;
+    pool.SetPoolSize(2, 4);
+    pool.Use("a", 2);
+    pool.Use("b", 1);
+
+    REQUIRE(pool.NeedsRefill());
+    REQUIRE(pool.RefillOne()); // one instance per call.
+    REQUIRE(pool.instancesCreated == 1);
+    pool.RefillAll();
+    REQUIRE(pool.instancesCreated == 4);
+    REQUIRE(pool.GetSpareCount("a") == 2);
+    REQUIRE(pool.GetSpareCount("b") == 2);
+    REQUIRE(!pool.NeedsRefill());
+    REQUIRE(!pool.RefillOne());
+
+    std::unique_ptr<TestInstance> instance = pool.Take("a");
+    REQUIRE(instance);
+    REQUIRE(instance->uri == "a");
+    REQUIRE(pool.GetSpareCount("a") == 1);
+    REQUIRE(pool.NeedsRefill());
+    REQUIRE(!pool.Take("c"));
+
+    REQUIRE(pool.Take("b"));
+    REQUIRE(pool.Take("b"));
+    REQUIRE(!pool.Take("b"));
+
+    pool.RefillAll();
+    REQUIRE(pool.instancesCreated == 7);
+    REQUIRE(pool.GetSpareCount("a") == 2);
+    REQUIRE(pool.GetSpareCount("b") == 2);
+
+    pool.Clear();
+    REQUIRE(pool.GetSpareCount("a") == 0);
+    REQUIRE(pool.NeedsRefill());
+}
+
+TEST_CASE("PluginInstancePool failed plugins", "[plugin_instance_pool][Build][Dev]")
+{
+    TestPool pool;
+    pool.SetPoolSize(1, 2);
+    pool.Use("missing", 3);
+    pool.Use("throws", 2);
+    pool.Use("a", 1);
+
+    REQUIRE(pool.GetPooledUris() == Uris{"missing", "throws"});
+    pool.RefillAll();
+    // plugins that can't be instantiated are skipped, and make room for others.
+    REQUIRE(pool.GetPooledUris() == Uris{"a"});
+    REQUIRE(pool.GetSpareCount("a") == 1);
+    REQUIRE(pool.instancesCreated == 3);
+
+    // ... until the pool is cleared.
+    pool.Clear();
+    REQUIRE(pool.GetPooledUris() == Uris{"missing", "throws"});
+}
+
+TEST_CASE("PluginInstancePool SetPoolSize", "[plugin_instance_pool][Build][Dev]")
+{
+    TestPool pool;
+    pool.SetPoolSize(3, 3);
+    pool.Use("a", 3);
+    pool.Use("b", 2);
+    pool.Use("c", 1);
+    pool.RefillAll();
+    REQUIRE(pool.GetSpareCount("a") == 3);
+    REQUIRE(pool.GetSpareCount("c") == 3);
+
+    // fewer spares per plugin.
+    pool.SetPoolSize(1, 3);
+    REQUIRE(pool.GetSpareCount("a") == 1);
+    REQUIRE(pool.GetSpareCount("b") == 1);
+    REQUIRE(pool.GetSpareCount("c") == 1);
+    REQUIRE(!pool.NeedsRefill());
+
+    // fewer plugins: the least used plugins lose their spares.
+    pool.SetPoolSize(1, 2);
+    REQUIRE(pool.GetSpareCount("a") == 1);
+    REQUIRE(pool.GetSpareCount("b") == 1);
+    REQUIRE(pool.GetSpareCount("c") == 0);
+
+    // disabled.
+    pool.SetPoolSize(0, 2);
+    REQUIRE(pool.GetSpareCount("a") == 0);
+    REQUIRE(pool.GetSpareCount("b") == 0);
+    REQUIRE(!pool.NeedsRefill());
+}
+
+TEST_CASE("PluginInstancePool refill in steps", "[plugin_instance_pool][Build][Dev]")
+{
+    TestPool pool;
+    pool.SetPoolSize(1, 2);
+    pool.Use("a", 2);
+    pool.Use("b", 1);
+
+    uint64_t generation;
+    std::string uri = pool.GetMissingSpare(&generation);
+    REQUIRE(uri == "a");
+    REQUIRE(pool.AddSpare(uri, generation, pool.CreateSpare(uri)));
+    REQUIRE(pool.GetSpareCount("a") == 1);
+
+    // a spare created before Clear() is discarded.
+    uri = pool.GetMissingSpare(&generation);
+    REQUIRE(uri == "b");
+    std::unique_ptr<TestInstance> instance = pool.CreateSpare(uri);
+    pool.Clear();
+    REQUIRE(pool.AddSpare(uri, generation, std::move(instance)));
+    REQUIRE(pool.GetSpareCount("b") == 0);
+
+    // a spare that is no longer required is discarded.
+    uri = pool.GetMissingSpare(&generation);
+    REQUIRE(uri == "a");
+    std::unique_ptr<TestInstance> first = pool.CreateSpare(uri);
+    std::unique_ptr<TestInstance> second = pool.CreateSpare(uri);
+    pool.AddSpare(uri, generation, std::move(first));
+    pool.AddSpare(uri, generation, std::move(second));
+    REQUIRE(pool.GetSpareCount("a") == 1);
+
+    // failures are recorded.
+    pool.Use("throws", 3);
+    uri = pool.GetMissingSpare(&generation);
+    REQUIRE(uri == "throws");
+    pool.AddSpare(uri, generation, pool.CreateSpare(uri));
+    REQUIRE(pool.GetPooledUris() == Uris{"a", "b"});
+}
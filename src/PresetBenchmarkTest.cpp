@@ -0,0 +1,406 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <thread>
+
+#include "PluginHost.hpp"
+#include "Lv2Pedalboard.hpp"
+#include "DummyAudioDriver.hpp"
+#include "Banks.hpp"
+#include "JackConfiguration.hpp"
+#include "JackServerSettings.hpp"
+#include "RingBufferReader.hpp"
+#include "json.hpp"
+
+// Whole-pedalboard benchmarks.
+//
+// Loads every preset in default_presets and test_data, runs it on the dummy audio driver for a fixed
+// number of periods at each of several sample rates and buffer sizes, and writes the results as JSON.
+//
+// Hidden from normal test runs. Run from the root of the project:
+//
+//     build/src/pipedaltest "[Benchmark]"
+//
+// or configure with -DPIPEDAL_BENCHMARKS=ON to register it with ctest.
+//
+// Environment variables:
+//     PIPEDAL_BENCHMARK_OUTPUT     Where to write results (default /tmp/pipedal_benchmark.json).
+//     PIPEDAL_BENCHMARK_BASELINE   Results from a previous build. Fails if the mean period cost of any
+//                                  preset has increased by more than PIPEDAL_BENCHMARK_TOLERANCE.
+//     PIPEDAL_BENCHMARK_TOLERANCE  Allowed fractional regression (default 0.2).
+//     PIPEDAL_BENCHMARK_PERIODS    Measured periods per run (default 2000).
+
+using namespace pipedal;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const char *LV2_PATH = "/usr/lib/lv2:/usr/local/lib/lv2:/usr/modep/lv2";
+    const std::vector<std::filesystem::path> PRESET_DIRECTORIES{"default_presets", "test_data"};
+    const std::vector<uint32_t> SAMPLE_RATES{44100, 48000};
+    const std::vector<uint32_t> BUFFER_SIZES{32, 64, 128, 256};
+
+    constexpr double WARMUP_SECONDS = 0.5;
+    constexpr auto RUN_TIMEOUT = std::chrono::minutes(5);
+
+    class PresetBenchmarkResult
+    {
+    public:
+        std::string bank_;
+        std::string preset_;
+        uint32_t sampleRate_ = 0;
+        uint32_t bufferSize_ = 0;
+        uint64_t periods_ = 0;
+        double instantiationMs_ = 0;
+        uint64_t heapBytes_ = 0;   // heap growth due to loading and activating the pedalboard.
+        uint64_t bufferBytes_ = 0; // audio and atom buffers owned by the pedalboard.
+        double meanUs_ = 0;
+        double p99Us_ = 0;
+        double maxUs_ = 0;
+        double cpuPercent_ = 0; // mean period cost as a percentage of the period.
+        std::vector<std::string> errors_;
+
+        DECLARE_JSON_MAP(PresetBenchmarkResult);
+    };
+
+    class PresetBenchmarkResults
+    {
+    public:
+        std::vector<PresetBenchmarkResult> results_;
+
+        DECLARE_JSON_MAP(PresetBenchmarkResults);
+    };
+
+    // Drains the pedalboard's realtime output (VU updates, patch property notifications &c).
+    class RingBufferSink
+    {
+    public:
+        RingBufferSink(RingBuffer<false, true> &ringBuffer)
+            : ringBuffer(ringBuffer)
+        {
+            thread = std::thread([this]()
+                                 { ThreadProc(); });
+        }
+        ~RingBufferSink()
+        {
+            ringBuffer.close();
+            thread.join();
+        }
+
+    private:
+        void ThreadProc()
+        {
+            std::vector<uint8_t> data(1024);
+            while (true)
+            {
+                RingBufferStatus status = ringBuffer.readWait_for(std::chrono::milliseconds(10));
+                if (status == RingBufferStatus::Closed)
+                {
+                    break;
+                }
+                if (status == RingBufferStatus::Ready)
+                {
+                    size_t available = ringBuffer.readSpace();
+                    while (available != 0)
+                    {
+                        size_t thisTime = std::min(data.size(), available);
+                        ringBuffer.read(thisTime, data.data());
+                        available -= thisTime;
+                    }
+                }
+            }
+        }
+        RingBuffer<false, true> &ringBuffer;
+        std::thread thread;
+    };
+
+    // Runs the pedalboard from the dummy audio driver's audio thread.
+    class BenchmarkDriverHost : public AudioDriverHost
+    {
+    public:
+        BenchmarkDriverHost(Lv2Pedalboard *pedalboard, RealtimeRingBufferWriter *ringBufferWriter)
+            : pedalboard(pedalboard), ringBufferWriter(ringBufferWriter)
+        {
+        }
+        AudioDriver *audioDriver = nullptr;
+
+        virtual void OnProcess(size_t nFrames) override
+        {
+            size_t rightInput = audioDriver->InputBufferCount() > 1 ? 1 : 0;
+            size_t rightOutput = audioDriver->OutputBufferCount() > 1 ? 1 : 0;
+            float *inputBuffers[3]{audioDriver->GetInputBuffer(0), audioDriver->GetInputBuffer(rightInput), nullptr};
+            float *outputBuffers[3]{audioDriver->GetOutputBuffer(0), audioDriver->GetOutputBuffer(rightOutput), nullptr};
+            pedalboard->Run(inputBuffers, outputBuffers, (uint32_t)nFrames, ringBufferWriter);
+        }
+        virtual void OnUnderrun() override {}
+        virtual void OnAudioStopped() override {}
+        virtual void OnAudioTerminated() override {}
+
+    private:
+        Lv2Pedalboard *pedalboard;
+        RealtimeRingBufferWriter *ringBufferWriter;
+    };
+
+    DummyAudioDriverStats RunDummyDriver(
+        BenchmarkDriverHost &driverHost,
+        const JackServerSettings &serverSettings,
+        const JackChannelSelection &channelSelection,
+        DummyAudioClock clock,
+        uint64_t periods)
+    {
+        DummyAudioDriverOptions options;
+        options.clock = clock;
+        options.maxPeriods = periods;
+        SetDummyAudioDriverOptions(options);
+
+        std::unique_ptr<AudioDriver> audioDriver{CreateDummyAudioDriver(&driverHost, serverSettings.GetAlsaInputDevice())};
+        driverHost.audioDriver = audioDriver.get();
+        audioDriver->Open(serverSettings, channelSelection);
+        audioDriver->Activate();
+        bool completed = WaitForDummyAudioDriver(RUN_TIMEOUT);
+        DummyAudioDriverStats stats = GetDummyAudioDriverStats();
+        audioDriver->Deactivate();
+        audioDriver->Close();
+        driverHost.audioDriver = nullptr;
+        REQUIRE(completed);
+        return stats;
+    }
+
+    std::string GetEnvironment(const char *name, const std::string &defaultValue)
+    {
+        const char *value = getenv(name);
+        if (value == nullptr || *value == 0)
+        {
+            return defaultValue;
+        }
+        return value;
+    }
+
+    size_t HeapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    std::vector<std::filesystem::path> FindBankFiles()
+    {
+        std::vector<std::filesystem::path> result;
+        for (const auto &directory : PRESET_DIRECTORIES)
+        {
+            if (!std::filesystem::exists(directory))
+            {
+                continue;
+            }
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(directory))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".bank")
+                {
+                    result.push_back(entry.path());
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    PresetBenchmarkResult RunPreset(
+        PluginHost &host,
+        const std::string &bankName,
+        Pedalboard &pedalboard,
+        uint32_t sampleRate,
+        uint32_t bufferSize,
+        uint64_t periods)
+    {
+        PresetBenchmarkResult result;
+        result.bank_ = bankName;
+        result.preset_ = pedalboard.name();
+        result.sampleRate_ = sampleRate;
+        result.bufferSize_ = bufferSize;
+        result.periods_ = periods;
+
+        JackServerSettings serverSettings("dummy:channels_2", sampleRate, bufferSize, 3);
+        JackConfiguration jackConfiguration;
+        jackConfiguration.AlsaInitialize(serverSettings);
+        JackChannelSelection channelSelection = JackChannelSelection::MakeDefault(jackConfiguration);
+        host.OnConfigurationChanged(jackConfiguration, channelSelection);
+
+        size_t initialHeap = HeapInUse();
+        Lv2PedalboardErrorList errors;
+
+        auto instantiationStart = Clock::now();
+        std::unique_ptr<Lv2Pedalboard> lv2Pedalboard{host.CreateLv2Pedalboard(pedalboard, errors)};
+        lv2Pedalboard->Activate();
+        result.instantiationMs_ = std::chrono::duration<double, std::milli>(Clock::now() - instantiationStart).count();
+
+        for (const auto &error : errors)
+        {
+            result.errors_.push_back(error.message);
+        }
+
+        RingBuffer<false, true> ringBuffer{65536, false};
+        RealtimeRingBufferWriter ringBufferWriter(&ringBuffer);
+        RingBufferSink ringBufferSink(ringBuffer);
+
+        // The dummy driver supplies a deterministic synthetic test signal.
+        BenchmarkDriverHost driverHost(lv2Pedalboard.get(), &ringBufferWriter);
+
+        // Warm up: first-run allocations, and initial work on the LV2 scheduler thread, which a
+        // realtime-paced run leaves time for.
+        uint64_t warmupPeriods = (uint64_t)(WARMUP_SECONDS * sampleRate / bufferSize);
+        RunDummyDriver(driverHost, serverSettings, channelSelection, DummyAudioClock::Deterministic, warmupPeriods);
+
+        result.heapBytes_ = HeapInUse() > initialHeap ? HeapInUse() - initialHeap : 0;
+        result.bufferBytes_ = lv2Pedalboard->GetBufferMemoryUse();
+
+        // In freewheel mode, the latency of each period is the cost of processing it.
+        DummyAudioDriverStats stats = RunDummyDriver(driverHost, serverSettings, channelSelection, DummyAudioClock::Freewheel, periods);
+        lv2Pedalboard->Deactivate();
+
+        result.periods_ = stats.periods_;
+        result.meanUs_ = stats.meanLatencyUs_;
+        result.p99Us_ = stats.p99LatencyUs_;
+        result.maxUs_ = stats.maxLatencyUs_;
+        double periodUs = 1E6 * bufferSize / sampleRate;
+        result.cpuPercent_ = result.meanUs_ * 100 / periodUs;
+
+        SetDummyAudioDriverOptions(DummyAudioDriverOptions());
+        return result;
+    }
+
+    std::string ResultKey(const PresetBenchmarkResult &result)
+    {
+        return SS(result.bank_ << "/" << result.preset_ << "@" << result.sampleRate_ << "/" << result.bufferSize_);
+    }
+}
+
+JSON_MAP_BEGIN(PresetBenchmarkResult)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, bank)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, preset)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, sampleRate)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, bufferSize)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, periods)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, instantiationMs)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, heapBytes)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, bufferBytes)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, meanUs)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, p99Us)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, maxUs)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, cpuPercent)
+JSON_MAP_REFERENCE(PresetBenchmarkResult, errors)
+JSON_MAP_END()
+
+JSON_MAP_BEGIN(PresetBenchmarkResults)
+JSON_MAP_REFERENCE(PresetBenchmarkResults, results)
+JSON_MAP_END()
+
+TEST_CASE("Preset performance", "[.Benchmark]")
+{
+    uint64_t periods = std::stoull(GetEnvironment("PIPEDAL_BENCHMARK_PERIODS", "2000"));
+    std::filesystem::path outputPath = GetEnvironment("PIPEDAL_BENCHMARK_OUTPUT", "/tmp/pipedal_benchmark.json");
+    std::string baselinePath = GetEnvironment("PIPEDAL_BENCHMARK_BASELINE", "");
+    double tolerance = std::stod(GetEnvironment("PIPEDAL_BENCHMARK_TOLERANCE", "0.2"));
+
+    std::vector<std::filesystem::path> bankFiles = FindBankFiles();
+    REQUIRE(bankFiles.size() != 0); // must be run from the project root.
+
+    PluginHost host;
+    host.Load(LV2_PATH);
+
+    PresetBenchmarkResults results;
+    for (const auto &bankPath : bankFiles)
+    {
+        BankFile bankFile;
+        {
+            std::ifstream f(bankPath);
+            json_reader reader(f);
+            reader.read(&bankFile);
+        }
+        for (auto &entry : bankFile.presets())
+        {
+            for (uint32_t sampleRate : SAMPLE_RATES)
+            {
+                for (uint32_t bufferSize : BUFFER_SIZES)
+                {
+                    PresetBenchmarkResult result = RunPreset(
+                        host, bankPath.filename().string(), entry->preset(), sampleRate, bufferSize, periods);
+                    std::cout << ResultKey(result)
+                              << " mean: " << result.meanUs_ << "us"
+                              << " p99: " << result.p99Us_ << "us"
+                              << " max: " << result.maxUs_ << "us"
+                              << " (" << result.cpuPercent_ << "%)"
+                              << " load: " << result.instantiationMs_ << "ms"
+                              << std::endl;
+                    results.results_.push_back(std::move(result));
+                }
+            }
+        }
+    }
+
+    {
+        std::ofstream f(outputPath);
+        json_writer writer(f, false);
+        writer.write(results);
+    }
+    std::cout << "Benchmark results written to " << outputPath << std::endl;
+
+    if (baselinePath.length() != 0)
+    {
+        PresetBenchmarkResults baseline;
+        {
+            std::ifstream f(baselinePath);
+            REQUIRE(f.is_open());
+            json_reader reader(f);
+            reader.read(&baseline);
+        }
+        std::map<std::string, const PresetBenchmarkResult *> baselineResults;
+        for (const auto &result : baseline.results_)
+        {
+            baselineResults[ResultKey(result)] = &result;
+        }
+        bool regressed = false;
+        for (const auto &result : results.results_)
+        {
+            auto f = baselineResults.find(ResultKey(result));
+            if (f == baselineResults.end() || f->second->meanUs_ <= 0)
+            {
+                continue;
+            }
+            double change = result.meanUs_ / f->second->meanUs_ - 1;
+            if (change > tolerance)
+            {
+                std::cout << "REGRESSION: " << ResultKey(result)
+                          << " mean " << f->second->meanUs_ << "us -> " << result.meanUs_ << "us"
+                          << " (+" << (change * 100) << "%)" << std::endl;
+                regressed = true;
+            }
+        }
+        REQUIRE(!regressed);
+    }
+}
@@ -256,18 +256,22 @@ void PresetBundleReaderImpl::RenameMediaFileProperty(const std::string oldName,
         auto items = pedalboard.GetAllPlugins();
         for (auto plugin : items)
         {
-            Lv2PluginState &state = plugin->lv2State();
-            for (auto &value : state.values_)
+            std::vector<std::string> renamedKeys;
+            for (const auto &value : plugin->lv2State().values_)
             {
                 if (value.second.atomType_ == LV2_ATOM__Path)
                 {
                     std::string path = ToString(value.second.value_);
                     if (path == oldName)
                     {
-                        state.values_.at(value.first).value_ = ToBinary(newName);
+                        renamedKeys.push_back(value.first);
                     }
                 }
             }
+            for (const auto &key : renamedKeys)
+            {
+                plugin->mutableLv2State().values_.at(key).value_ = ToBinary(newName);
+            }
         }
     }
     for (auto preset : pluginPresets.presets_)
@@ -30,13 +30,14 @@
 namespace pipedal
 {
     class IndexedSnapshot;
+    class RealtimeSnapshots;
+    class RealtimeAudioTaps;
 
     enum class RingBufferCommand : int64_t
     {
         Invalid = 0,
         ReplaceEffect,
         EffectReplaced,
-        SetValue,
         SetBypass,
         AudioStopped,
         SetVuSubscriptions,
@@ -79,6 +80,13 @@ namespace pipedal
 
         SendPathPropertyBuffer,
 
+        SetAudioTaps,
+        FreeAudioTaps,
+
+        SetRealtimeSnapshots,
+        FreeRealtimeSnapshots,
+        RealtimeMidiSnapshotApplied,
+
     };
 
     struct RealtimeMidiEventRequest
@@ -92,6 +100,12 @@ namespace pipedal
         int64_t snapshotRequestId;
     };
 
+    struct RealtimeMidiSnapshotApplied
+    {
+        int32_t snapshotIndex;
+        IndexedSnapshot *snapshot;
+    };
+
     struct RealtimeNextMidiProgramRequest
     {
         int64_t requestId;
@@ -177,13 +191,6 @@ namespace pipedal
         float value;
     };
 
-    class SetControlValueBody
-    {
-    public:
-        int effectIndex;
-        int controlIndex;
-        float value;
-    };
     class SetVolumeBody
     {
     public:
@@ -403,6 +410,11 @@ namespace pipedal
 
             write(RingBufferCommand::RealtimeMidiSnapshotRequest, msg);
         }
+        void OnRealtimeMidiSnapshotApplied(int32_t snapshotIndex, IndexedSnapshot *snapshot)
+        {
+            RealtimeMidiSnapshotApplied msg{snapshotIndex, snapshot};
+            write(RingBufferCommand::RealtimeMidiSnapshotApplied, msg);
+        }
 
         void OnNextMidiProgram(int64_t requestId, int32_t direction)
         {
@@ -415,14 +427,6 @@ namespace pipedal
             write(RingBufferCommand::NextMidiBank, msg);
         }
 
-        void SetControlValue(int effectIndex, int controlIndex, float value)
-        {
-            SetControlValueBody body;
-            body.effectIndex = effectIndex;
-            body.controlIndex = controlIndex;
-            body.value = value;
-            write(RingBufferCommand::SetValue, body);
-        }
         void SetInputVolume(float value)
         {
             SetVolumeBody body;
@@ -440,6 +444,10 @@ namespace pipedal
         {
             write(RingBufferCommand::FreeVuSubscriptions, configuration);
         }
+        void FreeAudioTaps(RealtimeAudioTaps *taps)
+        {
+            write(RingBufferCommand::FreeAudioTaps, taps);
+        }
         void FreeMonitorPortSubscriptions(RealtimeMonitorPortSubscriptions *subscriptions)
         {
 
@@ -474,10 +482,18 @@ namespace pipedal
         {
             write(RingBufferCommand::SetVuSubscriptions, configuration);
         }
+        void SetAudioTaps(RealtimeAudioTaps *taps)
+        {
+            write(RingBufferCommand::SetAudioTaps, taps);
+        }
         void LoadSnapshot(IndexedSnapshot *snapshot)
         {
             write(RingBufferCommand::LoadSnapshot, snapshot);
         }
+        void SetRealtimeSnapshots(RealtimeSnapshots *snapshots)
+        {
+            write(RingBufferCommand::SetRealtimeSnapshots, snapshots);
+        }
 
         void AckMidiProgramRequest(int64_t requestId)
         {
@@ -522,6 +538,10 @@ namespace pipedal
         {
             write(RingBufferCommand::FreeSnapshot, snapshot);
         }
+        void FreeRealtimeSnapshots(RealtimeSnapshots *snapshots)
+        {
+            write(RingBufferCommand::FreeRealtimeSnapshots, snapshots);
+        }
 
         void WriteLv2ErrorMessage(int64_t instanceId, const char *message)
         {
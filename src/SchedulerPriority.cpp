@@ -18,6 +18,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "SchedulerPriority.hpp"
+#include "ThreadPlacement.hpp"
 #include "Lv2Log.hpp"
 #include "memory.h"
 #include "sched.h"
@@ -35,6 +36,9 @@ static constexpr int EXPECTED_RT_THREAD_PRIORITY_MAX = 81;
 static constexpr int RT_AUDIO_THREAD_PRIORITY = 80;
 static constexpr int NICE_AUDIO_THREAD_PRIORITY = -19;
 
+static constexpr int RT_MIDIINPUT_THREAD_PRIORITY = 70;
+static constexpr int NICE_MIDIINPUT_THREAD_PRIORITY = -18;
+
 static constexpr int RT_AUDIOSERVICE_THREAD_PRIORITY = 10;
 static constexpr int NICE_AUDIOSERVICE_THREAD_PRIORITY = -17;
 
@@ -44,6 +48,17 @@ static constexpr int NICE_LV2SCHEDULER_THREAD_PRIORITY = 2; // nice(2): don't le
 static constexpr int RT_WEBSERVER_THREAD_PRIORITY = -1;
 static constexpr int NICE_WEBSERVER_THREAD_PRIORITY = -2; // don't get bogged down by UI threads.
 
+static thread_local bool isRealtimeThread = false;
+
+void pipedal::MarkRealtimeThread()
+{
+    isRealtimeThread = true;
+}
+bool pipedal::IsRealtimeThread()
+{
+    return isRealtimeThread;
+}
+
 bool pipedal::IsRtPreemptKernel(SchedulerPriority priority)
 {
     #ifdef __linux__
@@ -122,8 +137,13 @@ void pipedal::SetThreadPriority(SchedulerPriority priority)
     switch (priority)
     {
     case SchedulerPriority::RealtimeAudio:
+        isRealtimeThread = true;
         SetPriority(RT_AUDIO_THREAD_PRIORITY, NICE_AUDIO_THREAD_PRIORITY, "RealtimeAudio");
         break;
+    case SchedulerPriority::MidiInput:
+        isRealtimeThread = true;
+        SetPriority(RT_MIDIINPUT_THREAD_PRIORITY, NICE_MIDIINPUT_THREAD_PRIORITY, "MidiInput");
+        break;
     case SchedulerPriority::AudioService:
         SetPriority(RT_AUDIOSERVICE_THREAD_PRIORITY, NICE_AUDIOSERVICE_THREAD_PRIORITY, "AudioService");
         break;
@@ -137,6 +157,7 @@ void pipedal::SetThreadPriority(SchedulerPriority priority)
         Lv2Log::error("Invalid scheduler priority.");
         throw std::runtime_error("Invalid value.");
     }
+    SetThreadAffinity(priority);
 #elif defined(__WIN32)
 // Realtime thread priority must be set using MM scheduler.
 // Others must run with elevated priority, but not realtime priority (MUST run with higher priority than UI threads).
@@ -22,6 +22,7 @@
 namespace pipedal {
     enum class SchedulerPriority {
         RealtimeAudio, // the audio service thread.
+        MidiInput, // MIDI input thread. (must be serviced promptly to get accurate timestamps)
         AudioService, // non-realtime servicing of AudioThread responses.
         Lv2Scheduler, // LV2 Scheduler service thread.
         WebServerThread, // Web server threads.
@@ -30,4 +31,9 @@ namespace pipedal {
     bool IsRtPreemptKernel(SchedulerPriority priority);
 
     void SetThreadPriority(SchedulerPriority priority);
+
+    // Mark the current thread as a realtime thread for threads whose priority is set by someone else (e.g. Jack).
+    void MarkRealtimeThread();
+    // True if the current thread is a realtime thread, which must not block or call into the logging system.
+    bool IsRealtimeThread();
 }
\ No newline at end of file
@@ -296,15 +296,14 @@ void SplitEffect::SetChainBuffers(
 
 void SplitEffect::snapToMixTarget()
 {
-    this->blendLTop = targetBlendLTop;
-    this->blendRTop = targetBlendRTop;
-    this->blendRBottom = targetBlendRBottom;
-    this->blendLBottom = targetBlendLBottom;
+    for (int c = 0; c < 2; ++c)
+    {
+        this->blendTop[c] = targetBlendTop[c];
+        this->blendBottom[c] = targetBlendBottom[c];
+        this->blendDxTop[c] = 0;
+        this->blendDxBottom[c] = 0;
+    }
     this->blendFadeSamples = 0;
-    this->blendDxLTop = 0;
-    this->blendDxRTop = 0;
-    this->blendDxLBottom = 0;
-    this->blendDxRBottom = 0;
 }
 
 void SplitEffect::mixToTarget()
@@ -314,17 +313,18 @@ void SplitEffect::mixToTarget()
         transitionSamples = 1;
     double dxScale = 1.0 / transitionSamples;
     this->blendFadeSamples = transitionSamples;
-    this->blendDxLTop = dxScale * (this->targetBlendLTop - this->blendLTop);
-    this->blendDxRTop = dxScale * (this->targetBlendRTop - this->blendRTop);
-    this->blendDxLBottom = dxScale * (this->targetBlendLBottom - this->blendLBottom);
-    this->blendDxRBottom = dxScale * (this->targetBlendRBottom - this->blendRBottom);
+    for (int c = 0; c < 2; ++c)
+    {
+        this->blendDxTop[c] = dxScale * (this->targetBlendTop[c] - this->blendTop[c]);
+        this->blendDxBottom[c] = dxScale * (this->targetBlendBottom[c] - this->blendBottom[c]);
+    }
 }
 
 void SplitEffect::mixTo(float value)
 {
     float blend = (value + 1) * 0.5f;
-    this->targetBlendRTop = this->targetBlendLTop = 1 - blend;
-    this->targetBlendLBottom = this->targetBlendRBottom = blend;
+    this->targetBlendTop[0] = this->targetBlendTop[1] = 1 - blend;
+    this->targetBlendBottom[0] = this->targetBlendBottom[1] = blend;
     mixToTarget();
 }
 void SplitEffect::mixTo(float panL, float volL, float panR, float volR)
@@ -334,17 +334,17 @@ void SplitEffect::mixTo(float panL, float volL, float panR, float volR)
     if (this->outputBuffers.size() == 1)
     {
         // ignore pan. The R values actually have no effect.
-        this->targetBlendLTop = this->targetBlendRTop = aTop;
-        this->targetBlendLBottom = this->targetBlendRBottom = aBottom;
+        this->targetBlendTop[0] = this->targetBlendTop[1] = aTop;
+        this->targetBlendBottom[0] = this->targetBlendBottom[1] = aBottom;
     }
     else
     {
         float blendTop = (panL + 1) * 0.5;
         float blendBottom = (panR + 1) * 0.5;
-        this->targetBlendLTop = (1 - blendTop) * aTop;
-        this->targetBlendRTop = (blendTop)*aTop;
-        this->targetBlendLBottom = (1 - blendBottom) * aBottom;
-        this->targetBlendRBottom = (blendBottom)*aBottom;
+        this->targetBlendTop[0] = (1 - blendTop) * aTop;
+        this->targetBlendTop[1] = (blendTop)*aTop;
+        this->targetBlendBottom[0] = (1 - blendBottom) * aBottom;
+        this->targetBlendBottom[1] = (blendBottom)*aBottom;
     }
     mixToTarget();
 }
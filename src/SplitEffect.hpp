@@ -23,6 +23,7 @@
 #include "PiPedalException.hpp"
 #include "PiPedalMath.hpp"
 #include <assert.h>
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 
@@ -101,20 +102,15 @@ namespace pipedal
 
         float currentMix = 0;
 
-        float targetBlendLTop = 0.5;
-        float targetBlendRTop = 0.5;
-        float targetBlendLBottom = 0.5;
-        float targetBlendRBottom = 0.5;
+        // Mix gains, indexed by output channel (0 = L, 1 = R).
+        float targetBlendTop[2] = {0.5, 0.5};
+        float targetBlendBottom[2] = {0.5, 0.5};
 
-        float blendLTop = 0.5;
-        float blendRTop = 0.5;
-        float blendLBottom = 0.5;
-        float blendRBottom = 0.5;
+        float blendTop[2] = {0.5, 0.5};
+        float blendBottom[2] = {0.5, 0.5};
 
-        float blendDxLTop = 0;
-        float blendDxRTop = 0;
-        float blendDxLBottom = 0;
-        float blendDxRBottom = 0;
+        float blendDxTop[2] = {0, 0};
+        float blendDxBottom[2] = {0, 0};
 
         std::vector<float> defaultInputControlValues;
         
@@ -124,160 +120,127 @@ namespace pipedal
 
         bool activated = false;
 
-        using MixFunction = void (SplitEffect::*)(uint32_t frames);
+        // Pre-mix routing: the index of the split input that feeds each chain input channel.
+        int topSource[2] = {0, 0};
+        int bottomSource[2] = {0, 0};
 
-        MixFunction preAbTop;
-        MixFunction preAbBottom;
-
-        void Copy(float *input, float *output, uint32_t frames)
+        static void CopyBlock(const float *__restrict input, float *__restrict output, uint32_t frames)
         {
-            for (int i = 0; i < frames; ++i)
+            if (input != output)
             {
-                output[i] = input[i];
+                std::copy(input, input + frames, output);
             }
         }
 
-        void abTopMonoMono(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-        }
-        void abTopMonoStereo(uint32_t frames)
+        // output = gainTop*top + gainBottom*bottom, with constant gains.
+        static void MixBlock(
+            float *__restrict output,
+            const float *__restrict top, const float *__restrict bottom,
+            float gainTop, float gainBottom,
+            uint32_t frames)
         {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-            Copy(this->inputs[0], this->topInputs[1], frames);
-        }
-        void abTopStereoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-            Copy(this->inputs[1], this->topInputs[1], frames);
+            if (gainBottom == 0)
+            {
+                if (gainTop == 1)
+                {
+                    std::copy(top, top + frames, output);
+                    return;
+                }
+                for (uint32_t i = 0; i < frames; ++i)
+                {
+                    output[i] = gainTop * top[i];
+                }
+                return;
+            }
+            if (gainTop == 0)
+            {
+                if (gainBottom == 1)
+                {
+                    std::copy(bottom, bottom + frames, output);
+                    return;
+                }
+                for (uint32_t i = 0; i < frames; ++i)
+                {
+                    output[i] = gainBottom * bottom[i];
+                }
+                return;
+            }
+            for (uint32_t i = 0; i < frames; ++i)
+            {
+                output[i] = gainTop * top[i] + gainBottom * bottom[i];
+            }
         }
 
-        void abBottomMonoMono(uint32_t frames)
+        // output = linearly ramped gains applied to top and bottom.
+        static void MixRampBlock(
+            float *__restrict output,
+            const float *__restrict top, const float *__restrict bottom,
+            float gainTop, float dxTop, float gainBottom, float dxBottom,
+            uint32_t frames)
         {
-            Copy(this->inputs[0], this->bottomInputs[0], frames);
-        }
-        void abBottomMonoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->bottomInputs[0], frames);
-            Copy(this->inputs[0], this->bottomInputs[1], frames);
-        }
-        void abBottomStereoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->bottomInputs[0], frames);
-            Copy(this->inputs[1], this->bottomInputs[1], frames);
-        }
-        void lrTopMonoMono(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-        }
-        void lrTopMonoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-            Copy(this->inputs[0], this->topInputs[1], frames);
-        }
-        void lrTopStereoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->topInputs[0], frames);
-            Copy(this->inputs[0], this->topInputs[1], frames);
+            // gains are computed from the block start rather than accumulated, so the loop carries no dependency.
+            for (uint32_t i = 0; i < frames; ++i)
+            {
+                float t = (float)i;
+                output[i] = (gainTop + dxTop * t) * top[i] + (gainBottom + dxBottom * t) * bottom[i];
+            }
         }
 
-        void lrBottomMonoMono(uint32_t frames)
+        template <size_t CHANNELS>
+        void PostMixChannels(uint32_t frames)
         {
-            Copy(this->inputs[0], this->bottomInputs[0], frames);
-        }
-        void lrBottomMonoStereo(uint32_t frames)
-        {
-            Copy(this->inputs[0], this->bottomInputs[0], frames);
-            Copy(this->inputs[0], this->bottomInputs[1], frames);
+            uint32_t offset = 0;
+            if (this->blendFadeSamples != 0)
+            {
+                uint32_t rampFrames = (uint32_t)this->blendFadeSamples < frames ? (uint32_t)this->blendFadeSamples : frames;
+                for (size_t c = 0; c < CHANNELS; ++c)
+                {
+                    MixRampBlock(
+                        this->outputBuffers[c], this->mixTopInputs[c], this->mixBottomInputs[c],
+                        blendTop[c], blendDxTop[c], blendBottom[c], blendDxBottom[c],
+                        rampFrames);
+                    blendTop[c] += blendDxTop[c] * rampFrames;
+                    blendBottom[c] += blendDxBottom[c] * rampFrames;
+                }
+                this->blendFadeSamples -= rampFrames;
+                if (this->blendFadeSamples == 0)
+                {
+                    snapToMixTarget();
+                }
+                offset = rampFrames;
+            }
+            if (offset != frames)
+            {
+                for (size_t c = 0; c < CHANNELS; ++c)
+                {
+                    MixBlock(
+                        this->outputBuffers[c] + offset, this->mixTopInputs[c] + offset, this->mixBottomInputs[c] + offset,
+                        blendTop[c], blendBottom[c],
+                        frames - offset);
+                }
+            }
         }
-        void lrBottomStereoStereo(uint32_t frames)
+
+        static int SourceChannel(size_t nInputs, int channel)
         {
-            Copy(this->inputs[1], this->bottomInputs[0], frames);
-            Copy(this->inputs[1], this->bottomInputs[1], frames);
+            return nInputs == 1 ? 0 : channel;
         }
-
         void updateMixFunction()
         {
             if (activated)
             {
-
-                // Input Mix Functions.
-                if (splitType != SplitType::Lr)
-                {
-                    if (this->inputs.size() == 1)
-                    {
-                        if (this->topInputs.size() == 1)
-                            this->preAbTop = &SplitEffect::abTopMonoMono;
-                        else
-                        {
-                            this->preAbTop = &SplitEffect::abTopMonoStereo;
-                        }
-                        if (this->bottomInputs.size() == 1)
-                        {
-                            this->preAbBottom = &SplitEffect::abBottomMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbBottom = &SplitEffect::abBottomMonoStereo;
-                        }
-                    }
-                    else
-                    {
-                        if (this->topInputs.size() == 1)
-                        {
-                            this->preAbTop == &SplitEffect::abTopMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbTop = &SplitEffect::abTopStereoStereo;
-                        }
-                        if (this->bottomInputs.size() == 1)
-                        {
-                            this->preAbBottom == &SplitEffect::abBottomMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbBottom = &SplitEffect::abBottomStereoStereo;
-                        }
-                    }
-                }
-                else
+                size_t nInputs = this->inputs.size();
+                for (int c = 0; c < 2; ++c)
                 {
-                    if (this->inputs.size() == 1)
+                    if (splitType != SplitType::Lr)
                     {
-                        if (this->topInputs.size() == 1)
-                            this->preAbTop = &SplitEffect::lrTopMonoMono;
-                        else
-                        {
-                            this->preAbTop = &SplitEffect::lrTopMonoStereo;
-                        }
-                        if (this->bottomInputs.size() == 1)
-                        {
-                            this->preAbBottom = &SplitEffect::lrBottomMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbBottom = &SplitEffect::lrBottomMonoStereo;
-                        }
+                        topSource[c] = bottomSource[c] = SourceChannel(nInputs, c);
                     }
                     else
                     {
-                        if (this->topInputs.size() == 1)
-                        {
-                            this->preAbTop == &SplitEffect::lrTopMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbTop = &SplitEffect::lrTopStereoStereo;
-                        }
-                        if (this->bottomInputs.size() == 1)
-                        {
-                            this->preAbBottom == &SplitEffect::lrBottomMonoMono;
-                        }
-                        else
-                        {
-                            this->preAbBottom = &SplitEffect::lrBottomStereoStereo;
-                        }
+                        // left input feeds the top chain; right input feeds the bottom chain.
+                        topSource[c] = 0;
+                        bottomSource[c] = SourceChannel(nInputs, 1);
                     }
                 }
                 if (splitType == SplitType::Ab)
@@ -393,119 +356,25 @@ namespace pipedal
         }
         void PreMix(uint32_t frames)
         {
-            (this->*preAbTop)(frames);
-            (this->*preAbBottom)(frames);
-        }
-
-        void PostMixMono(uint32_t frames)
-        {
-            uint32_t ix = 0;
-
-            float *top = this->mixTopInputs[0];
-            float *bottom = this->mixBottomInputs[0];
-            float *output = this->outputBuffers[0];
-
-            while (frames)
+            for (size_t c = 0; c < this->topInputs.size(); ++c)
             {
-                if (this->blendFadeSamples != 0)
-                {
-                    uint32_t framesThisTime = this->blendFadeSamples < frames ? this->blendFadeSamples : frames;
-                    for (uint32_t i = 0; i < framesThisTime; ++i)
-                    {
-                        output[ix] = blendLBottom * bottom[ix] + blendLTop * top[ix];
-                        ++ix;
-
-                        this->blendLTop += this->blendDxLTop;
-                        this->blendLBottom += this->blendDxLBottom;
-                    }
-                    this->blendFadeSamples -= framesThisTime;
-                    frames -= framesThisTime;
-                    if (blendFadeSamples == 0)
-                    {
-                        this->blendLTop = this->targetBlendLTop;
-                        this->blendLBottom = this->targetBlendLBottom;
-                        this->blendDxLTop = this->blendDxLBottom = 0;
-                    }
-                }
-                else
-                {
-                    float blendTop = this->blendLTop;
-                    float blendBottom = this->blendLBottom;
-                    while (frames--)
-                    {
-                        output[ix] = blendBottom * bottom[ix] + blendTop * top[ix];
-                        ++ix;
-                    }
-                    return;
-                }
+                CopyBlock(this->inputs[topSource[c]], this->topInputs[c], frames);
             }
-        }
-
-        void PostMixStereo(uint32_t frames)
-        {
-            uint32_t ix = 0;
-
-            float *top = this->mixTopInputs[0];
-            float *bottom = this->mixBottomInputs[0];
-            float *output = this->outputBuffers[0];
-
-            float *topR = this->mixTopInputs[1];
-            float *bottomR = this->mixBottomInputs[1];
-            float *outputR = this->outputBuffers[1];
-
-            while (frames != 0)
+            for (size_t c = 0; c < this->bottomInputs.size(); ++c)
             {
-                if (this->blendFadeSamples != 0)
-                {
-                    uint32_t framesThisTime = this->blendFadeSamples < frames ? this->blendFadeSamples : frames;
-                    for (int i = 0; i < framesThisTime; ++i)
-                    {
-                        output[ix] = blendLBottom * bottom[ix] + blendLTop * top[ix];
-                        outputR[ix] = blendRBottom * bottomR[ix] + blendRTop * topR[ix];
-                        ++ix;
-
-                        this->blendLTop += this->blendDxLTop;
-                        this->blendRTop += this->blendDxRTop;
-                        this->blendLBottom += this->blendDxLBottom;
-                        this->blendRBottom += this->blendDxRBottom;
-                    }
-                    blendFadeSamples -= framesThisTime;
-                    frames -= framesThisTime;
-                    if (blendFadeSamples == 0)
-                    {
-                        this->blendLTop = this->targetBlendLTop;
-                        this->blendRTop = this->targetBlendRTop;
-                        this->blendLBottom = this->targetBlendLBottom;
-                        this->blendRBottom = this->targetBlendRBottom;
-                        this->blendDxLTop = this->blendDxRTop = this->blendDxLBottom = this->blendDxRBottom = 0;
-                    }
-                }
-                else
-                {
-                    float blendLTop = this->blendLTop;
-                    float blendRTop = this->blendRTop;
-                    float blendLBottom = this->blendLBottom;
-                    float blendRBottom = this->blendRBottom;
-
-                    for (int i = 0; i < frames; ++i)
-                    {
-                        output[ix] = blendLBottom * bottom[ix] + blendLTop * top[ix];
-                        outputR[ix] = blendRBottom * bottomR[ix] + blendRTop * topR[ix];
-                        ++ix;
-                    }
-                    return;
-                }
+                CopyBlock(this->inputs[bottomSource[c]], this->bottomInputs[c], frames);
             }
         }
+
         void PostMix(uint32_t frames)
         {
             if (this->outputBuffers.size() == 1)
             {
-                PostMixMono(frames);
+                PostMixChannels<1>(frames);
             }
             else
             {
-                PostMixStereo(frames);
+                PostMixChannels<2>(frames);
             }
         }
 
@@ -209,6 +209,11 @@ void Lv2PluginState::write_json(json_writer &writer) const
     writer.write(isValid_);
     writer.write_raw(",");
     writer.write(values_);
+    if (IsExternal())
+    {
+        writer.write_raw(",");
+        writer.write(blobKey_);
+    }
     writer.end_array();
 }
 void Lv2PluginState::read_json(json_reader &reader) {
@@ -216,6 +221,12 @@ void Lv2PluginState::read_json(json_reader &reader) {
     reader.read(&isValid_);
     reader.consume(',');
     reader.read(&values_);
+    blobKey_.clear();
+    if (reader.peek() == ',')
+    {
+        reader.consume(',');
+        reader.read(&blobKey_);
+    }
     reader.consume(']');
 }
 
@@ -315,5 +326,6 @@ bool Lv2PluginStateEntry::operator==(const Lv2PluginStateEntry&other) const
 bool Lv2PluginState::IsEqual(const Lv2PluginState&other) const
 {
     if (other.isValid_ != this->isValid_) return false;
+    if (other.blobKey_ != this->blobKey_) return false;
     return (other.values_ == this->values_);
 }
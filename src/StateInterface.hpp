@@ -46,10 +46,14 @@ namespace pipedal
     public:
         bool isValid_ = false;
         std::map<std::string,Lv2PluginStateEntry> values_;
+        // If non-empty, values_ have been moved to the preset BlobStore, and must be loaded before use.
+        std::string blobKey_;
         void Erase() {
             isValid_ = false;
             values_.clear();
+            blobKey_.clear();
         }
+        bool IsExternal() const { return !blobKey_.empty(); }
         bool IsEqual(const Lv2PluginState&other) const ;
 
         bool operator==(const Lv2PluginState&other) const { return IsEqual(other); }
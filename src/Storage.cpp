@@ -28,18 +28,25 @@
 #include <fstream>
 #include "Lv2Log.hpp"
 #include <map>
+#include <set>
 #include <sys/stat.h>
 #include "PiPedalUI.hpp"
 #include "PluginHost.hpp"
 #include "ss.hpp"
 #include "ofstream_synced.hpp"
 #include "ModFileTypes.hpp"
+#include "MediaIndex.hpp"
+#include "BlobStore.hpp"
 
 using namespace pipedal;
 namespace fs = std::filesystem;
 
 const char *BANK_EXTENSION = ".bank";
 const char *BANKS_FILENAME = "index.banks";
+const char *BANK_INDEX_EXTENSION = ".bank.index";
+
+// plugin states smaller than this are kept inline in bank files.
+static constexpr size_t MIN_BLOB_SIZE = 512;
 
 #define USER_SETTINGS_FILENAME "userSettings.json";
 
@@ -70,17 +77,169 @@ static bool isSubdirectory(const fs::path &path, const fs::path &basePath)
     return true;
 }
 
+// Apply fn to the LV2 state of each plugin (including those in splits) and each snapshot value. fn returns true if it replaced the state.
+// Snapshots are shared with other copies of the pedalboard, so modified snapshots are copied.
+template <typename FN>
+static bool UpdateLv2States(std::vector<PedalboardItem> &items, FN &fn)
+{
+    bool changed = false;
+    for (auto &item : items)
+    {
+        if (fn(item.lv2State_))
+        {
+            changed = true;
+        }
+        if (UpdateLv2States(item.topChain_, fn))
+        {
+            changed = true;
+        }
+        if (UpdateLv2States(item.bottomChain_, fn))
+        {
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+template <typename FN>
+static bool UpdateLv2States(Pedalboard &pedalboard, FN fn)
+{
+    bool changed = UpdateLv2States(pedalboard.items(), fn);
+    for (auto &snapshot : pedalboard.snapshots())
+    {
+        if (!snapshot)
+            continue;
+        std::shared_ptr<Snapshot> newSnapshot;
+        for (size_t i = 0; i < snapshot->values_.size(); ++i)
+        {
+            CopyOnWrite<Lv2PluginState> state = snapshot->values_[i].lv2State_;
+            if (fn(state))
+            {
+                if (!newSnapshot)
+                {
+                    newSnapshot = std::make_shared<Snapshot>(*snapshot);
+                }
+                newSnapshot->values_[i].lv2State_ = state;
+            }
+        }
+        if (newSnapshot)
+        {
+            snapshot = newSnapshot;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static std::vector<std::string> GetBlobKeys(const Pedalboard &pedalboard)
+{
+    std::set<std::string> keys;
+    Pedalboard t = pedalboard; // (cheap: settings are copy-on-write)
+    UpdateLv2States(
+        t,
+        [&keys](CopyOnWrite<Lv2PluginState> &state)
+        {
+            if (state->IsExternal())
+            {
+                keys.insert(state->blobKey_);
+            }
+            return false;
+        });
+    return std::vector<std::string>(keys.begin(), keys.end());
+}
+
+static int64_t GetFileTime(const fs::path &path)
+{
+    return (int64_t)fs::last_write_time(path).time_since_epoch().count();
+}
+
+// The byte range of each preset's JSON in a bank file, in the order the presets appear.
+static std::vector<std::pair<int64_t, int64_t>> FindPresetRanges(std::istream &is)
+{
+    std::vector<std::pair<int64_t, int64_t>> result;
+    json_reader reader(is);
+    reader.start_object();
+    while (reader.peek() != '}')
+    {
+        std::string memberName = reader.read_string();
+        reader.consume(':');
+        if (memberName != "presets")
+        {
+            reader.skip_property();
+        }
+        else
+        {
+            reader.consume('[');
+            while (reader.peek() != ']')
+            {
+                reader.start_object();
+                while (reader.peek() != '}')
+                {
+                    std::string entryMemberName = reader.read_string();
+                    reader.consume(':');
+                    reader.peek(); // skip whitespace.
+                    int64_t offset = (int64_t)is.tellg();
+                    reader.skip_property();
+                    if (entryMemberName == "preset")
+                    {
+                        result.push_back(std::make_pair(offset, (int64_t)is.tellg() - offset));
+                    }
+                    if (reader.peek() == ',')
+                    {
+                        reader.consume(',');
+                    }
+                }
+                reader.end_object();
+                if (reader.peek() == ',')
+                {
+                    reader.consume(',');
+                }
+            }
+            reader.consume(']');
+        }
+        if (reader.peek() == ',')
+        {
+            reader.consume(',');
+        }
+    }
+    return result;
+}
+
+// Write a bank's index. A failure just means the bank gets parsed in full next time.
+static void WriteBankFileIndex(const fs::path &fileName, const fs::path &indexFileName, BankFileIndex &index)
+{
+    try
+    {
+        index.bankFileSize_ = (int64_t)fs::file_size(fileName);
+        index.bankFileTime_ = GetFileTime(fileName);
+        pipedal::ofstream_synced f;
+        f.open(indexFileName, std::ios_base::trunc);
+        json_writer writer(f, true);
+        writer.write(index);
+    }
+    catch (const std::exception &e)
+    {
+        Lv2Log::warning(SS("Can't write bank index. (" << indexFileName << ") " << e.what()));
+        fs::remove(indexFileName);
+    }
+}
+
 static bool hasSyntheticModRoot(const UiFileProperty &fileProperty)
 {
     return (fileProperty.modDirectories().size() > 1 || (fileProperty.modDirectories().size() == 1 && fileProperty.useLegacyModDirectory()));
 }
 
 Storage::Storage()
+: mediaIndex(std::make_unique<MediaIndex>())
 {
     SetConfigRoot("~/var/Config");
     SetDataRoot("~/var/PiPedal");
 }
 
+Storage::~Storage()
+{
+}
+
 inline bool isSafeCharacter(char c)
 {
     return (c >= '0' && c <= '9') | (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '-';
@@ -259,6 +418,7 @@ void Storage::Initialize()
     {
         std::filesystem::create_directories(this->GetPresetsDirectory());
         std::filesystem::create_directories(this->GetPluginPresetsDirectory());
+        this->blobStore = std::make_unique<BlobStore>(GetBlobDirectory());
 
         MaybeCopyDefaultPresets();
     }
@@ -269,6 +429,7 @@ void Storage::Initialize()
     LoadPluginPresetIndex();
     LoadBankIndex();
     LoadCurrentBank();
+    CollectGarbage();
     try
     {
         LoadChannelSelection();
@@ -287,7 +448,10 @@ void Storage::LoadBank(int64_t instanceId)
 
     try
     {
-        LoadBankFile(indexEntry.name(), &(this->currentBank));
+        // load into a temporary, so that a bank that can't be read leaves the current bank intact.
+        BankFile bankFile;
+        LoadBankFile(indexEntry.name(), &bankFile);
+        this->currentBank = std::move(bankFile);
         if (this->bankIndex.selectedBank() != instanceId)
         {
             this->bankIndex.selectedBank(instanceId);
@@ -310,6 +474,10 @@ std::filesystem::path Storage::GetPresetsDirectory() const
 {
     return this->dataRoot / "presets";
 }
+std::filesystem::path Storage::GetBlobDirectory() const
+{
+    return this->GetPresetsDirectory() / "blobs";
+}
 std::filesystem::path Storage::GetPluginPresetsDirectory() const
 {
     return this->dataRoot / "plugin_presets";
@@ -337,6 +505,11 @@ std::filesystem::path Storage::GetBankFileName(const std::string &name) const
     std::string fileName = SafeEncodeName(name) + BANK_EXTENSION;
     return this->GetPresetsDirectory() / fileName;
 }
+std::filesystem::path Storage::GetBankIndexFileName(const std::string &name) const
+{
+    std::string fileName = SafeEncodeName(name) + BANK_INDEX_EXTENSION;
+    return this->GetPresetsDirectory() / fileName;
+}
 
 void Storage::LoadBankIndex()
 {
@@ -458,19 +631,358 @@ void Storage::GetBankFile(int64_t instanceId, BankFile *pBank) const
     json_reader reader(is);
     reader.read(pBank);
     pBank->name(indexEntry.name());
+    for (auto &entry : pBank->presets())
+    {
+        ResolveState(entry->preset());
+    }
 }
 
 void Storage::LoadBankFile(const std::string &name, BankFile *pBank)
 {
+    if (LoadBankFileIndex(name, pBank) && (pBank->IsStateExternalized() || !pluginStateBlobs))
+    {
+        return;
+    }
+    // The index is missing or stale, or the bank hasn't been migrated to the blob store yet.
     std::filesystem::path fileName = GetBankFileName(name);
-    std::ifstream is(fileName);
-    json_reader reader(is);
-    reader.read(pBank);
+    std::string text;
+    {
+        std::ifstream f(fileName, std::ios_base::binary);
+        std::stringstream s;
+        s << f.rdbuf();
+        text = s.str();
+    }
+    std::vector<std::pair<int64_t, int64_t>> presetRanges;
+    {
+        std::stringstream s(text);
+        json_reader reader(s);
+        reader.read(pBank);
+    }
+    {
+        std::stringstream s(text);
+        presetRanges = FindPresetRanges(s);
+    }
+    if (presetRanges.size() != pBank->presets().size())
+    {
+        throw PiPedalException(SS("Can't index bank file " << fileName));
+    }
+    // Unless pluginStateBlobs is set, the plugin state encoding is left as it was read, so banks
+    // written by earlier versions remain readable by them.
+    if (pluginStateBlobs && ExternalizeState(*pBank))
+    {
+        Lv2Log::info(SS("Moving plugin state of bank " << name << " to the blob store."));
+        SaveBankFile(name, *pBank);
+        return;
+    }
+
+    // The bank is unchanged. Rebuild the index from the file as read.
+    pBank->SetSourceFile(fileName);
+    BankFileIndex index;
+    index.nextInstanceId_ = pBank->nextInstanceId();
+    index.selectedPreset_ = pBank->selectedPreset();
+    index.pluginStateBlobs_ = pBank->IsStateExternalized();
+    for (size_t i = 0; i < pBank->presets().size(); ++i)
+    {
+        auto &entry = pBank->presets()[i];
+        entry->SetFileLocation(presetRanges[i].first, presetRanges[i].second);
+
+        BankFileIndexEntry indexEntry;
+        indexEntry.instanceId_ = entry->instanceId();
+        indexEntry.name_ = entry->preset().name();
+        indexEntry.offset_ = presetRanges[i].first;
+        indexEntry.length_ = presetRanges[i].second;
+        indexEntry.blobKeys_ = GetBlobKeys(entry->preset());
+        index.presets_.push_back(std::move(indexEntry));
+    }
+    WriteBankFileIndex(fileName, GetBankIndexFileName(name), index);
 }
 
-void Storage::SaveBankFile(const std::string &name, const BankFile &bankFile)
+bool Storage::LoadBankFileIndex(const std::string &name, BankFile *pBank)
 {
+    std::filesystem::path indexFileName = GetBankIndexFileName(name);
     std::filesystem::path fileName = GetBankFileName(name);
+    BankFileIndex index;
+    try
+    {
+        if (!fs::exists(indexFileName))
+        {
+            return false;
+        }
+        std::ifstream is(indexFileName);
+        json_reader reader(is);
+        reader.read(&index);
+
+        if (index.bankFileSize_ != (int64_t)fs::file_size(fileName) || index.bankFileTime_ != GetFileTime(fileName))
+        {
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        Lv2Log::warning(SS("Ignoring invalid bank index. (" << indexFileName << ") " << e.what()));
+        return false;
+    }
+    pBank->clear();
+    pBank->name(name);
+    pBank->SetStateExternalized(index.pluginStateBlobs_);
+    pBank->SetSourceFile(fileName);
+    pBank->nextInstanceId(index.nextInstanceId_);
+    pBank->selectedPreset(index.selectedPreset_);
+    for (const auto &indexEntry : index.presets_)
+    {
+        auto entry = std::make_unique<BankFileEntry>();
+        entry->instanceId(indexEntry.instanceId_);
+        entry->SetUnloaded(indexEntry.name_, indexEntry.offset_, indexEntry.length_, indexEntry.blobKeys_);
+        pBank->presets().push_back(std::move(entry));
+    }
+    return true;
+}
+
+Pedalboard Storage::ReadPresetEntry(const BankFile &bankFile, const BankFileEntry &entry) const
+{
+    if (entry.IsLoaded())
+    {
+        return entry.preset();
+    }
+    const std::filesystem::path &fileName = bankFile.SourceFile();
+
+    std::string text;
+    text.resize(entry.FileLength());
+    std::ifstream is(fileName, std::ios_base::binary);
+    is.seekg(entry.FileOffset());
+    is.read(text.data(), text.length());
+    if (!is)
+    {
+        throw PiPedalException(SS("Can't read preset from " << fileName));
+    }
+    Pedalboard result;
+    std::stringstream s(text);
+    json_reader reader(s);
+    reader.read(&result);
+    return result;
+}
+
+BankFileEntry &Storage::GetLoadedItem(int64_t instanceId)
+{
+    auto &item = currentBank.getItem(instanceId);
+    if (!item.IsLoaded())
+    {
+        item.preset(ReadPresetEntry(currentBank, item));
+    }
+    return item;
+}
+
+bool Storage::ExternalizeState(Pedalboard &pedalboard)
+{
+    if (!pluginStateBlobs)
+    {
+        return false;
+    }
+    return UpdateLv2States(
+        pedalboard,
+        [this](CopyOnWrite<Lv2PluginState> &state)
+        {
+            if (!state->isValid_ || state->IsExternal())
+            {
+                return false;
+            }
+            std::stringstream s;
+            json_writer writer(s, true);
+            writer.write(state->values_);
+            std::string content = s.str();
+            if (content.length() < MIN_BLOB_SIZE)
+            {
+                return false;
+            }
+            Lv2PluginState externalState;
+            externalState.isValid_ = true;
+            externalState.blobKey_ = blobStore->Put(content);
+            state = std::move(externalState);
+            return true;
+        });
+}
+
+bool Storage::ExternalizeState(BankFile &bankFile)
+{
+    bool changed = false;
+    for (auto &entry : bankFile.presets())
+    {
+        if (ExternalizeState(entry->preset()))
+        {
+            changed = true;
+        }
+    }
+    if (pluginStateBlobs)
+    {
+        bankFile.SetStateExternalized(true);
+    }
+    return changed;
+}
+
+void Storage::ResolveState(Pedalboard &pedalboard) const
+{
+    UpdateLv2States(
+        pedalboard,
+        [this](CopyOnWrite<Lv2PluginState> &state)
+        {
+            if (!state->IsExternal())
+            {
+                return false;
+            }
+            Lv2PluginState resolvedState;
+            std::string content;
+            if (blobStore->Get(state->blobKey_, &content))
+            {
+                try
+                {
+                    std::stringstream s(content);
+                    json_reader reader(s);
+                    reader.read(&resolvedState.values_);
+                    resolvedState.isValid_ = state->isValid_;
+                }
+                catch (const std::exception &e)
+                {
+                    Lv2Log::error(SS("Plugin state is corrupted. (" << state->blobKey_ << ") " << e.what()));
+                    resolvedState.values_.clear();
+                }
+            }
+            else
+            {
+                Lv2Log::error(SS("Plugin state not found. (" << state->blobKey_ << ")"));
+            }
+            state = std::move(resolvedState);
+            return true;
+        });
+}
+
+void Storage::CollectGarbage()
+{
+    std::map<std::string, size_t> referenceCounts;
+    auto countReferences = [&referenceCounts](CopyOnWrite<Lv2PluginState> &state)
+    {
+        if (state->IsExternal())
+        {
+            ++referenceCounts[state->blobKey_];
+        }
+        return false;
+    };
+    for (auto &entry : bankIndex.entries())
+    {
+        try
+        {
+            BankFile bankFile;
+            if (LoadBankFileIndex(entry.name(), &bankFile))
+            {
+                for (auto &preset : bankFile.presets())
+                {
+                    for (const auto &key : preset->BlobKeys())
+                    {
+                        ++referenceCounts[key];
+                    }
+                }
+                continue;
+            }
+            std::ifstream is(GetBankFileName(entry.name()));
+            json_reader reader(is);
+            reader.read(&bankFile);
+            for (auto &preset : bankFile.presets())
+            {
+                UpdateLv2States(preset->preset(), countReferences);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            // can't tell what an unreadable bank references, so don't delete anything.
+            Lv2Log::warning(SS("Plugin state cleanup skipped. Can't read bank " << entry.name() << ". " << e.what()));
+            return;
+        }
+    }
+    for (auto &preset : currentBank.presets())
+    {
+        if (preset->IsLoaded())
+        {
+            UpdateLv2States(preset->preset(), countReferences);
+        }
+    }
+    size_t deleted = blobStore->CollectGarbage(referenceCounts);
+    if (deleted != 0)
+    {
+        Lv2Log::info(SS("Deleted " << deleted << " unreferenced plugin state file(s)."));
+    }
+}
+
+void Storage::SaveBankFile(const std::string &name, BankFile &bankFile)
+{
+    std::filesystem::path fileName = GetBankFileName(name);
+    std::filesystem::path indexFileName = GetBankIndexFileName(name);
+
+    // Written by hand (rather than with writer.write(bankFile)) in order to record where each preset starts.
+    // Presets that haven't been loaded are copied from the existing file without being parsed.
+    BankFileIndex index;
+    index.nextInstanceId_ = bankFile.nextInstanceId();
+    index.selectedPreset_ = bankFile.selectedPreset();
+    // Presets added while pluginStateBlobs is off keep their state inline.
+    index.pluginStateBlobs_ = bankFile.IsStateExternalized() && this->pluginStateBlobs;
+
+    std::stringstream s;
+    {
+        std::ifstream existingFile;
+        json_writer writer(s, true);
+        writer.start_object();
+        writer.write_member("name", bankFile.name());
+        writer.write_raw(",");
+        writer.write_member("nextInstanceId", bankFile.nextInstanceId());
+        writer.write_raw(",");
+        writer.write_member("selectedPreset", bankFile.selectedPreset());
+        writer.write_raw(",");
+        writer.write_raw("\"presets\": [");
+        bool first = true;
+        for (auto &entry : bankFile.presets())
+        {
+            if (!first)
+            {
+                writer.write_raw(",");
+            }
+            first = false;
+            writer.start_object();
+            writer.write_member("instanceId", entry->instanceId());
+            writer.write_raw(",");
+            writer.write_raw("\"preset\": ");
+
+            BankFileIndexEntry indexEntry;
+            indexEntry.instanceId_ = entry->instanceId();
+            indexEntry.name_ = entry->preset().name();
+            indexEntry.offset_ = (int64_t)s.tellp();
+            if (entry->IsLoaded())
+            {
+                writer.write(entry->preset());
+                indexEntry.blobKeys_ = GetBlobKeys(entry->preset());
+            }
+            else
+            {
+                if (!existingFile.is_open())
+                {
+                    existingFile.open(bankFile.SourceFile(), std::ios_base::binary);
+                }
+                std::string text;
+                text.resize(entry->FileLength());
+                existingFile.seekg(entry->FileOffset());
+                existingFile.read(text.data(), text.length());
+                if (!existingFile)
+                {
+                    throw PiPedalException(SS("Can't read preset from " << bankFile.SourceFile()));
+                }
+                s << text;
+                indexEntry.blobKeys_ = entry->BlobKeys();
+            }
+            indexEntry.length_ = (int64_t)s.tellp() - indexEntry.offset_;
+            writer.end_object();
+            index.presets_.push_back(std::move(indexEntry));
+        }
+        writer.write_raw("]");
+        writer.end_object();
+    }
+
     std::filesystem::path backupFile = ((std::string)fileName) + ".$$$";
     if (std::filesystem::exists(backupFile))
     {
@@ -482,10 +994,11 @@ void Storage::SaveBankFile(const std::string &name, const BankFile &bankFile)
     }
     try
     {
-        pipedal::ofstream_synced s;
-        s.open(fileName, std::ios_base::trunc);
-        json_writer writer(s, true);
-        writer.write(bankFile);
+        {
+            pipedal::ofstream_synced f;
+            f.open(fileName, std::ios_base::trunc | std::ios_base::binary);
+            f << s.str();
+        }
         if (std::filesystem::exists(backupFile))
         {
             std::filesystem::remove(backupFile);
@@ -500,6 +1013,13 @@ void Storage::SaveBankFile(const std::string &name, const BankFile &bankFile)
         }
         throw;
     }
+    bankFile.SetSourceFile(fileName);
+    for (size_t i = 0; i < bankFile.presets().size(); ++i)
+    {
+        bankFile.presets()[i]->SetFileLocation(index.presets_[i].offset_, index.presets_[i].length_);
+    }
+
+    WriteBankFileIndex(fileName, indexFileName, index);
 }
 
 void Storage::SaveCurrentBank()
@@ -508,10 +1028,12 @@ void Storage::SaveCurrentBank()
     SaveBankFile(indexEntry.name(), this->currentBank);
 }
 
-const Pedalboard &Storage::GetCurrentPreset()
+Pedalboard Storage::GetCurrentPreset()
 {
-    auto &item = currentBank.getItem(currentBank.selectedPreset());
-    return item.preset();
+    auto &item = GetLoadedItem(currentBank.selectedPreset());
+    Pedalboard result = item.preset();
+    ResolveState(result);
+    return result;
 }
 
 bool Storage::LoadPreset(int64_t instanceId)
@@ -529,12 +1051,14 @@ void Storage::SaveCurrentPreset(const Pedalboard &pedalboard)
 {
     auto &item = currentBank.getItem(currentBank.selectedPreset());
     item.preset(pedalboard);
+    ExternalizeState(item.preset());
     SaveCurrentBank();
 }
 int64_t Storage::SaveCurrentPresetAs(const Pedalboard &pedalboard, const std::string &name, int64_t saveAfterInstanceId)
 {
     Pedalboard newPedalboard = pedalboard;
     newPedalboard.name(name);
+    ExternalizeState(newPedalboard);
 
     int64_t newInstanceId = currentBank.addPreset(newPedalboard, saveAfterInstanceId);
     currentBank.selectedPreset(newInstanceId);
@@ -606,7 +1130,9 @@ Pedalboard Storage::GetPreset(int64_t instanceId) const
     {
         if (currentBank.presets()[i]->instanceId() == instanceId)
         {
-            return currentBank.presets()[i]->preset();
+            Pedalboard result = ReadPresetEntry(currentBank, *currentBank.presets()[i]);
+            ResolveState(result);
+            return result;
         }
     }
     throw PiPedalException("Not found.");
@@ -621,6 +1147,10 @@ int64_t Storage::DeletePreset(int64_t presetId)
 
 bool Storage::RenamePreset(int64_t presetId, const std::string &name)
 {
+    if (this->currentBank.hasItem(presetId))
+    {
+        GetLoadedItem(presetId);
+    }
     if (this->currentBank.renamePreset(presetId, name))
     {
         SaveCurrentBank();
@@ -709,7 +1239,7 @@ int64_t Storage::CreateNewPreset()
 
 int64_t Storage::CopyPreset(int64_t fromId, int64_t toId)
 {
-    auto &fromItem = this->currentBank.getItem(fromId);
+    auto &fromItem = GetLoadedItem(fromId);
     if (toId == -1)
     {
         Pedalboard newPedalboard = fromItem.preset();
@@ -792,6 +1322,11 @@ void Storage::RenameBank(int64_t bankId, const std::string &newName)
     try
     {
         std::filesystem::rename(oldPath, newPath);
+        std::filesystem::path oldIndexPath = this->GetBankIndexFileName(entry.name());
+        if (std::filesystem::exists(oldIndexPath))
+        {
+            std::filesystem::rename(oldIndexPath, this->GetBankIndexFileName(newName));
+        }
     }
     catch (std::exception &e)
     {
@@ -800,6 +1335,10 @@ void Storage::RenameBank(int64_t bankId, const std::string &newName)
         throw PiPedalException(s.str());
     }
     entry.name(newName);
+    if (bankId == this->bankIndex.selectedBank())
+    {
+        this->currentBank.SetSourceFile(newPath);
+    }
     SaveBankIndex();
 }
 
@@ -816,6 +1355,13 @@ int64_t Storage::SaveBankAs(int64_t bankId, const std::string &newName)
     try
     {
         std::filesystem::copy(oldPath, newPath);
+        std::filesystem::path oldIndexPath = this->GetBankIndexFileName(entry.name());
+        if (std::filesystem::exists(oldIndexPath))
+        {
+            // the index is only valid for a bank file with the same modification time.
+            std::filesystem::last_write_time(newPath, std::filesystem::last_write_time(oldPath));
+            std::filesystem::copy(oldIndexPath, this->GetBankIndexFileName(newName));
+        }
     }
     catch (std::exception &e)
     {
@@ -856,6 +1402,7 @@ int64_t Storage::DeleteBank(int64_t bankId)
         if (entry.instanceId() == bankId)
         {
             std::filesystem::path fileName = this->GetBankFileName(entry.name());
+            std::filesystem::path indexFileName = this->GetBankIndexFileName(entry.name());
             entries.erase(entries.begin() + i);
 
             int64_t newSelection;
@@ -889,6 +1436,8 @@ int64_t Storage::DeleteBank(int64_t bankId)
             }
             this->SaveBankIndex();
             std::filesystem::remove(fileName);
+            std::filesystem::remove(indexFileName);
+            CollectGarbage();
             return newSelection;
         }
     }
@@ -924,6 +1473,7 @@ int64_t Storage::UploadPreset(const BankFile &bankFile, int64_t uploadAfter)
             s << baseName << "(" << n++ << ")";
             preset.name(s.str());
         }
+        ExternalizeState(preset);
 
         lastPreset = this->currentBank.addPreset(preset, lastPreset);
     }
@@ -952,14 +1502,8 @@ int64_t Storage::UploadBank(BankFile &bankFile, int64_t uploadAfter)
         s << baseName << "(" << n++ << ")";
         bankFile.name(s.str());
     }
-    std::filesystem::path path = this->GetBankFileName(bankFile.name());
-    pipedal::ofstream_synced f(path);
-    if (!f.is_open())
-    {
-        throw PiPedalException("Can't write to bank file.");
-    }
-    json_writer writer(f, true);
-    writer.write(bankFile);
+    ExternalizeState(bankFile);
+    SaveBankFile(bankFile.name(), bankFile);
 
     lastBank = this->bankIndex.addBank(lastBank, bankFile.name());
     this->SaveBankIndex();
@@ -1695,36 +2239,79 @@ static bool ensureNoDotDot(const std::filesystem::path &path)
     return true;
 }
 
+static std::string ToLower(const std::string &value)
+{
+    std::string result = value;
+    for (auto &c : result)
+    {
+        c = (char)std::tolower((unsigned char)c);
+    }
+    return result;
+}
+
+namespace pipedal
+{
+    struct FileListPageRequest
+    {
+        std::string filter; // case-insensitive match on the display names of files (but not directories).
+        size_t offset = 0;
+        size_t count = 0;
+    };
+}
+
 static void AddFilesToResult(
     FileRequestResult &result,
     const UiFileProperty &fileProperty,
-    const fs::path &rootPath)
+    const fs::path &rootPath,
+    MediaIndex &mediaIndex,
+    const FileListPageRequest *page)
 {
     if (!fs::exists(rootPath))
     {
         return; // silently without error.
     }
+    std::string lowerFilter = page ? ToLower(page->filter) : std::string();
+
+    auto predicate = [&fileProperty, &lowerFilter](const FileEntry &entry)
+    {
+        if (entry.isDirectory_)
+        {
+            return true;
+        }
+        if (!fileProperty.IsValidExtension(fs::path(entry.displayName_).extension().string()))
+        {
+            return false;
+        }
+        return lowerFilter.empty() || ToLower(entry.displayName_).find(lowerFilter) != std::string::npos;
+    };
+
+    // sort lexicographically
+
+    auto collator = Locale::GetInstance()->GetCollator();
+    auto less = [&collator](const FileEntry &l, const FileEntry &r)
+    {
+        if (l.isDirectory_ != r.isDirectory_)
+        {
+            return l.isDirectory_ > r.isDirectory_;
+        }
+        return collator->Compare(l.displayName_, r.displayName_) < 0;
+    };
+
     auto &resultFiles = result.files_;
     try
     {
-        for (auto const &dir_entry : std::filesystem::directory_iterator(rootPath))
+        if (page)
         {
-            const auto &path = dir_entry.path();
-            auto name = path.filename().string();
-            if (dir_entry.is_regular_file())
-            {
-                if (name.length() > 0 && name[0] != '.') // don't show hidden files.
-                {
-                    if (fileProperty.IsValidExtension(path.extension().string()))
-                    {
-                        resultFiles.push_back(
-                            FileEntry(path, name, false, false));
-                    }
-                }
-            }
-            else if (dir_entry.is_directory())
+            size_t totalFiles = 0;
+            resultFiles = mediaIndex.GetDirectoryPage(rootPath, predicate, less, page->offset, page->count, &totalFiles);
+            result.totalFiles_ = totalFiles;
+            return;
+        }
+        for (auto &entry : mediaIndex.GetDirectoryEntries(rootPath))
+        {
+            if (predicate(entry))
             {
-                resultFiles.push_back(FileEntry{path, name, true, fs::is_symlink(path)});
+                resultFiles.push_back(std::move(entry));
             }
         }
     }
@@ -1733,19 +2320,10 @@ static void AddFilesToResult(
         throw std::logic_error("GetFileList failed. Directory not found: " + rootPath.string());
     }
 
-    // sort lexicographically
-
-    auto collator = Locale::GetInstance()->GetCollator();
-
-    std::sort(resultFiles.begin(), resultFiles.end(), [&collator](const FileEntry &l, const FileEntry &r)
-              {
-        if (l.isDirectory_ != r.isDirectory_)
-        {
-            return l.isDirectory_ > r.isDirectory_;
-        }
-        return collator->Compare(l.displayName_,r.displayName_) < 0; });
+    std::sort(resultFiles.begin(), resultFiles.end(), less);
+    result.totalFiles_ = resultFiles.size();
 }
-FileRequestResult Storage::GetModFileList2(const std::string &relativePath, const UiFileProperty &fileProperty)
+FileRequestResult Storage::GetModFileList2(const std::string &relativePath, const UiFileProperty &fileProperty, const FileListPageRequest *page)
 {
     FileRequestResult result;
     fs::path uploadsDirectory = GetPluginUploadDirectory();
@@ -1771,6 +2349,15 @@ FileRequestResult Storage::GetModFileList2(const std::string &relativePath, cons
         }
         result.breadcrumbs_.push_back({"", "Home"});
         result.currentDirectory_ = relativePath;
+        result.totalFiles_ = result.files_.size();
+        if (page)
+        {
+            // a handful of synthetic directories, which the filter doesn't apply to.
+            auto &files = result.files_;
+            size_t begin = std::min(files.size(), page->offset);
+            size_t end = std::min(files.size(), begin + page->count);
+            files = std::vector<FileEntry>(files.begin() + begin, files.begin() + end);
+        }
         return result;
     }
     fs::path modDirectoryPath;
@@ -1824,7 +2411,7 @@ FileRequestResult Storage::GetModFileList2(const std::string &relativePath, cons
         }
     }
 
-    AddFilesToResult(result, fileProperty, relativePath);
+    AddFilesToResult(result, fileProperty, relativePath, *mediaIndex, page);
     result.currentDirectory_ = relativePath;
     return result;
 }
@@ -1842,7 +2429,7 @@ static bool IsChildDirectory(const fs::path& child, const fs::path&parent) {
     return true;
 }
 
-FileRequestResult Storage::GetFileList2(const std::string &relativePath_, const UiFileProperty &fileProperty)
+FileRequestResult Storage::GetFileList2(const std::string &relativePath_, const UiFileProperty &fileProperty, const FileListPageRequest *page)
 {
     std::string absolutePath = relativePath_;
     if (!ensureNoDotDot(absolutePath))
@@ -1851,7 +2438,7 @@ FileRequestResult Storage::GetFileList2(const std::string &relativePath_, const
     }
     if (hasSyntheticModRoot(fileProperty))
     {
-        return Storage::GetModFileList2(absolutePath, fileProperty);
+        return Storage::GetModFileList2(absolutePath, fileProperty, page);
     }
 
     FileRequestResult result;
@@ -1911,10 +2498,21 @@ FileRequestResult Storage::GetFileList2(const std::string &relativePath_, const
     {
         throw std::runtime_error(SS("Improper location. " << absolutePath));
     }
-    AddFilesToResult(result, fileProperty, absolutePath);
+    AddFilesToResult(result, fileProperty, absolutePath, *mediaIndex, page);
     return result;
 }
 
+FileRequestResult Storage::GetFileListPage(
+    const std::string &relativePath,
+    const UiFileProperty &fileProperty,
+    const std::string &filter,
+    size_t offset,
+    size_t count)
+{
+    FileListPageRequest page{filter, offset, count};
+    return GetFileList2(relativePath, fileProperty, &page);
+}
+
 bool Storage::IsValidSampleFileName(const std::filesystem::path &fileName)
 {
     if (!fileName.is_absolute())
@@ -1987,8 +2585,10 @@ void Storage::DeleteSampleFile(const std::filesystem::path &fileName)
     }
     catch (const std::exception &)
     {
+        mediaIndex->InvalidatePath(fileName);
         throw std::logic_error("Permission denied.");
     }
+    mediaIndex->InvalidatePath(fileName);
 }
 std::filesystem::path Storage::MakeUserFilePath(const std::string &directory, const std::string &filename)
 {
@@ -2005,6 +2605,17 @@ std::filesystem::path Storage::MakeUserFilePath(const std::string &directory, co
     }
     return result;
 }
+// The outermost directory that create_directories(path) will create, or an empty path if it already exists.
+static std::filesystem::path OutermostMissingDirectory(const std::filesystem::path &path)
+{
+    std::filesystem::path result;
+    for (auto directory = path; !directory.empty() && !std::filesystem::exists(directory); directory = directory.parent_path())
+    {
+        result = directory;
+    }
+    return result;
+}
+
 std::string Storage::UploadUserFile(const std::string &directory, const std::string &patchProperty, const std::string &filename, std::istream &stream, size_t contentLength)
 {
     std::filesystem::path path;
@@ -2022,6 +2633,7 @@ std::string Storage::UploadUserFile(const std::string &directory, const std::str
         throw std::logic_error("patchProperty directory not implemented.");
     }
     {
+        std::filesystem::path newDirectory = OutermostMissingDirectory(path.parent_path());
         try
         {
             std::filesystem::create_directories(path.parent_path());
@@ -2055,8 +2667,14 @@ std::string Storage::UploadUserFile(const std::string &directory, const std::str
         {
             Lv2Log::error(SS("Upload failed. " << e.what()));
             std::filesystem::remove(path);
+            mediaIndex->InvalidatePath(path);
             throw;
         }
+        if (!newDirectory.empty())
+        {
+            mediaIndex->InvalidatePath(newDirectory);
+        }
+        mediaIndex->InvalidatePath(path);
     }
     return path.string();
 }
@@ -2076,7 +2694,9 @@ std::string Storage::CreateNewSampleDirectory(const std::string &relativePath, c
     {
         throw std::runtime_error("A directory with that name already exists.");
     }
+    std::filesystem::path newDirectory = OutermostMissingDirectory(path);
     std::filesystem::create_directories(path);
+    mediaIndex->InvalidatePath(newDirectory);
     return path;
 }
 std::string Storage::RenameFilePropertyFile(
@@ -2116,16 +2736,18 @@ std::string Storage::RenameFilePropertyFile(
     }
 
     std::filesystem::rename(oldPath, newPath);
+    mediaIndex->InvalidatePath(oldPath);
+    mediaIndex->InvalidatePath(newPath);
     return newPath;
 }
 
 void Storage::FillSampleDirectoryTree(FilePropertyDirectoryTree *node, const std::filesystem::path &directory) const
 {
-    for (auto child : std::filesystem::directory_iterator(directory))
+    for (const auto &child : mediaIndex->GetDirectoryEntries(directory))
     {
-        if (child.is_directory())
+        if (child.isDirectory_)
         {
-            const auto &childPath = child.path();
+            const std::filesystem::path childPath{child.pathname_};
             FilePropertyDirectoryTree::ptr childTree = std::make_unique<FilePropertyDirectoryTree>(childPath);
             FillSampleDirectoryTree(childTree.get(), childPath);
             node->children_.push_back(std::move(childTree));
@@ -37,6 +37,9 @@ namespace pipedal {
 
 class UiFileProperty;
 class Lv2PluginInfo;
+class MediaIndex;
+struct FileListPageRequest;
+class BlobStore;
 
 class CurrentPreset {
 public:
@@ -71,6 +74,8 @@ private:
     BankIndex bankIndex;
     BankFile currentBank;
     PluginPresetIndex pluginPresetIndex;
+    std::unique_ptr<MediaIndex> mediaIndex;
+    std::unique_ptr<BlobStore> blobStore;
     
 private:
     void FillSampleDirectoryTree(FilePropertyDirectoryTree*node, const std::filesystem::path&directory) const;
@@ -82,6 +87,7 @@ private:
     std::filesystem::path GetPluginPresetsDirectory() const;
     std::filesystem::path GetIndexFileName() const;
     std::filesystem::path GetBankFileName(const std::string & name) const;
+    std::filesystem::path GetBankIndexFileName(const std::string & name) const;
     std::filesystem::path GetChannelSelectionFileName();
     std::filesystem::path GetCurrentPresetPath() const;
 
@@ -93,8 +99,23 @@ private:
 
     void LoadChannelSelection();
     void SaveChannelSelection();
-    void SaveBankFile(const std::string& name,const BankFile&bankFile);
+    void SaveBankFile(const std::string& name,BankFile&bankFile);
     void LoadBankFile(const std::string &name,BankFile *pBank);
+    // Load preset names and file locations from the bank's index, without parsing presets. Returns false if the index is missing or stale.
+    bool LoadBankFileIndex(const std::string &name,BankFile *pBank);
+    // Parse the preset of a bank entry, if it hasn't been loaded yet.
+    Pedalboard ReadPresetEntry(const BankFile&bankFile, const BankFileEntry&entry) const;
+    BankFileEntry&GetLoadedItem(int64_t instanceId);
+
+    // If pluginStateBlobs is set, large plugin state in banks is held in the blob store. Presets in
+    // currentBank then hold blob references; states are loaded (resolved) when a preset leaves Storage.
+    // Blob references are resolved whether or not pluginStateBlobs is set.
+    bool pluginStateBlobs = false;
+    std::filesystem::path GetBlobDirectory() const;
+    bool ExternalizeState(Pedalboard &pedalboard);
+    bool ExternalizeState(BankFile &bankFile);
+    void ResolveState(Pedalboard &pedalboard) const;
+    void CollectGarbage();
     std::string GetPresetCopyName(const std::string &name);
     bool isJackChannelSelectionValid = false;
     JackChannelSelection jackChannelSelection;
@@ -104,11 +125,14 @@ private:
     UserSettings userSettings;
 public:
     Storage();
+    ~Storage();
     void Initialize();
     void CreateBank(const std::string & name);
 
     void SetDataRoot(const std::filesystem::path& path);
     void SetConfigRoot(const std::filesystem::path& path);
+    // Move large plugin state out of bank files into the blob store. Must be called before Initialize().
+    void SetPluginStateBlobs(bool enable) { pluginStateBlobs = enable; }
     const std::filesystem::path&GetConfigRoot();
     const std::filesystem::path&GetDataRoot();
 
@@ -127,7 +151,7 @@ public:
     void SaveUserSettings();
     void LoadBank(int64_t instanceId);
     int64_t GetBankByMidiBankNumber(uint8_t bankNumber);
-    const Pedalboard& GetCurrentPreset();
+    Pedalboard GetCurrentPreset();
     void SaveCurrentPreset(const Pedalboard&pedalboard);
     int64_t SaveCurrentPresetAs(const Pedalboard&pedalboard, const std::string&namne,int64_t saveAfterInstanceId = -1);
     int64_t GetCurrentPresetId() const;
@@ -154,9 +178,17 @@ public:
     int64_t DeleteBank(int64_t bankId);
 
     std::vector<std::string> GetFileList(const UiFileProperty&fileProperty);
-    FileRequestResult GetFileList2(const std::string&relativePath,const UiFileProperty&fileProperty);
+    FileRequestResult GetFileList2(const std::string&relativePath,const UiFileProperty&fileProperty, const FileListPageRequest *page = nullptr);
 
-    FileRequestResult GetModFileList2(const std::string &relativePath,const UiFileProperty &fileProperty);
+    FileRequestResult GetModFileList2(const std::string &relativePath,const UiFileProperty &fileProperty, const FileListPageRequest *page = nullptr);
+
+    // A page of GetFileList2 results. Files (but not directories) are filtered by a case-insensitive match on their display name.
+    FileRequestResult GetFileListPage(
+        const std::string &relativePath,
+        const UiFileProperty &fileProperty,
+        const std::string &filter,
+        size_t offset,
+        size_t count);
 
 
     void SetJackChannelSelection(const JackChannelSelection&channelSelection);
@@ -0,0 +1,264 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "Storage.hpp"
+#include "TemporaryDirectory.hpp"
+#include "json.hpp"
+#include "json_variant.hpp"
+#include "ss.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace pipedal;
+namespace fs = std::filesystem;
+
+namespace
+{
+    class TestStorage : public Storage
+    {
+    public:
+        TestStorage(const TemporaryDirectory &directory)
+        {
+            fs::create_directories(directory.Path() / "config" / "default_presets" / "presets");
+            fs::create_directories(directory.Path() / "data");
+            SetConfigRoot(directory.Path() / "config");
+            SetDataRoot(directory.Path() / "data");
+            Initialize();
+        }
+    };
+
+    Pedalboard MakeTestPreset(float gain)
+    {
+        Pedalboard pedalboard = Pedalboard::MakeDefault();
+        PedalboardItem item;
+        item.instanceId(1000);
+        item.uri("http://example.com/plugins/test");
+        item.controlValues({ControlValue("gain", gain)});
+        pedalboard.items().push_back(item);
+        return pedalboard;
+    }
+
+    float GetTestGain(const Pedalboard &pedalboard)
+    {
+        for (const auto &item : pedalboard.items())
+        {
+            if (item.instanceId() == 1000)
+            {
+                return item.controlValues().at(0).value();
+            }
+        }
+        throw std::runtime_error("Test plugin not found.");
+    }
+
+    std::string ReadFile(const fs::path &path)
+    {
+        std::ifstream f(path, std::ios_base::binary);
+        std::stringstream s;
+        s << f.rdbuf();
+        return s.str();
+    }
+    void WriteFile(const fs::path &path, const std::string &text)
+    {
+        std::ofstream f(path, std::ios_base::binary | std::ios_base::trunc);
+        f << text;
+    }
+}
+
+TEST_CASE("Storage bank index", "[storage][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("StorageTest");
+    fs::path presetsDirectory = testDirectory.Path() / "data" / "presets";
+    fs::path bankFile = presetsDirectory / "Default+Bank.bank";
+    fs::path bankIndexFile = presetsDirectory / "Default+Bank.bank.index";
+
+    std::vector<int64_t> presetIds;
+    {
+        TestStorage storage(testDirectory);
+        for (int i = 0; i < 3; ++i)
+        {
+            presetIds.push_back(storage.SaveCurrentPresetAs(MakeTestPreset((float)i), SS("Preset " << i)));
+        }
+    }
+    REQUIRE(fs::exists(bankFile));
+    REQUIRE(fs::exists(bankIndexFile));
+
+    SECTION("round trip")
+    {
+        auto bankFileTime = fs::last_write_time(bankFile);
+
+        // presets are read from the byte offsets recorded in the index.
+        TestStorage storage(testDirectory);
+        REQUIRE(storage.GetCurrentPresetId() == presetIds[2]);
+        REQUIRE(storage.GetCurrentPreset().name() == "Preset 2");
+        for (int i = 0; i < 3; ++i)
+        {
+            Pedalboard preset = storage.GetPreset(presetIds[i]);
+            REQUIRE(preset.name() == SS("Preset " << i));
+            REQUIRE(GetTestGain(preset) == (float)i);
+        }
+        // a valid index doesn't cause the bank to be rewritten.
+        REQUIRE(fs::last_write_time(bankFile) == bankFileTime);
+
+        // saving a bank with presets that were never loaded copies them unchanged.
+        storage.RenamePreset(presetIds[0], "Renamed");
+        TestStorage reopened(testDirectory);
+        REQUIRE(reopened.GetPreset(presetIds[0]).name() == "Renamed");
+        REQUIRE(GetTestGain(reopened.GetPreset(presetIds[1])) == 1.0f);
+        REQUIRE(GetTestGain(reopened.GetPreset(presetIds[2])) == 2.0f);
+    }
+    SECTION("renamed bank")
+    {
+        // presets that haven't been loaded are read from wherever the bank's file now is.
+        TestStorage storage(testDirectory);
+        storage.RenameBank(storage.GetBanks().selectedBank(), "Renamed Bank");
+        REQUIRE(GetTestGain(storage.GetPreset(presetIds[1])) == 1.0f);
+        storage.RenamePreset(presetIds[0], "Renamed");
+        REQUIRE(GetTestGain(storage.GetPreset(presetIds[2])) == 2.0f);
+    }
+    SECTION("bank file format")
+    {
+        // SaveBankFile writes the bank by hand. It must produce the same document as the BankFile json map,
+        // both for presets it serializes and for presets it copies from the existing file.
+        {
+            TestStorage storage(testDirectory);
+            storage.RenamePreset(presetIds[1], "Renamed");
+        }
+        std::string text = ReadFile(bankFile);
+        BankFile bank;
+        {
+            std::stringstream s(text);
+            json_reader reader(s);
+            reader.read(&bank);
+        }
+        std::stringstream expectedText;
+        {
+            json_writer writer(expectedText, false);
+            writer.write(bank);
+        }
+        json_variant actual;
+        json_variant expected;
+        {
+            std::stringstream s(text);
+            json_reader reader(s);
+            reader.read(&actual);
+        }
+        {
+            std::stringstream s(expectedText.str());
+            json_reader reader(s);
+            reader.read(&expected);
+        }
+        REQUIRE(actual == expected);
+    }
+    SECTION("stale index")
+    {
+        // edit the bank file behind the index's back. Every later preset moves.
+        std::string text = ReadFile(bankFile);
+        size_t pos = text.find("\"Preset 0\"");
+        REQUIRE(pos != std::string::npos);
+        text.replace(pos, 10, "\"Preset 0 (edited)\"");
+        WriteFile(bankFile, text);
+
+        {
+            TestStorage storage(testDirectory);
+            REQUIRE(storage.GetPreset(presetIds[0]).name() == "Preset 0 (edited)");
+            for (int i = 1; i < 3; ++i)
+            {
+                Pedalboard preset = storage.GetPreset(presetIds[i]);
+                REQUIRE(preset.name() == SS("Preset " << i));
+                REQUIRE(GetTestGain(preset) == (float)i);
+            }
+        }
+        // the index was rebuilt without rewriting the bank.
+        REQUIRE(ReadFile(bankFile) == text);
+        auto bankFileTime = fs::last_write_time(bankFile);
+        TestStorage storage(testDirectory);
+        REQUIRE(GetTestGain(storage.GetPreset(presetIds[2])) == 2.0f);
+        REQUIRE(fs::last_write_time(bankFile) == bankFileTime);
+    }
+    SECTION("bank without an index")
+    {
+        // as written by earlier versions.
+        BankFile legacyBank;
+        for (int i = 0; i < 3; ++i)
+        {
+            Pedalboard preset = MakeTestPreset((float)i);
+            preset.name(SS("Legacy " << i));
+            legacyBank.addPreset(preset);
+        }
+        legacyBank.selectedPreset(legacyBank.presets()[1]->instanceId());
+        {
+            std::ofstream f(bankFile, std::ios_base::trunc);
+            json_writer writer(f, false);
+            writer.write(legacyBank);
+        }
+        fs::remove(bankIndexFile);
+        std::string text = ReadFile(bankFile);
+
+        {
+            TestStorage storage(testDirectory);
+            REQUIRE(storage.GetCurrentPreset().name() == "Legacy 1");
+        }
+        REQUIRE(fs::exists(bankIndexFile));
+        REQUIRE(ReadFile(bankFile) == text);
+
+        // presets are read through the rebuilt index.
+        TestStorage storage(testDirectory);
+        for (int i = 0; i < 3; ++i)
+        {
+            Pedalboard preset = storage.GetPreset(legacyBank.presets()[i]->instanceId());
+            REQUIRE(preset.name() == SS("Legacy " << i));
+            REQUIRE(GetTestGain(preset) == (float)i);
+        }
+    }
+    SECTION("unreadable index")
+    {
+        WriteFile(bankIndexFile, "{ not json");
+        TestStorage storage(testDirectory);
+        REQUIRE(GetTestGain(storage.GetPreset(presetIds[1])) == 1.0f);
+    }
+}
+
+TEST_CASE("Storage LoadBank failure", "[storage][Build][Dev]")
+{
+    TemporaryDirectory testDirectory("StorageTest");
+    fs::path presetsDirectory = testDirectory.Path() / "data" / "presets";
+    fs::path otherBankFile = presetsDirectory / "Other.bank";
+
+    TestStorage storage(testDirectory);
+    int64_t presetId = storage.SaveCurrentPresetAs(MakeTestPreset(3), "Current");
+    int64_t bankId = storage.GetBanks().selectedBank();
+    int64_t otherBankId = storage.SaveBankAs(bankId, "Other");
+
+    SECTION("unreadable bank")
+    {
+        WriteFile(otherBankFile, "{ \"name\": \"Other\", \"presets\": [ corrupted");
+        REQUIRE_THROWS(storage.LoadBank(otherBankId));
+    }
+
+    // the current bank is untouched.
+    REQUIRE(storage.GetBanks().selectedBank() == bankId);
+    REQUIRE(storage.GetCurrentPresetId() == presetId);
+    Pedalboard preset = storage.GetCurrentPreset();
+    REQUIRE(preset.name() == "Current");
+    REQUIRE(GetTestGain(preset) == 3.0f);
+}
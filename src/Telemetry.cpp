@@ -0,0 +1,225 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Telemetry.hpp"
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace pipedal;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Seqlock requires a lock-free sequence counter.");
+static_assert(offsetof(TelemetrySegment, writerPid) == 3 * sizeof(uint32_t), "HasLiveWriter reads the header as uint32_t[4].");
+
+int64_t pipedal::TelemetryNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+TelemetryWriter::TelemetryWriter(const std::string &segmentName)
+    : segmentName(segmentName)
+{
+    memset(&data, 0, sizeof(data));
+    data.temperaturemC = -100000;
+}
+TelemetryWriter::~TelemetryWriter()
+{
+    Close();
+}
+
+// True if the segment's header names a writer process that is still running.
+static bool HasLiveWriter(const std::string &segmentName)
+{
+    int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+    {
+        return false;
+    }
+    // (read rather than map, since the segment may be truncated under us.)
+    uint32_t header[4]; // magic, version, size, writerPid
+    bool result = false;
+    if (pread(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header) && header[0] == TELEMETRY_MAGIC)
+    {
+        pid_t writerPid = (pid_t)header[3];
+        result = writerPid > 0 && (kill(writerPid, 0) == 0 || errno == EPERM);
+    }
+    close(fd);
+    return result;
+}
+
+bool TelemetryWriter::Open()
+{
+    Close();
+    // Another running process owns the segment. Leave it alone.
+    if (HasLiveWriter(segmentName))
+    {
+        return false;
+    }
+    // /dev/shm is world-writable. Don't reuse an existing segment, which another user could have created in order
+    // to feed false data to readers, or to truncate under us (SIGBUS on the writer). Remove any segment left by a
+    // previous instance, and create a new one exclusively. (Another user's segment can't be removed, so O_EXCL fails.)
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        return false;
+    }
+    // world-readable regardless of umask, so that monitoring agents don't have to run as pipedal_d.
+    fchmod(fd, 0644);
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_uid != geteuid() || !S_ISREG(st.st_mode) || st.st_size != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(TelemetrySegment)) == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size != sizeof(TelemetrySegment))
+    {
+        close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        return false;
+    }
+    segment = (TelemetrySegment *)p;
+
+    // invalidate while the header is being (re)written.
+    segment->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->version = TELEMETRY_VERSION;
+    segment->size = sizeof(TelemetrySegment);
+    segment->writerPid = (uint32_t)getpid();
+    segment->sequence.store(0, std::memory_order_relaxed);
+    memcpy(&segment->data, &data, sizeof(data));
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = TELEMETRY_MAGIC;
+    return true;
+}
+
+void TelemetryWriter::Close()
+{
+    if (segment)
+    {
+        segment->magic = 0;
+        munmap(segment, sizeof(TelemetrySegment));
+        segment = nullptr;
+        shm_unlink(segmentName.c_str());
+    }
+}
+
+void TelemetryWriter::Publish()
+{
+    if (!segment)
+        return;
+    uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&segment->data, &data, sizeof(data));
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+TelemetryReader::TelemetryReader(const std::string &segmentName)
+    : segmentName(segmentName)
+{
+}
+TelemetryReader::~TelemetryReader()
+{
+    Close();
+}
+
+void TelemetryReader::Open()
+{
+    Close();
+    int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("Can't open telemetry segment. Is pipedald running? (") + strerror(errno) + ")");
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(TelemetrySegment))
+    {
+        close(fd);
+        throw std::runtime_error("Telemetry segment has an unexpected size. (pipedald version mismatch?)");
+    }
+    if ((st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Telemetry segment is writable by other users.");
+    }
+    void *p = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw std::runtime_error(std::string("Can't map telemetry segment. (") + strerror(errno) + ")");
+    }
+    segment = (const TelemetrySegment *)p;
+    if (segment->magic != TELEMETRY_MAGIC || segment->version != TELEMETRY_VERSION || segment->size != sizeof(TelemetrySegment))
+    {
+        Close();
+        throw std::runtime_error("Telemetry segment has an incompatible version.");
+    }
+}
+
+void TelemetryReader::Close()
+{
+    if (segment)
+    {
+        munmap((void *)segment, sizeof(TelemetrySegment));
+        segment = nullptr;
+    }
+}
+
+uint32_t TelemetryReader::GetWriterPid() const
+{
+    return segment ? segment->writerPid : 0;
+}
+
+bool TelemetryReader::Read(TelemetryData *data)
+{
+    if (!segment)
+        return false;
+    for (int retry = 0; retry < 1000; ++retry)
+    {
+        uint32_t sequence = segment->sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+        {
+            continue;
+        }
+        memcpy(data, (const void *)&segment->data, sizeof(TelemetryData));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment->sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            return segment->magic == TELEMETRY_MAGIC;
+        }
+    }
+    return false;
+}
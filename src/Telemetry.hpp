@@ -0,0 +1,124 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pipedal
+{
+    // Layout of the pipedald telemetry shared-memory segment (/dev/shm/pipedal_telemetry).
+    //
+    // The segment is written by a single thread in pipedald and protected by a seqlock: the writer
+    // increments sequence before and after each update, so readers retry if they see an odd sequence
+    // number, or if the sequence number changed while they were copying. Increment TELEMETRY_VERSION
+    // whenever the layout changes.
+
+    constexpr const char *TELEMETRY_SHM_NAME = "/pipedal_telemetry";
+    constexpr uint32_t TELEMETRY_MAGIC = 0x4D4C4554; // "TELM"
+    constexpr uint32_t TELEMETRY_VERSION = 1;
+    constexpr size_t TELEMETRY_MAX_VUS = 64;
+
+    struct TelemetryVu
+    {
+        int64_t instanceId;
+        float inputMaxValueL;
+        float inputMaxValueR;
+        float outputMaxValueL;
+        float outputMaxValueR;
+    };
+
+    struct TelemetryData
+    {
+        int64_t statusTimeNs; // CLOCK_REALTIME time of the last status update.
+        uint32_t active;
+        uint32_t restarting;
+        uint64_t underruns;
+        float cpuUsage; // percent
+        int32_t temperaturemC;
+        uint64_t cpuFreqMin;
+        uint64_t cpuFreqMax;
+
+        int64_t vuTimeNs; // CLOCK_REALTIME time of the last VU update. (VUs are only updated while a client is displaying them)
+        uint32_t vuCount;
+        TelemetryVu vus[TELEMETRY_MAX_VUS];
+    };
+
+    struct TelemetrySegment
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size; // sizeof(TelemetrySegment)
+        uint32_t writerPid;
+        std::atomic<uint32_t> sequence;
+        TelemetryData data;
+    };
+
+    // Publishes telemetry. Not thread-safe: use from a single thread.
+    class TelemetryWriter
+    {
+    public:
+        // (segmentName is only overridden by tests.)
+        TelemetryWriter(const std::string &segmentName = TELEMETRY_SHM_NAME);
+        ~TelemetryWriter();
+        TelemetryWriter(const TelemetryWriter &) = delete;
+        TelemetryWriter &operator=(const TelemetryWriter &) = delete;
+
+        // Creates a new segment. Fails if a segment with the same name belongs to a running process, or
+        // can't be removed (e.g. one created by another user).
+        bool Open();
+        void Close();
+        bool IsOpen() const { return segment != nullptr; }
+
+        // Staging copy. Modify, then call Publish().
+        TelemetryData &Data() { return data; }
+        void Publish();
+
+    private:
+        std::string segmentName;
+        TelemetryData data;
+        TelemetrySegment *segment = nullptr;
+    };
+
+    class TelemetryReader
+    {
+    public:
+        TelemetryReader(const std::string &segmentName = TELEMETRY_SHM_NAME);
+        ~TelemetryReader();
+        TelemetryReader(const TelemetryReader &) = delete;
+        TelemetryReader &operator=(const TelemetryReader &) = delete;
+
+        // Throws std::runtime_error if the segment doesn't exist, has an incompatible version, or is writable by other users.
+        void Open();
+        void Close();
+
+        // Returns false if a consistent copy couldn't be obtained. (The writer is updating continuously, or has stopped mid-update).
+        bool Read(TelemetryData *data);
+        uint32_t GetWriterPid() const;
+
+    private:
+        std::string segmentName;
+        const TelemetrySegment *segment = nullptr;
+    };
+
+    int64_t TelemetryNow();
+}
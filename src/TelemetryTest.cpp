@@ -0,0 +1,241 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "Telemetry.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pipedal;
+
+namespace
+{
+    // (a private segment name, so that tests don't disturb a running pipedald.)
+    std::string TestSegmentName()
+    {
+        return "/pipedal_telemetry_test_" + std::to_string(getpid());
+    }
+
+    void SetAll(TelemetryData &data, uint64_t value)
+    {
+        data.statusTimeNs = (int64_t)value;
+        data.underruns = value;
+        data.cpuFreqMin = value;
+        data.cpuFreqMax = value;
+        data.vuCount = (uint32_t)(value % TELEMETRY_MAX_VUS);
+        for (size_t i = 0; i < TELEMETRY_MAX_VUS; ++i)
+        {
+            data.vus[i].instanceId = (int64_t)value;
+        }
+    }
+    bool IsConsistent(const TelemetryData &data)
+    {
+        uint64_t value = data.underruns;
+        if ((uint64_t)data.statusTimeNs != value || data.cpuFreqMin != value || data.cpuFreqMax != value || data.vuCount != value % TELEMETRY_MAX_VUS)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < TELEMETRY_MAX_VUS; ++i)
+        {
+            if ((uint64_t)data.vus[i].instanceId != value)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST_CASE("Telemetry round trip", "[telemetry][Build][Dev]")
+{
+    std::string name = TestSegmentName();
+
+    {
+        TelemetryReader reader(name);
+        REQUIRE_THROWS_AS(reader.Open(), std::runtime_error);
+    }
+
+    TelemetryWriter writer(name);
+    REQUIRE(writer.Open());
+
+    TelemetryReader reader(name);
+    reader.Open();
+    REQUIRE(reader.GetWriterPid() == (uint32_t)getpid());
+
+    writer.Data().active = 1;
+    writer.Data().cpuUsage = 12.5f;
+    writer.Data().vuCount = 1;
+    writer.Data().vus[0].instanceId = 7;
+    writer.Data().vus[0].outputMaxValueR = 0.25f;
+    writer.Publish();
+
+    TelemetryData data;
+    REQUIRE(reader.Read(&data));
+    REQUIRE(data.active == 1);
+    REQUIRE(data.cpuUsage == 12.5f);
+    REQUIRE(data.temperaturemC == -100000);
+    REQUIRE(data.vuCount == 1);
+    REQUIRE(data.vus[0].instanceId == 7);
+    REQUIRE(data.vus[0].outputMaxValueR == 0.25f);
+
+    writer.Data().underruns = 3;
+    writer.Publish();
+    REQUIRE(reader.Read(&data));
+    REQUIRE(data.underruns == 3);
+
+    // a closed writer invalidates the segment for readers that still have it mapped.
+    writer.Close();
+    REQUIRE(!reader.Read(&data));
+}
+
+TEST_CASE("Telemetry seqlock", "[telemetry][Build][Dev]")
+{
+    std::string name = TestSegmentName();
+    TelemetryWriter writer(name);
+    REQUIRE(writer.Open());
+    SetAll(writer.Data(), 0);
+    writer.Publish();
+
+    TelemetryReader reader(name);
+    reader.Open();
+
+    constexpr uint64_t N = 200000;
+    std::atomic<bool> done = false;
+    std::thread writerThread(
+        [&]()
+        {
+            for (uint64_t i = 1; i <= N; ++i)
+            {
+                SetAll(writer.Data(), i);
+                writer.Publish();
+            }
+            done = true;
+        });
+
+    // every copy that Read() accepts is from a single Publish(), and copies never go backwards.
+    size_t reads = 0;
+    bool consistent = true;
+    bool monotonic = true;
+    uint64_t lastValue = 0;
+    TelemetryData data;
+    while (!done)
+    {
+        if (reader.Read(&data))
+        {
+            ++reads;
+            if (!IsConsistent(data))
+            {
+                consistent = false;
+            }
+            if (data.underruns < lastValue)
+            {
+                monotonic = false;
+            }
+            lastValue = data.underruns;
+        }
+    }
+    writerThread.join();
+
+    REQUIRE(reads > 0);
+    REQUIRE(consistent);
+    REQUIRE(monotonic);
+    REQUIRE(reader.Read(&data));
+    REQUIRE(data.underruns == N);
+}
+
+TEST_CASE("Telemetry existing segment", "[telemetry][Build][Dev]")
+{
+    std::string name = TestSegmentName();
+
+    // a stale, truncated segment is replaced rather than reused.
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    REQUIRE(fd != -1);
+    fchmod(fd, 0666);
+    REQUIRE(ftruncate(fd, 1) == 0);
+    close(fd);
+
+    TelemetryWriter writer(name);
+    REQUIRE(writer.Open());
+
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    REQUIRE(fd != -1);
+    struct stat st;
+    REQUIRE(fstat(fd, &st) == 0);
+    close(fd);
+    REQUIRE((size_t)st.st_size == sizeof(TelemetrySegment));
+    REQUIRE((st.st_mode & 0777) == 0644);
+
+    TelemetryReader reader(name);
+    reader.Open();
+    writer.Close();
+
+    // readers refuse segments that other users could write to.
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    REQUIRE(fd != -1);
+    fchmod(fd, 0666);
+    REQUIRE(ftruncate(fd, sizeof(TelemetrySegment)) == 0);
+    close(fd);
+    TelemetryReader otherReader(name);
+    REQUIRE_THROWS_AS(otherReader.Open(), std::runtime_error);
+    shm_unlink(name.c_str());
+}
+
+TEST_CASE("Telemetry live writer", "[telemetry][Build][Dev]")
+{
+    std::string name = TestSegmentName();
+
+    TelemetryWriter writer(name);
+    REQUIRE(writer.Open());
+    writer.Data().underruns = 5;
+    writer.Publish();
+
+    // a second writer doesn't take over a segment whose writer is still running.
+    {
+        TelemetryWriter other(name);
+        REQUIRE(!other.Open());
+    }
+    TelemetryReader reader(name);
+    reader.Open();
+    TelemetryData data;
+    REQUIRE(reader.Read(&data));
+    REQUIRE(data.underruns == 5);
+    reader.Close();
+    writer.Close();
+
+    // a segment left by a writer that is no longer running is replaced.
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    REQUIRE(fd != -1);
+    REQUIRE(ftruncate(fd, sizeof(TelemetrySegment)) == 0);
+    uint32_t header[4] = {TELEMETRY_MAGIC, TELEMETRY_VERSION, (uint32_t)sizeof(TelemetrySegment), 0x7FFFFFF0}; // (> pid_max)
+    REQUIRE(pwrite(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header));
+    close(fd);
+
+    REQUIRE(writer.Open());
+    reader.Open();
+    REQUIRE(reader.GetWriterPid() == (uint32_t)getpid());
+    writer.Close();
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <filesystem>
+#include <string>
+namespace pipedal {
+    // A directory that is deleted, with its contents, when the object is destroyed.
+    class TemporaryDirectory {
+    public:
+        // Creates <system temp directory>/<prefix>-<pid>, replacing any existing directory of that name.
+        TemporaryDirectory(const std::string&prefix);
+        TemporaryDirectory(const TemporaryDirectory&) = delete;
+        TemporaryDirectory&operator=(const TemporaryDirectory&) = delete;
+        ~TemporaryDirectory();
+
+        const std::filesystem::path&Path()const { return path;}
+    private:
+        std::filesystem::path path;
+    };
+}
@@ -0,0 +1,305 @@
+// Copyright (c) 2024 Robin E. R. Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "ThreadPlacement.hpp"
+#include "Lv2Log.hpp"
+#include "ss.hpp"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace pipedal;
+
+namespace
+{
+    std::mutex placementMutex;
+    bool placementEnabled = false;
+    std::vector<int> realtimeCpuSet;
+    std::vector<int> housekeepingCpuSet;
+    std::string placementDescription = "Thread placement disabled.";
+
+    std::string ReadSysFile(const char *path)
+    {
+        std::ifstream f(path);
+        std::string result;
+        if (f.is_open())
+        {
+            std::getline(f, result);
+        }
+        return result;
+    }
+    std::vector<int> ReadSysCpuList(const char *path)
+    {
+        try
+        {
+            return ParseCpuList(ReadSysFile(path));
+        }
+        catch (const std::exception &)
+        {
+            return std::vector<int>();
+        }
+    }
+
+    bool Contains(const std::vector<int> &cpus, int cpu)
+    {
+        return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+    }
+    bool ContainsAll(const std::vector<int> &cpus, const std::vector<int> &subset)
+    {
+        for (int cpu : subset)
+        {
+            if (!Contains(cpus, cpu))
+                return false;
+        }
+        return true;
+    }
+
+#ifdef __linux__
+    bool SetAffinity(const std::vector<int> &cpus)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : cpus)
+        {
+            CPU_SET(cpu, &cpuSet);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (rc != 0)
+        {
+            Lv2Log::warning(SS("Failed to set thread affinity to CPUs " << CpuListToString(cpus) << ". (" << strerror(rc) << ")"));
+            return false;
+        }
+        return true;
+    }
+#else
+    bool SetAffinity(const std::vector<int> &cpus)
+    {
+        return false;
+    }
+#endif
+}
+
+std::vector<int> pipedal::ParseCpuList(const std::string &cpuList)
+{
+    std::vector<int> result;
+    std::stringstream s(cpuList);
+    std::string range;
+    while (std::getline(s, range, ','))
+    {
+        // trim.
+        size_t start = range.find_first_not_of(" \t\n");
+        if (start == std::string::npos)
+            continue;
+        size_t end = range.find_last_not_of(" \t\n");
+        range = range.substr(start, end - start + 1);
+
+        size_t dash = range.find('-');
+        size_t pos;
+        int first, last;
+        if (dash == std::string::npos)
+        {
+            first = last = std::stoi(range, &pos);
+            if (pos != range.length())
+                throw std::invalid_argument(SS("Invalid CPU list: " << cpuList));
+        }
+        else
+        {
+            std::string strFirst = range.substr(0, dash);
+            std::string strLast = range.substr(dash + 1);
+            first = std::stoi(strFirst, &pos);
+            if (pos != strFirst.length())
+                throw std::invalid_argument(SS("Invalid CPU list: " << cpuList));
+            last = std::stoi(strLast, &pos);
+            if (pos != strLast.length())
+                throw std::invalid_argument(SS("Invalid CPU list: " << cpuList));
+        }
+        if (first < 0 || last < first)
+        {
+            throw std::invalid_argument(SS("Invalid CPU list: " << cpuList));
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            if (!Contains(result, cpu))
+            {
+                result.push_back(cpu);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::string pipedal::CpuListToString(const std::vector<int> &cpus)
+{
+    std::stringstream s;
+    size_t i = 0;
+    bool first = true;
+    while (i < cpus.size())
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+        {
+            ++j;
+        }
+        if (!first)
+            s << ',';
+        first = false;
+        if (j == i)
+        {
+            s << cpus[i];
+        }
+        else
+        {
+            s << cpus[i] << '-' << cpus[j];
+        }
+        i = j + 1;
+    }
+    return s.str();
+}
+
+void pipedal::ConfigureThreadPlacement(bool enabled, const std::string &realtimeCpus, const std::string &housekeepingCpus)
+{
+    std::lock_guard lock{placementMutex};
+    placementEnabled = false;
+    placementDescription = "Thread placement disabled.";
+    if (!enabled)
+    {
+        return;
+    }
+
+    std::vector<int> online = ReadSysCpuList("/sys/devices/system/cpu/online");
+    std::vector<int> isolated = ReadSysCpuList("/sys/devices/system/cpu/isolated");
+    std::vector<int> nohzFull = ReadSysCpuList("/sys/devices/system/cpu/nohz_full");
+
+    if (online.size() < 2)
+    {
+        placementDescription = "Thread placement disabled (single core).";
+        Lv2Log::info(placementDescription);
+        return;
+    }
+
+    std::vector<int> realtime;
+    std::vector<int> housekeeping;
+    try
+    {
+        if (realtimeCpus.length() != 0)
+        {
+            realtime = ParseCpuList(realtimeCpus);
+        }
+        else if (isolated.size() != 0 && ContainsAll(online, isolated))
+        {
+            realtime = isolated;
+        }
+        else
+        {
+            realtime.push_back(online[online.size() - 1]);
+        }
+        if (housekeepingCpus.length() != 0)
+        {
+            housekeeping = ParseCpuList(housekeepingCpus);
+        }
+        else
+        {
+            for (int cpu : online)
+            {
+                if (!Contains(realtime, cpu) && !Contains(isolated, cpu))
+                {
+                    housekeeping.push_back(cpu);
+                }
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        placementDescription = SS("Thread placement disabled (" << e.what() << ").");
+        Lv2Log::error(placementDescription);
+        return;
+    }
+    if (realtime.size() == 0 || housekeeping.size() == 0 || !ContainsAll(online, realtime) || !ContainsAll(online, housekeeping))
+    {
+        placementDescription = "Thread placement disabled (invalid CPU configuration).";
+        Lv2Log::error(SS(placementDescription << " Online: " << CpuListToString(online) << " Realtime: " << CpuListToString(realtime) << " Housekeeping: " << CpuListToString(housekeeping)));
+        return;
+    }
+
+    realtimeCpuSet = realtime;
+    housekeepingCpuSet = housekeeping;
+    placementEnabled = true;
+
+    std::stringstream s;
+    s << "Audio: CPU " << CpuListToString(realtime);
+    if (ContainsAll(isolated, realtime))
+    {
+        s << " (isolated";
+        if (ContainsAll(nohzFull, realtime))
+        {
+            s << ", nohz_full";
+        }
+        s << ")";
+    }
+    s << " Other: CPU " << CpuListToString(housekeeping);
+    placementDescription = s.str();
+    Lv2Log::info(SS("Thread placement. " << placementDescription));
+
+    if (!ContainsAll(isolated, realtime))
+    {
+        Lv2Log::info(SS("Audio CPUs are not isolated. Consider adding \"isolcpus=" << CpuListToString(realtime)
+                                                                                 << " nohz_full=" << CpuListToString(realtime) << "\" to the kernel command line."));
+    }
+
+    // threads created from here on inherit housekeeping placement.
+    SetAffinity(housekeepingCpuSet);
+}
+
+void pipedal::SetThreadAffinity(SchedulerPriority priority)
+{
+    std::vector<int> cpus;
+    {
+        std::lock_guard lock{placementMutex};
+        if (!placementEnabled)
+        {
+            return;
+        }
+        switch (priority)
+        {
+        case SchedulerPriority::RealtimeAudio:
+        case SchedulerPriority::MidiInput:
+            cpus = realtimeCpuSet;
+            break;
+        default:
+            cpus = housekeepingCpuSet;
+            break;
+        }
+    }
+    SetAffinity(cpus);
+}
+
+std::string pipedal::GetThreadPlacementDescription()
+{
+    std::lock_guard lock{placementMutex};
+    return placementDescription;
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2024 Robin E. R. Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "SchedulerPriority.hpp"
+
+namespace pipedal
+{
+    // Parse a linux cpu list (e.g. "0-2,5"). Throws std::invalid_argument on malformed input.
+    std::vector<int> ParseCpuList(const std::string &cpuList);
+    std::string CpuListToString(const std::vector<int> &cpus);
+
+    /// @brief Configure CPU placement of threads.
+    ///
+    /// Realtime threads (audio and MIDI input) are pinned to realtimeCpus; all other threads are
+    /// confined to housekeepingCpus. Empty strings select defaults: CPUs isolated with the isolcpus kernel
+    /// parameter if there are any, otherwise the highest-numbered core; housekeeping threads get the remaining cores.
+    ///
+    /// Call on the main thread before any other threads are created, so that threads which never call
+    /// SetThreadPriority inherit the housekeeping affinity.
+    void ConfigureThreadPlacement(bool enabled, const std::string &realtimeCpus, const std::string &housekeepingCpus);
+
+    // Pin the current thread according to its scheduling role. (Called by SetThreadPriority).
+    void SetThreadAffinity(SchedulerPriority priority);
+
+    // Human-readable description of the current placement, for status displays.
+    std::string GetThreadPlacementDescription();
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "ThreadPlacement.hpp"
+#include "catch.hpp"
+#include <stdexcept>
+
+using namespace pipedal;
+
+TEST_CASE("ParseCpuList", "[thread_placement][Build][Dev]")
+{
+    // single CPUs and lists.
+    REQUIRE(ParseCpuList("3") == std::vector<int>{3});
+    REQUIRE(ParseCpuList("0,2,5") == std::vector<int>{0, 2, 5});
+    REQUIRE(ParseCpuList("") == std::vector<int>{});
+
+    // ranges.
+    REQUIRE(ParseCpuList("0-3") == std::vector<int>{0, 1, 2, 3});
+    REQUIRE(ParseCpuList("2-2") == std::vector<int>{2});
+    REQUIRE(ParseCpuList("0-1,4-5,7") == std::vector<int>{0, 1, 4, 5, 7});
+
+    // sorted, without duplicates.
+    REQUIRE(ParseCpuList("5,1-3,2") == std::vector<int>{1, 2, 3, 5});
+
+    // whitespace (sysfs files end with a newline).
+    REQUIRE(ParseCpuList("2-3\n") == std::vector<int>{2, 3});
+    REQUIRE(ParseCpuList(" 1 , 3\t") == std::vector<int>{1, 3});
+    REQUIRE(ParseCpuList("1,,2") == std::vector<int>{1, 2});
+
+    // invalid input.
+    REQUIRE_THROWS_AS(ParseCpuList("a"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("1x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("3-1"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("-1"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("1-"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("1-2-3"), std::invalid_argument);
+    REQUIRE_THROWS_AS(ParseCpuList("1 2"), std::invalid_argument);
+}
+
+TEST_CASE("CpuListToString", "[thread_placement][Build][Dev]")
+{
+    REQUIRE(CpuListToString({}) == "");
+    REQUIRE(CpuListToString({3}) == "3");
+    REQUIRE(CpuListToString({0, 1, 2, 3}) == "0-3");
+    REQUIRE(CpuListToString({0, 1, 4, 5, 7}) == "0-1,4-5,7");
+    REQUIRE(ParseCpuList(CpuListToString({1, 2, 3, 6, 8, 9})) == std::vector<int>{1, 2, 3, 6, 8, 9});
+}
@@ -647,7 +647,7 @@ std::unique_ptr<Vst3Effect> Vst3HostImpl::CreatePlugin(PedalboardItem &pedalboar
 			}
 		}
 	}
-	for (ControlValue &controlValue : pedalboardItem.controlValues())
+	for (ControlValue &controlValue : pedalboardItem.mutableControlValues())
 	{
 		int32_t index = -1;
 		for (size_t i = 0; i < pluginInfo->controls().size(); ++i)
@@ -50,6 +50,7 @@
 
 #include "WebServerLog.hpp"
 #include "TemporaryFile.hpp"
+#include "Metrics.hpp"
 
 using namespace pipedal;
 using namespace std;
@@ -730,6 +731,7 @@ namespace pipedal
             server::connection_ptr webSocket;
             std::string fromAddress;
             std::shared_ptr<SocketHandler> socketHandler;
+            bool countedAsClient = false;
 
         private:
             // IWriteCallback
@@ -744,6 +746,15 @@ namespace pipedal
                 if (webSocket)
                 {
                     webSocket->send(text, websocketpp::frame::opcode::text);
+                    ++Metrics::Instance().websocketMessagesSent;
+                }
+            }
+            virtual void writeBinaryCallback(const void *data, size_t size)
+            {
+                if (webSocket)
+                {
+                    webSocket->send(data, size, websocketpp::frame::opcode::binary);
+                    ++Metrics::Instance().websocketMessagesSent;
                 }
             }
             virtual std::string getFromAddress() const
@@ -759,11 +770,21 @@ namespace pipedal
                     this->socketHandler->onSocketClosed();
                     this->socketHandler = nullptr;
                 }
+                if (countedAsClient)
+                {
+                    --Metrics::Instance().websocketClients;
+                }
                 webSocket = nullptr;
                 pServer = nullptr;
                 Lv2Log::info(SS("WebSocketSession closed. " << fromAddress));
             }
             using ptr = std::shared_ptr<WebSocketSession>;
+            // Data queued on the connection but not yet sent.
+            int64_t GetBufferedAmount()
+            {
+                auto webSocket = this->webSocket;
+                return webSocket ? (int64_t)webSocket->get_buffered_amount() : 0;
+            }
             WebSocketSession(WebServerImpl *pServer, server::connection_ptr &webSocket)
                 : pServer(pServer),
                   webSocket(webSocket)
@@ -794,6 +815,8 @@ namespace pipedal
 
                     socketHandler = pFactory->CreateHandler(requestUri);
                     socketHandler->setWriteCallback(this);
+                    ++Metrics::Instance().websocketClients;
+                    countedAsClient = true;
                 }
             }
             void on_close(connection_hdl hdl)
@@ -818,6 +841,17 @@ namespace pipedal
         std::recursive_mutex m_sessionsMutex;
         std::set<WebSocketSession::ptr, std::owner_less<WebSocketSession::ptr>> m_sessions;
 
+        int64_t GetWebsocketSendBufferBytes()
+        {
+            std::lock_guard<std::recursive_mutex> lock{m_sessionsMutex};
+            int64_t result = 0;
+            for (const auto &session : m_sessions)
+            {
+                result += session->GetBufferedAmount();
+            }
+            return result;
+        }
+
         void on_session_closed(WebSocketSession::ptr &session, connection_hdl hConnection)
         {
             std::lock_guard<std::recursive_mutex> lock{m_sessionsMutex};
@@ -855,6 +889,31 @@ namespace pipedal
             }
             return;
         };
+        void Forbidden(server::connection_type &connection, const std::string &filename)
+        {
+            try
+            {
+                // 403 error
+                std::stringstream ss;
+
+                ss << "<!doctype html><html><head>"
+                   << "<title>Error 403 (Forbidden)</title><body>"
+                   << "<h1>Error 403</h1>"
+                   << "<p>Access to " << HtmlHelper::HtmlEncode(filename) << " is not permitted from this address.</p>"
+                   << "</body></head></html>";
+
+                std::string body = ss.str();
+                connection.set_body(body);
+                std::stringstream ssLen;
+                ssLen << body.length();
+                connection.replace_header(HttpField::content_length, ssLen.str());
+                connection.set_status(websocketpp::http::status_code::forbidden);
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+
         void ServerError(server::connection_type &connection, const std::string &error)
         {
             try
@@ -1042,6 +1101,11 @@ namespace pipedal
                                 NotFound(*con, requestUri.str());
                                 return;
                             }
+                            if (ec == std::errc::permission_denied)
+                            {
+                                Forbidden(*con, requestUri.str());
+                                return;
+                            }
 
                             if (ec)
                             {
@@ -1065,6 +1129,11 @@ namespace pipedal
                                 NotFound(*con, requestUri.str());
                                 return;
                             }
+                            if (ec == std::errc::permission_denied)
+                            {
+                                Forbidden(*con, requestUri.str());
+                                return;
+                            }
 
                             if (ec)
                             {
@@ -1088,6 +1157,11 @@ namespace pipedal
                                 NotFound(*con, requestUri.str());
                                 return;
                             }
+                            if (ec == std::errc::permission_denied)
+                            {
+                                Forbidden(*con, requestUri.str());
+                                return;
+                            }
 
                             if (ec)
                             {
@@ -1370,6 +1444,10 @@ namespace pipedal
         virtual void DisplayIpAddresses() override;
 
         WebServerImpl(const std::string &address, int port, const char *rootPath, int threads, size_t maxUploadSize);
+        virtual ~WebServerImpl()
+        {
+            Metrics::Instance().SetWebsocketSendBufferSampler(nullptr);
+        }
     };
 } // namespace pipedal
 
@@ -1393,6 +1471,9 @@ WebServerImpl::WebServerImpl(const std::string &address, int port, const char *r
       maxUploadSize(maxUploadSize)
 {
     ::CustomPpConfig::max_http_body_size = maxUploadSize;
+    Metrics::Instance().SetWebsocketSendBufferSampler(
+        [this]()
+        { return GetWebsocketSendBufferBytes(); });
 }
 
 std::shared_ptr<WebServer> pipedal::WebServer::create(
@@ -87,6 +87,7 @@ public:
         virtual void close() = 0;
 
         virtual void writeCallback(const std::string& text) = 0;
+        virtual void writeBinaryCallback(const void *data, size_t size) = 0;
         virtual std::string getFromAddress() const = 0;
     };
 
@@ -113,6 +114,12 @@ public:
             writeCallback_->writeCallback(text);
         }
     }
+    void sendBinary(const void *data, size_t size) {
+        if (writeCallback_ != nullptr)
+        {
+            writeCallback_->writeBinaryCallback(data, size);
+        }
+    }
     virtual void OnSocketClosed()
     {
         writeCallback_ = nullptr;
@@ -34,6 +34,7 @@
 #include "PresetBundle.hpp"
 #include "json.hpp"
 #include "HotspotManager.hpp"
+#include "Metrics.hpp"
 
 #define OLD_PRESET_EXTENSION ".piPreset"
 #define PRESET_EXTENSION ".piPreset"
@@ -756,6 +757,81 @@ public:
     }
 };
 
+/* Prometheus text-format metrics. Reads lock-free counters, and samples websocket send buffers; never takes the model lock.
+   Like the other administrative endpoints, only served to clients on the local subnet.
+*/
+
+class MetricsHandler : public RequestHandler
+{
+public:
+    MetricsHandler()
+        : RequestHandler("/metrics")
+    {
+        Metrics::Instance(); // construct the counters off the audio thread.
+    }
+    virtual ~MetricsHandler() {}
+
+    virtual bool wants(const std::string &method, const uri &request_uri) const override
+    {
+        return request_uri.segment_count() == 1 && request_uri.segment(0) == "metrics";
+    }
+
+    virtual void head_response(
+        const uri &request_uri,
+        HttpRequest &req,
+        HttpResponse &res,
+        std::error_code &ec) override
+    {
+        // intercepted. See the other overload.
+    }
+
+    virtual void head_response(
+        const std::string &fromAddress,
+        const uri &request_uri,
+        HttpRequest &req,
+        HttpResponse &res,
+        std::error_code &ec) override
+    {
+        if (!IsOnLocalSubnet(fromAddress))
+        {
+            ec = std::make_error_code(std::errc::permission_denied);
+            return;
+        }
+        std::string response = Metrics::Instance().ToPrometheusText();
+        res.set(HttpField::content_type, "text/plain; version=0.0.4; charset=utf-8");
+        res.set(HttpField::cache_control, "no-cache");
+        res.setContentLength(response.length());
+    }
+
+    virtual void get_response(
+        const uri &request_uri,
+        HttpRequest &req,
+        HttpResponse &res,
+        std::error_code &ec) override
+    {
+        // intercepted. See the other overload.
+    }
+
+    virtual void get_response(
+        const std::string &fromAddress,
+        const uri &request_uri,
+        HttpRequest &req,
+        HttpResponse &res,
+        std::error_code &ec) override
+    {
+        if (!IsOnLocalSubnet(fromAddress))
+        {
+            ec = std::make_error_code(std::errc::permission_denied);
+            return;
+        }
+        std::string response = Metrics::Instance().ToPrometheusText();
+        res.set(HttpField::content_type, "text/plain; version=0.0.4; charset=utf-8");
+        res.set(HttpField::cache_control, "no-cache");
+        res.setContentLength(response.length());
+        res.setBody(response);
+    }
+};
+
 void pipedal::ConfigureWebServer(
     WebServer &server,
     PiPedalModel &model,
@@ -767,4 +843,6 @@ void pipedal::ConfigureWebServer(
 
     std::shared_ptr<DownloadIntercept> downloadIntercept = std::make_shared<DownloadIntercept>(&model);
     server.AddRequestHandler(downloadIntercept);
+
+    server.AddRequestHandler(std::make_shared<MetricsHandler>());
 }
@@ -41,37 +41,40 @@
 #include <iostream>
 #include <unistd.h> // for nice(
 #include <utility>
+#include <algorithm>
 #include "util.hpp"
 #include "SchedulerPriority.hpp"
+#include "ss.hpp"
 
 using namespace pipedal;
 
 const int RING_BUFFER_SIZE = 64 * 1024;
 
-Worker::Worker(const std::shared_ptr<HostWorkerThread> &pHostWorker, LilvInstance *lilvInstance_, const LV2_Worker_Interface *workerInterface_)
+Worker::Worker(const std::shared_ptr<HostWorkerPool> &pHostWorker, LilvInstance *lilvInstance_, const LV2_Worker_Interface *workerInterface_)
     : lilvInstance(lilvInstance_),
       pHostWorker(pHostWorker),
-      responseRingBuffer(RING_BUFFER_SIZE),
+      responseQueue(RING_BUFFER_SIZE),
+      requestQueue(RING_BUFFER_SIZE),
       workerInterface(workerInterface_)
 {
+    slot = pHostWorker->AddWorker(this);
 
     responseBuffer.resize(16 * 1024);
+    requestBuffer.resize(16 * 1024);
 }
 
 void Worker::Close()
 {
-    {
-        std::lock_guard lock(outstandingRequestMutex);
-        if (closed)
-            return;
-        closed = true;
-        exiting = true;
-    }
+    if (closed)
+        return;
+    closed = true;
+    exiting = true;
     WaitForAllResponses();
 }
 Worker::~Worker()
 {
     Close();
+    pHostWorker->RemoveWorker(this);
 }
 
 LV2_Worker_Status Worker::worker_respond_fn(LV2_Worker_Respond_Handle handle, uint32_t size, const void *data)
@@ -82,62 +85,34 @@ LV2_Worker_Status Worker::worker_respond_fn(LV2_Worker_Respond_Handle handle, ui
 
 LV2_Worker_Status Worker::WorkerRespond(uint32_t size, const void *data)
 {
+    ++outstandingResponses;
+    if (!responseQueue.write(size, data))
     {
-        std::lock_guard lock(outstandingRequestMutex);
-        ++outstandingResponses;
-    }
-    LV2_Worker_Status status;
-    if (responseRingBuffer.writeSpace() < sizeof(size) + size)
-    {
-        {
-            Lv2Log::warning(SS("LV2 Worker response too large: " << size << " bytes."));
-            std::lock_guard lock(outstandingRequestMutex);
-            --outstandingResponses;
-            // no need to notify, because outstandingRequests will be decremented after return.
-        }
+        Lv2Log::warning(SS("LV2 Worker response too large: " << size << " bytes."));
+        --outstandingResponses;
         return LV2_WORKER_ERR_NO_SPACE;
     }
-    else
-    {
-        if (!responseRingBuffer.write(sizeof(size), (uint8_t *)&size))
-        {
-            throw std::logic_error("Response queue sync lost.");
-        }
-        if (!responseRingBuffer.write(size, (uint8_t *)data))
-        {
-            throw std::logic_error("Response queue sync lost.");
-        }
-        return LV2_WORKER_SUCCESS;
-    }
+    pHostWorker->SignalResponse(slot);
+    return LV2_WORKER_SUCCESS;
 }
 
 bool Worker::EmitResponses()
 {
     bool emitted = false;
-    while (true)
+    uint32_t size;
+    while (responseQueue.peekSize(&size))
     {
-        if (!responseRingBuffer.isReadReady())
-        {
-            break;
-        }
-
         emitted = true;
-        uint32_t size;
-        responseRingBuffer.read(sizeof(size), (uint8_t *)&size);
         if (size > responseBuffer.size())
         {
             responseBuffer.resize(size); // allocation on the RT thread! But it's rare, and we have no choice.
         }
         uint8_t *pResponse = &(responseBuffer[0]);
 
-        responseRingBuffer.read(size, pResponse);
+        responseQueue.read(size, pResponse);
 
         workerInterface->work_response(lilvInstance->lv2_handle, size, pResponse);
-        {
-            std::lock_guard lock(outstandingRequestMutex);
-            --outstandingResponses;
-            cvOutstandingRequests.notify_all(); // must be done WITH the lock, since we may be destructed after the mutex is released.
-        }
+        --outstandingResponses;
     }
     return emitted;
 }
@@ -150,13 +125,10 @@ void Worker::WaitForAllResponses()
     {
         // can't do condition_variable::wait_until due to OS restrictions.
         // instead, sleep briefly, waiting for wait tasks to complete.
-        bool gotResponse = EmitResponses();
+        EmitResponses();
+        if (outstandingRequests == 0 && outstandingResponses == 0)
         {
-            std::unique_lock lock(outstandingRequestMutex);
-            if (outstandingRequests == 0 && outstandingResponses == 0)
-            {
-                break;
-            }
+            break;
         }
         std::chrono::seconds waitDuration = std::chrono::duration_cast<std::chrono::seconds>(Clock::now()-startTime);
         if (waitDuration.count() > 5) {
@@ -166,157 +138,387 @@ void Worker::WaitForAllResponses()
     }
 }
 
+bool Worker::WaitForPendingRequests(std::chrono::steady_clock::time_point deadline)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto POLL_INTERVAL = std::chrono::milliseconds(10);
+
+    std::unique_lock lock(pHostWorker->mutex);
+    while (outstandingRequests != 0)
+    {
+        auto now = Clock::now();
+        if (now >= deadline)
+        {
+            return false;
+        }
+        // (requests rejected on the audio thread don't signal, so re-check periodically.)
+        pHostWorker->cvRequestsComplete.wait_until(lock, std::min(deadline, now + POLL_INTERVAL));
+    }
+    return true;
+}
+
 LV2_Worker_Status Worker::ScheduleWork(
     uint32_t size,
     const void *data)
 {
+    // (increment before checking exiting, so that Close() either sees the request or we see exiting.)
+    // (called from the plugin's run() method, so the failure paths must not lock or notify.)
+    ++outstandingRequests;
+    if (exiting)
     {
-        std::lock_guard lock(outstandingRequestMutex);
-        ++outstandingRequests;
+        --outstandingRequests;
+        return LV2_Worker_Status::LV2_WORKER_ERR_UNKNOWN;
     }
     LV2_Worker_Status status = this->pHostWorker->ScheduleWork(this, size, data);
     if (status != LV2_Worker_Status::LV2_WORKER_SUCCESS)
     {
-        {
-            std::lock_guard lock(outstandingRequestMutex);
-            --outstandingRequests;
-            cvOutstandingRequests.notify_all(); // must be done WITH the lock!
-            return status; 
-        }
+        --outstandingRequests;
     }
     return status;
 }
 
-void HostWorkerThread::ThreadProc() noexcept
+void HostWorkerPool::ThreadProc(size_t threadIndex) noexcept
 {
     // run nice +2 (priority -2 on Windows)
-    SetThreadName("lv2_worker");
+    SetThreadName(SS("lv2_worker" << threadIndex));
     SetThreadPriority(SchedulerPriority::Lv2Scheduler);
 
-
     try
     {
         while (true)
         {
-            if (!requestRingBuffer.readWait())
-            {
-                return;
-            }
-            uint32_t size;
+            wakeSemaphore.acquire();
 
             Worker *pWorker;
-
-            if (!requestRingBuffer.read(sizeof(size), (uint8_t *)&size))
+            size_t bytesAvailable;
+            std::function<void()> task;
             {
-                throw PiPedalStateException("Working ringbuffer read failed.");
+                std::unique_lock lock(mutex);
+                if (closed)
+                {
+                    break;
+                }
+                CollectRequests_();
+                pWorker = Dequeue_();
+                if (pWorker == nullptr)
+                {
+                    if (tasks.empty())
+                    {
+                        continue; // another thread got there first.
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                else
+                {
+                    pWorker->running = true;
+                    pWorker->pendingPriority = WorkerPriority::Background;
+                }
+                if (HasReadyWorkers_() || !tasks.empty())
+                {
+                    wakeSemaphore.release(); // let another thread take the next one.
+                }
             }
-
-            if (!requestRingBuffer.read(sizeof(pWorker), (uint8_t *)&pWorker))
+            if (task)
             {
-                throw PiPedalStateException("Worker ringbuffer read failed.");
+                try
+                {
+                    task();
+                }
+                catch (const std::exception &e)
+                {
+                    Lv2Log::error(SS("Worker pool task failed. " << e.what()));
+                }
+                continue;
             }
-            size -= sizeof(pWorker);
+            // (requests written after this point are picked up when the worker is re-queued.)
+            bytesAvailable = pWorker->requestQueue.readSpace();
+            size_t requestCount = pWorker->RunPendingRequests(bytesAvailable);
 
-            if (size > dataBuffer.size())
             {
-                dataBuffer.resize(size);
+                std::lock_guard lock(mutex);
+                // requests signalled during the run update pendingPriority while the worker is still marked running.
+                CollectRequests_();
+                pWorker->running = false;
+                if (!pWorker->requestQueue.empty())
+                {
+                    // more work arrived while we were running.
+                    Append_(pWorker, pWorker->pendingPriority);
+                    wakeSemaphore.release();
+                }
+                else
+                {
+                    pWorker->scheduled = false;
+                }
             }
-            uint8_t *pData = &(dataBuffer[0]);
-            if (!requestRingBuffer.read(size, pData))
-            {
-                throw PiPedalStateException("Worker ringbuffer read failed.");
-            }
-            if (pWorker == nullptr) // signals close.
-            {
-                break;
-            }
-            pWorker->RunBackgroundTask(size, pData);
+            // must be the last access to pWorker, which may be deleted as soon as outstanding requests reach zero.
+            pWorker->OnRequestsComplete(requestCount);
         }
     }
     catch (const std::exception &e)
     {
         Lv2Log::error("Lv2 Worker thread proc exited abnormally. (%s)", e.what());
     }
-    requestRingBuffer.close();
 }
 
-HostWorkerThread::HostWorkerThread()
+HostWorkerPool::HostWorkerPool(size_t threadCount)
 {
-    this->dataBuffer.resize(16*1024);
-    pThread = std::make_unique<std::thread>([this]()
-                                            { this->ThreadProc(); });
+    if (threadCount == 0)
+    {
+        // leave a core for the audio thread.
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount > 1)
+        {
+            --threadCount;
+        }
+        if (threadCount == 0)
+        {
+            threadCount = 1;
+        }
+    }
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.push_back(std::make_unique<std::thread>([this, i]()
+                                                        { this->ThreadProc(i); }));
+    }
 }
 
-void HostWorkerThread::Close()
+void HostWorkerPool::Close()
 {
+    std::lock_guard lock{mutex};
+    if (closed)
+    {
+        return;
+    }
+    closed = true;
+    wakeSemaphore.release((std::ptrdiff_t)threads.size());
+}
+HostWorkerPool::~HostWorkerPool()
+{
+    // ask worker threads to terminate.
+    Close();
+    for (auto &thread : threads)
+    {
+        thread->join();
+    }
+    threads.clear();
+}
 
-    bool sendClose = false;
+void HostWorkerPool::CollectRequests_()
+{
+    uint64_t signalled = pendingRequests.exchange(0, std::memory_order_acquire);
+    if (signalled == 0)
+    {
+        return;
+    }
+    for (Worker *worker : workers)
     {
-        std::lock_guard lock{submitMutex};
-        if (!closed)
+        if ((signalled & worker->GetResponseMask()) == 0)
+        {
+            continue; // (a bit may be shared by several workers.)
+        }
+        int signal = worker->requestSignal.exchange(Worker::NO_REQUESTS, std::memory_order_acquire);
+        if (signal == Worker::NO_REQUESTS)
         {
-            closed = true;
-            sendClose = true;
+            continue;
         }
+        WorkerPriority priority = (WorkerPriority)signal;
+        if (!worker->scheduled)
+        {
+            if (worker->requestQueue.empty())
+            {
+                // the requests already ran, with an earlier dispatch. (A request written after this check signals again.)
+                continue;
+            }
+            worker->scheduled = true;
+            Append_(worker, priority);
+        }
+        else if (worker->running)
+        {
+            // applied when the worker is re-queued after the current run.
+            if (priority < worker->pendingPriority)
+            {
+                worker->pendingPriority = priority;
+            }
+        }
+        else if (priority < worker->queuedPriority)
+        {
+            // jump the queue.
+            Remove_(worker);
+            Append_(worker, priority);
+        }
+    }
+}
+
+bool HostWorkerPool::HasReadyWorkers_() const
+{
+    return readyLists[0].head != nullptr || readyLists[1].head != nullptr;
+}
+
+void HostWorkerPool::Append_(Worker *worker, WorkerPriority priority)
+{
+    ReadyList &list = readyLists[(int)priority];
+    worker->queuedPriority = priority;
+    worker->nextReady = nullptr;
+    if (list.tail)
+    {
+        list.tail->nextReady = worker;
     }
-    if (sendClose)
+    else
     {
-        ScheduleWork(nullptr, 0, nullptr);
+        list.head = worker;
     }
+    list.tail = worker;
 }
-HostWorkerThread::~HostWorkerThread()
+
+void HostWorkerPool::Remove_(Worker *worker)
 {
-    if (pThread)
+    ReadyList &list = readyLists[(int)worker->queuedPriority];
+    Worker *previous = nullptr;
+    for (Worker *p = list.head; p != nullptr; p = p->nextReady)
     {
-        // ask worker thread to terminate.
-        Close();
-        pThread->join();
-        pThread = nullptr;
+        if (p == worker)
+        {
+            if (previous)
+            {
+                previous->nextReady = p->nextReady;
+            }
+            else
+            {
+                list.head = p->nextReady;
+            }
+            if (list.tail == p)
+            {
+                list.tail = previous;
+            }
+            p->nextReady = nullptr;
+            return;
+        }
+        previous = p;
     }
 }
 
-LV2_Worker_Status HostWorkerThread::ScheduleWork(Worker *worker, size_t size, const void *data)
+Worker *HostWorkerPool::Dequeue_()
 {
-    std::lock_guard lock(submitMutex);
-
-    if (exiting)
+    for (ReadyList &list : readyLists)
     {
-        return LV2_Worker_Status::LV2_WORKER_ERR_NO_SPACE;
+        if (list.head)
+        {
+            Worker *result = list.head;
+            list.head = result->nextReady;
+            if (list.head == nullptr)
+            {
+                list.tail = nullptr;
+            }
+            result->nextReady = nullptr;
+            return result;
+        }
     }
-    if (worker == nullptr)
+    return nullptr;
+}
+
+void HostWorkerPool::Post(std::function<void()> &&task)
+{
     {
-        exiting = true;
+        std::lock_guard lock(mutex);
+        if (closed)
+        {
+            return;
+        }
+        tasks.push_back(std::move(task));
     }
+    wakeSemaphore.release();
+}
 
-    if (requestRingBuffer.writeSpace() < sizeof(worker) + sizeof(size) + size)
+LV2_Worker_Status HostWorkerPool::ScheduleWork(Worker *worker, size_t size, const void *data)
+{
+    // Realtime-safe: no locks. (Requests for a given worker come from one thread at a time.)
+    if (closed)
     {
         return LV2_Worker_Status::LV2_WORKER_ERR_NO_SPACE;
     }
-    size_t packetSizeL = (size + sizeof(worker));
-    uint32_t packetSize = (uint32_t)(packetSizeL);
-    if (packetSizeL != packetSize)
+    if (!worker->requestQueue.write(size, data))
     {
         return LV2_Worker_Status::LV2_WORKER_ERR_NO_SPACE;
     }
 
-    requestRingBuffer.write(sizeof(packetSize), (uint8_t *)&packetSize);
-    requestRingBuffer.write(sizeof(worker), (uint8_t *)&worker);
-    requestRingBuffer.write(size, (uint8_t *)data);
-    
+    // Interactive priority applies to the next request only; later requests revert to background priority.
+    int priority = (int)worker->priority.exchange(WorkerPriority::Background);
+    int previous = worker->requestSignal.load(std::memory_order_relaxed);
+    while (priority < previous &&
+           !worker->requestSignal.compare_exchange_weak(previous, priority, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    if (previous == Worker::NO_REQUESTS)
+    {
+        // first request since the pool last collected this worker.
+        pendingRequests.fetch_or(worker->GetResponseMask(), std::memory_order_release);
+        wakeSemaphore.release();
+    }
     return LV2_Worker_Status::LV2_WORKER_SUCCESS;
 }
 
-void Worker::RunBackgroundTask(size_t size, uint8_t *data)
+size_t Worker::RunPendingRequests(size_t bytesAvailable)
 {
-    workerInterface->work(lilvInstance->lv2_handle, worker_respond_fn, (LV2_Handle)this, size, data);
+    size_t requestCount = 0;
+    while (bytesAvailable >= sizeof(uint32_t))
     {
-        std::lock_guard lock { this->outstandingRequestMutex};
-        --this->outstandingRequests;
-        if (this->outstandingRequests == 0)
+        uint32_t size;
+        if (!requestQueue.peekSize(&size))
+        {
+            throw PiPedalStateException("Worker request queue read failed.");
+        }
+        if (size > requestBuffer.size())
         {
-            this->cvOutstandingRequests.notify_all();
+            requestBuffer.resize(size);
         }
+        uint8_t *pData = requestBuffer.data();
+        requestQueue.read(size, pData);
+        bytesAvailable -= sizeof(size) + size;
 
+        workerInterface->work(lilvInstance->lv2_handle, worker_respond_fn, (LV2_Handle)this, size, pData);
+        ++requestCount;
     }
+    return requestCount;
+}
 
+// Pool threads only.
+void Worker::OnRequestsComplete(size_t requestCount)
+{
+    // The pool can't be destroyed until this thread exits, so it's safe to notify after this worker may have been deleted.
+    // (Don't copy the shared_ptr: if it were the last reference, the pool would be destroyed on -- and try to join -- this thread.)
+    HostWorkerPool *pool = this->pHostWorker.get();
+    std::lock_guard lock(pool->mutex);
+    this->outstandingRequests -= (int64_t)requestCount;
+    pool->cvRequestsComplete.notify_all();
+}
+
+uint32_t HostWorkerPool::AddWorker(Worker *worker)
+{
+    std::lock_guard lock(mutex);
+    workers.push_back(worker);
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < slotUsage.size(); ++i)
+    {
+        if (slotUsage[i] < slotUsage[best])
+        {
+            best = i;
+        }
+    }
+    ++slotUsage[best];
+    return best;
+}
+
+void HostWorkerPool::RemoveWorker(Worker *worker)
+{
+    std::lock_guard lock(mutex);
+    for (auto i = workers.begin(); i != workers.end(); ++i)
+    {
+        if (*i == worker)
+        {
+            workers.erase(i);
+            break;
+        }
+    }
+    --slotUsage[worker->slot];
 }
@@ -38,72 +38,163 @@
 #include <mutex>
 #include <thread>
 #include "RingBuffer.hpp"
+#include "LockFreeQueue.hpp"
 #include <memory>
 #include "inverting_mutex.hpp"
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <array>
+#include <semaphore>
+#include <deque>
+#include <functional>
 
 
 namespace pipedal {
 
     class Worker;
 
-    class HostWorkerThread {
+    enum class WorkerPriority {
+        Interactive = 0, // work requested in response to user actions.
+        Background = 1,  // preloading of files while constructing pedalboards.
+    };
+
+    /// @brief A pool of threads that execute LV2 worker requests.
+    ///
+    /// Requests for any given Worker execute serially, in the order they were scheduled. Requests for different Workers
+    /// run in parallel. Interactive work is dispatched ahead of background work.
+    ///
+    /// Workers that have responses waiting set their bit in a shared pending-responses mask, so the audio thread
+    /// only visits plugins that actually have responses. Workers share bits when there are more than 64 of them.
+    ///
+    /// The request side works the same way in the other direction. ScheduleWork writes to the worker's own request
+    /// queue, records the request's priority in the worker, sets the worker's bit in the pending-requests mask, and
+    /// posts a semaphore that pool threads wait on. Pool threads collect the signalled workers into the ready lists.
+    /// No lock is shared between the audio thread and the pool threads.
+    class HostWorkerPool {
     public:
-        HostWorkerThread();
-        ~HostWorkerThread();
+        // threadCount == 0: size to the number of available cores.
+        HostWorkerPool(size_t threadCount = 0);
+        ~HostWorkerPool();
 
         void Close();
+        size_t GetThreadCount() const { return threads.size(); }
         LV2_Worker_Status ScheduleWork(Worker*worker, size_t size, const void*data);
-    private:
-        bool closed = false;
-        std::unique_ptr<std::thread> pThread;
-        void ThreadProc() noexcept;
 
-        RingBuffer<false,true> requestRingBuffer;
-        bool exiting = false;
-        inverting_mutex submitMutex;
-
-        std::vector<uint8_t> dataBuffer;
-
-        
+        // Non-realtime. Run a task on a pool thread, after any worker requests that are already waiting.
+        // Tasks that are still queued when the pool closes are discarded.
+        void Post(std::function<void()> &&task);
 
+        // Realtime-safe. Returns and clears the pending-responses mask.
+        uint64_t TakePendingResponses() { return pendingResponses.exchange(0, std::memory_order_acquire); }
+    private:
+        friend class Worker;
+        // Register a worker, and assign it a bit in the pending-requests and pending-responses masks.
+        uint32_t AddWorker(Worker *worker);
+        void RemoveWorker(Worker *worker);
+        void SignalResponse(uint32_t slot) { pendingResponses.fetch_or(((uint64_t)1) << slot, std::memory_order_release); }
+
+        std::atomic<uint64_t> pendingResponses = 0;
+        std::atomic<uint64_t> pendingRequests = 0;
+        std::counting_semaphore<> wakeSemaphore{0}; // posted when there may be work to collect or dispatch.
+
+        void ThreadProc(size_t threadIndex) noexcept;
+
+        // all require the mutex to be held.
+        void CollectRequests_();
+        void Append_(Worker *worker, WorkerPriority priority);
+        void Remove_(Worker *worker);
+        Worker *Dequeue_();
+        bool HasReadyWorkers_() const;
+
+        struct ReadyList {
+            Worker *head = nullptr;
+            Worker *tail = nullptr;
+        };
+
+        std::atomic<bool> closed = false;
+        std::vector<std::unique_ptr<std::thread>> threads;
+
+        // Shared by pool threads and non-realtime callers only.
+        inverting_mutex mutex;
+        std::condition_variable_any cvRequestsComplete; // signalled when a Worker's outstandingRequests is decremented.
+        std::vector<Worker *> workers;
+        std::array<size_t, 64> slotUsage{};
+        ReadyList readyLists[2]; // indexed by WorkerPriority.
+        std::deque<std::function<void()>> tasks;
     };
 
 	class Worker {
 
 	private:
-        std::shared_ptr<HostWorkerThread> pHostWorker = nullptr;
+        friend class HostWorkerPool;
+
+        std::shared_ptr<HostWorkerPool> pHostWorker = nullptr;
         LilvInstance*lilvInstance;
         const LV2_Worker_Interface*workerInterface;
 
         bool closed = false;
-        bool exiting = false;
-        RingBuffer<true,false> responseRingBuffer;
+        std::atomic<bool> exiting = false;
+
+        // Written only by the pool thread running this worker; read only by the audio thread.
+        LockFreePacketQueue responseQueue;
+        uint32_t slot; // bit in the pool's pending-requests and pending-responses masks.
 
         std::vector<uint8_t> responseBuffer;
 
+        // Written by ScheduleWork; read only by the pool thread running this worker.
+        LockFreePacketQueue requestQueue;
+        // Highest priority of the requests written since the pool last collected this worker (NO_REQUESTS if none).
+        static constexpr int NO_REQUESTS = 2;
+        std::atomic<int> requestSignal = NO_REQUESTS;
+
+        // Pool scheduling state. Protected by HostWorkerPool::mutex.
+        Worker *nextReady = nullptr;
+        bool scheduled = false; // in a ready list, or running.
+        bool running = false;
+        WorkerPriority queuedPriority = WorkerPriority::Background;
+        WorkerPriority pendingPriority = WorkerPriority::Background; // of requests scheduled while running.
+
+        std::atomic<WorkerPriority> priority = WorkerPriority::Background;
+        std::vector<uint8_t> requestBuffer; // only accessed by the pool thread running this worker.
+
         static LV2_Worker_Status worker_respond_fn(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data);
 
 
         LV2_Worker_Status WorkerRespond(uint32_t size,const void*data);
 
-        inverting_mutex outstandingRequestMutex;
-        std::condition_variable cvOutstandingRequests;
-        int64_t outstandingRequests = 0;
-        int64_t outstandingResponses = 0;
+        // (atomics rather than a mutex, so that the audio thread never contends with worker threads.)
+        // Pool threads decrement outstandingRequests with HostWorkerPool::mutex held and signal cvRequestsComplete.
+        // ScheduleWork (on the audio thread) undoes its own increment with a plain decrement, which waiters pick up by polling.
+        std::atomic<int64_t> outstandingRequests = 0;
+        std::atomic<int64_t> outstandingResponses = 0;
         void WaitForAllResponses();
+
+        size_t RunPendingRequests(size_t bytesAvailable);
+        void OnRequestsComplete(size_t requestCount);
 	public:
-		Worker(const std::shared_ptr<HostWorkerThread>& pHostWorker,LilvInstance *instance, const LV2_Worker_Interface *iface);
+		Worker(const std::shared_ptr<HostWorkerPool>& pHostWorker,LilvInstance *instance, const LV2_Worker_Interface *iface);
         ~Worker();
         void Close();
 
+        // Priority of the next scheduled request. Reverts to Background once that request has been queued,
+        // so the worker drops back to background priority when the request completes.
+        void SetPriority(WorkerPriority priority) { this->priority = priority; }
+        WorkerPriority GetPriority() const { return this->priority; }
+
         LV2_Worker_Status ScheduleWork(
             uint32_t size,
             const void *data);
 
-        void RunBackgroundTask(size_t size, uint8_t*data);
-        
+        // Bit in HostWorkerPool's pending-responses mask that is set when this worker has responses.
+        uint64_t GetResponseMask() const { return ((uint64_t)1) << slot; }
+
+        // Deliver responses to the plugin. Call on the audio thread.
         bool EmitResponses();
 
+        // Wait until all scheduled requests have executed (responses may still be pending). Returns false on timeout.
+        bool WaitForPendingRequests(std::chrono::steady_clock::time_point deadline);
+
 
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2024 Robin Davies
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pch.h"
+#include "catch.hpp"
+#include "Worker.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace pipedal;
+
+namespace
+{
+    // A fake plugin whose work() records the requests it executes. Requests with value < 0 block until released.
+    class TestPlugin
+    {
+    public:
+        TestPlugin(std::vector<int> *log, std::mutex *logMutex)
+            : log(log), logMutex(logMutex)
+        {
+            instance.lv2_handle = (LV2_Handle)this;
+            iface.work = &TestPlugin::work;
+        }
+
+        LilvInstance instance{};
+        LV2_Worker_Interface iface{};
+
+        std::atomic<bool> running = false;
+        bool overlapped = false;
+
+        static std::atomic<bool> gateOpen;
+        static std::atomic<bool> blocked;
+
+    private:
+        std::vector<int> *log;
+        std::mutex *logMutex;
+
+        static LV2_Worker_Status work(LV2_Handle handle, LV2_Worker_Respond_Function, LV2_Worker_Respond_Handle, uint32_t size, const void *data)
+        {
+            TestPlugin *this_ = (TestPlugin *)handle;
+            if (this_->running.exchange(true))
+            {
+                this_->overlapped = true;
+            }
+            int value = *(const int *)data;
+            if (value < 0)
+            {
+                blocked = true;
+                while (!gateOpen)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            {
+                std::lock_guard lock(*this_->logMutex);
+                this_->log->push_back(value);
+            }
+            this_->running = false;
+            return LV2_WORKER_SUCCESS;
+        }
+    };
+    std::atomic<bool> TestPlugin::gateOpen = false;
+    std::atomic<bool> TestPlugin::blocked = false;
+
+    void Schedule(Worker &worker, int value)
+    {
+        REQUIRE(worker.ScheduleWork(sizeof(value), &value) == LV2_WORKER_SUCCESS);
+    }
+
+    // Occupy the pool's only thread until ReleaseGate() is called.
+    void BlockPool(Worker &worker)
+    {
+        TestPlugin::gateOpen = false;
+        TestPlugin::blocked = false;
+        Schedule(worker, -1);
+        while (!TestPlugin::blocked)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    void ReleaseGate()
+    {
+        TestPlugin::gateOpen = true;
+    }
+
+    bool WaitFor(Worker &worker)
+    {
+        return worker.WaitForPendingRequests(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    }
+}
+
+TEST_CASE("HostWorkerPool ordering", "[worker_pool][Build][Dev]")
+{
+    std::vector<int> log;
+    std::mutex logMutex;
+    auto pool = std::make_shared<HostWorkerPool>(4);
+
+    // requests for one worker run serially, in order, even with idle threads available.
+    TestPlugin plugin(&log, &logMutex);
+    {
+        Worker worker(pool, &plugin.instance, &plugin.iface);
+        constexpr int N = 1000;
+        for (int i = 0; i < N; ++i)
+        {
+            Schedule(worker, i);
+            if (i % 64 == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        REQUIRE(WaitFor(worker));
+        REQUIRE(!plugin.overlapped);
+        REQUIRE(log.size() == N);
+        for (int i = 0; i < N; ++i)
+        {
+            REQUIRE(log[i] == i);
+        }
+    }
+}
+
+TEST_CASE("HostWorkerPool priority", "[worker_pool][Build][Dev]")
+{
+    std::vector<int> log;
+    std::mutex logMutex;
+    auto pool = std::make_shared<HostWorkerPool>(1);
+
+    TestPlugin blocker(&log, &logMutex), background1(&log, &logMutex), background2(&log, &logMutex), interactive(&log, &logMutex);
+    Worker blockerWorker(pool, &blocker.instance, &blocker.iface);
+    Worker background1Worker(pool, &background1.instance, &background1.iface);
+    Worker background2Worker(pool, &background2.instance, &background2.iface);
+    Worker interactiveWorker(pool, &interactive.instance, &interactive.iface);
+
+    SECTION("Interactive work is dispatched ahead of background work")
+    {
+        BlockPool(blockerWorker);
+        Schedule(background1Worker, 1);
+        Schedule(background2Worker, 2);
+        interactiveWorker.SetPriority(WorkerPriority::Interactive);
+        Schedule(interactiveWorker, 3);
+        ReleaseGate();
+
+        REQUIRE(WaitFor(background1Worker));
+        REQUIRE(WaitFor(background2Worker));
+        REQUIRE(WaitFor(interactiveWorker));
+        REQUIRE(log == std::vector<int>{-1, 3, 1, 2});
+    }
+    SECTION("A queued worker is promoted")
+    {
+        BlockPool(blockerWorker);
+        Schedule(background1Worker, 1);
+        Schedule(interactiveWorker, 3);
+        interactiveWorker.SetPriority(WorkerPriority::Interactive);
+        Schedule(interactiveWorker, 4);
+        ReleaseGate();
+
+        REQUIRE(WaitFor(background1Worker));
+        REQUIRE(WaitFor(interactiveWorker));
+        REQUIRE(log == std::vector<int>{-1, 3, 4, 1});
+    }
+    SECTION("A running worker is promoted when it is re-queued")
+    {
+        BlockPool(blockerWorker);
+        Schedule(background1Worker, 1);
+        Schedule(background2Worker, 2);
+        blockerWorker.SetPriority(WorkerPriority::Interactive);
+        Schedule(blockerWorker, 3);
+        ReleaseGate();
+
+        REQUIRE(WaitFor(blockerWorker));
+        REQUIRE(WaitFor(background1Worker));
+        REQUIRE(WaitFor(background2Worker));
+        REQUIRE(log == std::vector<int>{-1, 3, 1, 2});
+    }
+}
+
+TEST_CASE("HostWorkerPool rejected requests", "[worker_pool][Build][Dev]")
+{
+    std::vector<int> log;
+    std::mutex logMutex;
+    auto pool = std::make_shared<HostWorkerPool>(1);
+    TestPlugin plugin(&log, &logMutex);
+    Worker worker(pool, &plugin.instance, &plugin.iface);
+
+    // a request that doesn't fit is rejected without leaving an outstanding request behind.
+    std::vector<uint8_t> tooLarge(1024 * 1024);
+    REQUIRE(worker.ScheduleWork((uint32_t)tooLarge.size(), tooLarge.data()) != LV2_WORKER_SUCCESS);
+    REQUIRE(worker.WaitForPendingRequests(std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+    REQUIRE(log.empty());
+}
+
+TEST_CASE("HostWorkerPool posted tasks", "[worker_pool][Build][Dev]")
+{
+    HostWorkerPool pool(2);
+    std::mutex mutex;
+    std::condition_variable cvDone;
+    int completed = 0;
+    const int TASK_COUNT = 20;
+    for (int i = 0; i < TASK_COUNT; ++i)
+    {
+        pool.Post([&, i]()
+                  {
+                      if (i == 0)
+                      {
+                          throw std::runtime_error("Expected error."); // logged; must not stop the pool thread.
+                      }
+                      std::lock_guard lock(mutex);
+                      ++completed;
+                      cvDone.notify_all(); });
+    }
+    std::unique_lock lock(mutex);
+    REQUIRE(cvDone.wait_for(lock, std::chrono::seconds(10), [&]()
+                            { return completed == TASK_COUNT - 1; }));
+}
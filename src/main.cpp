@@ -45,6 +45,8 @@
 #include <signal.h>
 #include <semaphore.h>
 #include "SchedulerPriority.hpp"
+#include "ThreadPlacement.hpp"
+#include "Telemetry.hpp"
 
 #include <systemd/sd-daemon.h>
 
@@ -234,6 +236,12 @@ int main(int argc, char *argv[])
         configuration.SetSocketServerEndpoint(portOption);
     }
 
+    // before any threads are created, so that they inherit housekeeping CPU affinity.
+    ConfigureThreadPlacement(
+        configuration.GetThreadPlacement(),
+        configuration.GetRealtimeCpus(),
+        configuration.GetHousekeepingCpus());
+
     uint16_t port;
     std::shared_ptr<WebServer> server;
     try
@@ -310,6 +318,7 @@ int main(int argc, char *argv[])
                     g_restart = true;
                     raise(SIGTERM); // throws an exception under gdb, but correctly restarts the service when running live.
                 });
+            model.SetTelemetrySegmentName(TELEMETRY_SHM_NAME);
 
             model.Init(configuration);
 